@@ -0,0 +1,129 @@
+/*
+
+	uWSGI request arenas
+
+	Each core has a bump allocator for the memory living as long as the
+	request (routing translations, transformations, response headers, logvars...).
+
+	Allocations are never freed one by one, the whole arena is reset
+	at the end of the request. When the arena is full, memory is taken from the heap
+	and released on reset, the next cycles will use a bigger arena (up to UWSGI_ARENA_MAX),
+	so in the steady state request handling does not call malloc()/free().
+
+	Heap memory can be attached to the arena (uwsgi_arena_adopt) to be released on reset.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+#define UWSGI_ARENA_ALIGN 16
+#define UWSGI_ARENA_MAX (1024 * 1024)
+
+struct uwsgi_arena_block {
+	struct uwsgi_arena_block *next;
+	// NULL for overflow blocks (the memory follows the header)
+	void *ptr;
+};
+
+struct uwsgi_arena *uwsgi_arena_new(size_t len) {
+	struct uwsgi_arena *ua = uwsgi_calloc(sizeof(struct uwsgi_arena));
+	if (len < UWSGI_ARENA_ALIGN)
+		len = UWSGI_ARENA_ALIGN;
+	ua->base = uwsgi_malloc(len);
+	ua->len = len;
+	return ua;
+}
+
+void *uwsgi_arena_alloc(struct uwsgi_arena *ua, size_t size) {
+	size = (size + (UWSGI_ARENA_ALIGN - 1)) & ~((size_t) UWSGI_ARENA_ALIGN - 1);
+	ua->used += size;
+
+	if (ua->pos + size <= ua->len) {
+		void *ptr = ua->base + ua->pos;
+		ua->pos += size;
+		return ptr;
+	}
+
+	// the arena is full, fallback to the heap
+	struct uwsgi_arena_block *uab = uwsgi_malloc(sizeof(struct uwsgi_arena_block) + size);
+	uab->ptr = NULL;
+	uab->next = ua->blocks;
+	ua->blocks = uab;
+	ua->overflows++;
+	return ((char *) uab) + sizeof(struct uwsgi_arena_block);
+}
+
+void *uwsgi_arena_calloc(struct uwsgi_arena *ua, size_t size) {
+	void *ptr = uwsgi_arena_alloc(ua, size);
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+// release the heap memory pointed by ptr on the next reset
+void uwsgi_arena_adopt(struct uwsgi_arena *ua, void *ptr) {
+	struct uwsgi_arena_block *uab = uwsgi_arena_alloc(ua, sizeof(struct uwsgi_arena_block));
+	uab->ptr = ptr;
+	uab->next = ua->blocks;
+	ua->blocks = uab;
+}
+
+void uwsgi_arena_reset(struct uwsgi_arena *ua) {
+	// blocks are in LIFO order, so adopted pointers are released before the blocks holding them
+	struct uwsgi_arena_block *uab = ua->blocks;
+	while (uab) {
+		struct uwsgi_arena_block *next = uab->next;
+		if (uab->ptr) {
+			free(uab->ptr);
+		}
+		else {
+			free(uab);
+		}
+		uab = next;
+	}
+	ua->blocks = NULL;
+
+	// the arena was too small, grow it for the next cycles
+	if (ua->used > ua->len && ua->len < UWSGI_ARENA_MAX) {
+		size_t new_len = ua->len;
+		while (new_len < ua->used && new_len < UWSGI_ARENA_MAX) {
+			new_len *= 2;
+		}
+		free(ua->base);
+		ua->base = uwsgi_malloc(new_len);
+		ua->len = new_len;
+	}
+
+	ua->pos = 0;
+	ua->used = 0;
+}
+
+char *uwsgi_arena_strncpy(struct uwsgi_arena *ua, char *s, size_t len) {
+	char *ptr = uwsgi_arena_alloc(ua, len + 1);
+	memcpy(ptr, s, len);
+	ptr[len] = 0;
+	return ptr;
+}
+
+// get the arena of the core managing the request
+struct uwsgi_arena *uwsgi_req_arena(struct wsgi_request *wsgi_req) {
+	struct uwsgi_arena **ua = &uwsgi.request_arenas[wsgi_req->async_id];
+	if (!*ua) {
+		*ua = uwsgi_arena_new(uwsgi.request_arena_size);
+	}
+	return *ua;
+}
+
+void *uwsgi_req_alloc(struct wsgi_request *wsgi_req, size_t size) {
+	return uwsgi_arena_alloc(uwsgi_req_arena(wsgi_req), size);
+}
+
+void uwsgi_req_arena_reset(struct wsgi_request *wsgi_req) {
+	if (!uwsgi.request_arenas || !uwsgi.request_arenas[wsgi_req->async_id])
+		return;
+	struct uwsgi_arena *ua = uwsgi.request_arenas[wsgi_req->async_id];
+	uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].arena_overflows += ua->overflows;
+	ua->overflows = 0;
+	uwsgi_arena_reset(ua);
+}
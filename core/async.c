@@ -38,6 +38,9 @@ void uwsgi_async_init() {
 	uwsgi_add_sockets_to_queue(uwsgi.async_queue, -1);
 
 	uwsgi.rb_async_timeouts = uwsgi_init_rb_timer();
+	if (uwsgi.async_timer_wheel) {
+		uwsgi.async_wheel = uwsgi_init_timer_wheel(uwsgi_now());
+	}
 
 	// optimization, this array maps file descriptor to requests
         uwsgi.async_waiting_fd_table = uwsgi_calloc(sizeof(struct wsgi_request *) * uwsgi.max_fd);
@@ -117,7 +120,10 @@ struct wsgi_request *find_first_available_wsgi_req() {
 }
 
 void async_reset_request(struct wsgi_request *wsgi_req) {
-	if (wsgi_req->async_timeout) {
+	if (uwsgi.async_wheel) {
+		uwsgi_del_wheel_timer(uwsgi.async_wheel, &wsgi_req->async_wheel_timeout);
+	}
+	else if (wsgi_req->async_timeout) {
 		uwsgi_del_rb_timer(uwsgi.rb_async_timeouts, wsgi_req->async_timeout);
 		free(wsgi_req->async_timeout);
 		wsgi_req->async_timeout = NULL;
@@ -135,11 +141,28 @@ void async_reset_request(struct wsgi_request *wsgi_req) {
 	wsgi_req->waiting_fds = NULL;
 }
 
+static void async_expire_timeout(struct wsgi_request *wsgi_req) {
+	// timeout expired
+	wsgi_req->async_timed_out = 1;
+	// reset the request
+	async_reset_request(wsgi_req);
+	// push it in the runqueue
+	runqueue_push(wsgi_req);
+}
+
 static void async_expire_timeouts(uint64_t now) {
 
 	struct wsgi_request *wsgi_req;
 	struct uwsgi_rb_timer *urbt;
 
+	if (uwsgi.async_wheel) {
+		struct uwsgi_wheel_timer *uwt;
+		while ((uwt = uwsgi_expired_wheel_timer(uwsgi.async_wheel, now))) {
+			async_expire_timeout((struct wsgi_request *) uwt->data);
+		}
+		return;
+	}
+
 	for (;;) {
 
 		urbt = uwsgi_min_rb_timer(uwsgi.rb_async_timeouts, NULL);
@@ -149,12 +172,7 @@ static void async_expire_timeouts(uint64_t now) {
 
 		if (urbt->value <= now) {
 			wsgi_req = (struct wsgi_request *) urbt->data;
-			// timeout expired
-			wsgi_req->async_timed_out = 1;
-			// reset the request
-			async_reset_request(wsgi_req);
-			// push it in the runqueue
-			runqueue_push(wsgi_req);
+			async_expire_timeout(wsgi_req);
 			continue;
 		}
 
@@ -207,6 +225,7 @@ static int async_wait_fd_read(int fd, int timeout) {
 	struct wsgi_request *wsgi_req = current_wsgi_req();
 
 	wsgi_req->async_ready_fd = 0;
+	uwsgi_response_flush_current();
 
 	if (async_add_fd_read(wsgi_req, fd, timeout)) {
 		return -1;
@@ -226,6 +245,7 @@ static int async_wait_fd_read2(int fd0, int fd1, int timeout, int *fd) {
         struct wsgi_request *wsgi_req = current_wsgi_req();
 
         wsgi_req->async_ready_fd = 0;
+        uwsgi_response_flush_current();
 
         if (async_add_fd_read(wsgi_req, fd0, timeout)) {
                 return -1;
@@ -264,7 +284,13 @@ void async_add_timeout(struct wsgi_request *wsgi_req, int timeout) {
 
 	wsgi_req->async_ready_fd = 0;
 
-	if (timeout > 0 && wsgi_req->async_timeout == NULL) {
+	if (timeout > 0 && uwsgi.async_wheel) {
+		// already armed timers are not extended
+		if (!wsgi_req->async_wheel_timeout.list) {
+			uwsgi_add_wheel_timer(uwsgi.async_wheel, &wsgi_req->async_wheel_timeout, uwsgi_now() + timeout, wsgi_req);
+		}
+	}
+	else if (timeout > 0 && wsgi_req->async_timeout == NULL) {
 		wsgi_req->async_timeout = uwsgi_add_rb_timer(uwsgi.rb_async_timeouts, uwsgi_now() + timeout, wsgi_req);
 	}
 
@@ -389,6 +415,7 @@ end:
 
 static int uwsgi_async_wait_milliseconds_hook(int timeout) {
 	struct wsgi_request *wsgi_req = current_wsgi_req();
+	uwsgi_response_flush_current();
 	timeout = timeout / 1000;
 	if (!timeout) timeout = 1;
 	async_add_timeout(wsgi_req, timeout);
@@ -452,6 +479,12 @@ void async_loop() {
 		if (uwsgi.async_runqueue) {
 			timeout = 0;
 		}
+		else if (uwsgi.async_wheel) {
+			timeout = uwsgi_wheel_timer_next(uwsgi.async_wheel, now);
+			if (timeout == 0) {
+				async_expire_timeouts(now);
+			}
+		}
 		else {
 			min_timeout = uwsgi_min_rb_timer(uwsgi.rb_async_timeouts, NULL);
 			if (min_timeout) {
@@ -500,31 +533,35 @@ void async_loop() {
 
 					is_a_new_connection = 1;
 
-					uwsgi.wsgi_req = find_first_available_wsgi_req();
-					if (uwsgi.wsgi_req == NULL) {
-						uwsgi_async_queue_is_full((time_t)now);
-						break;
-					}
-
-					// on error re-insert the request in the queue
-					wsgi_req_setup(uwsgi.wsgi_req, uwsgi.wsgi_req->async_id, uwsgi_sock);
-					if (wsgi_req_simple_accept(uwsgi.wsgi_req, interesting_fd)) {
-						uwsgi.async_queue_unused_ptr++;
-						uwsgi.async_queue_unused[uwsgi.async_queue_unused_ptr] = uwsgi.wsgi_req;
-						break;
-					}
-
-					if (wsgi_req_async_recv(uwsgi.wsgi_req)) {
-						uwsgi.async_queue_unused_ptr++;
-						uwsgi.async_queue_unused[uwsgi.async_queue_unused_ptr] = uwsgi.wsgi_req;
-						break;
-					}
-
-					// by default the core is in UWSGI_AGAIN mode
-					uwsgi.wsgi_req->async_status = UWSGI_AGAIN;
-					// some protocol (like zeromq) do not need additional parsing, just push it in the runqueue
-					if (uwsgi.wsgi_req->do_not_add_to_async_queue) {
-						runqueue_push(uwsgi.wsgi_req);
+					// drain up to --accept-batch pending connections (the socket is non-blocking)
+					int accepted;
+					for (accepted = 0; accepted < uwsgi.accept_batch; accepted++) {
+						uwsgi.wsgi_req = find_first_available_wsgi_req();
+						if (uwsgi.wsgi_req == NULL) {
+							uwsgi_async_queue_is_full((time_t)now);
+							break;
+						}
+
+						// on error re-insert the request in the queue
+						wsgi_req_setup(uwsgi.wsgi_req, uwsgi.wsgi_req->async_id, uwsgi_sock);
+						if (wsgi_req_simple_accept(uwsgi.wsgi_req, interesting_fd)) {
+							uwsgi.async_queue_unused_ptr++;
+							uwsgi.async_queue_unused[uwsgi.async_queue_unused_ptr] = uwsgi.wsgi_req;
+							break;
+						}
+
+						if (wsgi_req_async_recv(uwsgi.wsgi_req)) {
+							uwsgi.async_queue_unused_ptr++;
+							uwsgi.async_queue_unused[uwsgi.async_queue_unused_ptr] = uwsgi.wsgi_req;
+							continue;
+						}
+
+						// by default the core is in UWSGI_AGAIN mode
+						uwsgi.wsgi_req->async_status = UWSGI_AGAIN;
+						// some protocol (like zeromq) do not need additional parsing, just push it in the runqueue
+						if (uwsgi.wsgi_req->do_not_add_to_async_queue) {
+							runqueue_push(uwsgi.wsgi_req);
+						}
 					}
 
 					break;
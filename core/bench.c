@@ -0,0 +1,906 @@
+/*
+
+	uWSGI load generator (--bench <addr>)
+
+	Drives a server with the uwsgi protocol, HTTP, raw payloads or websockets messages
+	using a pool of non-blocking connections (--bench-concurrency) spread over
+	one or more threads (--bench-threads), each one with its own event queue.
+
+	Requests are sent in batches of --bench-pipeline items (http keepalive, raw with
+	--bench-expect and websockets), uwsgi protocol and non-keepalive http use a
+	connection per request.
+
+	Latency is measured from the first byte written to the end of the response
+	(connect and websockets handshake are excluded) and recorded in the same log-linear
+	histograms used by --histograms.
+
+	The run stops after --bench-requests requests (default 10000) or after --bench-duration
+	seconds. t/bench/ contains a set of standard scenarios.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+#define UWSGI_BENCH_UWSGI 0
+#define UWSGI_BENCH_HTTP 1
+#define UWSGI_BENCH_RAW 2
+#define UWSGI_BENCH_WEBSOCKET 3
+
+#define UWSGI_BENCH_CONNECTING 0
+#define UWSGI_BENCH_HANDSHAKE 1
+#define UWSGI_BENCH_HANDSHAKE_RESPONSE 2
+#define UWSGI_BENCH_WRITING 3
+#define UWSGI_BENCH_READING 4
+
+static char *uwsgi_bench_protocols[] = { "uwsgi", "http", "raw", "websocket" };
+
+static struct uwsgi_bench {
+	int protocol;
+	int keepalive;
+	struct uwsgi_buffer *request;
+	struct uwsgi_buffer *handshake;
+	uint64_t issued;
+	uint64_t deadline;
+	volatile int stop;
+} ubench;
+
+struct uwsgi_bench_conn {
+	int fd;
+	int status;
+	int handshaken;
+	int server_close;
+	// the connection already completed a batch
+	int reused;
+	struct uwsgi_buffer *in;
+	size_t out_pos;
+	uint64_t batch;
+	uint64_t done;
+	uint64_t batch_start;
+	uint64_t last_io;
+	// size and status of the current response (once known)
+	size_t need;
+	int need_status;
+};
+
+struct uwsgi_bench_thread {
+	pthread_t tid;
+	int queue;
+	int nconns;
+	int active;
+	struct uwsgi_bench_conn *conns;
+	struct uwsgi_bench_conn **table;
+	int table_size;
+
+	uint64_t requests;
+	uint64_t errors;
+	uint64_t timeouts;
+	uint64_t connections;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t status[6];
+	uint64_t min;
+	struct uwsgi_histogram latency;
+};
+
+static struct uwsgi_buffer *uwsgi_bench_body() {
+	if (uwsgi.bench.body_file) {
+		struct uwsgi_buffer *ub = uwsgi_buffer_from_file(uwsgi.bench.body_file);
+		if (!ub) {
+			uwsgi_error_open(uwsgi.bench.body_file);
+			exit(1);
+		}
+		return ub;
+	}
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	if (uwsgi.bench.body) {
+		if (uwsgi_buffer_append(ub, uwsgi.bench.body, strlen(uwsgi.bench.body)))
+			goto error;
+	}
+	return ub;
+error:
+	uwsgi_log("[uwsgi-bench] unable to build the request body\n");
+	exit(1);
+}
+
+static char *uwsgi_bench_host() {
+	char *host = uwsgi_str(uwsgi.bench.address);
+	// unix sockets
+	if (!strchr(host, ':')) {
+		free(host);
+		return uwsgi_str("localhost");
+	}
+	if (host[0] == ':') {
+		char *tmp = uwsgi_concat2("localhost", host);
+		free(host);
+		return tmp;
+	}
+	return host;
+}
+
+static struct uwsgi_buffer *uwsgi_bench_build_uwsgi(struct uwsgi_buffer *body) {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	char *host = uwsgi_bench_host();
+	char *path_info = uwsgi_str(uwsgi.bench.uri);
+	char *query_string = strchr(path_info, '?');
+	if (query_string) {
+		*query_string = 0;
+		query_string++;
+	}
+	char *port = strchr(host, ':');
+	// leave space for the uwsgi header
+	ub->pos = 4;
+	if (uwsgi_buffer_append_keyval(ub, "REQUEST_METHOD", 14, uwsgi.bench.method, strlen(uwsgi.bench.method)))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "REQUEST_URI", 11, uwsgi.bench.uri, strlen(uwsgi.bench.uri)))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "PATH_INFO", 9, path_info, strlen(path_info)))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "QUERY_STRING", 12, query_string ? query_string : "", query_string ? strlen(query_string) : 0))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "SCRIPT_NAME", 11, "", 0))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "SERVER_PROTOCOL", 15, "HTTP/1.1", 8))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "SERVER_NAME", 11, host, port ? (size_t) (port - host) : strlen(host)))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "SERVER_PORT", 11, port ? port + 1 : "80", port ? strlen(port + 1) : 2))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "REMOTE_ADDR", 11, "127.0.0.1", 9))
+		goto error;
+	if (uwsgi_buffer_append_keyval(ub, "HTTP_HOST", 9, host, strlen(host)))
+		goto error;
+	if (body->pos > 0) {
+		char cl[sizeof(UMAX64_STR) + 1];
+		int cl_len = uwsgi_long2str2n(body->pos, cl, sizeof(UMAX64_STR) + 1);
+		if (uwsgi_buffer_append_keyval(ub, "CONTENT_LENGTH", 14, cl, cl_len))
+			goto error;
+	}
+
+	// headers are translated to HTTP_* vars
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.bench.headers) {
+		char *colon = strchr(usl->value, ':');
+		if (!colon)
+			continue;
+		char *value = colon + 1;
+		while (*value == ' ')
+			value++;
+		size_t i, key_len = colon - usl->value;
+		char *key = uwsgi_concat2n("HTTP_", 5, usl->value, key_len);
+		for (i = 5; i < key_len + 5; i++) {
+			key[i] = toupper((int) key[i]);
+			if (key[i] == '-')
+				key[i] = '_';
+		}
+		int ret = uwsgi_buffer_append_keyval(ub, key, key_len + 5, value, strlen(value));
+		free(key);
+		if (ret)
+			goto error;
+	}
+
+	uwsgi_foreach(usl, uwsgi.bench.vars) {
+		char *equal = strchr(usl->value, '=');
+		if (!equal)
+			continue;
+		if (uwsgi_buffer_append_keyval(ub, usl->value, equal - usl->value, equal + 1, strlen(equal + 1)))
+			goto error;
+	}
+
+	if (uwsgi_buffer_set_uh(ub, uwsgi.bench.modifier1, uwsgi.bench.modifier2))
+		goto error;
+	if (uwsgi_buffer_append(ub, body->buf, body->pos))
+		goto error;
+	free(host);
+	free(path_info);
+	return ub;
+error:
+	uwsgi_log("[uwsgi-bench] unable to build the uwsgi packet (too many vars ?)\n");
+	exit(1);
+}
+
+static struct uwsgi_buffer *uwsgi_bench_build_http(struct uwsgi_buffer *body) {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	char *host = uwsgi_bench_host();
+	if (uwsgi_buffer_append(ub, uwsgi.bench.method, strlen(uwsgi.bench.method)))
+		goto error;
+	if (uwsgi_buffer_append(ub, " ", 1))
+		goto error;
+	if (uwsgi_buffer_append(ub, uwsgi.bench.uri, strlen(uwsgi.bench.uri)))
+		goto error;
+	if (uwsgi_buffer_append(ub, " HTTP/1.1\r\nHost: ", 17))
+		goto error;
+	if (uwsgi_buffer_append(ub, host, strlen(host)))
+		goto error;
+	if (uwsgi_buffer_append(ub, "\r\n", 2))
+		goto error;
+	if (!ubench.keepalive) {
+		if (uwsgi_buffer_append(ub, "Connection: close\r\n", 19))
+			goto error;
+	}
+	if (body->pos > 0) {
+		if (uwsgi_buffer_append(ub, "Content-Length: ", 16))
+			goto error;
+		if (uwsgi_buffer_num64(ub, body->pos))
+			goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2))
+			goto error;
+	}
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.bench.headers) {
+		if (uwsgi_buffer_append(ub, usl->value, usl->len))
+			goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2))
+			goto error;
+	}
+	if (uwsgi_buffer_append(ub, "\r\n", 2))
+		goto error;
+	if (uwsgi_buffer_append(ub, body->buf, body->pos))
+		goto error;
+	free(host);
+	return ub;
+error:
+	uwsgi_log("[uwsgi-bench] unable to build the http request\n");
+	exit(1);
+}
+
+static struct uwsgi_buffer *uwsgi_bench_build_websocket_handshake() {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+	char *host = uwsgi_bench_host();
+	if (uwsgi_buffer_append(ub, "GET ", 4))
+		goto error;
+	if (uwsgi_buffer_append(ub, uwsgi.bench.uri, strlen(uwsgi.bench.uri)))
+		goto error;
+	if (uwsgi_buffer_append(ub, " HTTP/1.1\r\nHost: ", 17))
+		goto error;
+	if (uwsgi_buffer_append(ub, host, strlen(host)))
+		goto error;
+	if (uwsgi_buffer_append(ub, "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n", 115))
+		goto error;
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.bench.headers) {
+		if (uwsgi_buffer_append(ub, usl->value, usl->len))
+			goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2))
+			goto error;
+	}
+	if (uwsgi_buffer_append(ub, "\r\n", 2))
+		goto error;
+	free(host);
+	return ub;
+error:
+	uwsgi_log("[uwsgi-bench] unable to build the websocket handshake\n");
+	exit(1);
+}
+
+// a masked binary frame (the body or --bench-message-size bytes)
+static struct uwsgi_buffer *uwsgi_bench_build_websocket_message(struct uwsgi_buffer *body) {
+	static char mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+	uint64_t i, len = body->pos;
+	if (!len) {
+		len = uwsgi.bench.message_size ? uwsgi.bench.message_size : 64;
+		if (uwsgi_buffer_ensure(body, len))
+			goto error;
+		memset(body->buf, 'x', len);
+		body->pos = len;
+	}
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(len + 14);
+	if (uwsgi_buffer_byte(ub, 0x82))
+		goto error;
+	if (len < 126) {
+		if (uwsgi_buffer_byte(ub, 0x80 | len))
+			goto error;
+	}
+	else if (len <= 0xffff) {
+		if (uwsgi_buffer_byte(ub, 0x80 | 126))
+			goto error;
+		if (uwsgi_buffer_u16be(ub, len))
+			goto error;
+	}
+	else {
+		if (uwsgi_buffer_byte(ub, 0x80 | 127))
+			goto error;
+		if (uwsgi_buffer_u64be(ub, len))
+			goto error;
+	}
+	if (uwsgi_buffer_append(ub, mask, 4))
+		goto error;
+	if (uwsgi_buffer_ensure(ub, len))
+		goto error;
+	for (i = 0; i < len; i++) {
+		ub->buf[ub->pos + i] = body->buf[i] ^ mask[i % 4];
+	}
+	ub->pos += len;
+	return ub;
+error:
+	uwsgi_log("[uwsgi-bench] unable to build the websocket message\n");
+	exit(1);
+}
+
+/*
+	response parsers: return the size of the first complete response in the input buffer,
+	0 if more data is needed and -1 for broken responses
+*/
+
+static ssize_t uwsgi_bench_parse_http(struct uwsgi_bench_conn *c, int closed, int *status) {
+	char *buf = c->in->buf;
+	size_t pos = c->in->pos;
+
+	if (c->need) {
+		*status = c->need_status;
+		if (pos >= c->need)
+			return c->need;
+		return closed ? -1 : 0;
+	}
+
+	char *end = memmem(buf, pos, "\r\n\r\n", 4);
+	if (!end)
+		return closed ? -1 : 0;
+	size_t hlen = (end - buf) + 4;
+
+	if (hlen < 12 || memcmp(buf, "HTTP/", 5))
+		return -1;
+	*status = uwsgi_str3_num(buf + 9);
+
+	int64_t cl = -1;
+	int chunked = 0;
+	char *line = memchr(buf, '\n', hlen);
+	while (line && line + 1 < end) {
+		line++;
+		size_t remains = end - line;
+		if (remains > 15 && !strncasecmp(line, "Content-Length:", 15)) {
+			cl = strtoll(line + 15, NULL, 10);
+		}
+		else if (remains > 18 && !strncasecmp(line, "Transfer-Encoding:", 18)) {
+			chunked = memmem(line, remains, "chunked", 7) != NULL;
+		}
+		else if (remains > 17 && !strncasecmp(line, "Connection: close", 17)) {
+			c->server_close = 1;
+		}
+		line = memchr(line, '\n', end - line);
+	}
+
+	if (c->status == UWSGI_BENCH_HANDSHAKE_RESPONSE || *status < 200 || *status == 204 || *status == 304 || !strcmp(uwsgi.bench.method, "HEAD")) {
+		return hlen;
+	}
+
+	if (cl >= 0) {
+		c->need = hlen + cl;
+		c->need_status = *status;
+		if (pos >= c->need)
+			return c->need;
+		return closed ? -1 : 0;
+	}
+
+	if (chunked) {
+		size_t off = hlen;
+		for (;;) {
+			char *crlf = memmem(buf + off, pos - off, "\r\n", 2);
+			if (!crlf)
+				return closed ? -1 : 0;
+			size_t chunk = strtoul(buf + off, NULL, 16);
+			off = (crlf - buf) + 2;
+			if (chunk == 0) {
+				if (pos >= off + 2)
+					return off + 2;
+				return closed ? -1 : 0;
+			}
+			off += chunk + 2;
+			if (off > pos)
+				return closed ? -1 : 0;
+		}
+	}
+
+	// the end of the response is the end of the connection
+	c->server_close = 1;
+	return closed ? (ssize_t) pos : 0;
+}
+
+static ssize_t uwsgi_bench_parse_websocket(struct uwsgi_bench_conn *c, int closed) {
+	uint8_t *buf = (uint8_t *) c->in->buf;
+	size_t pos = c->in->pos;
+	if (pos < 2)
+		return closed ? -1 : 0;
+	uint8_t opcode = buf[0] & 0xf;
+	// close
+	if (opcode == 8)
+		return -1;
+	size_t hlen = 2;
+	uint64_t len = buf[1] & 0x7f;
+	if (len == 126) {
+		if (pos < 4)
+			return closed ? -1 : 0;
+		len = uwsgi_be16((char *) buf + 2);
+		hlen = 4;
+	}
+	else if (len == 127) {
+		if (pos < 10)
+			return closed ? -1 : 0;
+		len = uwsgi_be64((char *) buf + 2);
+		hlen = 10;
+	}
+	if (buf[1] & 0x80)
+		hlen += 4;
+	if (pos < hlen + len)
+		return closed ? -1 : 0;
+	return hlen + len;
+}
+
+static ssize_t uwsgi_bench_parse(struct uwsgi_bench_conn *c, int closed, int *status) {
+	*status = 0;
+	switch (ubench.protocol) {
+	case UWSGI_BENCH_RAW:
+		if (uwsgi.bench.expect) {
+			if (c->in->pos >= uwsgi.bench.expect)
+				return uwsgi.bench.expect;
+			return closed ? -1 : 0;
+		}
+		return closed ? (ssize_t) c->in->pos : 0;
+	case UWSGI_BENCH_WEBSOCKET:
+		if (c->status == UWSGI_BENCH_HANDSHAKE_RESPONSE)
+			return uwsgi_bench_parse_http(c, closed, status);
+		return uwsgi_bench_parse_websocket(c, closed);
+	default:
+		return uwsgi_bench_parse_http(c, closed, status);
+	}
+}
+
+static uint64_t uwsgi_bench_claim(uint64_t n) {
+	if (ubench.stop)
+		return 0;
+	if (ubench.deadline) {
+		if (uwsgi_micros() >= ubench.deadline) {
+			ubench.stop = 1;
+			return 0;
+		}
+		return n;
+	}
+	uint64_t issued = uwsgi_atomic_add(ubench.issued, n);
+	if (issued >= uwsgi.bench.requests)
+		return 0;
+	return UMIN(n, uwsgi.bench.requests - issued);
+}
+
+static void uwsgi_bench_conn_close(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	if (c->fd < 0)
+		return;
+	ubt->table[c->fd] = NULL;
+	close(c->fd);
+	c->fd = -1;
+	c->handshaken = 0;
+	c->server_close = 0;
+	c->reused = 0;
+	c->need = 0;
+	c->in->pos = 0;
+}
+
+static void uwsgi_bench_conn_fail(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	ubt->errors += c->batch - c->done;
+	c->done = c->batch;
+	uwsgi_bench_conn_close(ubt, c);
+}
+
+static int uwsgi_bench_conn_open(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	c->fd = uwsgi_connect(uwsgi.bench.address, 0, 1);
+	if (c->fd < 0)
+		return -1;
+	if (c->fd >= ubt->table_size) {
+		uwsgi_log("[uwsgi-bench] file descriptor %d out of range\n", c->fd);
+		exit(1);
+	}
+	ubt->table[c->fd] = c;
+	c->status = UWSGI_BENCH_CONNECTING;
+	if (event_queue_add_fd_write(ubt->queue, c->fd)) {
+		uwsgi_bench_conn_close(ubt, c);
+		return -1;
+	}
+	return 0;
+}
+
+// start the next batch of requests on a connection (opening it if needed)
+static void uwsgi_bench_conn_next(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	for (;;) {
+		c->batch = uwsgi_bench_claim(ubench.keepalive ? uwsgi.bench.pipeline : 1);
+		c->done = 0;
+		c->out_pos = 0;
+		c->need = 0;
+		if (!c->batch) {
+			uwsgi_bench_conn_close(ubt, c);
+			ubt->active--;
+			return;
+		}
+
+		c->last_io = uwsgi_micros();
+
+		if (c->fd >= 0) {
+			c->status = UWSGI_BENCH_WRITING;
+			c->batch_start = c->last_io;
+			if (event_queue_fd_read_to_write(ubt->queue, c->fd)) {
+				uwsgi_bench_conn_fail(ubt, c);
+				continue;
+			}
+			return;
+		}
+
+		if (uwsgi_bench_conn_open(ubt, c)) {
+			ubt->errors += c->batch;
+			continue;
+		}
+		return;
+	}
+}
+
+/*
+	servers are free to close idle keepalive connections (and a lot of them
+	do it without a "Connection: close"), so when a reused connection breaks
+	before the first byte of the response the batch is sent again on a new one
+*/
+static void uwsgi_bench_conn_broken(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	if (c->reused && c->done == 0 && c->in->pos == 0) {
+		uwsgi_bench_conn_close(ubt, c);
+		c->out_pos = 0;
+		if (!uwsgi_bench_conn_open(ubt, c))
+			return;
+	}
+	uwsgi_bench_conn_fail(ubt, c);
+	uwsgi_bench_conn_next(ubt, c);
+}
+
+static void uwsgi_bench_conn_write(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	if (c->status == UWSGI_BENCH_CONNECTING) {
+		int soopt = 0;
+		socklen_t solen = sizeof(int);
+		if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) (&soopt), &solen) < 0 || soopt) {
+			uwsgi_bench_conn_fail(ubt, c);
+			uwsgi_bench_conn_next(ubt, c);
+			return;
+		}
+		ubt->connections++;
+		uwsgi_tcp_nodelay(c->fd);
+		if (ubench.protocol == UWSGI_BENCH_WEBSOCKET && !c->handshaken) {
+			c->status = UWSGI_BENCH_HANDSHAKE;
+		}
+		else {
+			c->status = UWSGI_BENCH_WRITING;
+			c->batch_start = uwsgi_micros();
+		}
+	}
+
+	struct uwsgi_buffer *ub = c->status == UWSGI_BENCH_HANDSHAKE ? ubench.handshake : ubench.request;
+	size_t total = c->status == UWSGI_BENCH_HANDSHAKE ? ub->pos : ub->pos * c->batch;
+
+	while (c->out_pos < total) {
+		size_t offset = c->out_pos % ub->pos;
+		ssize_t wlen = write(c->fd, ub->buf + offset, ub->pos - offset);
+		if (wlen < 0) {
+			if (uwsgi_is_again())
+				return;
+			uwsgi_bench_conn_broken(ubt, c);
+			return;
+		}
+		c->out_pos += wlen;
+		ubt->bytes_out += wlen;
+	}
+
+	c->last_io = uwsgi_micros();
+	c->status = c->status == UWSGI_BENCH_HANDSHAKE ? UWSGI_BENCH_HANDSHAKE_RESPONSE : UWSGI_BENCH_READING;
+	if (event_queue_fd_write_to_read(ubt->queue, c->fd)) {
+		uwsgi_bench_conn_fail(ubt, c);
+		uwsgi_bench_conn_next(ubt, c);
+	}
+}
+
+static void uwsgi_bench_conn_read(struct uwsgi_bench_thread *ubt, struct uwsgi_bench_conn *c) {
+	if (uwsgi_buffer_ensure(c->in, 8192)) {
+		uwsgi_bench_conn_fail(ubt, c);
+		uwsgi_bench_conn_next(ubt, c);
+		return;
+	}
+	ssize_t rlen = read(c->fd, c->in->buf + c->in->pos, c->in->len - c->in->pos);
+	if (rlen < 0) {
+		if (uwsgi_is_again())
+			return;
+		uwsgi_bench_conn_broken(ubt, c);
+		return;
+	}
+	int closed = rlen == 0;
+	c->in->pos += rlen;
+	ubt->bytes_in += rlen;
+	uint64_t now = uwsgi_micros();
+	c->last_io = now;
+
+	while (c->in->pos > 0 || closed) {
+		// the server closed the connection with nothing pending
+		if (c->in->pos == 0) {
+			uwsgi_bench_conn_broken(ubt, c);
+			return;
+		}
+		int status = 0;
+		ssize_t len = uwsgi_bench_parse(c, closed, &status);
+		if (len < 0) {
+			uwsgi_bench_conn_fail(ubt, c);
+			uwsgi_bench_conn_next(ubt, c);
+			return;
+		}
+		if (len == 0) {
+			if (!closed)
+				return;
+			uwsgi_bench_conn_fail(ubt, c);
+			uwsgi_bench_conn_next(ubt, c);
+			return;
+		}
+		if (uwsgi_buffer_decapitate(c->in, len)) {
+			uwsgi_bench_conn_fail(ubt, c);
+			uwsgi_bench_conn_next(ubt, c);
+			return;
+		}
+		c->need = 0;
+
+		if (c->status == UWSGI_BENCH_HANDSHAKE_RESPONSE) {
+			if (status != 101) {
+				uwsgi_bench_conn_fail(ubt, c);
+				uwsgi_bench_conn_next(ubt, c);
+				return;
+			}
+			c->handshaken = 1;
+			c->status = UWSGI_BENCH_WRITING;
+			c->out_pos = 0;
+			c->batch_start = now;
+			if (event_queue_fd_read_to_write(ubt->queue, c->fd)) {
+				uwsgi_bench_conn_fail(ubt, c);
+				uwsgi_bench_conn_next(ubt, c);
+			}
+			return;
+		}
+
+		uint64_t latency = now - c->batch_start;
+		uwsgi_histogram_add(&ubt->latency, latency, 0);
+		if (!ubt->min || latency < ubt->min)
+			ubt->min = latency;
+		ubt->requests++;
+		ubt->status[status > 0 && status < 600 ? status / 100 : 0]++;
+		c->done++;
+
+		if (c->done >= c->batch) {
+			if (closed || c->server_close || !ubench.keepalive) {
+				uwsgi_bench_conn_close(ubt, c);
+			}
+			else {
+				c->reused = 1;
+			}
+			uwsgi_bench_conn_next(ubt, c);
+			return;
+		}
+	}
+}
+
+static void *uwsgi_bench_loop(void *arg) {
+	struct uwsgi_bench_thread *ubt = (struct uwsgi_bench_thread *) arg;
+	int i;
+	int nevents = 64;
+	void *events = event_queue_alloc(nevents);
+	uint64_t timeout = (uint64_t) uwsgi.bench.timeout * 1000 * 1000;
+	uint64_t last_check = uwsgi_micros();
+
+	ubt->active = ubt->nconns;
+	for (i = 0; i < ubt->nconns; i++) {
+		uwsgi_bench_conn_next(ubt, &ubt->conns[i]);
+	}
+
+	while (ubt->active > 0) {
+		int ret = event_queue_wait_multi(ubt->queue, 1, events, nevents);
+		for (i = 0; i < ret; i++) {
+			int fd = event_queue_interesting_fd(events, i);
+			if (fd < 0 || fd >= ubt->table_size)
+				continue;
+			struct uwsgi_bench_conn *c = ubt->table[fd];
+			if (!c)
+				continue;
+			if (c->status == UWSGI_BENCH_CONNECTING || c->status == UWSGI_BENCH_HANDSHAKE || c->status == UWSGI_BENCH_WRITING) {
+				uwsgi_bench_conn_write(ubt, c);
+			}
+			else {
+				uwsgi_bench_conn_read(ubt, c);
+			}
+		}
+
+		uint64_t now = uwsgi_micros();
+		if (ubench.deadline && now >= ubench.deadline)
+			ubench.stop = 1;
+		// on stop, pending requests are simply discarded
+		if (ubench.stop) {
+			for (i = 0; i < ubt->nconns; i++) {
+				uwsgi_bench_conn_close(ubt, &ubt->conns[i]);
+			}
+			break;
+		}
+
+		if (now - last_check < 1000 * 1000)
+			continue;
+		last_check = now;
+		for (i = 0; i < ubt->nconns; i++) {
+			struct uwsgi_bench_conn *c = &ubt->conns[i];
+			if (c->fd < 0 || now - c->last_io < timeout)
+				continue;
+			ubt->timeouts++;
+			uwsgi_bench_conn_fail(ubt, c);
+			uwsgi_bench_conn_next(ubt, c);
+		}
+	}
+
+	free(events);
+	return NULL;
+}
+
+static void uwsgi_bench_stop(int signum) {
+	ubench.stop = 1;
+}
+
+static void uwsgi_bench_report(struct uwsgi_bench_thread *total, uint64_t elapsed) {
+	uint64_t count = uwsgi_histogram_count(&total->latency);
+	double secs = elapsed / 1000000.0;
+	double rps = total->requests / secs;
+	uint64_t avg = count ? total->latency.sum / count : 0;
+	uint64_t p50 = uwsgi_histogram_quantile(&total->latency, count, 5000);
+	uint64_t p90 = uwsgi_histogram_quantile(&total->latency, count, 9000);
+	uint64_t p99 = uwsgi_histogram_quantile(&total->latency, count, 9900);
+	uint64_t p999 = uwsgi_histogram_quantile(&total->latency, count, 9990);
+
+	if (uwsgi.bench.json) {
+		fprintf(stdout, "{\"address\":\"%s\",\"protocol\":\"%s\",\"threads\":%d,\"concurrency\":%d,\"pipeline\":%d,"
+			"\"requests\":%llu,\"errors\":%llu,\"timeouts\":%llu,\"connections\":%llu,\"duration\":%.3f,\"rps\":%.1f,"
+			"\"bytes_in\":%llu,\"bytes_out\":%llu,\"status\":{\"1xx\":%llu,\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu},"
+			"\"latency\":{\"min\":%llu,\"avg\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+			uwsgi.bench.address, uwsgi_bench_protocols[ubench.protocol], uwsgi.bench.threads, uwsgi.bench.concurrency, uwsgi.bench.pipeline,
+			(unsigned long long) total->requests, (unsigned long long) total->errors, (unsigned long long) total->timeouts,
+			(unsigned long long) total->connections, secs, rps,
+			(unsigned long long) total->bytes_in, (unsigned long long) total->bytes_out,
+			(unsigned long long) total->status[1], (unsigned long long) total->status[2], (unsigned long long) total->status[3],
+			(unsigned long long) total->status[4], (unsigned long long) total->status[5],
+			(unsigned long long) total->min, (unsigned long long) avg, (unsigned long long) p50, (unsigned long long) p90,
+			(unsigned long long) p99, (unsigned long long) p999, (unsigned long long) total->latency.max);
+		return;
+	}
+
+	fprintf(stdout, "*** uWSGI bench: %s (%s) ***\n", uwsgi.bench.address, uwsgi_bench_protocols[ubench.protocol]);
+	fprintf(stdout, "threads: %d concurrency: %d pipeline: %d\n", uwsgi.bench.threads, uwsgi.bench.concurrency, ubench.keepalive ? uwsgi.bench.pipeline : 1);
+	fprintf(stdout, "requests: %llu errors: %llu timeouts: %llu connections: %llu\n", (unsigned long long) total->requests, (unsigned long long) total->errors, (unsigned long long) total->timeouts, (unsigned long long) total->connections);
+	fprintf(stdout, "duration: %.3f secs throughput: %.1f req/s (in: %.2f MB/s out: %.2f MB/s)\n", secs, rps, (total->bytes_in / secs) / (1024 * 1024), (total->bytes_out / secs) / (1024 * 1024));
+	if (ubench.protocol == UWSGI_BENCH_UWSGI || ubench.protocol == UWSGI_BENCH_HTTP) {
+		fprintf(stdout, "status: 1xx=%llu 2xx=%llu 3xx=%llu 4xx=%llu 5xx=%llu\n", (unsigned long long) total->status[1], (unsigned long long) total->status[2], (unsigned long long) total->status[3], (unsigned long long) total->status[4], (unsigned long long) total->status[5]);
+	}
+	fprintf(stdout, "latency (usecs): min=%llu avg=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n", (unsigned long long) total->min, (unsigned long long) avg, (unsigned long long) p50, (unsigned long long) p90, (unsigned long long) p99, (unsigned long long) p999, (unsigned long long) total->latency.max);
+}
+
+void uwsgi_bench() {
+	int i;
+
+	if (!uwsgi.bench.protocol || !strcmp(uwsgi.bench.protocol, "uwsgi")) {
+		ubench.protocol = UWSGI_BENCH_UWSGI;
+	}
+	else if (!strcmp(uwsgi.bench.protocol, "http")) {
+		ubench.protocol = UWSGI_BENCH_HTTP;
+		ubench.keepalive = uwsgi.bench.keepalive;
+	}
+	else if (!strcmp(uwsgi.bench.protocol, "raw")) {
+		ubench.protocol = UWSGI_BENCH_RAW;
+		ubench.keepalive = uwsgi.bench.expect > 0;
+	}
+	else if (!strcmp(uwsgi.bench.protocol, "websocket") || !strcmp(uwsgi.bench.protocol, "websockets")) {
+		ubench.protocol = UWSGI_BENCH_WEBSOCKET;
+		ubench.keepalive = 1;
+	}
+	else {
+		uwsgi_log("[uwsgi-bench] unsupported protocol: %s (available: uwsgi, http, raw, websocket)\n", uwsgi.bench.protocol);
+		exit(1);
+	}
+
+	if (uwsgi.bench.concurrency <= 0)
+		uwsgi.bench.concurrency = 10;
+	if (uwsgi.bench.threads <= 0)
+		uwsgi.bench.threads = 1;
+	if (uwsgi.bench.threads > uwsgi.bench.concurrency)
+		uwsgi.bench.threads = uwsgi.bench.concurrency;
+	if (uwsgi.bench.pipeline <= 0)
+		uwsgi.bench.pipeline = 1;
+	if (!uwsgi.bench.requests)
+		uwsgi.bench.requests = 10000;
+	if (uwsgi.bench.timeout <= 0)
+		uwsgi.bench.timeout = 10;
+	if (!uwsgi.bench.method)
+		uwsgi.bench.method = "GET";
+	if (!uwsgi.bench.uri)
+		uwsgi.bench.uri = "/";
+
+	struct uwsgi_buffer *body = uwsgi_bench_body();
+	switch (ubench.protocol) {
+	case UWSGI_BENCH_UWSGI:
+		ubench.request = uwsgi_bench_build_uwsgi(body);
+		break;
+	case UWSGI_BENCH_HTTP:
+		ubench.request = uwsgi_bench_build_http(body);
+		break;
+	case UWSGI_BENCH_RAW:
+		if (!body->pos) {
+			uwsgi_log("[uwsgi-bench] raw mode requires a payload (--bench-body or --bench-body-file)\n");
+			exit(1);
+		}
+		ubench.request = body;
+		break;
+	case UWSGI_BENCH_WEBSOCKET:
+		ubench.handshake = uwsgi_bench_build_websocket_handshake();
+		ubench.request = uwsgi_bench_build_websocket_message(body);
+		break;
+	}
+
+	struct rlimit rl;
+	int table_size = 65536;
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur > 0) {
+		table_size = rl.rlim_cur;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, uwsgi_bench_stop);
+	signal(SIGTERM, uwsgi_bench_stop);
+
+	struct uwsgi_bench_thread *threads = uwsgi_calloc(sizeof(struct uwsgi_bench_thread) * uwsgi.bench.threads);
+	for (i = 0; i < uwsgi.bench.threads; i++) {
+		struct uwsgi_bench_thread *ubt = &threads[i];
+		int j;
+		ubt->nconns = uwsgi.bench.concurrency / uwsgi.bench.threads;
+		if (i < uwsgi.bench.concurrency % uwsgi.bench.threads)
+			ubt->nconns++;
+		ubt->conns = uwsgi_calloc(sizeof(struct uwsgi_bench_conn) * ubt->nconns);
+		for (j = 0; j < ubt->nconns; j++) {
+			ubt->conns[j].fd = -1;
+			ubt->conns[j].in = uwsgi_buffer_new(8192);
+		}
+		ubt->table_size = table_size;
+		ubt->table = uwsgi_calloc(sizeof(struct uwsgi_bench_conn *) * table_size);
+		ubt->queue = event_queue_init();
+		if (ubt->queue < 0)
+			exit(1);
+	}
+
+	uwsgi_log("[uwsgi-bench] running %s against %s (%d connections, %d threads)...\n", uwsgi_bench_protocols[ubench.protocol], uwsgi.bench.address, uwsgi.bench.concurrency, uwsgi.bench.threads);
+
+	uint64_t start = uwsgi_micros();
+	if (uwsgi.bench.duration > 0) {
+		ubench.deadline = start + ((uint64_t) uwsgi.bench.duration * 1000 * 1000);
+	}
+
+	for (i = 0; i < uwsgi.bench.threads; i++) {
+		if (pthread_create(&threads[i].tid, NULL, uwsgi_bench_loop, &threads[i])) {
+			uwsgi_error("uwsgi_bench()/pthread_create()");
+			exit(1);
+		}
+	}
+
+	struct uwsgi_bench_thread total;
+	memset(&total, 0, sizeof(struct uwsgi_bench_thread));
+	for (i = 0; i < uwsgi.bench.threads; i++) {
+		struct uwsgi_bench_thread *ubt = &threads[i];
+		int j;
+		pthread_join(ubt->tid, NULL);
+		total.requests += ubt->requests;
+		total.errors += ubt->errors;
+		total.timeouts += ubt->timeouts;
+		total.connections += ubt->connections;
+		total.bytes_in += ubt->bytes_in;
+		total.bytes_out += ubt->bytes_out;
+		for (j = 0; j < 6; j++) {
+			total.status[j] += ubt->status[j];
+		}
+		if (ubt->min && (!total.min || ubt->min < total.min))
+			total.min = ubt->min;
+		uwsgi_histogram_merge(&total.latency, &ubt->latency);
+	}
+
+	uint64_t elapsed = uwsgi_micros() - start;
+	if (!elapsed)
+		elapsed = 1;
+
+	uwsgi_bench_report(&total, elapsed);
+	exit(total.requests > 0 && !total.errors ? 0 : 1);
+}
@@ -16,10 +16,35 @@ struct uwsgi_buffer *uwsgi_buffer_new(size_t len) {
 
 }
 
+struct uwsgi_buffer *uwsgi_buffer_new_arena(struct uwsgi_arena *ua, size_t len) {
+	struct uwsgi_buffer *ub = uwsgi_arena_calloc(ua, sizeof(struct uwsgi_buffer));
+	ub->arena = ua;
+	if (len) {
+		ub->buf = uwsgi_arena_alloc(ua, len);
+		ub->len = len;
+	}
+	return ub;
+}
+
+// arena memory cannot be realloc()'ed, grow geometrically to amortize the copies
+static int uwsgi_buffer_arena_grow(struct uwsgi_buffer *ub, size_t len) {
+	size_t new_len = UMAX(len, ub->len * 2);
+	if (ub->limit > 0 && new_len > ub->limit)
+		new_len = UMAX(len, ub->limit);
+	char *new_buf = uwsgi_arena_alloc(ub->arena, new_len);
+	if (ub->buf && ub->len) {
+		memcpy(new_buf, ub->buf, ub->len);
+	}
+	ub->buf = new_buf;
+	ub->len = new_len;
+	return 0;
+}
+
 int uwsgi_buffer_fix(struct uwsgi_buffer *ub, size_t len) {
 	if (ub->limit > 0 && len > ub->limit)
 		return -1;
 	if (ub->len < len) {
+		if (ub->arena) return uwsgi_buffer_arena_grow(ub, len);
 		char *new_buf = realloc(ub->buf, len);
 		if (!new_buf) {
 			uwsgi_error("uwsgi_buffer_fix()");
@@ -40,6 +65,7 @@ int uwsgi_buffer_ensure(struct uwsgi_buffer *ub, size_t len) {
 			if (new_len == ub->len)
 				return -1;
 		}
+		if (ub->arena) return uwsgi_buffer_arena_grow(ub, new_len);
 		char *new_buf = realloc(ub->buf, new_len);
 		if (!new_buf) {
 			uwsgi_error("uwsgi_buffer_ensure()");
@@ -110,13 +136,18 @@ int uwsgi_buffer_append(struct uwsgi_buffer *ub, char *buf, size_t len) {
 			if (ub->len + chunk_size > ub->limit)
 				return -1;
 		}
-		char *new_buf = realloc(ub->buf, ub->len + chunk_size);
-		if (!new_buf) {
-			uwsgi_error("uwsgi_buffer_append()");
-			return -1;
+		if (ub->arena) {
+			uwsgi_buffer_arena_grow(ub, ub->len + chunk_size);
+		}
+		else {
+			char *new_buf = realloc(ub->buf, ub->len + chunk_size);
+			if (!new_buf) {
+				uwsgi_error("uwsgi_buffer_append()");
+				return -1;
+			}
+			ub->buf = new_buf;
+			ub->len += chunk_size;
 		}
-		ub->buf = new_buf;
-		ub->len += chunk_size;
 	}
 
 	memcpy(ub->buf + ub->pos, buf, len);
@@ -352,6 +383,9 @@ void uwsgi_buffer_destroy(struct uwsgi_buffer *ub) {
 	}
 	ub->freed = 1;
 #endif
+	// released on arena reset
+	if (ub->arena)
+		return;
 	if (ub->buf)
 		free(ub->buf);
 	free(ub);
@@ -437,7 +471,11 @@ struct uwsgi_buffer *uwsgi_buffer_from_file(char *filename) {
 }
 
 void uwsgi_buffer_map(struct uwsgi_buffer *ub, char *buf, size_t len) {
-	if (ub->buf) {
+	if (ub->arena) {
+		// the new (heap) memory will be released on arena reset
+		uwsgi_arena_adopt(ub->arena, buf);
+	}
+	else if (ub->buf) {
 		free(ub->buf);
 	}
 	ub->buf = buf;
@@ -574,10 +574,12 @@ char *uwsgi_cache_get2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
 		}
 		uci->hits++;
 		uc->hits++;
+		UWSGI_PROBE4(cache__hit, uc->name, key, keylen, uci->valsize);
 		return uc->data + (uci->first_block * uc->blocksize);
 	}
 
 	uc->miss++;
+	UWSGI_PROBE3(cache__miss, uc->name, key, keylen);
 
 	return NULL;
 }
@@ -617,10 +619,12 @@ char *uwsgi_cache_get3(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
 		}
                 uci->hits++;
                 uc->hits++;
+                UWSGI_PROBE4(cache__hit, uc->name, key, keylen, uci->valsize);
                 return uc->data + (uci->first_block * uc->blocksize);
         }
 
         uc->miss++;
+        UWSGI_PROBE3(cache__miss, uc->name, key, keylen);
 
         return NULL;
 }
@@ -638,10 +642,12 @@ char *uwsgi_cache_get4(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint6
                         *hits = uci->hits;
                 uci->hits++;
                 uc->hits++;
+                UWSGI_PROBE4(cache__hit, uc->name, key, keylen, uci->valsize);
                 return uc->data + (uci->first_block * uc->blocksize);
         }
 
         uc->miss++;
+        UWSGI_PROBE3(cache__miss, uc->name, key, keylen);
 
         return NULL;
 }
@@ -936,6 +942,7 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 
 
 end:
+	UWSGI_PROBE5(cache__set, uc->name, key, keylen, vallen, ret);
 	return ret;
 
 }
@@ -1013,6 +1020,48 @@ static void cache_send_udp_command(struct uwsgi_cache *uc, char *key, uint16_t k
 
 }
 
+static void cache_udp_server_manage(struct uwsgi_cache *uc, char *buf, ssize_t len) {
+	uint16_t pktsize = 0, ss = 0;
+
+	if (len <= 7) return;
+	if (buf[0] != 111) return;
+	memcpy(&pktsize, buf+1, 2);
+	if (pktsize != len-4) return;
+
+	memcpy(&ss, buf + 4, 2);
+	if (4+ss > pktsize) return;
+	uint16_t keylen = ss;
+	char *key = buf + 6;
+
+	// cache set/update
+	if (buf[3] == 10) {
+		if (keylen + 2 + 2 > pktsize) return;
+		memcpy(&ss, buf + 6 + keylen, 2);
+		if (4+keylen+ss > pktsize) return;
+		uint16_t vallen = ss;
+		char *val = buf + 8 + keylen;
+		uint64_t expires = 0;
+		if (2 + keylen + 2 + vallen + 2 < pktsize) {
+			memcpy(&ss, buf + 8 + keylen + vallen , 2);
+			if (6+keylen+vallen+ss > pktsize) return;
+			expires = uwsgi_str_num(buf + 10 + keylen+vallen, ss);
+		}
+		uwsgi_wlock(uc->lock);
+		if (uwsgi_cache_set2(uc, key, keylen, val, vallen, expires, UWSGI_CACHE_FLAG_UPDATE|UWSGI_CACHE_FLAG_LOCAL|UWSGI_CACHE_FLAG_ABSEXPIRE)) {
+			uwsgi_log("[cache-udp-server] unable to update cache\n");
+		}
+		uwsgi_rwunlock(uc->lock);
+	}
+	// cache del
+	else if (buf[3] == 11) {
+		uwsgi_wlock(uc->lock);
+		if (uwsgi_cache_del2(uc, key, keylen, 0, UWSGI_CACHE_FLAG_LOCAL)) {
+			uwsgi_log("[cache-udp-server] unable to update cache\n");
+		}
+		uwsgi_rwunlock(uc->lock);
+	}
+}
+
 void *cache_udp_server_loop(void *ucache) {
         // block all signals
         sigset_t smask;
@@ -1037,54 +1086,22 @@ void *cache_udp_server_loop(void *ucache) {
                 usl = usl->next;
         }
 
-        // allocate 64k chunk to receive messages
-        char *buf = uwsgi_malloc(UMAX16);
+        // allocate 64k chunks to receive messages
+	struct uwsgi_dgram_batch *udb = uwsgi_dgram_batch_new(uwsgi.udp_batch, UMAX16);
 	
 	for(;;) {
-                uint16_t pktsize = 0, ss = 0;
                 int interesting_fd = -1;
                 int rlen = event_queue_wait(queue, -1, &interesting_fd);
                 if (rlen <= 0) continue;
                 if (interesting_fd < 0) continue;
-                ssize_t len = read(interesting_fd, buf, UMAX16);
-                if (len <= 7) {
+                int n = uwsgi_dgram_batch_recv(interesting_fd, udb);
+                if (n < 0) {
                         uwsgi_error("[cache-udp-server] read()");
+                        continue;
                 }
-                if (buf[0] != 111) continue;
-                memcpy(&pktsize, buf+1, 2);
-                if (pktsize != len-4) continue;
-
-                memcpy(&ss, buf + 4, 2);
-                if (4+ss > pktsize) continue;
-                uint16_t keylen = ss;
-                char *key = buf + 6;
-
-                // cache set/update
-                if (buf[3] == 10) {
-                        if (keylen + 2 + 2 > pktsize) continue;
-                        memcpy(&ss, buf + 6 + keylen, 2);
-                        if (4+keylen+ss > pktsize) continue;
-                        uint16_t vallen = ss;
-                        char *val = buf + 8 + keylen;
-                        uint64_t expires = 0;
-                        if (2 + keylen + 2 + vallen + 2 < pktsize) {
-                                memcpy(&ss, buf + 8 + keylen + vallen , 2);
-                                if (6+keylen+vallen+ss > pktsize) continue;
-                                expires = uwsgi_str_num(buf + 10 + keylen+vallen, ss);
-                        }
-                        uwsgi_wlock(uc->lock);
-                        if (uwsgi_cache_set2(uc, key, keylen, val, vallen, expires, UWSGI_CACHE_FLAG_UPDATE|UWSGI_CACHE_FLAG_LOCAL|UWSGI_CACHE_FLAG_ABSEXPIRE)) {
-                                uwsgi_log("[cache-udp-server] unable to update cache\n");
-                        }
-                        uwsgi_rwunlock(uc->lock);
-                }
-                // cache del
-                else if (buf[3] == 11) {
-                        uwsgi_wlock(uc->lock);
-                        if (uwsgi_cache_del2(uc, key, keylen, 0, UWSGI_CACHE_FLAG_LOCAL)) {
-                                uwsgi_log("[cache-udp-server] unable to update cache\n");
-                        }
-                        uwsgi_rwunlock(uc->lock);
+                int i;
+                for(i=0;i<n;i++) {
+                        cache_udp_server_manage(uc, udb->buf + (udb->buf_size * i), udb->len[i]);
                 }
         }
 
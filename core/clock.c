@@ -3,6 +3,7 @@
 extern struct uwsgi_server uwsgi;
 
 int uwsgi_simple_wait_milliseconds_hook(int timeout) {
+        uwsgi_response_flush_current();
         return poll(NULL, 0, timeout);
 }
 
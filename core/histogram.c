@@ -0,0 +1,379 @@
+/*
+
+	uWSGI request histograms (--histograms)
+
+	HDR-style (log-linear) histograms living in shared memory: each power of two
+	is split in UWSGI_HISTOGRAM_SUB linear buckets, so the relative error of the
+	reported values is below 1/UWSGI_HISTOGRAM_SUB (12.5%) on the whole range.
+
+	Workers update them with atomic increments (no locks), the master takes snapshots
+	(plain copies of the buckets), merges them and extracts the percentiles for the stats
+	server and the metrics subsystem.
+
+	For each request three values are recorded:
+
+		rt -> request time (microseconds)
+		queue -> time between accept() and the start of the request (microseconds)
+		size -> response size (bytes, headers included)
+
+	in the histograms of the worker, of the app and (optionally) in the ones of
+	the label set by the 'histogram' routing action.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+static uint64_t uwsgi_histogram_quantiles[] = { 5000, 9000, 9900, 9990 };
+static char *uwsgi_histogram_quantiles_names[] = { "p50", "p90", "p99", "p999" };
+
+static int uwsgi_histogram_index(uint64_t value) {
+	if (value < UWSGI_HISTOGRAM_SUB)
+		return value;
+	int exp = 63 - __builtin_clzll(value);
+	if (exp >= UWSGI_HISTOGRAM_MAX_EXP)
+		return UWSGI_HISTOGRAM_BUCKETS - 1;
+	int shift = exp - UWSGI_HISTOGRAM_SUB_BITS;
+	return UWSGI_HISTOGRAM_SUB + (shift * UWSGI_HISTOGRAM_SUB) + ((value >> shift) & (UWSGI_HISTOGRAM_SUB - 1));
+}
+
+// the highest value stored in a bucket
+static uint64_t uwsgi_histogram_value(int index) {
+	if (index < UWSGI_HISTOGRAM_SUB)
+		return index;
+	int shift = (index - UWSGI_HISTOGRAM_SUB) / UWSGI_HISTOGRAM_SUB;
+	uint64_t sub = (index - UWSGI_HISTOGRAM_SUB) % UWSGI_HISTOGRAM_SUB;
+	return ((UWSGI_HISTOGRAM_SUB + sub + 1) << shift) - 1;
+}
+
+// atomic is required when more than one thread (or process) updates the histogram
+void uwsgi_histogram_add(struct uwsgi_histogram *uh, uint64_t value, int atomic) {
+	int index = uwsgi_histogram_index(value);
+	if (!atomic) {
+		uh->buckets[index]++;
+		uh->sum += value;
+		if (value > uh->max)
+			uh->max = value;
+		return;
+	}
+	uwsgi_atomic_add(uh->buckets[index], 1);
+	uwsgi_atomic_add(uh->sum, value);
+	uint64_t max = uwsgi_atomic_load(uh->max);
+	while (value > max) {
+		if (uwsgi_atomic_cas(uh->max, &max, value))
+			break;
+	}
+}
+
+// merge a (live) histogram in a snapshot
+void uwsgi_histogram_merge(struct uwsgi_histogram *dst, struct uwsgi_histogram *src) {
+	int i;
+	for (i = 0; i < UWSGI_HISTOGRAM_BUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+	dst->sum += src->sum;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+uint64_t uwsgi_histogram_count(struct uwsgi_histogram *uh) {
+	int i;
+	uint64_t count = 0;
+	for (i = 0; i < UWSGI_HISTOGRAM_BUCKETS; i++) {
+		count += uh->buckets[i];
+	}
+	return count;
+}
+
+// number of values lower than value (exact when value is the start of a bucket, like the powers of two)
+uint64_t uwsgi_histogram_count_below(struct uwsgi_histogram *uh, uint64_t value) {
+	int i;
+	int index = uwsgi_histogram_index(value);
+	uint64_t count = 0;
+	for (i = 0; i < index; i++) {
+		count += uh->buckets[i];
+	}
+	return count;
+}
+
+// quantile is expressed in 1/10000 (9990 -> p99.9)
+uint64_t uwsgi_histogram_quantile(struct uwsgi_histogram *uh, uint64_t count, uint64_t quantile) {
+	int i;
+	if (!count)
+		return 0;
+	// rank of the requested item (at least 1)
+	uint64_t rank = ((count * quantile) + 9999) / 10000;
+	if (!rank)
+		rank = 1;
+	uint64_t seen = 0;
+	for (i = 0; i < UWSGI_HISTOGRAM_BUCKETS; i++) {
+		seen += uh->buckets[i];
+		if (seen >= rank) {
+			return UMIN(uwsgi_histogram_value(i), uh->max);
+		}
+	}
+	return uh->max;
+}
+
+void uwsgi_histograms_init() {
+	uwsgi.histograms_workers = uwsgi_calloc_shared(sizeof(struct uwsgi_request_histograms) * (uwsgi.numproc + 1));
+	uwsgi.histograms_apps = uwsgi_calloc_shared(sizeof(struct uwsgi_request_histograms) * (uwsgi.numproc + 1) * uwsgi.max_apps);
+	int labels = 0;
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.histograms_labels) {
+		labels++;
+	}
+	if (labels > 0) {
+		uwsgi.histograms_routes = uwsgi_calloc_shared(sizeof(struct uwsgi_request_histograms) * labels);
+	}
+}
+
+// returns the 1-based index of the label (registering it if needed)
+int uwsgi_histogram_label(char *label) {
+	int id = 1;
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.histograms_labels) {
+		if (!strcmp(usl->value, label))
+			return id;
+		id++;
+	}
+	uwsgi_string_new_list(&uwsgi.histograms_labels, label);
+	return id;
+}
+
+static void uwsgi_request_histograms_add(struct uwsgi_request_histograms *urh, struct wsgi_request *wsgi_req, uint64_t rt, int atomic) {
+	uwsgi_histogram_add(&urh->rt, rt, atomic);
+	if (wsgi_req->accepted_at && wsgi_req->accepted_at <= wsgi_req->start_of_request) {
+		uwsgi_histogram_add(&urh->queue, wsgi_req->start_of_request - wsgi_req->accepted_at, atomic);
+	}
+	uwsgi_histogram_add(&urh->size, wsgi_req->response_size + wsgi_req->headers_size, atomic);
+}
+
+// called at the end of each request
+void uwsgi_histograms_account(struct wsgi_request *wsgi_req) {
+	uint64_t rt = wsgi_req->end_of_request - wsgi_req->start_of_request;
+	// the worker histograms are updated only by its cores
+	int atomic = uwsgi.cores > 1;
+	uwsgi_request_histograms_add(&uwsgi.histograms_workers[uwsgi.mywid], wsgi_req, rt, atomic);
+	if (wsgi_req->app_id >= 0 && wsgi_req->app_id < uwsgi.max_apps) {
+		uwsgi_request_histograms_add(&uwsgi.histograms_apps[(uwsgi.mywid * uwsgi.max_apps) + wsgi_req->app_id], wsgi_req, rt, atomic);
+	}
+	// route histograms are shared by all of the workers
+	if (wsgi_req->histogram_label > 0 && uwsgi.histograms_routes) {
+		uwsgi_request_histograms_add(&uwsgi.histograms_routes[wsgi_req->histogram_label - 1], wsgi_req, rt, 1);
+	}
+}
+
+int uwsgi_stats_histogram(struct uwsgi_stats *us, char *key, struct uwsgi_histogram *uh) {
+	int i;
+	uint64_t count = uwsgi_histogram_count(uh);
+	if (uwsgi_stats_key(us, key))
+		return -1;
+	if (uwsgi_stats_object_open(us))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "count", (unsigned long long) count))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "sum", (unsigned long long) uh->sum))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "mean", (unsigned long long) (count ? uh->sum / count : 0)))
+		return -1;
+	for (i = 0; i < 4; i++) {
+		if (uwsgi_stats_keylong_comma(us, uwsgi_histogram_quantiles_names[i], (unsigned long long) uwsgi_histogram_quantile(uh, count, uwsgi_histogram_quantiles[i])))
+			return -1;
+	}
+	if (uwsgi_stats_keylong(us, "max", (unsigned long long) uh->max))
+		return -1;
+	return uwsgi_stats_object_close(us);
+}
+
+// "key":{"rt":{...},"queue":{...},"size":{...}}
+int uwsgi_stats_request_histograms(struct uwsgi_stats *us, char *key, struct uwsgi_request_histograms *urh) {
+	// snapshot
+	struct uwsgi_request_histograms copy;
+	memset(&copy, 0, sizeof(struct uwsgi_request_histograms));
+	uwsgi_histogram_merge(&copy.rt, &urh->rt);
+	uwsgi_histogram_merge(&copy.queue, &urh->queue);
+	uwsgi_histogram_merge(&copy.size, &urh->size);
+
+	if (uwsgi_stats_key(us, key))
+		return -1;
+	if (uwsgi_stats_object_open(us))
+		return -1;
+	if (uwsgi_stats_histogram(us, "rt", &copy.rt))
+		return -1;
+	if (uwsgi_stats_comma(us))
+		return -1;
+	if (uwsgi_stats_histogram(us, "queue", &copy.queue))
+		return -1;
+	if (uwsgi_stats_comma(us))
+		return -1;
+	if (uwsgi_stats_histogram(us, "size", &copy.size))
+		return -1;
+	return uwsgi_stats_object_close(us);
+}
+
+// the merged view of all of the workers and the route labels
+int uwsgi_stats_histograms(struct uwsgi_stats *us) {
+	int i;
+	struct uwsgi_request_histograms *merged = uwsgi_calloc(sizeof(struct uwsgi_request_histograms));
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		uwsgi_histogram_merge(&merged->rt, &uwsgi.histograms_workers[i].rt);
+		uwsgi_histogram_merge(&merged->queue, &uwsgi.histograms_workers[i].queue);
+		uwsgi_histogram_merge(&merged->size, &uwsgi.histograms_workers[i].size);
+	}
+
+	if (uwsgi_stats_key(us, "histograms"))
+		goto error;
+	if (uwsgi_stats_object_open(us))
+		goto error;
+	if (uwsgi_stats_request_histograms(us, "total", merged))
+		goto error;
+	free(merged);
+	merged = NULL;
+	if (uwsgi_stats_comma(us))
+		goto error;
+	if (uwsgi_stats_key(us, "routes"))
+		goto error;
+	if (uwsgi_stats_object_open(us))
+		goto error;
+	struct uwsgi_string_list *usl;
+	i = 0;
+	uwsgi_foreach(usl, uwsgi.histograms_labels) {
+		if (i > 0) {
+			if (uwsgi_stats_comma(us))
+				goto error;
+		}
+		if (uwsgi_stats_request_histograms(us, usl->value, &uwsgi.histograms_routes[i]))
+			goto error;
+		i++;
+	}
+	if (uwsgi_stats_object_close(us))
+		goto error;
+	return uwsgi_stats_object_close(us);
+error:
+	free(merged);
+	return -1;
+}
+
+/*
+	the "histogram" metric collector
+
+	custom points to a struct uwsgi_histogram_metric, the histograms are merged
+	and the requested quantile is returned
+*/
+struct uwsgi_histogram_metric {
+	struct uwsgi_histogram **histograms;
+	int count;
+	uint64_t quantile;
+};
+
+int64_t uwsgi_metric_collector_histogram(struct uwsgi_metric *um) {
+	struct uwsgi_histogram_metric *uhm = (struct uwsgi_histogram_metric *) um->custom;
+	struct uwsgi_histogram snapshot;
+	int i;
+	if (!uhm)
+		return 0;
+	memset(&snapshot, 0, sizeof(struct uwsgi_histogram));
+	for (i = 0; i < uhm->count; i++) {
+		uwsgi_histogram_merge(&snapshot, uhm->histograms[i]);
+	}
+	return uwsgi_histogram_quantile(&snapshot, uwsgi_histogram_count(&snapshot), uhm->quantile);
+}
+
+static void uwsgi_histogram_register_metrics(char *prefix, char *oid_prefix, struct uwsgi_histogram **histograms, int count) {
+	int i;
+	char name[4096];
+	char oid[4096];
+	for (i = 0; i < 4; i++) {
+		struct uwsgi_histogram_metric *uhm = uwsgi_calloc(sizeof(struct uwsgi_histogram_metric));
+		uhm->histograms = histograms;
+		uhm->count = count;
+		uhm->quantile = uwsgi_histogram_quantiles[i];
+		int ret = snprintf(name, 4096, "%s_%s", prefix, uwsgi_histogram_quantiles_names[i]);
+		if (ret <= 1 || ret >= 4096) {
+			uwsgi_log("unable to register metric name %s_%s\n", prefix, uwsgi_histogram_quantiles_names[i]);
+			exit(1);
+		}
+		char *oid_ptr = NULL;
+		if (oid_prefix) {
+			ret = snprintf(oid, 4096, "%s.%d", oid_prefix, i + 1);
+			if (ret <= 1 || ret >= 4096) {
+				uwsgi_log("unable to register metric oid %s.%d\n", oid_prefix, i + 1);
+				exit(1);
+			}
+			oid_ptr = oid;
+		}
+		uwsgi_register_metric(name, oid_ptr, UWSGI_METRIC_GAUGE, "histogram", NULL, 0, uhm);
+	}
+}
+
+static void uwsgi_request_histograms_register_metrics(char *prefix, char *oid_prefix, struct uwsgi_request_histograms **urh, int count) {
+	int i;
+	char name[4096];
+	char oid[4096];
+	char *names[] = { "rt", "queue", "size" };
+	int j;
+	for (j = 0; j < 3; j++) {
+		struct uwsgi_histogram **histograms = uwsgi_calloc(sizeof(struct uwsgi_histogram *) * count);
+		for (i = 0; i < count; i++) {
+			if (j == 0)
+				histograms[i] = &urh[i]->rt;
+			else if (j == 1)
+				histograms[i] = &urh[i]->queue;
+			else
+				histograms[i] = &urh[i]->size;
+		}
+		int ret = snprintf(name, 4096, "%s.%s", prefix, names[j]);
+		if (ret <= 1 || ret >= 4096) {
+			uwsgi_log("unable to register metric name %s.%s\n", prefix, names[j]);
+			exit(1);
+		}
+		char *oid_ptr = NULL;
+		if (oid_prefix) {
+			ret = snprintf(oid, 4096, "%s.%d", oid_prefix, j + 1);
+			if (ret <= 1 || ret >= 4096) {
+				uwsgi_log("unable to register metric oid %s.%d\n", oid_prefix, j + 1);
+				exit(1);
+			}
+			oid_ptr = oid;
+		}
+		uwsgi_histogram_register_metrics(name, oid_ptr, histograms, count);
+	}
+}
+
+/*
+	worker.N.{rt,queue,size}_{p50,p90,p99,p999}
+	core.{rt,queue,size}_{p50,p90,p99,p999} (all of the workers)
+	route.LABEL.{rt,queue,size}_{p50,p90,p99,p999}
+*/
+void uwsgi_histograms_register_metrics() {
+	int i;
+	char name[4096];
+	char oid[4096];
+
+	struct uwsgi_request_histograms **all = uwsgi_calloc(sizeof(struct uwsgi_request_histograms *) * uwsgi.numproc);
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		all[i - 1] = &uwsgi.histograms_workers[i];
+		struct uwsgi_request_histograms **urh = uwsgi_malloc(sizeof(struct uwsgi_request_histograms *));
+		urh[0] = &uwsgi.histograms_workers[i];
+		snprintf(name, 4096, "worker.%d", i);
+		snprintf(oid, 4096, "3.%d.20", i);
+		uwsgi_request_histograms_register_metrics(name, oid, urh, 1);
+	}
+	uwsgi_request_histograms_register_metrics("core", "5.110", all, uwsgi.numproc);
+
+	struct uwsgi_string_list *usl;
+	i = 0;
+	uwsgi_foreach(usl, uwsgi.histograms_labels) {
+		struct uwsgi_request_histograms **urh = uwsgi_malloc(sizeof(struct uwsgi_request_histograms *));
+		urh[0] = &uwsgi.histograms_routes[i];
+		int ret = snprintf(name, 4096, "route.%s", usl->value);
+		if (ret <= 1 || ret >= 4096) {
+			uwsgi_log("unable to register metric name route.%s\n", usl->value);
+			exit(1);
+		}
+		uwsgi_request_histograms_register_metrics(name, NULL, urh, 1);
+		i++;
+	}
+}
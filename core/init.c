@@ -71,9 +71,14 @@ void uwsgi_init_default() {
 	uwsgi.signal_socket = -1;
 	uwsgi.my_signal_socket = -1;
 	uwsgi.stats_fd = -1;
+	uwsgi.metrics_http_fd = -1;
 
 	uwsgi.stats_pusher_default_freq = 3;
 
+	uwsgi.trace_ring_size = 4096;
+	uwsgi.trace_sample = 1;
+	uwsgi.trace_flush_interval = 100;
+
 	uwsgi.original_log_fd = 2;
 
 	uwsgi.emperor_fd_config = -1;
@@ -95,6 +100,8 @@ void uwsgi_init_default() {
 
 	// default max number of rpc slot
 	uwsgi.rpc_max = 64;
+	uwsgi.rpc_mule_slots = 4;
+	uwsgi.rpc_mule_bufsize = 65536;
 
 	uwsgi.offload_threads_events = 64;
 
@@ -109,11 +116,16 @@ void uwsgi_init_default() {
 	uwsgi.async = 0;
 	uwsgi.async_warn_if_queue_full = 1;
 	uwsgi.listen_queue = 100;
+	uwsgi.accept_batch = 1;
+	uwsgi.udp_batch = 8;
+	uwsgi.request_arena_size = 16384;
 
 	uwsgi.cheaper_overload = 3;
 	uwsgi.cheaper_idle = 10;
 
 	uwsgi.log_master_bufsize = 8192;
+	uwsgi.log_batch_size = 65536;
+	uwsgi.log_batch_flush = 100;
 
 	uwsgi.worker_reload_mercy = 60;
 	uwsgi.mule_reload_mercy = 60;
@@ -128,6 +140,8 @@ void uwsgi_init_default() {
 	uwsgi.min_worker_lifetime = 10;
 
 	uwsgi.spooler_frequency = 30;
+	uwsgi.spooler_index_size = 1000000;
+	uwsgi.spooler_log_segment_size = 64 * 1024 * 1024;
 
 	uwsgi.shared->spooler_signal_pipe[0] = -1;
 	uwsgi.shared->spooler_signal_pipe[1] = -1;
@@ -367,6 +381,9 @@ void uwsgi_setup_workers() {
 		snprintf(uwsgi.workers[i].name, 0xff, "uWSGI worker %d", i);
 	}
 
+	// per-core request arenas (process local, the arenas are created on the first use of each core)
+	uwsgi.request_arenas = uwsgi_calloc(sizeof(struct uwsgi_arena *) * uwsgi.cores);
+
 	uint64_t total_memory = (sizeof(struct uwsgi_app) * uwsgi.max_apps) + (sizeof(struct uwsgi_core) * uwsgi.cores) + (sizeof(void *) * uwsgi.max_apps * uwsgi.cores) + (uwsgi.buffer_size * uwsgi.cores) + (sizeof(struct iovec) * uwsgi.vec_size * uwsgi.cores);
 	if (uwsgi.post_buffering > 0) {
 		total_memory += (uwsgi.post_buffering_bufsize * uwsgi.cores);
@@ -386,6 +403,15 @@ void uwsgi_setup_workers() {
 	uwsgi_fixup_routes(uwsgi.final_routes);
 #endif
 
+	// routes are parsed, so the labels are known
+	if (uwsgi.histograms) {
+		uwsgi_histograms_init();
+	}
+
+	if (uwsgi.trace_spans) {
+		uwsgi_tracing_init();
+	}
+
 }
 
 pid_t uwsgi_daemonize2() {
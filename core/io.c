@@ -1634,3 +1634,70 @@ end:
 	return ret;	
 }
 
+
+/*
+	datagrams batching
+
+	read up to udb->max datagrams with a single syscall (recvmmsg() on Linux),
+	other platforms (or a batch of 1) fallback to a plain recvfrom().
+
+	returns the number of datagrams read (or -1 on error)
+*/
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define UWSGI_HAS_RECVMMSG 1
+#endif
+
+struct uwsgi_dgram_batch *uwsgi_dgram_batch_new(int max, size_t buf_size) {
+	int i;
+	if (max < 1) max = 1;
+	struct uwsgi_dgram_batch *udb = uwsgi_calloc(sizeof(struct uwsgi_dgram_batch));
+	udb->max = max;
+	udb->buf_size = buf_size;
+	udb->buf = uwsgi_malloc(buf_size * max);
+	udb->len = uwsgi_calloc(sizeof(ssize_t) * max);
+	udb->addr = uwsgi_calloc(sizeof(struct sockaddr_storage) * max);
+	udb->addr_len = uwsgi_calloc(sizeof(socklen_t) * max);
+#ifdef UWSGI_HAS_RECVMMSG
+	struct mmsghdr *msgs = uwsgi_calloc(sizeof(struct mmsghdr) * max);
+	struct iovec *iov = uwsgi_calloc(sizeof(struct iovec) * max);
+	for(i=0;i<max;i++) {
+		iov[i].iov_base = udb->buf + (buf_size * i);
+		iov[i].iov_len = buf_size;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &udb->addr[i];
+	}
+	udb->msgs = msgs;
+	udb->iov = iov;
+#else
+	(void) i;
+#endif
+	return udb;
+}
+
+int uwsgi_dgram_batch_recv(int fd, struct uwsgi_dgram_batch *udb) {
+#ifdef UWSGI_HAS_RECVMMSG
+	if (udb->max > 1) {
+		int i;
+		struct mmsghdr *msgs = (struct mmsghdr *) udb->msgs;
+		for(i=0;i<udb->max;i++) {
+			msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			msgs[i].msg_len = 0;
+		}
+		// block (if needed) only for the first datagram
+		int ret = recvmmsg(fd, msgs, udb->max, MSG_WAITFORONE, NULL);
+		if (ret < 0) return -1;
+		for(i=0;i<ret;i++) {
+			udb->len[i] = msgs[i].msg_len;
+			udb->addr_len[i] = msgs[i].msg_hdr.msg_namelen;
+		}
+		return ret;
+	}
+#endif
+	udb->addr_len[0] = sizeof(struct sockaddr_storage);
+	ssize_t rlen = recvfrom(fd, udb->buf, udb->buf_size, 0, (struct sockaddr *) &udb->addr[0], &udb->addr_len[0]);
+	if (rlen < 0) return -1;
+	udb->len[0] = rlen;
+	return 1;
+}
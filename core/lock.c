@@ -801,6 +801,43 @@ int uwsgi_fcntl_is_locked(int fd) {
 
 }
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+	wait until *addr differs from val (or a wakeup/timeout happens), timeout is in milliseconds (-1 for infinite).
+
+	The words live in memory shared by different processes, so FUTEX_PRIVATE_FLAG cannot be used.
+	On non-Linux systems waiting degrades to a short sleep (callers always recheck their condition).
+*/
+int uwsgi_futex_wait(uint32_t *addr, uint32_t val, int timeout) {
+#ifdef __linux__
+	struct timespec ts, *tsp = NULL;
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		tsp = &ts;
+	}
+	return syscall(SYS_futex, addr, FUTEX_WAIT, val, tsp, NULL, 0);
+#else
+	if (uwsgi_atomic_load(*addr) != val)
+		return 0;
+	usleep(timeout >= 0 && timeout < 10 ? timeout * 1000 : 10000);
+	return 0;
+#endif
+}
+
+// wake up to n waiters of addr
+int uwsgi_futex_wake(uint32_t *addr, int n) {
+#ifdef __linux__
+	return syscall(SYS_futex, addr, FUTEX_WAKE, n, NULL, NULL, 0);
+#else
+	return 0;
+#endif
+}
+
 void uwsgi_deadlock_check(pid_t diedpid) {
 	struct uwsgi_lock_item *uli = uwsgi.registered_locks;
 	while (uli) {
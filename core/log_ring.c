@@ -0,0 +1,213 @@
+/*
+
+	uWSGI request log rings (--log-req-ring)
+
+	Each worker has a shared memory ring where its threads/cores push request log lines
+	(multiple producers), the master (or the threaded logger) drains all of the rings
+	in batches (single consumer).
+
+	Producers reserve space by moving the ring head with a CAS, copy the line,
+	and publish the record by storing its absolute position in the record header.
+	The consumer stops at the first unpublished record, so stale data from the
+	previous laps is never read.
+
+	When the ring is full the line is dropped (and accounted), unless --log-req-ring-block
+	is set: in such a case the worker waits for the master to free some space.
+
+	The master request logpipe is still used as a doorbell: the consumer
+	marks itself as sleeping before waiting on it, and only the first producer
+	publishing a line after that writes a byte into it.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+#define UWSGI_LOG_RING_ALIGN 16
+#define UWSGI_LOG_RING_PAD 0xffffffff
+#define UWSGI_LOG_RING_BATCH 4096
+
+struct uwsgi_log_ring_record {
+	uint64_t pos;
+	uint32_t len;
+	uint32_t reserved;
+	char data[];
+};
+
+#define uwsgi_log_ring_aligned(x) (((x) + (UWSGI_LOG_RING_ALIGN - 1)) & ~((uint64_t) UWSGI_LOG_RING_ALIGN - 1))
+
+void uwsgi_req_log_rings_init() {
+	int i;
+	uint64_t size = uwsgi_log_ring_aligned(uwsgi.req_log_ring_size);
+	if (size < 4096)
+		size = 4096;
+
+	uwsgi.req_log_rings = uwsgi_calloc(sizeof(struct uwsgi_log_ring *) * (uwsgi.numproc + 1));
+	for (i = 0; i <= uwsgi.numproc; i++) {
+		struct uwsgi_log_ring *ulr = uwsgi_calloc_shared(sizeof(struct uwsgi_log_ring) + size);
+		ulr->size = size;
+		// zeroed headers must not look like published records
+		ulr->head = size;
+		ulr->tail = size;
+		uwsgi.req_log_rings[i] = ulr;
+	}
+
+	// the consumer is not running yet
+	uwsgi.shared->req_log_ring_sleeping = 1;
+}
+
+// force is used by blocked producers (the consumer could be already awake but slow)
+static void uwsgi_req_log_ring_wakeup(int force) {
+	int sleeping = 1;
+	uwsgi_atomic_fence();
+	if (!force) {
+		if (!uwsgi_atomic_load(uwsgi.shared->req_log_ring_sleeping))
+			return;
+		// only one producer rings the doorbell
+		if (!uwsgi_atomic_cas(uwsgi.shared->req_log_ring_sleeping, &sleeping, 0))
+			return;
+	}
+	// the consumer will be woken up anyway if the logpipe is full
+	if (write(uwsgi.shared->worker_req_log_pipe[1], "\n", 1) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		uwsgi_error("uwsgi_req_log_ring_wakeup()/write()");
+	}
+}
+
+// push a log line (gathered from the iovecs) in the ring of the current worker
+int uwsgi_req_log_ring_push(struct iovec *iov, int iovcnt) {
+	struct uwsgi_log_ring *ulr = uwsgi.req_log_rings[uwsgi.mywid];
+	int i;
+	size_t len = 0;
+	for (i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	// lines are truncated as with the logpipe
+	if (len > uwsgi.log_master_bufsize)
+		len = uwsgi.log_master_bufsize;
+	if (len > ulr->size / 4)
+		len = ulr->size / 4;
+
+	uint64_t need = uwsgi_log_ring_aligned(sizeof(struct uwsgi_log_ring_record) + len);
+	uint64_t head, off, total;
+
+	for (;;) {
+		head = uwsgi_atomic_load(ulr->head);
+		off = head % ulr->size;
+		total = need;
+		// records never wrap, the end of the ring is skipped
+		if (off + need > ulr->size) {
+			total += ulr->size - off;
+		}
+		uint64_t tail = uwsgi_atomic_load(ulr->tail);
+		if (head + total - tail > ulr->size) {
+			if (!uwsgi.req_log_ring_block) {
+				uwsgi_atomic_add(ulr->dropped, 1);
+				return -1;
+			}
+			uwsgi_atomic_add(ulr->waits, 1);
+			uwsgi_req_log_ring_wakeup(1);
+			usleep(1000);
+			continue;
+		}
+		if (uwsgi_atomic_cas(ulr->head, &head, head + total))
+			break;
+	}
+
+	struct uwsgi_log_ring_record *ulrr;
+	if (total != need) {
+		ulrr = (struct uwsgi_log_ring_record *) (ulr->data + off);
+		ulrr->len = UWSGI_LOG_RING_PAD;
+		uwsgi_atomic_store(ulrr->pos, head);
+		head += ulr->size - off;
+		off = 0;
+	}
+
+	ulrr = (struct uwsgi_log_ring_record *) (ulr->data + off);
+	size_t copied = 0;
+	for (i = 0; i < iovcnt && copied < len; i++) {
+		size_t chunk = UMIN(iov[i].iov_len, len - copied);
+		memcpy(ulrr->data + copied, iov[i].iov_base, chunk);
+		copied += chunk;
+	}
+	ulrr->len = len;
+	uwsgi_atomic_store(ulrr->pos, head);
+	uwsgi_atomic_add(ulr->lines, 1);
+
+	uwsgi_req_log_ring_wakeup(0);
+	return 0;
+}
+
+// consume the published records of a ring, returns the number of lines
+static uint64_t uwsgi_req_log_ring_drain(struct uwsgi_log_ring *ulr, void (*func) (char *, size_t)) {
+	uint64_t lines = 0;
+	uint64_t tail = ulr->tail;
+	for (;;) {
+		uint64_t off = tail % ulr->size;
+		struct uwsgi_log_ring_record *ulrr = (struct uwsgi_log_ring_record *) (ulr->data + off);
+		if (uwsgi_atomic_load(ulrr->pos) != tail)
+			break;
+		if (ulrr->len == UWSGI_LOG_RING_PAD) {
+			tail += ulr->size - off;
+			continue;
+		}
+		// copy the line, so the space can be released before calling the loggers
+		size_t len = UMIN(ulrr->len, uwsgi.log_master_bufsize);
+		memcpy(uwsgi.log_master_buf, ulrr->data, len);
+		tail += uwsgi_log_ring_aligned(sizeof(struct uwsgi_log_ring_record) + ulrr->len);
+		uwsgi_atomic_store(ulr->tail, tail);
+		func(uwsgi.log_master_buf, len);
+		lines++;
+	}
+	return lines;
+}
+
+/*
+	drain all of the rings, the consumer is marked as sleeping only when they are empty
+
+	after UWSGI_LOG_RING_BATCH lines the consumer rings the doorbell by itself and
+	returns, so the master event loop is not starved under load
+*/
+void uwsgi_req_log_rings_consume(void (*func) (char *, size_t)) {
+	int i;
+	uint64_t consumed = 0;
+	for (;;) {
+		uint64_t lines = 0;
+		for (i = 0; i <= uwsgi.numproc; i++) {
+			lines += uwsgi_req_log_ring_drain(uwsgi.req_log_rings[i], func);
+		}
+		consumed += lines;
+		if (consumed >= UWSGI_LOG_RING_BATCH) {
+			uwsgi_req_log_ring_wakeup(1);
+			return;
+		}
+		if (lines)
+			continue;
+		uwsgi_atomic_store(uwsgi.shared->req_log_ring_sleeping, 1);
+		uwsgi_atomic_fence();
+		// check again for lines published before the flag was set
+		for (i = 0; i <= uwsgi.numproc; i++) {
+			lines += uwsgi_req_log_ring_drain(uwsgi.req_log_rings[i], func);
+		}
+		if (!lines)
+			break;
+	}
+}
+
+/*
+	a dead worker could have left a reserved (but never published) record in the ring,
+	called by the master before respawning it
+*/
+void uwsgi_req_log_ring_recover(int wid, void (*func) (char *, size_t)) {
+	struct uwsgi_log_ring *ulr = uwsgi.req_log_rings[wid];
+	// the master log buffer is not available at the first spawn (the rings are empty)
+	if (!uwsgi.log_master_buf)
+		return;
+	uwsgi_req_log_ring_drain(ulr, func);
+	uint64_t head = uwsgi_atomic_load(ulr->head);
+	if (ulr->tail != head) {
+		uwsgi_atomic_add(ulr->dropped, 1);
+		uwsgi_atomic_store(ulr->tail, head);
+	}
+}
@@ -0,0 +1,645 @@
+/*
+
+	uWSGI logformat engine (--logformat)
+
+	the format is parsed in a chain of chunks (raw text, request fields, vars,
+	logvars, metrics and functions registered by the core and the plugins).
+
+	By default the chunks are rendered by a compiled formatter: each core has a preallocated
+	buffer and all of the fields are written directly in it (numbers included), so in the steady
+	state building a log line does not need heap memory. Lines longer than the buffer are truncated.
+
+	--logformat-json escapes the values of the variables (not the raw text) for being
+	used in a json document.
+
+	--logformat-iovec restores the old engine, building an iovec for each line.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+// the core log chunks are allocated in the request arena (no need to free them)
+static char *uwsgi_lf_alloc_num(struct wsgi_request *wsgi_req, int64_t num) {
+	char *buf = uwsgi_req_alloc(wsgi_req, sizeof(UMAX64_STR) + 1);
+	snprintf(buf, sizeof(UMAX64_STR) + 1, "%lld", (long long) num);
+	return buf;
+}
+
+void uwsgi_logit_lf(struct wsgi_request *wsgi_req) {
+	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
+	ssize_t rlen = 0;
+	const char *empty_var = "-";
+	while (logchunk) {
+		int pos = logchunk->vec;
+		// raw string
+		if (logchunk->type == 0) {
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = logchunk->ptr;
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = logchunk->len;
+		}
+		// offsetof
+		else if (logchunk->type == 1) {
+			char **var = (char **) (((char *) wsgi_req) + logchunk->pos);
+			uint16_t *varlen = (uint16_t *) (((char *) wsgi_req) + logchunk->pos_len);
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = *var;
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = *varlen;
+		}
+		// logvar
+		else if (logchunk->type == 2) {
+			struct uwsgi_logvar *lv = uwsgi_logvar_get(wsgi_req, logchunk->ptr, logchunk->len);
+			if (lv) {
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = lv->val;
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = lv->vallen;
+			}
+			else {
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = NULL;
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
+			}
+		}
+		// func
+		else if (logchunk->type == 3) {
+			rlen = logchunk->func(wsgi_req, (char **) &uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
+			if (rlen > 0) {
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = rlen;
+			}
+			else {
+				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
+			}
+		}
+		// var
+		else if (logchunk->type == 5) {
+			uint16_t value_len = 0;
+			char *value = uwsgi_get_var(wsgi_req, logchunk->ptr, logchunk->len, &value_len);
+			// could be NULL
+                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = value;
+                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = (size_t) value_len;
+                }
+		// metric
+		else if (logchunk->type == 4) {
+			int64_t metric = uwsgi_metric_get(logchunk->ptr, NULL);
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = uwsgi_lf_alloc_num(wsgi_req, metric);
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = strlen(uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
+		}
+		// numeric func
+		else if (logchunk->type == 6) {
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = uwsgi_lf_alloc_num(wsgi_req, logchunk->num(wsgi_req));
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = strlen(uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
+		}
+
+		if (uwsgi.logvectors[wsgi_req->async_id][pos].iov_len == 0 && logchunk->type != 0) {
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = (char *) empty_var;
+			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 1;
+		}
+		logchunk = logchunk->next;
+	}
+
+	uwsgi_req_log_write(uwsgi.logvectors[wsgi_req->async_id], uwsgi.logformat_vectors);
+
+	// free allocated memory
+	logchunk = uwsgi.logchunks;
+	while (logchunk) {
+		if (logchunk->free) {
+			if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_len > 0) {
+				if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base != empty_var) {
+					free(uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base);
+				}
+			}
+		}
+		logchunk = logchunk->next;
+	}
+}
+
+/*
+	compiled formatter helpers
+
+	they never write past end (one byte is always reserved for the trailing newline)
+*/
+static char *uwsgi_lf_put(char *ptr, char *end, char *buf, size_t len) {
+	if (len > (size_t) (end - ptr))
+		len = end - ptr;
+	memcpy(ptr, buf, len);
+	return ptr + len;
+}
+
+static char *uwsgi_lf_put_json(char *ptr, char *end, char *buf, size_t len) {
+	static char hex[] = "0123456789abcdef";
+	size_t i;
+	for (i = 0; i < len && ptr < end; i++) {
+		unsigned char c = (unsigned char) buf[i];
+		char *esc = NULL;
+		switch (c) {
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		default:
+			if (c < 0x20) {
+				// do not split escape sequences
+				if (end - ptr < 6)
+					return ptr;
+				*ptr++ = '\\';
+				*ptr++ = 'u';
+				*ptr++ = '0';
+				*ptr++ = '0';
+				*ptr++ = hex[c >> 4];
+				*ptr++ = hex[c & 0xf];
+				continue;
+			}
+			*ptr++ = c;
+			continue;
+		}
+		if (end - ptr < 2)
+			return ptr;
+		*ptr++ = esc[0];
+		*ptr++ = esc[1];
+	}
+	return ptr;
+}
+
+static char *uwsgi_lf_put_var(char *ptr, char *end, char *buf, size_t len) {
+	if (!buf || len == 0)
+		return uwsgi_lf_put(ptr, end, "-", 1);
+	if (uwsgi.logformat_json)
+		return uwsgi_lf_put_json(ptr, end, buf, len);
+	return uwsgi_lf_put(ptr, end, buf, len);
+}
+
+static char *uwsgi_lf_put_num(char *ptr, char *end, int64_t num) {
+	char tmp[sizeof(UMAX64_STR) + 1];
+	char *digits = tmp + sizeof(tmp);
+	uint64_t n = num < 0 ? -(uint64_t) num : (uint64_t) num;
+	do {
+		*--digits = '0' + (n % 10);
+		n /= 10;
+	} while (n);
+	if (num < 0)
+		*--digits = '-';
+	return uwsgi_lf_put(ptr, end, digits, (tmp + sizeof(tmp)) - digits);
+}
+
+// render the chunks in buf, returns the size of the line (newline included)
+size_t uwsgi_logformat_render(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
+	char *ptr = buf;
+	// reserve space for the newline
+	char *end = buf + len - 1;
+
+	while (logchunk) {
+		switch (logchunk->type) {
+		// raw string
+		case 0:
+			ptr = uwsgi_lf_put(ptr, end, logchunk->ptr, logchunk->len);
+			break;
+		// offsetof
+		case 1:{
+				char **var = (char **) (((char *) wsgi_req) + logchunk->pos);
+				uint16_t *varlen = (uint16_t *) (((char *) wsgi_req) + logchunk->pos_len);
+				ptr = uwsgi_lf_put_var(ptr, end, *var, *varlen);
+			}
+			break;
+		// logvar
+		case 2:{
+				struct uwsgi_logvar *lv = uwsgi_logvar_get(wsgi_req, logchunk->ptr, logchunk->len);
+				if (lv) {
+					ptr = uwsgi_lf_put_var(ptr, end, lv->val, lv->vallen);
+				}
+				else {
+					ptr = uwsgi_lf_put_var(ptr, end, NULL, 0);
+				}
+			}
+			break;
+		// func
+		case 3:{
+				char *value = NULL;
+				ssize_t rlen = logchunk->func(wsgi_req, &value);
+				ptr = uwsgi_lf_put_var(ptr, end, value, rlen > 0 ? rlen : 0);
+				if (logchunk->free && rlen > 0)
+					free(value);
+			}
+			break;
+		// metric
+		case 4:
+			ptr = uwsgi_lf_put_num(ptr, end, uwsgi_metric_get(logchunk->ptr, NULL));
+			break;
+		// var
+		case 5:{
+				uint16_t value_len = 0;
+				char *value = uwsgi_get_var(wsgi_req, logchunk->ptr, logchunk->len, &value_len);
+				ptr = uwsgi_lf_put_var(ptr, end, value, value_len);
+			}
+			break;
+		// numeric func
+		case 6:
+			ptr = uwsgi_lf_put_num(ptr, end, logchunk->num(wsgi_req));
+			break;
+		default:
+			break;
+		}
+		logchunk = logchunk->next;
+	}
+
+	*ptr++ = '\n';
+	return ptr - buf;
+}
+
+void uwsgi_logit_lf_compiled(struct wsgi_request *wsgi_req) {
+	struct iovec iov;
+	iov.iov_base = uwsgi.logformat_buffers[wsgi_req->async_id];
+	iov.iov_len = uwsgi_logformat_render(wsgi_req, iov.iov_base, uwsgi.logformat_buffer_size);
+	uwsgi_req_log_write(&iov, 1);
+}
+
+// called after the cores are allocated
+void uwsgi_logformat_init() {
+	int j;
+	uwsgi_build_log_format(uwsgi.logformat);
+
+	if (uwsgi.logformat_iovec && !uwsgi.logformat_json) {
+		uwsgi.logit = uwsgi_logit_lf;
+		uwsgi.logvectors = uwsgi_malloc(sizeof(struct iovec *) * uwsgi.cores);
+		for (j = 0; j < uwsgi.cores; j++) {
+			uwsgi.logvectors[j] = uwsgi_malloc(sizeof(struct iovec) * uwsgi.logformat_vectors);
+			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_base = "\n";
+			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_len = 1;
+		}
+		return;
+	}
+
+	if (!uwsgi.logformat_buffer_size) {
+		uwsgi.logformat_buffer_size = uwsgi.log_master_bufsize;
+	}
+	if (uwsgi.logformat_buffer_size < 2) {
+		uwsgi.logformat_buffer_size = 2;
+	}
+
+	uwsgi.logit = uwsgi_logit_lf_compiled;
+	uwsgi.logformat_buffers = uwsgi_malloc(sizeof(char *) * uwsgi.cores);
+	for (j = 0; j < uwsgi.cores; j++) {
+		uwsgi.logformat_buffers[j] = uwsgi_malloc(uwsgi.logformat_buffer_size);
+	}
+}
+
+void uwsgi_build_log_format(char *format) {
+	int state = 0;
+	char *ptr = format;
+	char *current = ptr;
+	char *logvar = NULL;
+	// get the number of required iovec
+	while (*ptr) {
+		if (*ptr == '%') {
+			if (state == 0) {
+				state = 1;
+			}
+		}
+		// start of the variable
+		else if (*ptr == '(') {
+			if (state == 1) {
+				state = 2;
+			}
+		}
+		// end of the variable
+		else if (*ptr == ')') {
+			if (logvar) {
+				uwsgi_add_logchunk(1, uwsgi.logformat_vectors, logvar, ptr - logvar);
+				uwsgi.logformat_vectors++;
+				state = 0;
+				logvar = NULL;
+				current = ptr + 1;
+			}
+		}
+		else {
+			if (state == 2) {
+				uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, (ptr - current) - 2);
+				uwsgi.logformat_vectors++;
+				logvar = ptr;
+			}
+			state = 0;
+		}
+		ptr++;
+	}
+
+	if (ptr - current > 0) {
+		uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, ptr - current);
+		uwsgi.logformat_vectors++;
+	}
+
+	// +1 for "\n"
+
+	uwsgi.logformat_vectors++;
+
+}
+
+static int64_t uwsgi_lf_status(struct wsgi_request *wsgi_req) {
+	return wsgi_req->status;
+}
+
+static int64_t uwsgi_lf_rsize(struct wsgi_request *wsgi_req) {
+	return wsgi_req->response_size;
+}
+
+static int64_t uwsgi_lf_hsize(struct wsgi_request *wsgi_req) {
+	return wsgi_req->headers_size;
+}
+
+static int64_t uwsgi_lf_size(struct wsgi_request *wsgi_req) {
+	return wsgi_req->headers_size + wsgi_req->response_size;
+}
+
+static int64_t uwsgi_lf_cl(struct wsgi_request *wsgi_req) {
+	return wsgi_req->post_cl;
+}
+
+static int64_t uwsgi_lf_epoch(struct wsgi_request *wsgi_req) {
+	return uwsgi_now();
+}
+
+static ssize_t uwsgi_lf_ctime(struct wsgi_request * wsgi_req, char **buf) {
+	*buf = uwsgi_req_alloc(wsgi_req, 26);
+#if defined(__sun__) && !defined(__clang__)
+	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf, 26);
+#else
+	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf);
+#endif
+	return 24;
+}
+
+static int64_t uwsgi_lf_time(struct wsgi_request *wsgi_req) {
+	return wsgi_req->start_of_request / 1000000;
+}
+
+static ssize_t uwsgi_lf_ltime(struct wsgi_request * wsgi_req, char **buf) {
+	*buf = uwsgi_req_alloc(wsgi_req, 64);
+	time_t now = wsgi_req->start_of_request / 1000000;
+	size_t ret = strftime(*buf, 64, "%d/%b/%Y:%H:%M:%S %z", localtime(&now));
+	if (ret == 0) {
+		*buf[0] = 0;
+		return 0;
+	}
+	return ret;
+}
+
+static ssize_t uwsgi_lf_ftime(struct wsgi_request * wsgi_req, char **buf) {
+	if (!uwsgi.logformat_strftime || !uwsgi.log_strftime) {
+		return uwsgi_lf_ltime(wsgi_req, buf);
+	}
+	*buf = uwsgi_req_alloc(wsgi_req, 64);
+	time_t now = wsgi_req->start_of_request / 1000000;
+	size_t ret = strftime(*buf, 64, uwsgi.log_strftime, localtime(&now));
+	if (ret == 0) {
+		*buf[0] = 0;
+		return 0;
+	}
+	return ret;
+}
+
+static int64_t uwsgi_lf_tmsecs(struct wsgi_request *wsgi_req) {
+	return wsgi_req->start_of_request / (int64_t) 1000;
+}
+
+static int64_t uwsgi_lf_tmicros(struct wsgi_request *wsgi_req) {
+	return wsgi_req->start_of_request;
+}
+
+static int64_t uwsgi_lf_micros(struct wsgi_request *wsgi_req) {
+	return wsgi_req->end_of_request - wsgi_req->start_of_request;
+}
+
+static int64_t uwsgi_lf_msecs(struct wsgi_request *wsgi_req) {
+	return (wsgi_req->end_of_request - wsgi_req->start_of_request) / 1000;
+}
+
+static int64_t uwsgi_lf_pid(struct wsgi_request *wsgi_req) {
+	return uwsgi.mypid;
+}
+
+static int64_t uwsgi_lf_wid(struct wsgi_request *wsgi_req) {
+	return uwsgi.mywid;
+}
+
+static int64_t uwsgi_lf_switches(struct wsgi_request *wsgi_req) {
+	return wsgi_req->switches;
+}
+
+static int64_t uwsgi_lf_vars(struct wsgi_request *wsgi_req) {
+	return wsgi_req->var_cnt;
+}
+
+static int64_t uwsgi_lf_core(struct wsgi_request *wsgi_req) {
+	return wsgi_req->async_id;
+}
+
+static int64_t uwsgi_lf_vsz(struct wsgi_request *wsgi_req) {
+	return uwsgi.workers[uwsgi.mywid].vsz_size;
+}
+
+static int64_t uwsgi_lf_rss(struct wsgi_request *wsgi_req) {
+	return uwsgi.workers[uwsgi.mywid].rss_size;
+}
+
+static int64_t uwsgi_lf_vszM(struct wsgi_request *wsgi_req) {
+	return uwsgi.workers[uwsgi.mywid].vsz_size / 1024 / 1024;
+}
+
+static int64_t uwsgi_lf_rssM(struct wsgi_request *wsgi_req) {
+	return uwsgi.workers[uwsgi.mywid].rss_size / 1024 / 1024;
+}
+
+static int64_t uwsgi_lf_pktsize(struct wsgi_request *wsgi_req) {
+	return wsgi_req->len;
+}
+
+static int64_t uwsgi_lf_modifier1(struct wsgi_request *wsgi_req) {
+	return wsgi_req->uh->modifier1;
+}
+
+static int64_t uwsgi_lf_modifier2(struct wsgi_request *wsgi_req) {
+	return wsgi_req->uh->modifier2;
+}
+
+static int64_t uwsgi_lf_headers(struct wsgi_request *wsgi_req) {
+	return wsgi_req->header_cnt;
+}
+
+static int64_t uwsgi_lf_werr(struct wsgi_request *wsgi_req) {
+	return (int) wsgi_req->write_errors;
+}
+
+static int64_t uwsgi_lf_rerr(struct wsgi_request *wsgi_req) {
+	return (int) wsgi_req->read_errors;
+}
+
+static int64_t uwsgi_lf_ioerr(struct wsgi_request *wsgi_req) {
+	return (int) (wsgi_req->write_errors + wsgi_req->read_errors);
+}
+
+struct uwsgi_logchunk *uwsgi_register_logchunk(char *name, ssize_t (*func)(struct wsgi_request *, char **), int need_free) {
+	struct uwsgi_logchunk *old_logchunk = NULL, *logchunk = uwsgi.registered_logchunks;
+	while(logchunk) {
+		if (!strcmp(logchunk->name, name)) goto found;
+		old_logchunk = logchunk;
+		logchunk = logchunk->next;
+	}
+	logchunk = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
+	logchunk->name = name;
+	if (old_logchunk) {
+		old_logchunk->next = logchunk;
+	}
+	else {
+		uwsgi.registered_logchunks = logchunk;
+	}
+found:
+	logchunk->func = func;
+	logchunk->free = need_free;
+	logchunk->type = 3;
+	return logchunk;
+}
+
+// numeric chunks are directly rendered by the compiled formatter
+struct uwsgi_logchunk *uwsgi_register_logchunk_num(char *name, int64_t (*num)(struct wsgi_request *)) {
+	struct uwsgi_logchunk *logchunk = uwsgi_register_logchunk(name, NULL, 0);
+	logchunk->num = num;
+	logchunk->type = 6;
+	return logchunk;
+}
+
+struct uwsgi_logchunk *uwsgi_get_logchunk_by_name(char *name, size_t name_len) {
+	struct uwsgi_logchunk *logchunk = uwsgi.registered_logchunks;
+	while(logchunk) {
+		if (!uwsgi_strncmp(name, name_len, logchunk->name, strlen(logchunk->name))) {
+			return logchunk;
+		}
+		logchunk = logchunk->next;
+	}
+	return NULL;
+}
+
+void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
+
+	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
+
+	if (logchunk) {
+		while (logchunk) {
+			if (!logchunk->next) {
+				logchunk->next = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
+				logchunk = logchunk->next;
+				break;
+			}
+			logchunk = logchunk->next;
+		}
+	}
+	else {
+		uwsgi.logchunks = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
+		logchunk = uwsgi.logchunks;
+	}
+
+	/*
+	   0 -> raw text
+	   1 -> offsetof variable
+	   2 -> logvar
+	   3 -> func
+	   4 -> metric
+	   5 -> request variable
+	   6 -> numeric func
+	 */
+
+	logchunk->type = variable;
+	logchunk->vec = pos;
+	// normal text
+	logchunk->ptr = ptr;
+	logchunk->len = len;
+	// variable
+	if (variable) {
+		struct uwsgi_logchunk *rlc = uwsgi_get_logchunk_by_name(ptr, len);
+		if (rlc) {
+			if (rlc->type == 1) {
+				logchunk->pos = rlc->pos;
+				logchunk->pos_len = rlc->pos_len;
+			}
+			else if (rlc->type == 3) {
+				logchunk->type = 3;
+				logchunk->func = rlc->func;
+				logchunk->free = rlc->free;
+			}
+			else if (rlc->type == 6) {
+				logchunk->type = 6;
+				logchunk->num = rlc->num;
+			}
+		}
+		// var
+		else if (!uwsgi_starts_with(ptr, len, "var.", 4)) {
+			logchunk->type = 5;
+			logchunk->ptr = ptr+4;
+			logchunk->len = len-4;
+			logchunk->free = 0;
+		}
+		// metric
+		else if (!uwsgi_starts_with(ptr, len, "metric.", 7)) {
+			logchunk->type = 4;
+			logchunk->ptr = uwsgi_concat2n(ptr+7, len - 7, "", 0);
+			logchunk->free = 0;
+		}
+		// logvar
+		else {
+			logchunk->type = 2;
+		}
+	}
+}
+
+#define r_logchunk(x) uwsgi_register_logchunk(#x, uwsgi_lf_ ## x, 0)
+#define r_logchunk_num(x) uwsgi_register_logchunk_num(#x, uwsgi_lf_ ## x)
+#define r_logchunk_offset(x, y) { struct uwsgi_logchunk *lc = uwsgi_register_logchunk(#x, NULL, 0); lc->pos = offsetof(struct wsgi_request, y); lc->pos_len = offsetof(struct wsgi_request, y ## _len); lc->type = 1; lc->free=0;}
+void uwsgi_register_logchunks() {
+	// offsets
+	r_logchunk_offset(uri, uri);
+	r_logchunk_offset(method, method);
+	r_logchunk_offset(user, remote_user);
+	r_logchunk_offset(addr, remote_addr);
+	r_logchunk_offset(host, host);
+	r_logchunk_offset(proto, protocol);
+	r_logchunk_offset(uagent, user_agent);
+	r_logchunk_offset(referer, referer);
+
+	// funcs
+	r_logchunk_num(status);
+	r_logchunk_num(rsize);
+	r_logchunk_num(hsize);
+	r_logchunk_num(size);
+	r_logchunk_num(cl);
+	r_logchunk_num(micros);
+	r_logchunk_num(msecs);
+	r_logchunk_num(tmsecs);
+	r_logchunk_num(tmicros);
+	r_logchunk_num(time);
+	r_logchunk(ltime);
+	r_logchunk(ftime);
+	r_logchunk(ctime);
+	r_logchunk_num(epoch);
+	r_logchunk_num(pid);
+	r_logchunk_num(wid);
+	r_logchunk_num(switches);
+	r_logchunk_num(vars);
+	r_logchunk_num(core);
+	r_logchunk_num(vsz);
+	r_logchunk_num(rss);
+	r_logchunk_num(vszM);
+	r_logchunk_num(rssM);
+	r_logchunk_num(pktsize);
+	r_logchunk_num(modifier1);
+	r_logchunk_num(modifier2);
+	r_logchunk_num(headers);
+	r_logchunk_num(werr);
+	r_logchunk_num(rerr);
+	r_logchunk_num(ioerr);
+}
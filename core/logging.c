@@ -234,6 +234,9 @@ void create_logpipe(void) {
 		uwsgi_socket_nb(uwsgi.shared->worker_req_log_pipe[0]);
 		uwsgi_socket_nb(uwsgi.shared->worker_req_log_pipe[1]);
 		uwsgi.req_log_fd = uwsgi.shared->worker_req_log_pipe[1];
+		if (uwsgi.req_log_ring_size) {
+			uwsgi_req_log_rings_init();
+		}
 	}
 
 }
@@ -454,11 +457,12 @@ void uwsgi_logvar_add(struct wsgi_request *wsgi_req, char *key, uint8_t keylen,
 
 	// add a new log object
 
+	// released at the end of the request
 	lv = wsgi_req->logvars;
 	if (lv) {
 		while (lv) {
 			if (!lv->next) {
-				lv->next = uwsgi_malloc(sizeof(struct uwsgi_logvar));
+				lv->next = uwsgi_req_alloc(wsgi_req, sizeof(struct uwsgi_logvar));
 				lv = lv->next;
 				break;
 			}
@@ -466,7 +470,7 @@ void uwsgi_logvar_add(struct wsgi_request *wsgi_req, char *key, uint8_t keylen,
 		}
 	}
 	else {
-		lv = uwsgi_malloc(sizeof(struct uwsgi_logvar));
+		lv = uwsgi_req_alloc(wsgi_req, sizeof(struct uwsgi_logvar));
 		wsgi_req->logvars = lv;
 	}
 
@@ -588,6 +592,16 @@ void uwsgi_log_reopen() {
 }
 
 
+// send a request log line to the master (or directly to the req logger)
+void uwsgi_req_log_write(struct iovec *iov, int iovcnt) {
+	if (uwsgi.req_log_rings) {
+		uwsgi_req_log_ring_push(iov, iovcnt);
+		return;
+	}
+	// do not check for errors
+	writev(uwsgi.req_log_fd, iov, iovcnt);
+}
+
 void log_request(struct wsgi_request *wsgi_req) {
 
 	int log_it = uwsgi.logging_options.enabled;
@@ -728,8 +742,7 @@ void uwsgi_logit_simple(struct wsgi_request *wsgi_req) {
 	logvec[logvecpos].iov_base = logpkt;
 	logvec[logvecpos].iov_len = rlen;
 
-	// do not check for errors
-	rlen = writev(uwsgi.req_log_fd, logvec, logvecpos + 1);
+	uwsgi_req_log_write(logvec, logvecpos + 1);
 }
 
 void get_memusage(uint64_t * rss, uint64_t * vsz) {
@@ -876,13 +889,27 @@ void uwsgi_register_logger(char *name, ssize_t(*func) (struct uwsgi_logger *, ch
 	ul->fd = -1;
 	ul->data = NULL;
 	ul->buf = NULL;
-
+	ul->flags = 0;
+	ul->batch_func = NULL;
+	ul->batch_buf = NULL;
+	ul->batch_pos = 0;
+	ul->batch_iov = NULL;
+	ul->batch_count = 0;
+	ul->batch_since = 0;
 
 #ifdef UWSGI_DEBUG
 	uwsgi_log("[uwsgi-logger] registered \"%s\"\n", ul->name);
 #endif
 }
 
+// register a logger able to send multiple lines at once (see --log-batch)
+void uwsgi_register_batch_logger(char *name, ssize_t(*func) (struct uwsgi_logger *, char *, size_t), ssize_t(*batch_func) (struct uwsgi_logger *, struct iovec *, size_t)) {
+	uwsgi_register_logger(name, func);
+	struct uwsgi_logger *ul = uwsgi_get_logger(name);
+	ul->flags |= UWSGI_LOGGER_BATCH;
+	ul->batch_func = batch_func;
+}
+
 void uwsgi_append_logger(struct uwsgi_logger *ul) {
 
 	if (!uwsgi.choosen_logger) {
@@ -944,407 +971,133 @@ struct uwsgi_logger *uwsgi_get_logger_from_id(char *id) {
 	return NULL;
 }
 
+/*
+	log batching (--log-batch)
 
-void uwsgi_logit_lf(struct wsgi_request *wsgi_req) {
-	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
-	ssize_t rlen = 0;
-	const char *empty_var = "-";
-	while (logchunk) {
-		int pos = logchunk->vec;
-		// raw string
-		if (logchunk->type == 0) {
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = logchunk->ptr;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = logchunk->len;
-		}
-		// offsetof
-		else if (logchunk->type == 1) {
-			char **var = (char **) (((char *) wsgi_req) + logchunk->pos);
-			uint16_t *varlen = (uint16_t *) (((char *) wsgi_req) + logchunk->pos_len);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = *var;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = *varlen;
-		}
-		// logvar
-		else if (logchunk->type == 2) {
-			struct uwsgi_logvar *lv = uwsgi_logvar_get(wsgi_req, logchunk->ptr, logchunk->len);
-			if (lv) {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = lv->val;
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = lv->vallen;
-			}
-			else {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = NULL;
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
-			}
-		}
-		// func
-		else if (logchunk->type == 3) {
-			rlen = logchunk->func(wsgi_req, (char **) &uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
-			if (rlen > 0) {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = rlen;
-			}
-			else {
-				uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 0;
-			}
-		}
-		// var
-		else if (logchunk->type == 5) {
-			uint16_t value_len = 0;
-			char *value = uwsgi_get_var(wsgi_req, logchunk->ptr, logchunk->len, &value_len);
-			// could be NULL
-                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = value;
-                        uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = (size_t) value_len;
-                }
-		// metric
-		else if (logchunk->type == 4) {
-			int64_t metric = uwsgi_metric_get(logchunk->ptr, NULL);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = uwsgi_64bit2str(metric);
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = strlen(uwsgi.logvectors[wsgi_req->async_id][pos].iov_base);
-		}
-
-		if (uwsgi.logvectors[wsgi_req->async_id][pos].iov_len == 0 && logchunk->type != 0) {
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_base = (char *) empty_var;
-			uwsgi.logvectors[wsgi_req->async_id][pos].iov_len = 1;	
-		}
-		logchunk = logchunk->next;
-	}
-
-	// do not check for errors
-	rlen = writev(uwsgi.req_log_fd, uwsgi.logvectors[wsgi_req->async_id], uwsgi.logformat_vectors);
-
-	// free allocated memory
-	logchunk = uwsgi.logchunks;
-	while (logchunk) {
-		if (logchunk->free) {
-			if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_len > 0) {
-				if (uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base != empty_var) {
-					free(uwsgi.logvectors[wsgi_req->async_id][logchunk->vec].iov_base);
-				}
-			}
-		}
-		logchunk = logchunk->next;
-	}
+	loggers registered with uwsgi_register_batch_logger() receive lines in batches:
+	each configured logger buffers up to --log-batch lines (and --log-batch-size bytes),
+	the batch is sent when full or after --log-batch-flush milliseconds.
+*/
+void uwsgi_logger_batch_flush(struct uwsgi_logger *ul) {
+	if (!ul->batch_count) return;
+	ul->batch_func(ul, ul->batch_iov, ul->batch_count);
+	ul->batch_count = 0;
+	ul->batch_pos = 0;
 }
 
-void uwsgi_build_log_format(char *format) {
-	int state = 0;
-	char *ptr = format;
-	char *current = ptr;
-	char *logvar = NULL;
-	// get the number of required iovec
-	while (*ptr) {
-		if (*ptr == '%') {
-			if (state == 0) {
-				state = 1;
-			}
-		}
-		// start of the variable
-		else if (*ptr == '(') {
-			if (state == 1) {
-				state = 2;
-			}
-		}
-		// end of the variable
-		else if (*ptr == ')') {
-			if (logvar) {
-				uwsgi_add_logchunk(1, uwsgi.logformat_vectors, logvar, ptr - logvar);
-				uwsgi.logformat_vectors++;
-				state = 0;
-				logvar = NULL;
-				current = ptr + 1;
-			}
-		}
-		else {
-			if (state == 2) {
-				uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, (ptr - current) - 2);
-				uwsgi.logformat_vectors++;
-				logvar = ptr;
-			}
-			state = 0;
-		}
-		ptr++;
+static void uwsgi_logger_batch_add(struct uwsgi_logger *ul, char *msg, size_t len) {
+	if (!ul->batch_buf) {
+		ul->batch_buf = uwsgi_malloc(uwsgi.log_batch_size);
+		ul->batch_iov = uwsgi_malloc(sizeof(struct iovec) * uwsgi.log_batch);
 	}
 
-	if (ptr - current > 0) {
-		uwsgi_add_logchunk(0, uwsgi.logformat_vectors, current, ptr - current);
-		uwsgi.logformat_vectors++;
+	// too big, send it directly (after the already buffered lines)
+	if (len > uwsgi.log_batch_size) {
+		uwsgi_logger_batch_flush(ul);
+		ul->func(ul, msg, len);
+		return;
 	}
 
-	// +1 for "\n"
-
-	uwsgi.logformat_vectors++;
-
-}
-
-static ssize_t uwsgi_lf_status(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->status);
-	return strlen(*buf);
-}
-
-
-static ssize_t uwsgi_lf_rsize(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->response_size);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_hsize(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->headers_size);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_size(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->headers_size+wsgi_req->response_size);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_cl(struct wsgi_request *wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->post_cl);
-	return strlen(*buf);
-}
-
-
-static ssize_t uwsgi_lf_epoch(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi_now());
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_ctime(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_malloc(26);
-#if defined(__sun__) && !defined(__clang__)
-	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf, 26);
-#else
-	ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, *buf);
-#endif
-	return 24;
-}
-
-static ssize_t uwsgi_lf_time(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->start_of_request / 1000000);
-	return strlen(*buf);
-}
-
-
-static ssize_t uwsgi_lf_ltime(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_malloc(64);
-	time_t now = wsgi_req->start_of_request / 1000000;
-	size_t ret = strftime(*buf, 64, "%d/%b/%Y:%H:%M:%S %z", localtime(&now));
-	if (ret == 0) {
-		*buf[0] = 0;
-		return 0;
+	if (ul->batch_pos + len > uwsgi.log_batch_size) {
+		uwsgi_logger_batch_flush(ul);
 	}
-	return ret;
-}
 
-static ssize_t uwsgi_lf_ftime(struct wsgi_request * wsgi_req, char **buf) {
-	if (!uwsgi.logformat_strftime || !uwsgi.log_strftime) {
-		return uwsgi_lf_ltime(wsgi_req, buf);
-	}
-	*buf = uwsgi_malloc(64);
-	time_t now = wsgi_req->start_of_request / 1000000;
-	size_t ret = strftime(*buf, 64, uwsgi.log_strftime, localtime(&now));
-	if (ret == 0) {
-		*buf[0] = 0;
-		return 0;
+	if (!ul->batch_count) {
+		ul->batch_since = uwsgi_micros();
 	}
-	return ret;
-}
-
-static ssize_t uwsgi_lf_tmsecs(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_64bit2str(wsgi_req->start_of_request / (int64_t) 1000);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_tmicros(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_64bit2str(wsgi_req->start_of_request);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_micros(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->end_of_request - wsgi_req->start_of_request);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_msecs(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((wsgi_req->end_of_request - wsgi_req->start_of_request) / 1000);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_pid(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.mypid);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_wid(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.mywid);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_switches(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->switches);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_vars(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->var_cnt);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_core(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->async_id);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_vsz(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].vsz_size);
-	return strlen(*buf);
-}
 
-static ssize_t uwsgi_lf_rss(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].rss_size);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_vszM(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].vsz_size / 1024 / 1024);
-	return strlen(*buf);
-}
+	memcpy(ul->batch_buf + ul->batch_pos, msg, len);
+	ul->batch_iov[ul->batch_count].iov_base = ul->batch_buf + ul->batch_pos;
+	ul->batch_iov[ul->batch_count].iov_len = len;
+	ul->batch_pos += len;
+	ul->batch_count++;
 
-static ssize_t uwsgi_lf_rssM(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(uwsgi.workers[uwsgi.mywid].rss_size / 1024 / 1024);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_pktsize(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->len);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_modifier1(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->uh->modifier1);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_modifier2(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->uh->modifier2);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_headers(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str(wsgi_req->header_cnt);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_werr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) wsgi_req->write_errors);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_rerr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) wsgi_req->read_errors);
-	return strlen(*buf);
-}
-
-static ssize_t uwsgi_lf_ioerr(struct wsgi_request * wsgi_req, char **buf) {
-	*buf = uwsgi_num2str((int) (wsgi_req->write_errors + wsgi_req->read_errors));
-	return strlen(*buf);
-}
-
-struct uwsgi_logchunk *uwsgi_register_logchunk(char *name, ssize_t (*func)(struct wsgi_request *, char **), int need_free) {
-	struct uwsgi_logchunk *old_logchunk = NULL, *logchunk = uwsgi.registered_logchunks;
-	while(logchunk) {
-		if (!strcmp(logchunk->name, name)) goto found;
-		old_logchunk = logchunk;
-		logchunk = logchunk->next;
-	}
-	logchunk = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
-	logchunk->name = name;
-	if (old_logchunk) {
-		old_logchunk->next = logchunk;
-	}
-	else {
-		uwsgi.registered_logchunks = logchunk;
+	if (ul->batch_count >= (size_t) uwsgi.log_batch) {
+		uwsgi_logger_batch_flush(ul);
 	}
-found:
-	logchunk->func = func;
-	logchunk->free = need_free;
-	logchunk->type = 3;
-	return logchunk;	
 }
 
-struct uwsgi_logchunk *uwsgi_get_logchunk_by_name(char *name, size_t name_len) {
-	struct uwsgi_logchunk *logchunk = uwsgi.registered_logchunks;
-	while(logchunk) {
-		if (!uwsgi_strncmp(name, name_len, logchunk->name, strlen(logchunk->name))) {
-			return logchunk;
+static int uwsgi_loggers_batch_flush(struct uwsgi_logger *ul, uint64_t now, int force, int next) {
+	uint64_t interval = uwsgi.log_batch_flush * 1000;
+	while (ul) {
+		if (ul->batch_count) {
+			uint64_t elapsed = now - ul->batch_since;
+			if (force || elapsed >= interval) {
+				uwsgi_logger_batch_flush(ul);
+			}
+			else {
+				int ms = (interval - elapsed + 999) / 1000;
+				if (next < 0 || ms < next) next = ms;
+			}
 		}
-		logchunk = logchunk->next;
+		ul = ul->next;
 	}
-	return NULL;
+	return next;
 }
 
-void uwsgi_add_logchunk(int variable, int pos, char *ptr, size_t len) {
+/*
+	flush the expired batches (all of them if force is set),
+	returns the milliseconds before the next expiration (-1 if nothing is buffered)
+*/
+int uwsgi_log_batches_flush(int force) {
+	if (uwsgi.log_batch <= 0) return -1;
+	uint64_t now = uwsgi_micros();
+	int next = uwsgi_loggers_batch_flush(uwsgi.choosen_logger, now, force, -1);
+	return uwsgi_loggers_batch_flush(uwsgi.choosen_req_logger, now, force, next);
+}
 
-	struct uwsgi_logchunk *logchunk = uwsgi.logchunks;
+/*
+	send a batch of datagrams (using sendmmsg() when available) to the logger address,
+	every message is composed by iovcnt/msgs consecutive iovecs.
 
-	if (logchunk) {
-		while (logchunk) {
-			if (!logchunk->next) {
-				logchunk->next = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
-				logchunk = logchunk->next;
-				break;
-			}
-			logchunk = logchunk->next;
-		}
-	}
-	else {
-		uwsgi.logchunks = uwsgi_calloc(sizeof(struct uwsgi_logchunk));
-		logchunk = uwsgi.logchunks;
-	}
-
-	/*
-	   0 -> raw text
-	   1 -> offsetof variable
-	   2 -> logvar
-	   3 -> func
-	   4 -> metric
-	   5 -> request variable
-	 */
-
-	logchunk->type = variable;
-	logchunk->vec = pos;
-	// normal text
-	logchunk->ptr = ptr;
-	logchunk->len = len;
-	// variable
-	if (variable) {
-		struct uwsgi_logchunk *rlc = uwsgi_get_logchunk_by_name(ptr, len);
-		if (rlc) {
-			if (rlc->type == 1) {
-				logchunk->pos = rlc->pos;
-				logchunk->pos_len = rlc->pos_len;
-			}
-			else if (rlc->type == 3) {
-				logchunk->type = 3;
-				logchunk->func = rlc->func;
-				logchunk->free = rlc->free;
-			}
-		}
-		// var
-		else if (!uwsgi_starts_with(ptr, len, "var.", 4)) {
-			logchunk->type = 5;
-			logchunk->ptr = ptr+4;
-			logchunk->len = len-4;
-			logchunk->free = 0;
-		}
-		// metric
-		else if (!uwsgi_starts_with(ptr, len, "metric.", 7)) {
-			logchunk->type = 4;
-			logchunk->ptr = uwsgi_concat2n(ptr+7, len - 7, "", 0);
-			logchunk->free = 1;
-		}
-		// logvar
-		else {
-			logchunk->type = 2;
-		}
-	}
+	The socket is never blocked for more than --socket-timeout seconds (a full unix socket
+	could stall the log thread forever otherwise)
+*/
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+int uwsgi_logger_send_datagrams(struct uwsgi_logger *ul, struct iovec *iov, size_t iovcnt, size_t msgs) {
+	size_t i;
+	size_t iov_per_msg = iovcnt / msgs;
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+	struct mmsghdr mmsg[64];
+	size_t sent = 0;
+	while (sent < msgs) {
+		size_t n = UMIN(msgs - sent, 64);
+		memset(mmsg, 0, sizeof(struct mmsghdr) * n);
+		for (i = 0; i < n; i++) {
+			mmsg[i].msg_hdr.msg_name = &ul->addr;
+			mmsg[i].msg_hdr.msg_namelen = ul->addr_len;
+			mmsg[i].msg_hdr.msg_iov = iov + ((sent + i) * iov_per_msg);
+			mmsg[i].msg_hdr.msg_iovlen = iov_per_msg;
+		}
+		int ret = sendmmsg(ul->fd, mmsg, n, MSG_DONTWAIT);
+		if (ret < 0 && uwsgi_is_again()) {
+			if (uwsgi_waitfd_write(ul->fd, uwsgi.socket_timeout) <= 0) return -1;
+			continue;
+		}
+		if (ret <= 0) return -1;
+		sent += ret;
+	}
+	return sent;
+#else
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_name = &ul->addr;
+	msg.msg_namelen = ul->addr_len;
+	msg.msg_iovlen = iov_per_msg;
+	i = 0;
+	while (i < msgs) {
+		msg.msg_iov = iov + (i * iov_per_msg);
+		if (sendmsg(ul->fd, &msg, MSG_DONTWAIT) < 0) {
+			if (!uwsgi_is_again()) return -1;
+			if (uwsgi_waitfd_write(ul->fd, uwsgi.socket_timeout) <= 0) return -1;
+			continue;
+		}
+		i++;
+	}
+	return msgs;
+#endif
 }
 
 static void uwsgi_log_func_do(struct uwsgi_string_list *encoders, struct uwsgi_logger *ul, char *msg, size_t len) {
@@ -1375,7 +1128,12 @@ next:
 		usl = usl->next;
 	}
 	if (ul) {
-		ul->func(ul, new_msg, new_msg_len);
+		if (uwsgi.log_batch > 0 && (ul->flags & UWSGI_LOGGER_BATCH)) {
+			uwsgi_logger_batch_add(ul, new_msg, new_msg_len);
+		}
+		else {
+			ul->func(ul, new_msg, new_msg_len);
+		}
 	}
 	else {
 		new_msg_len = (size_t) write(uwsgi.original_log_fd, new_msg, new_msg_len);
@@ -1452,50 +1210,67 @@ next:
         return -1;
 }
 
-int uwsgi_master_req_log(void) {
-
-        ssize_t rlen = read(uwsgi.shared->worker_req_log_pipe[0], uwsgi.log_master_buf, uwsgi.log_master_bufsize);
-        if (rlen > 0) {
+static void uwsgi_master_req_log_line(char *buf, size_t rlen) {
 #ifdef UWSGI_PCRE
-                struct uwsgi_regexp_list *url = uwsgi.log_req_route;
-                int finish = 0;
-                while (url) {
-                        if (uwsgi_regexp_match(url->pattern, url->pattern_extra, uwsgi.log_master_buf, rlen) >= 0) {
-                                struct uwsgi_logger *ul_route = (struct uwsgi_logger *) url->custom_ptr;
-                                if (ul_route) {
-                                        uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul_route, uwsgi.log_master_buf, rlen);
-                                        finish = 1;
-                                }
+        struct uwsgi_regexp_list *url = uwsgi.log_req_route;
+        int finish = 0;
+        while (url) {
+                if (uwsgi_regexp_match(url->pattern, url->pattern_extra, buf, rlen) >= 0) {
+                        struct uwsgi_logger *ul_route = (struct uwsgi_logger *) url->custom_ptr;
+                        if (ul_route) {
+                                uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul_route, buf, rlen);
+                                finish = 1;
                         }
-                        url = url->next;
                 }
-                if (finish)
-                        return 0;
+                url = url->next;
+        }
+        if (finish)
+                return;
 #endif
 
-                int raw_log = 1;
+        int raw_log = 1;
 
-                struct uwsgi_logger *ul = uwsgi.choosen_req_logger;
-                while (ul) {
-                        // check for named logger
-                        if (ul->id) {
-                                goto next;
-                        }
-                        uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul, uwsgi.log_master_buf, rlen);
-                        raw_log = 0;
-next:
-                        ul = ul->next;
+        struct uwsgi_logger *ul = uwsgi.choosen_req_logger;
+        while (ul) {
+                // check for named logger
+                if (ul->id) {
+                        goto next;
                 }
+                uwsgi_log_func_do(uwsgi.requested_log_req_encoders, ul, buf, rlen);
+                raw_log = 0;
+next:
+                ul = ul->next;
+        }
 
-                if (raw_log) {
-			uwsgi_log_func_do(uwsgi.requested_log_req_encoders, NULL, uwsgi.log_master_buf, rlen);
-                }
-                return 0;
+        if (raw_log) {
+		uwsgi_log_func_do(uwsgi.requested_log_req_encoders, NULL, buf, rlen);
+        }
+}
+
+int uwsgi_master_req_log(void) {
+
+        ssize_t rlen = read(uwsgi.shared->worker_req_log_pipe[0], uwsgi.log_master_buf, uwsgi.log_master_bufsize);
+        if (rlen > 0) {
+		// the logpipe is only a doorbell for the rings, consume all of the pending lines
+		if (uwsgi.req_log_rings) {
+			while (read(uwsgi.shared->worker_req_log_pipe[0], uwsgi.log_master_buf, uwsgi.log_master_bufsize) > 0);
+			uwsgi_req_log_rings_consume(uwsgi_master_req_log_line);
+			return 0;
+		}
+		uwsgi_master_req_log_line(uwsgi.log_master_buf, rlen);
+		return 0;
         }
 
         return -1;
 }
 
+// called by the master before respawning a worker
+void uwsgi_master_req_log_ring_recover(int wid) {
+	if (uwsgi.threaded_logger) pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+	uwsgi_req_log_ring_recover(wid, uwsgi_master_req_log_line);
+	if (uwsgi.threaded_logger) pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
+}
+
 static void *logger_thread_loop(void *noarg) {
         struct pollfd logpoll[2];
 
@@ -1512,24 +1287,32 @@ static void *logger_thread_loop(void *noarg) {
         if (uwsgi.req_log_master) {
                 logpoll[1].events = POLLIN;
                 logpoll[1].fd = uwsgi.shared->worker_req_log_pipe[0];
+                logpolls = 2;
         }
 
 
+        int timeout = -1;
+
         for (;;) {
-                int ret = poll(logpoll, logpolls, -1);
+                int ret = poll(logpoll, logpolls, timeout);
                 if (ret > 0) {
                         if (logpoll[0].revents & POLLIN) {
                                 pthread_mutex_lock(&uwsgi.threaded_logger_lock);
                                 uwsgi_master_log();
                                 pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
                         }
-                        else if (logpolls > 1 && logpoll[1].revents & POLLIN) {
+                        if (logpolls > 1 && logpoll[1].revents & POLLIN) {
                                 pthread_mutex_lock(&uwsgi.threaded_logger_lock);
                                 uwsgi_master_req_log();
                                 pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
                         }
 
                 }
+                if (uwsgi.log_batch > 0) {
+                        pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+                        timeout = uwsgi_log_batches_flush(0);
+                        pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
+                }
         }
 
         return NULL;
@@ -1857,22 +1640,10 @@ static char *uwsgi_log_encoder_json(struct uwsgi_log_encoder *ule, char *msg, si
                         if (!uwsgi_strncmp(usl->value, usl->len, "msg", 3)) {
 				size_t msg_len = len;
                                 if (msg[len-1] == '\n') msg_len--;
-				char *e_json = uwsgi_malloc((msg_len * 2)+1);
-				escape_json(msg, msg_len, e_json);
-				if (uwsgi_buffer_append(ub, e_json, strlen(e_json))){
-                                	free(e_json);
-                                        goto end;
-                                }
-                                free(e_json);
+				if (uwsgi_buffer_append_json(ub, msg, msg_len)) goto end;
                         }
                         else if (!uwsgi_strncmp(usl->value, usl->len, "msgnl", 5)) {
-				char *e_json = uwsgi_malloc((len * 2)+1);
-                                escape_json(msg, len, e_json);
-                                if (uwsgi_buffer_append(ub, e_json, strlen(e_json))){
-                                        free(e_json);
-                                        goto end;
-                                }
-                                free(e_json);
+				if (uwsgi_buffer_append_json(ub, msg, len)) goto end;
                         }
                         else if (!uwsgi_strncmp(usl->value, usl->len, "unix", 4)) {
                                 if (uwsgi_buffer_num64(ub, uwsgi_now())) goto end;
@@ -1887,13 +1658,7 @@ static char *uwsgi_log_encoder_json(struct uwsgi_log_encoder *ule, char *msg, si
                                 int strftime_len = strftime(sftime, 64, buf, localtime(&now));
                                 free(buf);
                                 if (strftime_len > 0) {
-					char *e_json = uwsgi_malloc((strftime_len * 2)+1);
-					escape_json(sftime, strftime_len, e_json);
-                                        if (uwsgi_buffer_append(ub, e_json, strlen(e_json))){
-						free(e_json);
-						goto end;
-					}
-					free(e_json);
+					if (uwsgi_buffer_append_json(ub, sftime, strftime_len)) goto end;
                                 }
                         }
                 }
@@ -1910,52 +1675,6 @@ end:
         return buf;
 }
 
-#define r_logchunk(x) uwsgi_register_logchunk(#x, uwsgi_lf_ ## x, 1)
-#define r_logchunk_offset(x, y) { struct uwsgi_logchunk *lc = uwsgi_register_logchunk(#x, NULL, 0); lc->pos = offsetof(struct wsgi_request, y); lc->pos_len = offsetof(struct wsgi_request, y ## _len); lc->type = 1; lc->free=0;}
-void uwsgi_register_logchunks() {
-	// offsets
-	r_logchunk_offset(uri, uri);
-	r_logchunk_offset(method, method);
-	r_logchunk_offset(user, remote_user);
-	r_logchunk_offset(addr, remote_addr);
-	r_logchunk_offset(host, host);
-	r_logchunk_offset(proto, protocol);
-	r_logchunk_offset(uagent, user_agent);
-	r_logchunk_offset(referer, referer);
-
-	// funcs
-	r_logchunk(status);
-	r_logchunk(rsize);
-	r_logchunk(hsize);
-	r_logchunk(size);
-	r_logchunk(cl);
-	r_logchunk(micros);
-	r_logchunk(msecs);
-	r_logchunk(tmsecs);
-	r_logchunk(tmicros);
-	r_logchunk(time);
-	r_logchunk(ltime);
-	r_logchunk(ftime);
-	r_logchunk(ctime);
-	r_logchunk(epoch);
-	r_logchunk(pid);
-	r_logchunk(wid);
-	r_logchunk(switches);
-	r_logchunk(vars);
-	r_logchunk(core);
-	r_logchunk(vsz);
-	r_logchunk(rss);
-	r_logchunk(vszM);
-	r_logchunk(rssM);
-	r_logchunk(pktsize);
-	r_logchunk(modifier1);
-	r_logchunk(modifier2);
-	r_logchunk(headers);
-	r_logchunk(werr);
-	r_logchunk(rerr);
-	r_logchunk(ioerr);
-}
-
 void uwsgi_log_encoders_register_embedded() {
 	uwsgi_register_log_encoder("prefix", uwsgi_log_encoder_prefix);
 	uwsgi_register_log_encoder("suffix", uwsgi_log_encoder_suffix);
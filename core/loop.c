@@ -59,6 +59,10 @@ void *uwsgi_get_loop(char *name) {
 */
 
 void simple_loop() {
+	if (uwsgi.thread_acceptor && uwsgi.threads > 1) {
+		uwsgi_thread_acceptor_loop();
+		return;
+	}
 	uwsgi_loop_cores_run(simple_loop_run);
 }
 
@@ -164,3 +168,381 @@ void *simple_loop_run(void *arg1) {
 	}
 	return NULL;
 }
+
+/*
+
+	the threaded acceptor loop (--thread-acceptor)
+
+	a dedicated thread waits for new connections (and signals) and pushes them
+	into a bounded lock-free ring, the worker threads pop items from it.
+
+	This way a thread stuck in a slow request does not hold back
+	the connections it would have accepted, any idle thread can manage them.
+
+	Request parsing is still done by the thread popping the connection, as the parsers
+	work on per-core buffers.
+
+	The ring is a single producer/multiple consumers variant of the classic
+	bounded queue with per-slot sequence numbers. The mutex and the condition variables
+	are only used for sleeping when the ring is empty (or full).
+
+*/
+
+static struct uwsgi_request_ring *uwsgi_request_ring_new(uint64_t size) {
+	uint64_t i;
+	uint64_t ring_size = 1;
+	while (ring_size < size) {
+		ring_size <<= 1;
+	}
+
+	struct uwsgi_request_ring *ring = uwsgi_calloc(sizeof(struct uwsgi_request_ring));
+	ring->items = uwsgi_calloc(sizeof(struct uwsgi_request_ring_item) * ring_size);
+	ring->mask = ring_size - 1;
+	for (i = 0; i < ring_size; i++) {
+		ring->items[i].seq = i;
+	}
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->not_empty, NULL);
+	pthread_cond_init(&ring->not_full, NULL);
+	return ring;
+}
+
+static int uwsgi_request_ring_is_full(struct uwsgi_request_ring *ring) {
+	return uwsgi_atomic_load(ring->items[ring->tail & ring->mask].seq) != ring->tail;
+}
+
+static int uwsgi_request_ring_is_empty(struct uwsgi_request_ring *ring) {
+	return uwsgi_atomic_load(ring->head) == uwsgi_atomic_load(ring->tail);
+}
+
+// only the acceptor thread can push
+static int uwsgi_request_ring_push(struct uwsgi_request_ring *ring, struct uwsgi_request_ring_item *item) {
+	uint64_t pos = ring->tail;
+	struct uwsgi_request_ring_item *slot = &ring->items[pos & ring->mask];
+
+	if (uwsgi_atomic_load(slot->seq) != pos)
+		return -1;
+
+	slot->fd = item->fd;
+	slot->signal_fd = item->signal_fd;
+	slot->socket = item->socket;
+	slot->c_addr = item->c_addr;
+	slot->c_len = item->c_len;
+	slot->accepted_at = item->accepted_at;
+	uwsgi_atomic_store(slot->seq, pos + 1);
+	uwsgi_atomic_store(ring->tail, pos + 1);
+
+	// wake up a sleeping thread (if any)
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(ring->sleepers) > 0) {
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_signal(&ring->not_empty);
+		pthread_mutex_unlock(&ring->lock);
+	}
+	return 0;
+}
+
+static int uwsgi_request_ring_pop(struct uwsgi_request_ring *ring, struct uwsgi_request_ring_item *item) {
+	struct uwsgi_request_ring_item *slot;
+	uint64_t pos = uwsgi_atomic_load(ring->head);
+
+	for (;;) {
+		slot = &ring->items[pos & ring->mask];
+		int64_t diff = (int64_t) uwsgi_atomic_load(slot->seq) - (int64_t) (pos + 1);
+		if (diff == 0) {
+			// on failure pos is updated with the current head
+			if (uwsgi_atomic_cas(ring->head, &pos, pos + 1))
+				break;
+		}
+		else if (diff < 0) {
+			// empty
+			return -1;
+		}
+		else {
+			pos = uwsgi_atomic_load(ring->head);
+		}
+	}
+
+	*item = *slot;
+	uwsgi_atomic_store(slot->seq, pos + ring->mask + 1);
+
+	// the acceptor is waiting for room ?
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(ring->acceptor_waiting)) {
+		pthread_mutex_lock(&ring->lock);
+		pthread_cond_signal(&ring->not_full);
+		pthread_mutex_unlock(&ring->lock);
+	}
+	return 0;
+}
+
+static void uwsgi_request_ring_unlock(void *arg) {
+	struct uwsgi_request_ring *ring = (struct uwsgi_request_ring *) arg;
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void uwsgi_request_ring_wait(struct uwsgi_request_ring *ring, struct uwsgi_request_ring_item *item) {
+	for (;;) {
+		if (!uwsgi_request_ring_pop(ring, item))
+			return;
+		volatile int found = 0;
+		pthread_mutex_lock(&ring->lock);
+		pthread_cleanup_push(uwsgi_request_ring_unlock, ring);
+		uwsgi_atomic_add(ring->sleepers, 1);
+		// re-check after announcing ourselves
+		if (!uwsgi_request_ring_pop(ring, item)) {
+			found = 1;
+		}
+		else {
+			pthread_cond_wait(&ring->not_empty, &ring->lock);
+		}
+		uwsgi_atomic_sub(ring->sleepers, 1);
+		pthread_cleanup_pop(1);
+		if (found)
+			return;
+	}
+}
+
+static void uwsgi_request_ring_wait_for_room(struct uwsgi_request_ring *ring) {
+	pthread_mutex_lock(&ring->lock);
+	// the acceptor can be cancelled while waiting
+	pthread_cleanup_push(uwsgi_request_ring_unlock, ring);
+	uwsgi_atomic_store(ring->acceptor_waiting, 1);
+	uwsgi_atomic_fence();
+	while (uwsgi_request_ring_is_full(ring)) {
+		pthread_cond_wait(&ring->not_full, &ring->lock);
+	}
+	uwsgi_atomic_store(ring->acceptor_waiting, 0);
+	pthread_cleanup_pop(1);
+}
+
+static void *uwsgi_thread_acceptor(void *arg) {
+	struct uwsgi_request_ring *ring = uwsgi.request_ring;
+	struct uwsgi_worker *uw = &uwsgi.workers[uwsgi.mywid];
+	struct uwsgi_request_ring_item item;
+	// used only for calling the proto_accept hook
+	struct wsgi_request acceptor_req;
+	sigset_t smask;
+
+	sigfillset(&smask);
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	int queue = event_queue_init();
+	uwsgi_add_sockets_to_queue(queue, -1);
+
+	if (uwsgi.signal_socket > -1) {
+		event_queue_add_fd_read(queue, uwsgi.signal_socket);
+		event_queue_add_fd_read(queue, uwsgi.my_signal_socket);
+	}
+
+	while (uw->manage_next_request) {
+		int interesting_fd = -1;
+		int timeout = -1;
+
+		// backpressure: stop accepting until a thread frees a slot
+		if (uwsgi_request_ring_is_full(ring)) {
+			uwsgi_request_ring_wait_for_room(ring);
+		}
+
+		if (uwsgi.has_emperor && uwsgi.heartbeat) {
+			time_t now = uwsgi_now();
+			timeout = uwsgi.heartbeat;
+			if (!uwsgi.next_heartbeat) {
+				uwsgi.next_heartbeat = now;
+			}
+			if (uwsgi.next_heartbeat >= now) {
+				timeout = uwsgi.next_heartbeat - now;
+			}
+		}
+
+		int ret = event_queue_wait(queue, timeout, &interesting_fd);
+		if (ret < 0)
+			continue;
+
+		if (uwsgi.has_emperor && uwsgi.heartbeat) {
+			uwsgi_heartbeat();
+		}
+
+		// the worker is going away, leave the new connections to the other ones
+		if (ret == 0 || !uw->manage_next_request)
+			continue;
+
+		memset(&item, 0, sizeof(struct uwsgi_request_ring_item));
+		item.accepted_at = uwsgi_micros();
+
+		if (uwsgi.signal_socket > -1 && (interesting_fd == uwsgi.signal_socket || interesting_fd == uwsgi.my_signal_socket)) {
+			if (uwsgi_read_signal(interesting_fd, "worker", uwsgi.mywid))
+				continue;
+			item.fd = -1;
+			item.signal_fd = interesting_fd;
+			uw->ring_depth[uwsgi_log2_bucket(ring->tail - uwsgi_atomic_load(ring->head))]++;
+			// cannot fail, we are the only producer and we checked for room
+			uwsgi_request_ring_push(ring, &item);
+			continue;
+		}
+
+		struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+		while (uwsgi_sock) {
+			if (interesting_fd == uwsgi_sock->fd)
+				break;
+			uwsgi_sock = uwsgi_sock->next;
+		}
+		if (!uwsgi_sock)
+			continue;
+
+		// drain up to --accept-batch pending connections (while the ring has room)
+		int accepted;
+		for (accepted = 0; accepted < uwsgi.accept_batch; accepted++) {
+			if (uwsgi_request_ring_is_full(ring) || !uw->manage_next_request)
+				break;
+			memset(&acceptor_req, 0, sizeof(struct wsgi_request));
+			acceptor_req.socket = uwsgi_sock;
+			item.fd = uwsgi_sock->proto_accept(&acceptor_req, interesting_fd);
+			if (item.fd < 0)
+				break;
+			item.socket = uwsgi_sock;
+			item.c_addr = acceptor_req.c_addr;
+			item.c_len = acceptor_req.c_len;
+
+			uw->ring_depth[uwsgi_log2_bucket(ring->tail - uwsgi_atomic_load(ring->head))]++;
+			// cannot fail, we are the only producer and we checked for room
+			uwsgi_request_ring_push(ring, &item);
+		}
+	}
+
+	return NULL;
+}
+
+static void *uwsgi_thread_acceptor_run(void *arg1) {
+
+	long core_id = (long) arg1;
+	int ret;
+	struct uwsgi_request_ring_item item;
+	struct uwsgi_worker *uw = &uwsgi.workers[uwsgi.mywid];
+
+	struct wsgi_request *wsgi_req = &uw->cores[core_id].req;
+
+	uwsgi_setup_thread_req(core_id, wsgi_req);
+
+	// the connections already accepted are served even when the worker is going away
+	while (uw->manage_next_request || !uwsgi_request_ring_is_empty(uwsgi.request_ring)) {
+
+		wsgi_req_setup(wsgi_req, core_id, NULL);
+
+		uwsgi_request_ring_wait(uwsgi.request_ring, &item);
+
+		// kill the thread after the request completion
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ret);
+
+		uwsgi_atomic_add(uw->ring_wait[uwsgi_log2_bucket(uwsgi_micros() - item.accepted_at)], 1);
+
+		if (item.fd < 0) {
+			uwsgi_signal_dispatch(wsgi_req, item.signal_fd, "worker", uwsgi.mywid, -1);
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ret);
+			continue;
+		}
+
+		wsgi_req->socket = item.socket;
+		wsgi_req->fd = item.fd;
+		wsgi_req->c_addr = item.c_addr;
+		wsgi_req->c_len = item.c_len;
+		uwsgi_post_accept(wsgi_req);
+		// the connection has been accepted by the acceptor thread
+		if (uwsgi.histograms || uwsgi.trace_spans) {
+			wsgi_req->accepted_at = item.accepted_at;
+		}
+
+		if (wsgi_req_recv(-1, wsgi_req)) {
+			uwsgi_destroy_request(wsgi_req);
+			continue;
+		}
+
+		uwsgi_close_request(wsgi_req);
+	}
+
+	// end of the loop
+	if (uw->destroy && uwsgi.workers[0].pid > 0) {
+#ifdef __APPLE__
+		kill(uwsgi.workers[0].pid, SIGTERM);
+#else
+		if (uwsgi.propagate_touch) {
+			kill(uwsgi.workers[0].pid, SIGHUP);
+		}
+		else {
+			gracefully_kill(0);
+		}
+#endif
+	}
+	return NULL;
+}
+
+void uwsgi_thread_acceptor_loop() {
+	// only sockets using the plain accept() hook can be passed between threads
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while (uwsgi_sock) {
+		if (uwsgi_sock->proto_accept != uwsgi_proto_base_accept || uwsgi_sock->edge_trigger || uwsgi_sock->fd_threads) {
+			uwsgi_log("the thread acceptor does not support the socket %s (%s)\n", uwsgi_sock->name, uwsgi_sock->proto_name ? uwsgi_sock->proto_name : "uwsgi");
+			exit(1);
+		}
+		uwsgi_sock = uwsgi_sock->next;
+	}
+
+	if (!uwsgi.thread_acceptor_ring_size) {
+		uwsgi.thread_acceptor_ring_size = 1024;
+	}
+	uwsgi.request_ring = uwsgi_request_ring_new(uwsgi.thread_acceptor_ring_size);
+
+	if (pthread_create(&uwsgi.request_ring->acceptor, &uwsgi.threads_attr, uwsgi_thread_acceptor, NULL)) {
+		uwsgi_error("uwsgi_thread_acceptor_loop()/pthread_create()");
+		exit(1);
+	}
+
+	uwsgi_loop_cores_run(uwsgi_thread_acceptor_run);
+}
+
+/*
+	called by wait_for_threads() when the worker is going away (reload, max-requests...):
+	the acceptor is stopped (the connections it would accept are left to the other workers)
+	and the other cores are given up to --worker-reload-mercy seconds to serve the ring before
+	being cancelled. The items still there when they are gone are closed.
+*/
+void uwsgi_thread_acceptor_stop() {
+	struct uwsgi_request_ring *ring = uwsgi.request_ring;
+	if (!ring || uwsgi_atomic_xchg(ring->stopped, 1))
+		return;
+
+	if (pthread_cancel(ring->acceptor)) {
+		uwsgi_error("uwsgi_thread_acceptor_stop()/pthread_cancel()");
+		return;
+	}
+	int ret = pthread_join(ring->acceptor, NULL);
+	if (ret) {
+		uwsgi_log("pthread_join() = %d on the acceptor thread\n", ret);
+	}
+
+	uint64_t deadline = uwsgi_micros() + (uwsgi.worker_reload_mercy * 1000000ULL);
+	while (!uwsgi_request_ring_is_empty(ring) && uwsgi_micros() < deadline) {
+		usleep(1000);
+	}
+}
+
+void uwsgi_thread_acceptor_drain() {
+	struct uwsgi_request_ring *ring = uwsgi.request_ring;
+	struct uwsgi_request_ring_item item;
+	int closed = 0;
+	if (!ring)
+		return;
+
+	while (!uwsgi_request_ring_pop(ring, &item)) {
+		// the signals are still in the bitmaps, but the wakeup byte has been consumed
+		if (item.fd < 0) {
+			uwsgi_signal_disarm(item.signal_fd);
+			continue;
+		}
+		close(item.fd);
+		closed++;
+	}
+	if (closed) {
+		uwsgi_log("closed %d queued connections of worker %d\n", closed, uwsgi.mywid);
+	}
+}
@@ -83,50 +83,59 @@ void uwsgi_unblock_signal(int signum) {
 	}
 }
 
-void uwsgi_master_manage_udp(int udp_fd) {
-	char buf[4096];
-	struct sockaddr_in udp_client;
+static void uwsgi_master_manage_udp_packet(int udp_fd, char *buf, ssize_t rlen, struct sockaddr_in *udp_client) {
 	char udp_client_addr[16];
 	int i;
 
-	socklen_t udp_len = sizeof(udp_client);
-	ssize_t rlen = recvfrom(udp_fd, buf, 4096, 0, (struct sockaddr *) &udp_client, &udp_len);
-
-	if (rlen < 0) {
-		uwsgi_error("uwsgi_master_manage_udp()/recvfrom()");
-	}
-	else if (rlen > 0) {
-
-		memset(udp_client_addr, 0, 16);
-		if (inet_ntop(AF_INET, &udp_client.sin_addr.s_addr, udp_client_addr, 16)) {
-			if (buf[0] == UWSGI_MODIFIER_MULTICAST_ANNOUNCE) {
-			}
-			else if (buf[0] == 0x30 && uwsgi.snmp) {
-				manage_snmp(udp_fd, (uint8_t *) buf, rlen, &udp_client);
-			}
-			else {
+	memset(udp_client_addr, 0, 16);
+	if (inet_ntop(AF_INET, &udp_client->sin_addr.s_addr, udp_client_addr, 16)) {
+		if (buf[0] == UWSGI_MODIFIER_MULTICAST_ANNOUNCE) {
+		}
+		else if (buf[0] == 0x30 && uwsgi.snmp) {
+			manage_snmp(udp_fd, (uint8_t *) buf, rlen, udp_client);
+		}
+		else {
 
-				// loop the various udp manager until one returns true
-				int udp_managed = 0;
-				for (i = 0; i < 256; i++) {
-					if (uwsgi.p[i]->manage_udp) {
-						if (uwsgi.p[i]->manage_udp(udp_client_addr, udp_client.sin_port, buf, rlen)) {
-							udp_managed = 1;
-							break;
-						}
+			// loop the various udp manager until one returns true
+			int udp_managed = 0;
+			for (i = 0; i < 256; i++) {
+				if (uwsgi.p[i]->manage_udp) {
+					if (uwsgi.p[i]->manage_udp(udp_client_addr, udp_client->sin_port, buf, rlen)) {
+						udp_managed = 1;
+						break;
 					}
 				}
+			}
 
-				// else a simple udp logger
-				if (!udp_managed) {
-					uwsgi_log("[udp:%s:%d] %.*s", udp_client_addr, ntohs(udp_client.sin_port), (int) rlen, buf);
-				}
+			// else a simple udp logger
+			if (!udp_managed) {
+				uwsgi_log("[udp:%s:%d] %.*s", udp_client_addr, ntohs(udp_client->sin_port), (int) rlen, buf);
 			}
 		}
-		else {
-			uwsgi_error("uwsgi_master_manage_udp()/inet_ntop()");
-		}
+	}
+	else {
+		uwsgi_error("uwsgi_master_manage_udp()/inet_ntop()");
+	}
+}
+
+void uwsgi_master_manage_udp(int udp_fd) {
+	static struct uwsgi_dgram_batch *udb = NULL;
+	int i;
+
+	if (!udb) {
+		udb = uwsgi_dgram_batch_new(uwsgi.udp_batch, 4096);
+	}
+
+	int n = uwsgi_dgram_batch_recv(udp_fd, udb);
+	if (n < 0) {
+		uwsgi_error("uwsgi_master_manage_udp()/recvfrom()");
+		return;
+	}
 
+	for (i = 0; i < n; i++) {
+		if (udb->len[i] > 0) {
+			uwsgi_master_manage_udp_packet(udp_fd, udb->buf + (udb->buf_size * i), udb->len[i], (struct sockaddr_in *) &udb->addr[i]);
+		}
 	}
 }
 
@@ -418,6 +427,7 @@ int master_loop(char **argv, char **environ) {
 	uwsgi_start_legions();
 #endif
 	uwsgi_metrics_start_collector();
+	uwsgi_tracing_start_exporter();
 
 	uwsgi_add_reload_fds();
 
@@ -472,10 +482,19 @@ int master_loop(char **argv, char **environ) {
 			uwsgi.stats_fd = bind_to_unix(uwsgi.stats, uwsgi.listen_queue, uwsgi.chmod_socket, uwsgi.abstract_socket);
 		}
 
-		event_queue_add_fd_read(uwsgi.master_queue, uwsgi.stats_fd);
+		if (uwsgi.stats_thread) {
+			uwsgi_stats_thread_start();
+		}
+		else {
+			event_queue_add_fd_read(uwsgi.master_queue, uwsgi.stats_fd);
+		}
 		uwsgi_log("*** Stats server enabled on %s fd: %d ***\n", uwsgi.stats, uwsgi.stats_fd);
 	}
 
+	if (uwsgi.metrics_http) {
+		uwsgi_openmetrics_bind();
+	}
+
 
 	if (uwsgi.stats_pusher_instances) {
 		if (!uwsgi_thread_new(uwsgi_stats_pusher_loop)) {
@@ -782,6 +801,11 @@ int master_loop(char **argv, char **environ) {
 				}
 			}
 
+			// send the expired log batches
+			if (uwsgi.log_batch > 0 && !uwsgi.threaded_logger) {
+				uwsgi_log_batches_flush(0);
+			}
+
 			now = uwsgi_now();
 			if (now - uwsgi.current_time < 1) {
 				continue;
@@ -803,6 +827,9 @@ int master_loop(char **argv, char **environ) {
 			// check for idle
 			uwsgi_master_check_idle();
 
+			// wake up again the receivers of signals left behind by dead processes
+			uwsgi_signal_kick_all();
+
 			check_interval = uwsgi.master_interval;
 			if (!check_interval) {
 				check_interval = 1;
@@ -29,7 +29,15 @@ int uwsgi_master_manage_events(int interesting_fd) {
 	// stats server ?
 	if (uwsgi.stats && uwsgi.stats_fd > -1) {
 		if (interesting_fd == uwsgi.stats_fd) {
-			uwsgi_send_stats(uwsgi.stats_fd, uwsgi_master_generate_stats);
+			uwsgi_master_send_stats(uwsgi.stats_fd);
+			return 0;
+		}
+	}
+
+	// OpenMetrics scrape ?
+	if (uwsgi.metrics_http && uwsgi.metrics_http_fd > -1) {
+		if (interesting_fd == uwsgi.metrics_http_fd) {
+			uwsgi_openmetrics_send(uwsgi.metrics_http_fd);
 			return 0;
 		}
 	}
@@ -197,15 +205,16 @@ int uwsgi_master_manage_events(int interesting_fd) {
 		}
 	}
 
-	uint8_t uwsgi_signal;
+	// the signal sockets only carry wakeups, the signals are in the master bitmap
+	char wakeup[64];
 	// check for worker signal
 	if (interesting_fd == uwsgi.shared->worker_signal_pipe[0]) {
-		ssize_t rlen = read(interesting_fd, &uwsgi_signal, 1);
+		ssize_t rlen = read(interesting_fd, wakeup, 64);
 		if (rlen < 0) {
 			uwsgi_error("uwsgi_master_manage_events()/read()");
 		}
 		else if (rlen > 0) {
-			uwsgi_route_signal(uwsgi_signal);
+			uwsgi_route_pending_signals();
 		}
 		else {
 			// TODO restart workers here
@@ -218,12 +227,12 @@ int uwsgi_master_manage_events(int interesting_fd) {
 	// check for spooler signal
 	if (uwsgi.spoolers) {
 		if (interesting_fd == uwsgi.shared->spooler_signal_pipe[0]) {
-			ssize_t rlen = read(interesting_fd, &uwsgi_signal, 1);
+			ssize_t rlen = read(interesting_fd, wakeup, 64);
 			if (rlen < 0) {
 				uwsgi_error("uwsgi_master_manage_events()/read()");
 			}
 			else if (rlen > 0) {
-				uwsgi_route_signal(uwsgi_signal);
+				uwsgi_route_pending_signals();
 			}
 			else {
 				// TODO restart spoolers here
@@ -238,12 +247,12 @@ int uwsgi_master_manage_events(int interesting_fd) {
 	// check for mules signal
 	if (uwsgi.mules_cnt > 0) {
 		if (interesting_fd == uwsgi.shared->mule_signal_pipe[0]) {
-			ssize_t rlen = read(interesting_fd, &uwsgi_signal, 1);
+			ssize_t rlen = read(interesting_fd, wakeup, 64);
 			if (rlen < 0) {
 				uwsgi_error("uwsgi_master_manage_events()/read()");
 			}
 			else if (rlen > 0) {
-				uwsgi_route_signal(uwsgi_signal);
+				uwsgi_route_pending_signals();
 			}
 			else {
 				// TODO respawn mules here
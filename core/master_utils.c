@@ -714,6 +714,10 @@ int uwsgi_respawn_worker(int wid) {
 		uwsgi.workers[wid].cores[i].user_harakiri = 0;
 	}
 	uwsgi.workers[wid].pending_harakiri = 0;
+	// ... and the request log ring
+	if (uwsgi.req_log_rings) {
+		uwsgi_master_req_log_ring_recover(wid);
+	}
 	uwsgi.workers[wid].rss_size = 0;
 	uwsgi.workers[wid].vsz_size = 0;
 	// ... reset stopped_at
@@ -730,6 +734,9 @@ int uwsgi_respawn_worker(int wid) {
 	// this is required for various checks
 	uwsgi.workers[wid].delta_requests = 0;
 
+	// the previous worker could have left signals behind (in its bitmap or in the pool one)
+	uwsgi_signal_kick_all();
+
 	if (uwsgi.threaded_logger) {
 		pthread_mutex_lock(&uwsgi.threaded_logger_lock);
 	}
@@ -777,6 +784,7 @@ int uwsgi_respawn_worker(int wid) {
 		uwsgi_fixup_fds(wid, 0, NULL);
 
 		uwsgi.my_signal_socket = uwsgi.workers[wid].signal_pipe[1];
+		uwsgi.my_signal_bitmap = &uwsgi.workers[wid].signals_pending;
 
 		if (uwsgi.master_process) {
 			if ((uwsgi.workers[uwsgi.mywid].respawn_count || uwsgi.status.is_cheap)) {
@@ -801,6 +809,8 @@ int uwsgi_respawn_worker(int wid) {
 		// the pid is set only in the master, as the worker should never use it
 		uwsgi.workers[wid].pid = pid;
 
+		UWSGI_PROBE3(worker__respawn, wid, pid, respawns);
+
 		if (respawns > 0) {
 			uwsgi_log("Respawned uWSGI worker %d (new pid: %d)\n", wid, (int) pid);
 		}
@@ -817,11 +827,9 @@ int uwsgi_respawn_worker(int wid) {
 	return 0;
 }
 
-struct uwsgi_stats *uwsgi_master_generate_stats() {
-
-	int i;
-
-	struct uwsgi_stats *us = uwsgi_stats_new(8192);
+static int uwsgi_stats_section_server(struct uwsgi_stats *us, int comma) {
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
 	if (uwsgi_stats_keyval_comma(us, "version", UWSGI_VERSION))
 		goto end;
@@ -833,12 +841,9 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		goto end;
 #endif
 
-	int signal_queue = 0;
-	if (ioctl(uwsgi.shared->worker_signal_pipe[1], FIONREAD, &signal_queue)) {
-		uwsgi_error("uwsgi_master_generate_stats() -> ioctl()\n");
-	}
-
-	if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) signal_queue))
+	if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) uwsgi_signal_pending(&uwsgi.shared->worker_signals)))
+		goto end;
+	if (uwsgi_stats_keylong_comma(us, "coalesced_signals", (unsigned long long) uwsgi.shared->coalesced_signals))
 		goto end;
 
 	if (uwsgi_stats_keylong_comma(us, "load", (unsigned long long) uwsgi.shared->load))
@@ -851,50 +856,67 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		goto end;
 
 	char *cwd = uwsgi_get_cwd();
-	if (uwsgi_stats_keyval_comma(us, "cwd", cwd)) {
+	if (uwsgi_stats_keyval(us, "cwd", cwd)) {
 		free(cwd);
 		goto end;
 	}
 	free(cwd);
 
-	if (uwsgi.daemons) {
-		if (uwsgi_stats_key(us, "daemons"))
-			goto end;
-		if (uwsgi_stats_list_open(us))
-			goto end;
+	return 1;
+end:
+	return -1;
+}
 
-		struct uwsgi_daemon *ud = uwsgi.daemons;
-		while (ud) {
-			if (uwsgi_stats_object_open(us))
-				goto end;
+static int uwsgi_stats_section_daemons(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.daemons)
+		return 0;
 
-			// allocate 2x the size of original command
-			// in case we need to escape all chars
-			char *cmd = uwsgi_malloc((strlen(ud->command)*2)+1);
-			escape_json(ud->command, strlen(ud->command), cmd);
-			if (uwsgi_stats_keyval_comma(us, "cmd", cmd)) {
-				free(cmd);
-				goto end;
-			}
-			free(cmd);
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
-			if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) (ud->pid < 0) ? 0 : ud->pid))
-				goto end;
-			if (uwsgi_stats_keylong(us, "respawns", (unsigned long long) ud->respawns ? 0 : ud->respawns))
-				goto end;
-			if (uwsgi_stats_object_close(us))
-				goto end;
-			if (ud->next) {
-				if (uwsgi_stats_comma(us))
-					goto end;
-			}
-			ud = ud->next;
+	if (uwsgi_stats_key(us, "daemons"))
+		goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
+
+	struct uwsgi_daemon *ud = uwsgi.daemons;
+	while (ud) {
+		if (uwsgi_stats_object_open(us))
+			goto end;
+
+		// allocate 2x the size of original command
+		// in case we need to escape all chars
+		char *cmd = uwsgi_malloc((strlen(ud->command)*2)+1);
+		escape_json(ud->command, strlen(ud->command), cmd);
+		if (uwsgi_stats_keyval_comma(us, "cmd", cmd)) {
+			free(cmd);
+			goto end;
 		}
-		if (uwsgi_stats_list_close(us))
+		free(cmd);
+
+		if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) (ud->pid < 0) ? 0 : ud->pid))
 			goto end;
-		if (uwsgi_stats_comma(us))
+		if (uwsgi_stats_keylong(us, "respawns", (unsigned long long) ud->respawns ? 0 : ud->respawns))
+			goto end;
+		if (uwsgi_stats_object_close(us))
 			goto end;
+		if (ud->next) {
+			if (uwsgi_stats_comma(us))
+				goto end;
+		}
+		ud = ud->next;
 	}
+	if (uwsgi_stats_list_close(us))
+		goto end;
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_locks(struct uwsgi_stats *us, int comma) {
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
 	if (uwsgi_stats_key(us, "locks"))
 		goto end;
@@ -918,138 +940,222 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 
 	if (uwsgi_stats_list_close(us))
 		goto end;
-	if (uwsgi_stats_comma(us))
-		goto end;
 
-	if (uwsgi.caches) {
+	return 1;
+end:
+	return -1;
+}
 
-		
-		if (uwsgi_stats_key(us, "caches"))
-                goto end;
+static int uwsgi_stats_section_caches(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.caches)
+		return 0;
 
-		if (uwsgi_stats_list_open(us)) goto end;
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
-		struct uwsgi_cache *uc = uwsgi.caches;
-		while(uc) {
-			if (uwsgi_stats_object_open(us))
+	if (uwsgi_stats_key(us, "caches"))
+		goto end;
+
+	if (uwsgi_stats_list_open(us)) goto end;
+
+	struct uwsgi_cache *uc = uwsgi.caches;
+	while(uc) {
+		if (uwsgi_stats_object_open(us))
                         	goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "name", uc->name ? uc->name : "default"))
+		if (uwsgi_stats_keyval_comma(us, "name", uc->name ? uc->name : "default"))
                         	goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "hash", uc->hash->name))
+		if (uwsgi_stats_keyval_comma(us, "hash", uc->hash->name))
                         	goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "hashsize", (unsigned long long) uc->hashsize))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "hashsize", (unsigned long long) uc->hashsize))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "keysize", (unsigned long long) uc->keysize))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "keysize", (unsigned long long) uc->keysize))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "max_items", (unsigned long long) uc->max_items))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "max_items", (unsigned long long) uc->max_items))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "blocks", (unsigned long long) uc->blocks))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "blocks", (unsigned long long) uc->blocks))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "blocksize", (unsigned long long) uc->blocksize))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "blocksize", (unsigned long long) uc->blocksize))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "items", (unsigned long long) uc->n_items))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "items", (unsigned long long) uc->n_items))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) uc->hits))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "hits", (unsigned long long) uc->hits))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "miss", (unsigned long long) uc->miss))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "miss", (unsigned long long) uc->miss))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "full", (unsigned long long) uc->full))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "full", (unsigned long long) uc->full))
+			goto end;
 
-			if (uwsgi_stats_keylong(us, "last_modified_at", (unsigned long long) uc->last_modified_at))
-				goto end;
+		if (uwsgi_stats_keylong(us, "last_modified_at", (unsigned long long) uc->last_modified_at))
+			goto end;
 
-			if (uwsgi_stats_object_close(us))
-				goto end;
+		if (uwsgi_stats_object_close(us))
+			goto end;
 
-			if (uc->next) {
-				if (uwsgi_stats_comma(us))
-					goto end;
-			}
-			uc = uc->next;
+		if (uc->next) {
+			if (uwsgi_stats_comma(us))
+				goto end;
 		}
+		uc = uc->next;
+	}
 
-		if (uwsgi_stats_list_close(us))
-		goto end;
+	if (uwsgi_stats_list_close(us))
+	goto end;
 
-		if (uwsgi_stats_comma(us))
-		goto end;
-	}
 
-	if (uwsgi.has_metrics && !uwsgi.stats_no_metrics) {
-		if (uwsgi_stats_key(us, "metrics"))
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_metrics(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.has_metrics || uwsgi.stats_no_metrics)
+		return 0;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+
+	if (uwsgi_stats_key(us, "metrics"))
                 	goto end;
 
-		if (uwsgi_stats_object_open(us))
-			goto end;
+	if (uwsgi_stats_object_open(us))
+		goto end;
 
-		uwsgi_rlock(uwsgi.metrics_lock);
-		struct uwsgi_metric *um = uwsgi.metrics;
-		while(um) {
+	uwsgi_rlock(uwsgi.metrics_lock);
+	struct uwsgi_metric *um = uwsgi.metrics;
+	while(um) {
         		int64_t um_val = *um->value;
 
-			if (uwsgi_stats_key(us, um->name)) {
-				uwsgi_rwunlock(uwsgi.metrics_lock);
+		if (uwsgi_stats_key(us, um->name)) {
+			uwsgi_rwunlock(uwsgi.metrics_lock);
                 		goto end;
-			}
+		}
 
-			if (uwsgi_stats_object_open(us)) {
-				uwsgi_rwunlock(uwsgi.metrics_lock);
+		if (uwsgi_stats_object_open(us)) {
+			uwsgi_rwunlock(uwsgi.metrics_lock);
                                 goto end;
-			}
+		}
 
-			if (uwsgi_stats_keylong(us, "type", (long long) um->type)) {
+		if (uwsgi_stats_keylong(us, "type", (long long) um->type)) {
         			uwsgi_rwunlock(uwsgi.metrics_lock);
-				goto end;
-			} 
+			goto end;
+		} 
 
-			if (uwsgi_stats_comma(us)) {
+		if (uwsgi_stats_comma(us)) {
         			uwsgi_rwunlock(uwsgi.metrics_lock);
-				goto end;
-			}
+			goto end;
+		}
 
-			if (uwsgi_stats_keyval_comma(us, "oid", um->oid ? um->oid : "")) {
+		if (uwsgi_stats_keyval_comma(us, "oid", um->oid ? um->oid : "")) {
                                 uwsgi_rwunlock(uwsgi.metrics_lock);
                                 goto end;
                         }
 
-			if (uwsgi_stats_keyslong(us, "value", (long long) um_val)) {
+		if (uwsgi_stats_keyslong(us, "value", (long long) um_val)) {
         			uwsgi_rwunlock(uwsgi.metrics_lock);
-				goto end;
-			} 
+			goto end;
+		} 
 
-			if (uwsgi_stats_object_close(us)) {
+		if (uwsgi_stats_object_close(us)) {
                                 uwsgi_rwunlock(uwsgi.metrics_lock);
                                 goto end;
                         }
 
-			um = um->next;
-			if (um) {
-				if (uwsgi_stats_comma(us)) {
+		um = um->next;
+		if (um) {
+			if (uwsgi_stats_comma(us)) {
         				uwsgi_rwunlock(uwsgi.metrics_lock);
-					goto end;
-				}
+				goto end;
 			}
 		}
+	}
         	uwsgi_rwunlock(uwsgi.metrics_lock);
 
+	if (uwsgi_stats_object_close(us))
+		goto end;
+
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_tracing(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.trace_spans)
+		return 0;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+
+	if (uwsgi_stats_key(us, "tracing"))
+		goto end;
+	if (uwsgi_stats_object_open(us))
+		goto end;
+	if (uwsgi_stats_keyval_comma(us, "collector", uwsgi.trace_spans))
+		goto end;
+	if (uwsgi_stats_keylong_comma(us, "send_errors", (unsigned long long) uwsgi.shared->trace_send_errors))
+		goto end;
+	if (uwsgi_stats_key(us, "rings"))
+		goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
+
+	int i;
+	for (i = 0; i <= uwsgi.numproc; i++) {
+		struct uwsgi_trace_ring *utr = uwsgi.trace_rings[i];
+		if (uwsgi_stats_object_open(us))
+			goto end;
+		if (uwsgi_stats_keylong_comma(us, "id", (unsigned long long) i))
+			goto end;
+		if (uwsgi_stats_keylong_comma(us, "size", (unsigned long long) utr->size))
+			goto end;
+		if (uwsgi_stats_keylong_comma(us, "pushed", (unsigned long long) uwsgi_atomic_load(utr->head)))
+			goto end;
+		if (uwsgi_stats_keylong_comma(us, "exported", (unsigned long long) utr->exported))
+			goto end;
+		if (uwsgi_stats_keylong(us, "dropped", (unsigned long long) uwsgi_atomic_load(utr->dropped)))
+			goto end;
 		if (uwsgi_stats_object_close(us))
 			goto end;
+		if (i < uwsgi.numproc) {
+			if (uwsgi_stats_comma(us))
+				goto end;
+		}
+	}
 
-		if (uwsgi_stats_comma(us))
+	if (uwsgi_stats_list_close(us))
 		goto end;
-	}
+	if (uwsgi_stats_object_close(us))
+		goto end;
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_histograms(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.histograms)
+		return 0;
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+	if (uwsgi_stats_histograms(us))
+		return -1;
+	return 1;
+}
+
+static int uwsgi_stats_section_sockets(struct uwsgi_stats *us, int comma) {
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
 	if (uwsgi_stats_key(us, "sockets"))
 		goto end;
@@ -1093,8 +1199,17 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 	if (uwsgi_stats_list_close(us))
 		goto end;
 
-	if (uwsgi_stats_comma(us))
-		goto end;
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_workers(struct uwsgi_stats *us, int comma) {
+	int i;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
 	if (uwsgi_stats_key(us, "workers"))
 		goto end;
@@ -1122,11 +1237,7 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		if (uwsgi_stats_keylong_comma(us, "signals", (unsigned long long) uwsgi.workers[i + 1].signals))
 			goto end;
 
-		if (ioctl(uwsgi.workers[i + 1].signal_pipe[1], FIONREAD, &signal_queue)) {
-			uwsgi_error("uwsgi_master_generate_stats() -> ioctl()\n");
-		}
-
-		if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) signal_queue))
+		if (uwsgi_stats_keylong_comma(us, "signal_queue", (unsigned long long) uwsgi_signal_pending(&uwsgi.workers[i + 1].signals_pending)))
 			goto end;
 
 		if (uwsgi.workers[i + 1].cheaped) {
@@ -1169,6 +1280,34 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 		if (uwsgi_stats_keylong_comma(us, "avg_rt", (unsigned long long) uwsgi.workers[i + 1].avg_response_time))
 			goto end;
 
+		if (uwsgi.req_log_rings) {
+			struct uwsgi_log_ring *ulr = uwsgi.req_log_rings[i + 1];
+			if (uwsgi_stats_keylong_comma(us, "req_log_ring_size", (unsigned long long) ulr->size))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "req_log_ring_used", (unsigned long long) (uwsgi_atomic_load(ulr->head) - uwsgi_atomic_load(ulr->tail))))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "req_log_ring_lines", (unsigned long long) ulr->lines))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "req_log_ring_dropped", (unsigned long long) ulr->dropped))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "req_log_ring_waits", (unsigned long long) ulr->waits))
+				goto end;
+		}
+
+		if (uwsgi.thread_acceptor) {
+			if (uwsgi_stats_keylongs_comma(us, "ring_wait", uwsgi.workers[i + 1].ring_wait, UWSGI_LOG2_HISTOGRAM_BUCKETS))
+				goto end;
+			if (uwsgi_stats_keylongs_comma(us, "ring_depth", uwsgi.workers[i + 1].ring_depth, UWSGI_LOG2_HISTOGRAM_BUCKETS))
+				goto end;
+		}
+
+		if (uwsgi.histograms) {
+			if (uwsgi_stats_request_histograms(us, "histograms", &uwsgi.histograms_workers[i + 1]))
+				goto end;
+			if (uwsgi_stats_comma(us))
+				goto end;
+		}
+
 		// applications list
 		if (uwsgi_stats_key(us, "apps"))
 			goto end;
@@ -1197,6 +1336,13 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			if (uwsgi_stats_keylong_comma(us, "exceptions", ua->exceptions))
 				goto end;
 
+			if (uwsgi.histograms) {
+				if (uwsgi_stats_request_histograms(us, "histograms", &uwsgi.histograms_apps[((i + 1) * uwsgi.max_apps) + j]))
+					goto end;
+				if (uwsgi_stats_comma(us))
+					goto end;
+			}
+
 			if (*ua->chdir) {
 				if (uwsgi_stats_keyval(us, "chdir", ua->chdir))
 					goto end;
@@ -1255,6 +1401,9 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			if (uwsgi_stats_keylong_comma(us, "read_errors", (unsigned long long) uc->read_errors))
 				goto end;
 
+			if (uwsgi_stats_keylong_comma(us, "arena_overflows", (unsigned long long) uc->arena_overflows))
+				goto end;
+
 			if (uwsgi_stats_keylong_comma(us, "in_request", (unsigned long long) uc->in_request))
 				goto end;
 
@@ -1292,159 +1441,272 @@ nocores:
 			if (uwsgi_stats_comma(us))
 				goto end;
 		}
+
+		// big instances: do not accumulate all of the workers in memory
+		if (uwsgi_stats_flush(us))
+			goto end;
 	}
 
 	if (uwsgi_stats_list_close(us))
 		goto end;
 
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_spoolers(struct uwsgi_stats *us, int comma) {
 	struct uwsgi_spooler *uspool = uwsgi.spoolers;
-	if (uspool) {
-		if (uwsgi_stats_comma(us))
+	if (!uspool)
+		return 0;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+
+	if (uwsgi_stats_key(us, "spoolers"))
+		goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
+	while (uspool) {
+		if (uwsgi_stats_object_open(us))
 			goto end;
-		if (uwsgi_stats_key(us, "spoolers"))
+
+		if (uwsgi_stats_keyval_comma(us, "dir", uspool->dir))
 			goto end;
-		if (uwsgi_stats_list_open(us))
+
+		if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) uspool->pid))
 			goto end;
-		while (uspool) {
-			if (uwsgi_stats_object_open(us))
-				goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "dir", uspool->dir))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "tasks", (unsigned long long) uspool->tasks))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "pid", (unsigned long long) uspool->pid))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "respawns", (unsigned long long) uspool->respawned))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "tasks", (unsigned long long) uspool->tasks))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "indexed", (unsigned long long) uspool->indexed))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "respawns", (unsigned long long) uspool->respawned))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "running", (unsigned long long) uspool->running))
+			goto end;
 
-			if (uwsgi_stats_keylong(us, "running", (unsigned long long) uspool->running))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "inflight", (unsigned long long) uspool->inflight))
+			goto end;
 
-			if (uwsgi_stats_object_close(us))
+		// snapshot
+		struct uwsgi_histogram latency;
+		memset(&latency, 0, sizeof(struct uwsgi_histogram));
+		uwsgi_histogram_merge(&latency, uspool->latency);
+		if (uwsgi_stats_histogram(us, "latency", &latency))
+			goto end;
+
+		if (uwsgi_stats_object_close(us))
+			goto end;
+		uspool = uspool->next;
+		if (uspool) {
+			if (uwsgi_stats_comma(us))
 				goto end;
-			uspool = uspool->next;
-			if (uspool) {
-				if (uwsgi_stats_comma(us))
-					goto end;
-			}
 		}
-		if (uwsgi_stats_list_close(us))
+	}
+	if (uwsgi_stats_list_close(us))
+		goto end;
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_mule_ring(struct uwsgi_stats *us, struct uwsgi_mule_ring *umr) {
+	uint64_t pushed = uwsgi_atomic_load(umr->pushed);
+	uint64_t pulled = uwsgi_atomic_load(umr->pulled);
+
+	if (uwsgi_stats_object_open(us))
+		return -1;
+	if (uwsgi_stats_keyval_comma(us, "name", umr->name))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "size", (unsigned long long) umr->ring.size))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "used", (unsigned long long) (uwsgi_atomic_load(umr->ring.prod_tail) - uwsgi_atomic_load(umr->ring.cons_tail))))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "depth", (unsigned long long) (pushed > pulled ? pushed - pulled : 0)))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "pushed", (unsigned long long) pushed))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "pulled", (unsigned long long) pulled))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "dropped", (unsigned long long) uwsgi_atomic_load(umr->dropped)))
+		return -1;
+	if (uwsgi_stats_keylong_comma(us, "blocked", (unsigned long long) uwsgi_atomic_load(umr->blocked)))
+		return -1;
+
+	// snapshot
+	struct uwsgi_histogram latency;
+	memset(&latency, 0, sizeof(struct uwsgi_histogram));
+	uwsgi_histogram_merge(&latency, &umr->latency);
+	if (uwsgi_stats_histogram(us, "latency", &latency))
+		return -1;
+
+	if (uwsgi_stats_object_close(us))
+		return -1;
+	return 0;
+}
+
+static int uwsgi_stats_section_mule_rings(struct uwsgi_stats *us, int comma) {
+	if (!uwsgi.mules_msg_ring)
+		return 0;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+
+	if (uwsgi_stats_key(us, "mule_rings"))
+		goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
+
+	if (uwsgi_stats_mule_ring(us, uwsgi.mules_msg_ring))
+		goto end;
+
+	int i;
+	for (i = 0; i < uwsgi.mules_cnt; i++) {
+		if (uwsgi_stats_comma(us))
+			goto end;
+		if (uwsgi_stats_mule_ring(us, uwsgi.mules[i].msg_ring))
 			goto end;
 	}
 
-	struct uwsgi_cron *ucron = uwsgi.crons;
-	if (ucron) {
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
 		if (uwsgi_stats_comma(us))
 			goto end;
-		if (uwsgi_stats_key(us, "crons"))
+		if (uwsgi_stats_mule_ring(us, uwsgi.farms[i].msg_ring))
 			goto end;
-		if (uwsgi_stats_list_open(us))
+	}
+
+	if (uwsgi_stats_list_close(us))
+		goto end;
+
+	return 1;
+end:
+	return -1;
+}
+
+static int uwsgi_stats_section_crons(struct uwsgi_stats *us, int comma) {
+	struct uwsgi_cron *ucron = uwsgi.crons;
+	if (!ucron)
+		return 0;
+
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
+
+	if (uwsgi_stats_key(us, "crons"))
+		goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
+	while (ucron) {
+		if (uwsgi_stats_object_open(us))
 			goto end;
-		while (ucron) {
-			if (uwsgi_stats_object_open(us))
-				goto end;
 
-			if (uwsgi_stats_keyslong_comma(us, "minute", (long long) ucron->minute))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "minute", (long long) ucron->minute))
+			goto end;
 
-			if (uwsgi_stats_keyslong_comma(us, "hour", (long long) ucron->hour))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "hour", (long long) ucron->hour))
+			goto end;
 
-			if (uwsgi_stats_keyslong_comma(us, "day", (long long) ucron->day))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "day", (long long) ucron->day))
+			goto end;
 
-			if (uwsgi_stats_keyslong_comma(us, "month", (long long) ucron->month))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "month", (long long) ucron->month))
+			goto end;
 
-			if (uwsgi_stats_keyslong_comma(us, "week", (long long) ucron->week))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "week", (long long) ucron->week))
+			goto end;
 
-			char *cmd = uwsgi_malloc((strlen(ucron->command)*2)+1);
-			escape_json(ucron->command, strlen(ucron->command), cmd);
-			if (uwsgi_stats_keyval_comma(us, "command", cmd)) {
-				free(cmd);
-				goto end;
-			}
+		char *cmd = uwsgi_malloc((strlen(ucron->command)*2)+1);
+		escape_json(ucron->command, strlen(ucron->command), cmd);
+		if (uwsgi_stats_keyval_comma(us, "command", cmd)) {
 			free(cmd);
+			goto end;
+		}
+		free(cmd);
 
-			if (uwsgi_stats_keylong_comma(us, "unique", (unsigned long long) ucron->unique))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "unique", (unsigned long long) ucron->unique))
+			goto end;
 
 #ifdef UWSGI_SSL
-			if (uwsgi_stats_keyval_comma(us, "legion", ucron->legion ? ucron->legion : ""))
-				goto end;
+		if (uwsgi_stats_keyval_comma(us, "legion", ucron->legion ? ucron->legion : ""))
+			goto end;
 #endif
 
-			if (uwsgi_stats_keyslong_comma(us, "pid", (long long) ucron->pid))
-				goto end;
+		if (uwsgi_stats_keyslong_comma(us, "pid", (long long) ucron->pid))
+			goto end;
 
-			if (uwsgi_stats_keylong(us, "started_at", (unsigned long long) ucron->started_at))
-				goto end;
+		if (uwsgi_stats_keylong(us, "started_at", (unsigned long long) ucron->started_at))
+			goto end;
 
-			if (uwsgi_stats_object_close(us))
-				goto end;
+		if (uwsgi_stats_object_close(us))
+			goto end;
 
-			ucron = ucron->next;
-			if (ucron) {
-				if (uwsgi_stats_comma(us))
-					goto end;
-			}
+		ucron = ucron->next;
+		if (ucron) {
+			if (uwsgi_stats_comma(us))
+				goto end;
 		}
-		if (uwsgi_stats_list_close(us))
-			goto end;
 	}
+	if (uwsgi_stats_list_close(us))
+		goto end;
+
+	return 1;
+end:
+	return -1;
+}
 
 #ifdef UWSGI_SSL
+static int uwsgi_stats_section_legions(struct uwsgi_stats *us, int comma) {
 	struct uwsgi_legion *legion = NULL;
-	if (uwsgi.legions) {
+	if (!uwsgi.legions)
+		return 0;
 
-		if (uwsgi_stats_comma(us))
-			goto end;
+	if (comma && uwsgi_stats_comma(us))
+		return -1;
 
-		if (uwsgi_stats_key(us, "legions"))
-			goto end;
+	if (uwsgi_stats_key(us, "legions"))
+		goto end;
 
-		if (uwsgi_stats_list_open(us))
-			goto end;
+	if (uwsgi_stats_list_open(us))
+		goto end;
 
-		legion = uwsgi.legions;
-		while (legion) {
-			if (uwsgi_stats_object_open(us))
-				goto end;
+	legion = uwsgi.legions;
+	while (legion) {
+		if (uwsgi_stats_object_open(us))
+			goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "legion", legion->legion))
-				goto end;
+		if (uwsgi_stats_keyval_comma(us, "legion", legion->legion))
+			goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "addr", legion->addr))
-				goto end;
+		if (uwsgi_stats_keyval_comma(us, "addr", legion->addr))
+			goto end;
 
-			if (uwsgi_stats_keyval_comma(us, "uuid", legion->uuid))
-				goto end;
+		if (uwsgi_stats_keyval_comma(us, "uuid", legion->uuid))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "valor", (unsigned long long) legion->valor))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "valor", (unsigned long long) legion->valor))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "checksum", (unsigned long long) legion->checksum))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "checksum", (unsigned long long) legion->checksum))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "quorum", (unsigned long long) legion->quorum))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "quorum", (unsigned long long) legion->quorum))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "i_am_the_lord", (unsigned long long) legion->i_am_the_lord))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "i_am_the_lord", (unsigned long long) legion->i_am_the_lord))
+			goto end;
 
-			if (uwsgi_stats_keylong_comma(us, "lord_valor", (unsigned long long) legion->lord_valor))
-				goto end;
+		if (uwsgi_stats_keylong_comma(us, "lord_valor", (unsigned long long) legion->lord_valor))
+			goto end;
 
-			if (uwsgi_stats_keyvaln_comma(us, "lord_uuid", legion->lord_uuid, 36))
-				goto end;
+		if (uwsgi_stats_keyvaln_comma(us, "lord_uuid", legion->lord_uuid, 36))
+			goto end;
 
-			// legion nodes start
-			if (uwsgi_stats_key(us, "nodes"))
+		// legion nodes start
+		if (uwsgi_stats_key(us, "nodes"))
                                 goto end;
 
                         if (uwsgi_stats_list_open(us))
@@ -1453,7 +1715,7 @@ nocores:
                         struct uwsgi_string_list *nodes = legion->nodes;
                         while (nodes) {
 
-				if (uwsgi_stats_str(us, nodes->value))
+			if (uwsgi_stats_str(us, nodes->value))
                                 	goto end;
 
                                 nodes = nodes->next;
@@ -1463,85 +1725,136 @@ nocores:
                                 }
                         }
 
-			if (uwsgi_stats_list_close(us))
-				goto end;
+		if (uwsgi_stats_list_close(us))
+			goto end;
 
                         if (uwsgi_stats_comma(us))
                         	goto end;
 
 
-			// legion members start
-			if (uwsgi_stats_key(us, "members"))
-				goto end;
-
-			if (uwsgi_stats_list_open(us))
-				goto end;
-
-			uwsgi_rlock(legion->lock);
-			struct uwsgi_legion_node *node = legion->nodes_head;
-			while (node) {
-				if (uwsgi_stats_object_open(us))
-					goto unlock_legion_mutex;
+		// legion members start
+		if (uwsgi_stats_key(us, "members"))
+			goto end;
 
-				if (uwsgi_stats_keyvaln_comma(us, "name", node->name, node->name_len))
-					goto unlock_legion_mutex;
+		if (uwsgi_stats_list_open(us))
+			goto end;
 
-				if (uwsgi_stats_keyval_comma(us, "uuid", node->uuid))
-					goto unlock_legion_mutex;
+		uwsgi_rlock(legion->lock);
+		struct uwsgi_legion_node *node = legion->nodes_head;
+		while (node) {
+			if (uwsgi_stats_object_open(us))
+				goto unlock_legion_mutex;
 
-				if (uwsgi_stats_keylong_comma(us, "valor", (unsigned long long) node->valor))
-					goto unlock_legion_mutex;
+			if (uwsgi_stats_keyvaln_comma(us, "name", node->name, node->name_len))
+				goto unlock_legion_mutex;
 
-				if (uwsgi_stats_keylong_comma(us, "checksum", (unsigned long long) node->checksum))
-					goto unlock_legion_mutex;
+			if (uwsgi_stats_keyval_comma(us, "uuid", node->uuid))
+				goto unlock_legion_mutex;
 
-				if (uwsgi_stats_keylong(us, "last_seen", (unsigned long long) node->last_seen))
-					goto unlock_legion_mutex;
+			if (uwsgi_stats_keylong_comma(us, "valor", (unsigned long long) node->valor))
+				goto unlock_legion_mutex;
 
-				if (uwsgi_stats_object_close(us))
-					goto unlock_legion_mutex;
+			if (uwsgi_stats_keylong_comma(us, "checksum", (unsigned long long) node->checksum))
+				goto unlock_legion_mutex;
 
-				node = node->next;
-				if (node) {
-					if (uwsgi_stats_comma(us))
-						goto unlock_legion_mutex;
-				}
-			}
-			uwsgi_rwunlock(legion->lock);
-
-			if (uwsgi_stats_list_close(us))
-				goto end;
-			// legion nodes end
+			if (uwsgi_stats_keylong(us, "last_seen", (unsigned long long) node->last_seen))
+				goto unlock_legion_mutex;
 
 			if (uwsgi_stats_object_close(us))
-				goto end;
+				goto unlock_legion_mutex;
 
-			legion = legion->next;
-			if (legion) {
+			node = node->next;
+			if (node) {
 				if (uwsgi_stats_comma(us))
-					goto end;
+					goto unlock_legion_mutex;
 			}
 		}
+		uwsgi_rwunlock(legion->lock);
 
 		if (uwsgi_stats_list_close(us))
 			goto end;
+		// legion nodes end
 
+		if (uwsgi_stats_object_close(us))
+			goto end;
+
+		legion = legion->next;
+		if (legion) {
+			if (uwsgi_stats_comma(us))
+				goto end;
+		}
 	}
-#endif
 
-	if (uwsgi_stats_object_close(us))
+	if (uwsgi_stats_list_close(us))
 		goto end;
 
-	return us;
-#ifdef UWSGI_SSL
+	return 1;
 unlock_legion_mutex:
 	if (legion)
 		uwsgi_rwunlock(legion->lock);
-#endif
 end:
-	free(us->base);
-	free(us);
-	return NULL;
+	return -1;
+}
+#endif
+
+static struct uwsgi_stats_section {
+	char *name;
+	int (*func)(struct uwsgi_stats *, int);
+} uwsgi_stats_sections[] = {
+	{"server", uwsgi_stats_section_server},
+	{"daemons", uwsgi_stats_section_daemons},
+	{"locks", uwsgi_stats_section_locks},
+	{"caches", uwsgi_stats_section_caches},
+	{"metrics", uwsgi_stats_section_metrics},
+	{"histograms", uwsgi_stats_section_histograms},
+	{"tracing", uwsgi_stats_section_tracing},
+	{"sockets", uwsgi_stats_section_sockets},
+	{"workers", uwsgi_stats_section_workers},
+	{"spoolers", uwsgi_stats_section_spoolers},
+	{"mule_rings", uwsgi_stats_section_mule_rings},
+	{"crons", uwsgi_stats_section_crons},
+#ifdef UWSGI_SSL
+	{"legions", uwsgi_stats_section_legions},
+#endif
+	{NULL, NULL},
+};
+
+/*
+	generate the stats document (or only the requested comma separated sections)
+
+	if the uwsgi_stats structure has a file descriptor mapped, the output is flushed
+	to it after each section (and after each worker)
+*/
+int uwsgi_master_generate_stats_sections(struct uwsgi_stats *us, char *sections) {
+	int comma = 0;
+	struct uwsgi_stats_section *uss = uwsgi_stats_sections;
+	while (uss->name) {
+		if (sections && !uwsgi_list_has_str(sections, uss->name))
+			goto next;
+		int ret = uss->func(us, comma);
+		if (ret < 0)
+			return -1;
+		if (ret > 0)
+			comma = 1;
+		if (uwsgi_stats_flush(us))
+			return -1;
+next:
+		uss++;
+	}
+
+	if (uwsgi_stats_object_close(us))
+		return -1;
+	return uwsgi_stats_flush(us);
+}
+
+struct uwsgi_stats *uwsgi_master_generate_stats() {
+	struct uwsgi_stats *us = uwsgi_stats_new(8192);
+	if (uwsgi_master_generate_stats_sections(us, NULL)) {
+		free(us->base);
+		free(us);
+		return NULL;
+	}
+	return us;
 }
 
 void uwsgi_register_cheaper_algo(char *name, int (*func) (int)) {
@@ -1575,6 +1888,7 @@ void uwsgi_register_cheaper_algo(char *name, int (*func) (int)) {
 
 void trigger_harakiri(int i) {
 	int j;
+	UWSGI_PROBE3(worker__harakiri, i, uwsgi.workers[i].pid, uwsgi.workers[i].pending_harakiri + 1);
 	uwsgi_log_verbose("*** HARAKIRI ON WORKER %d (pid: %d, try: %d) ***\n", i, uwsgi.workers[i].pid, uwsgi.workers[i].pending_harakiri + 1);
 	if (uwsgi.harakiri_verbose) {
 #ifdef __linux__
@@ -437,6 +437,124 @@ struct uwsgi_metric *uwsgi_register_keyval_metric(char *arg) {
 	return um;
 }
 
+/*
+	metrics are grouped by collection frequency, every group is collected
+	in a single batch (one write lock for the whole group) only when its time has come.
+
+	metrics without a collector, thresholds or a memory mapped file do not need
+	any work from this thread (their value is directly updated with atomic ops)
+*/
+struct uwsgi_metrics_bucket {
+	uint32_t freq;
+	time_t next_run;
+	struct uwsgi_metric **metrics;
+	int64_t *values;
+	uint64_t count;
+	struct uwsgi_metrics_bucket *next;
+};
+
+static struct uwsgi_metrics_bucket *uwsgi_metrics_buckets_build(time_t now) {
+	struct uwsgi_metrics_bucket *buckets = NULL;
+	struct uwsgi_metric *metric = uwsgi.metrics;
+	while(metric) {
+		if (!metric->collector && !metric->thresholds && !metric->map) goto next;
+		struct uwsgi_metrics_bucket *umb = buckets;
+		while(umb) {
+			if (umb->freq == metric->freq) break;
+			umb = umb->next;
+		}
+		if (!umb) {
+			umb = uwsgi_calloc(sizeof(struct uwsgi_metrics_bucket));
+			umb->freq = metric->freq;
+			umb->next_run = now;
+			umb->next = buckets;
+			buckets = umb;
+		}
+		umb->metrics = realloc(umb->metrics, sizeof(struct uwsgi_metric *) * (umb->count + 1));
+		if (!umb->metrics) {
+			uwsgi_error("uwsgi_metrics_buckets_build()/realloc()");
+			exit(1);
+		}
+		umb->metrics[umb->count] = metric;
+		umb->count++;
+next:
+		metric = metric->next;
+	}
+
+	struct uwsgi_metrics_bucket *umb = buckets;
+	while(umb) {
+		umb->values = uwsgi_calloc(sizeof(int64_t) * umb->count);
+		umb = umb->next;
+	}
+	return buckets;
+}
+
+static void uwsgi_metric_check_thresholds(struct uwsgi_metric *metric, int64_t new_value, time_t now) {
+	struct uwsgi_metric_threshold *umt = metric->thresholds;
+	while(umt) {
+		if (new_value >= umt->value) {
+			if (umt->reset) {
+				uwsgi_atomic_store(*metric->value, umt->reset_value);
+			}
+
+			if (umt->alarm) {
+				if (umt->last_alarm + umt->rate <= now) {
+					if (umt->msg) {
+						uwsgi_alarm_trigger(umt->alarm, umt->msg, umt->msg_len);
+					}
+					else {
+						uwsgi_alarm_trigger(umt->alarm, metric->name, metric->name_len);
+					}
+					umt->last_alarm = now;
+				}
+			}
+		}
+		umt = umt->next;
+	}
+}
+
+static void uwsgi_metrics_bucket_collect(struct uwsgi_metrics_bucket *umb, time_t now) {
+	uint64_t i;
+	// collectors only read shared memory (or other metrics), run them out of the lock
+	for(i=0;i<umb->count;i++) {
+		struct uwsgi_metric *metric = umb->metrics[i];
+		if (metric->collector) {
+			umb->values[i] = metric->initial_value + metric->collector->func(metric);
+		}
+	}
+
+	// publish the whole batch at once
+	uwsgi_wlock(uwsgi.metrics_lock);
+	for(i=0;i<umb->count;i++) {
+		struct uwsgi_metric *metric = umb->metrics[i];
+		if (metric->collector) {
+			uwsgi_atomic_store(*metric->value, umb->values[i]);
+		}
+		else {
+			umb->values[i] = uwsgi_atomic_load(*metric->value);
+		}
+	}
+	uwsgi_rwunlock(uwsgi.metrics_lock);
+
+	for(i=0;i<umb->count;i++) {
+		struct uwsgi_metric *metric = umb->metrics[i];
+		int64_t new_value = umb->values[i];
+		metric->last_update = now;
+		if (metric->map) {
+			// the file is rewritten only when the value changes
+			if (strtoll(metric->map, NULL, 10) != new_value) {
+				int ret = snprintf(metric->map, uwsgi.page_size, "%lld\n", (long long) new_value);
+				if (ret > 0 && ret < uwsgi.page_size) {
+					memset(metric->map+ret, 0, uwsgi.page_size-ret);
+				}
+			}
+		}
+		uwsgi_metric_check_thresholds(metric, new_value, now);
+	}
+
+	umb->next_run = now + umb->freq;
+}
+
 static void *uwsgi_metrics_loop(void *arg) {
 
 	// block signals on this thread
@@ -447,65 +565,25 @@ static void *uwsgi_metrics_loop(void *arg) {
 #endif
         pthread_sigmask(SIG_BLOCK, &smask, NULL);
 
+	struct uwsgi_metrics_bucket *buckets = uwsgi_metrics_buckets_build(uwsgi_now());
+	if (!buckets) return NULL;
+
 	for(;;) {
-		struct uwsgi_metric *metric = uwsgi.metrics;
-		// every second scan the whole metrics tree
 		time_t now = uwsgi_now();
-		while(metric) {
-			if (!metric->last_update) {
-				metric->last_update = now;
-			}
-			else {
-				if ((uint32_t) (now - metric->last_update) < metric->freq) goto next;
-			}
-			uwsgi_wlock(uwsgi.metrics_lock);
-			int64_t value = *metric->value;
-			// gather the new value based on the type of collection strategy
-			if (metric->collector) {
-				*metric->value = metric->initial_value + metric->collector->func(metric);
-			}
-			int64_t new_value = *metric->value;
-			uwsgi_rwunlock(uwsgi.metrics_lock);
-
-			metric->last_update = now;
-
-			if (uwsgi.metrics_dir && metric->map) {
-				if (value != new_value) {
-					int ret = snprintf(metric->map, uwsgi.page_size, "%lld\n", (long long) new_value);
-					if (ret > 0 && ret < uwsgi.page_size) {
-						memset(metric->map+ret, 0, 4096-ret);
-					}
-				}
-			}
-
-			// thresholds;
-			struct uwsgi_metric_threshold *umt = metric->thresholds;
-			while(umt) {
-				if (new_value >= umt->value) {
-					if (umt->reset) {
-						uwsgi_wlock(uwsgi.metrics_lock);
-						*metric->value = umt->reset_value;
-						uwsgi_rwunlock(uwsgi.metrics_lock);
-					}
-
-					if (umt->alarm) {
-						if (umt->last_alarm + umt->rate <= now) {
-							if (umt->msg) {
-								uwsgi_alarm_trigger(umt->alarm, umt->msg, umt->msg_len);
-							}
-							else {
-								uwsgi_alarm_trigger(umt->alarm, metric->name, metric->name_len);
-							}
-							umt->last_alarm = now;
-						}
-					}
-				}
-				umt = umt->next;
+		time_t next_run = 0;
+		struct uwsgi_metrics_bucket *umb = buckets;
+		while(umb) {
+			if (umb->next_run <= now) {
+				uwsgi_metrics_bucket_collect(umb, now);
 			}
-next:
-			metric = metric->next;
+			if (!next_run || umb->next_run < next_run) next_run = umb->next_run;
+			umb = umb->next;
+		}
+		// sleep until the next batch is due
+		now = uwsgi_now();
+		if (next_run > now) {
+			sleep(next_run - now);
 		}
-		sleep(1);
 	}
 
 	return NULL;
@@ -610,6 +688,11 @@ struct uwsgi_metric *uwsgi_metric_find_by_asn(char *asn, size_t len) {
 
 */
 
+/*
+	values live in shared memory and are updated with atomic ops,
+	the metrics_lock is only used by the collector thread to publish
+	consistent batches (and by the readers needing a consistent view)
+*/
 #define um_op struct uwsgi_metric *um = NULL;\
 	if (!uwsgi.has_metrics) return -1;\
 	if (name) {\
@@ -619,34 +702,35 @@ struct uwsgi_metric *uwsgi_metric_find_by_asn(char *asn, size_t len) {
                 um = uwsgi_metric_find_by_oid(oid);\
         }\
         if (!um) return -1;\
-	if (um->collector || um->type == UWSGI_METRIC_ALIAS) return -1;\
-	uwsgi_wlock(uwsgi.metrics_lock)
+	if (um->collector || um->type == UWSGI_METRIC_ALIAS) return -1;
+
+// compare and swap loop for operations without a native atomic
+#define um_cas_op(expr) int64_t old_value = uwsgi_atomic_load(*um->value), new_value;\
+	do {\
+		new_value = (expr);\
+	} while(!uwsgi_atomic_cas(*um->value, &old_value, new_value));
 
 int uwsgi_metric_set(char *name, char *oid, int64_t value) {
 	um_op;
-	*um->value = value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	uwsgi_atomic_store(*um->value, value);
 	return 0;
 }
 
 int uwsgi_metric_inc(char *name, char *oid, int64_t value) {
         um_op;
-	*um->value += value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	uwsgi_atomic_add(*um->value, value);
 	return 0;
 }
 
 int uwsgi_metric_dec(char *name, char *oid, int64_t value) {
         um_op;
-	*um->value -= value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	uwsgi_atomic_sub(*um->value, value);
 	return 0;
 }
 
 int uwsgi_metric_mul(char *name, char *oid, int64_t value) {
         um_op;
-	*um->value *= value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	um_cas_op(old_value * value);
 	return 0;
 }
 
@@ -654,14 +738,12 @@ int uwsgi_metric_div(char *name, char *oid, int64_t value) {
 	// avoid division by zero
 	if (value == 0) return -1;
         um_op;
-	*um->value /= value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	um_cas_op(old_value / value);
 	return 0;
 }
 
 int64_t uwsgi_metric_get(char *name, char *oid) {
 	if (!uwsgi.has_metrics) return 0;
-	int64_t ret = 0;
 	struct uwsgi_metric *um = NULL;
 	if (name) {
 		um = uwsgi_metric_find_by_name(name);
@@ -671,18 +753,11 @@ int64_t uwsgi_metric_get(char *name, char *oid) {
 	}
 	if (!um) return 0;
 
-	// now (in rlocked context) we get the value from
-	// the map
-	uwsgi_rlock(uwsgi.metrics_lock);
-	ret = *um->value;
-	// unlock
-	uwsgi_rwunlock(uwsgi.metrics_lock);
-	return ret;
+	return uwsgi_atomic_load(*um->value);
 }
 
 int64_t uwsgi_metric_getn(char *name, size_t nlen, char *oid, size_t olen) {
         if (!uwsgi.has_metrics) return 0;
-        int64_t ret = 0;
         struct uwsgi_metric *um = NULL;
         if (name) {
                 um = uwsgi_metric_find_by_namen(name, nlen);
@@ -692,28 +767,18 @@ int64_t uwsgi_metric_getn(char *name, size_t nlen, char *oid, size_t olen) {
         }
         if (!um) return 0;
 
-        // now (in rlocked context) we get the value from
-        // the map
-        uwsgi_rlock(uwsgi.metrics_lock);
-        ret = *um->value;
-        // unlock
-        uwsgi_rwunlock(uwsgi.metrics_lock);
-        return ret;
+        return uwsgi_atomic_load(*um->value);
 }
 
 int uwsgi_metric_set_max(char *name, char *oid, int64_t value) {
 	um_op;
-    if (value > *um->value)
-        *um->value = value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	um_cas_op(value > old_value ? value : old_value);
 	return 0;
 }
 
 int uwsgi_metric_set_min(char *name, char *oid, int64_t value) {
 	um_op;
-    if ((value > um->initial_value || 0) && value < *um->value)
-        *um->value = value;
-	uwsgi_rwunlock(uwsgi.metrics_lock);
+	um_cas_op((value > um->initial_value || 0) && value < old_value ? value : old_value);
 	return 0;
 }
 
@@ -750,6 +815,7 @@ void uwsgi_setup_metrics() {
 	uwsgi_register_metric("core.busy_workers", "5.3", UWSGI_METRIC_GAUGE, "ptr", &uwsgi.shared->busy_workers, 0, NULL);
 	uwsgi_register_metric("core.idle_workers", "5.4", UWSGI_METRIC_GAUGE, "ptr", &uwsgi.shared->idle_workers, 0, NULL);
 	uwsgi_register_metric("core.overloaded", "5.5", UWSGI_METRIC_COUNTER, "ptr", &uwsgi.shared->overloaded, 0, NULL);
+	uwsgi_register_metric("core.coalesced_signals", "5.6", UWSGI_METRIC_COUNTER, "ptr", &uwsgi.shared->coalesced_signals, 0, NULL);
 
 	// parents are appended only at the end
 	struct uwsgi_metric *total_tx = uwsgi_register_metric_do("core.total_tx", "5.100", UWSGI_METRIC_COUNTER, "sum", NULL, 0, NULL, 1);
@@ -838,6 +904,11 @@ void uwsgi_setup_metrics() {
 		uwsgi_sock = uwsgi_sock->next;
 	}
 
+	// latency/size percentiles
+	if (uwsgi.histograms) {
+		uwsgi_histograms_register_metrics();
+	}
+
 	// create aliases
 	uwsgi_register_metric("rss_size", NULL, UWSGI_METRIC_ALIAS, NULL, total_rss, 0, NULL);
 	uwsgi_register_metric("vsz_size", NULL, UWSGI_METRIC_ALIAS, NULL, total_vsz, 0, NULL);
@@ -1078,4 +1149,5 @@ void uwsgi_metrics_collectors_setup() {
 	uwsgi_register_metric_collector("multiplier", uwsgi_metric_collector_multiplier);
 	uwsgi_register_metric_collector("avg", uwsgi_metric_collector_avg);
 	uwsgi_register_metric_collector("func", uwsgi_metric_collector_func);
+	uwsgi_register_metric_collector("histogram", uwsgi_metric_collector_histogram);
 }
@@ -11,8 +11,9 @@ By default they born in signal-only mode, but if you patch them (passing the scr
 extern struct uwsgi_server uwsgi;
 
 void uwsgi_mule_handler(void);
+int farm_has_msg(int);
 
-void mule_send_msg(int fd, char *message, size_t len) {
+static void mule_send_msg_fd(int fd, char *message, size_t len) {
 
 	socklen_t so_bufsize_len = sizeof(int);
 	int so_bufsize = 0;
@@ -30,10 +31,204 @@ void mule_send_msg(int fd, char *message, size_t len) {
 	}
 }
 
+static struct uwsgi_mule_ring *uwsgi_mule_ring_new(char *name, int wake_fd) {
+	struct uwsgi_mule_ring *umr = uwsgi_calloc_shared(sizeof(struct uwsgi_mule_ring) + uwsgi.mule_msg_ring);
+	umr->ring.magic = UWSGI_QUEUE_RING_MAGIC;
+	umr->ring.size = uwsgi.mule_msg_ring;
+	umr->data = ((char *) umr) + sizeof(struct uwsgi_mule_ring);
+	umr->name = uwsgi_str(name);
+	umr->wake_fd = wake_fd;
+	return umr;
+}
+
+// the ring of the queue socketpair (sender side) fd
+static struct uwsgi_mule_ring *uwsgi_mule_ring_by_fd(int fd) {
+	int i;
+	if (fd == uwsgi.shared->mule_queue_pipe[0])
+		return uwsgi.mules_msg_ring;
+	for (i = 0; i < uwsgi.mules_cnt; i++) {
+		if (fd == uwsgi.mules[i].queue_pipe[0])
+			return uwsgi.mules[i].msg_ring;
+	}
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
+		if (fd == uwsgi.farms[i].queue_pipe[0])
+			return uwsgi.farms[i].msg_ring;
+	}
+	return NULL;
+}
+
+static void uwsgi_mule_ring_push(struct uwsgi_mule_ring *umr, char *message, size_t len) {
+	struct uwsgi_ring_slot slot;
+	uint64_t deadline = 0;
+
+	while (!uwsgi_ring_reserve(&umr->ring, umr->data, len + 8, &slot)) {
+		uint64_t now = uwsgi_micros();
+		// --mule-msg-ring-block: wait for room up to the specified seconds
+		if (uwsgi.mule_msg_ring_block <= 0 || len + 8 + 16 > umr->ring.size)
+			goto drop;
+		if (!deadline) {
+			deadline = now + (uwsgi.mule_msg_ring_block * 1000000ULL);
+			uwsgi_atomic_add(umr->blocked, 1);
+		}
+		else if (now >= deadline) {
+			goto drop;
+		}
+		uint32_t seq = uwsgi_atomic_load(umr->ring.futex);
+		uwsgi_atomic_add(umr->ring.waiters, 1);
+		uwsgi_atomic_fence();
+		if (uwsgi_ring_reserve(&umr->ring, umr->data, len + 8, &slot)) {
+			uwsgi_atomic_sub(umr->ring.waiters, 1);
+			break;
+		}
+		uwsgi_futex_wait(&umr->ring.futex, seq, ((deadline - now) / 1000) + 1);
+		uwsgi_atomic_sub(umr->ring.waiters, 1);
+	}
+
+	uint64_t now = uwsgi_micros();
+	memcpy(slot.data, &now, 8);
+	memcpy(slot.data + 8, message, len);
+	// a stalled sender before us, the message is lost
+	if (!uwsgi_ring_publish(&umr->ring, umr->data, &slot))
+		goto drop;
+	uwsgi_atomic_add(umr->pushed, 1);
+
+	// wake up the sleeping mules (a full socket means they are already awake)
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(umr->sleeping)) {
+		if (write(umr->wake_fd, "", 1) < 0 && !uwsgi_is_again()) {
+			uwsgi_error("uwsgi_mule_ring_push()/write()");
+		}
+	}
+	return;
+
+drop:
+	// log only the first drops of a burst, the stats server reports all of them
+	if ((uwsgi_atomic_add(umr->dropped, 1) & 1023) == 0) {
+		uwsgi_log("*** MULE MSG RING %s IS FULL: %llu messages dropped (you can tune it with --mule-msg-ring) ***\n", umr->name, (unsigned long long) uwsgi_atomic_load(umr->dropped));
+	}
+}
+
+static void mule_send_msg_to(int fd, char *message, size_t len) {
+	struct uwsgi_mule_ring *umr = uwsgi.mule_msg_ring ? uwsgi_mule_ring_by_fd(fd) : NULL;
+	if (umr) {
+		uwsgi_mule_ring_push(umr, message, len);
+		return;
+	}
+	mule_send_msg_fd(fd, message, len);
+}
+
+void mule_send_msg(int fd, char *message, size_t len) {
+	int i;
+	// farms in fan-out mode send a copy to each of their mules
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
+		if (uwsgi.farms[i].fanout && fd == uwsgi.farms[i].queue_pipe[0]) {
+			struct uwsgi_mule_farm *umf = uwsgi.farms[i].mules;
+			while (umf) {
+				mule_send_msg_to(umf->mule->queue_pipe[0], message, len);
+				umf = umf->next;
+			}
+			return;
+		}
+	}
+	mule_send_msg_to(fd, message, len);
+}
+
+static ssize_t uwsgi_mule_ring_pull(struct uwsgi_mule_ring *umr, char *message, size_t buffer_size) {
+	struct uwsgi_ring_slot slot;
+	if (!umr || !uwsgi_ring_consume(&umr->ring, umr->data, &slot))
+		return -1;
+
+	uint64_t ts;
+	memcpy(&ts, slot.data, 8);
+	size_t len = slot.len - 8;
+	// like a datagram, the message is truncated to the buffer size
+	if (len > buffer_size)
+		len = buffer_size;
+	memcpy(message, slot.data + 8, len);
+	uwsgi_ring_release(&umr->ring, umr->data, &slot);
+
+	uint64_t now = uwsgi_micros();
+	uwsgi_histogram_add(&umr->latency, now > ts ? now - ts : 0, 1);
+	uwsgi_atomic_add(umr->pulled, 1);
+
+	// senders waiting for room
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(umr->ring.waiters)) {
+		uwsgi_atomic_add(umr->ring.futex, 1);
+		uwsgi_futex_wake(&umr->ring.futex, INT_MAX);
+	}
+	return len;
+}
+
+/*
+	get the next message (without waiting) from the rings the current mule consumes:
+	its own one, the ones of its farms and the shared one. Returns -1 if they are all empty.
+*/
+ssize_t uwsgi_mule_ring_get(int sources, char *message, size_t buffer_size) {
+	ssize_t len;
+	int i;
+
+	if (!uwsgi.mule_msg_ring || uwsgi.muleid <= 0)
+		return -1;
+
+	if (sources & UWSGI_MULE_MSG_OWN) {
+		len = uwsgi_mule_ring_pull(uwsgi.mules[uwsgi.muleid - 1].msg_ring, message, buffer_size);
+		if (len >= 0)
+			return len;
+	}
+
+	if (sources & UWSGI_MULE_MSG_FARMS) {
+		for (i = 0; i < uwsgi.farms_cnt; i++) {
+			if (!uwsgi_farm_has_mule(&uwsgi.farms[i], uwsgi.muleid))
+				continue;
+			len = uwsgi_mule_ring_pull(uwsgi.farms[i].msg_ring, message, buffer_size);
+			if (len >= 0)
+				return len;
+		}
+	}
+
+	if (sources & UWSGI_MULE_MSG_SHARED) {
+		return uwsgi_mule_ring_pull(uwsgi.mules_msg_ring, message, buffer_size);
+	}
+
+	return -1;
+}
+
+// announce (delta 1) or retire (delta -1) the current mule as sleeping on its rings
+void uwsgi_mule_ring_sleeping(int sources, int delta) {
+	int i;
+
+	if (!uwsgi.mule_msg_ring || uwsgi.muleid <= 0)
+		return;
+
+	if (sources & UWSGI_MULE_MSG_OWN) {
+		uwsgi_atomic_add(uwsgi.mules[uwsgi.muleid - 1].msg_ring->sleeping, delta);
+	}
+	if (sources & UWSGI_MULE_MSG_FARMS) {
+		for (i = 0; i < uwsgi.farms_cnt; i++) {
+			if (uwsgi_farm_has_mule(&uwsgi.farms[i], uwsgi.muleid))
+				uwsgi_atomic_add(uwsgi.farms[i].msg_ring->sleeping, delta);
+		}
+	}
+	if (sources & UWSGI_MULE_MSG_SHARED) {
+		uwsgi_atomic_add(uwsgi.mules_msg_ring->sleeping, delta);
+	}
+	uwsgi_atomic_fence();
+}
+
+// consume the wakeup bytes of a queue socket
+void uwsgi_mule_ring_drain(int fd) {
+	char buf[64];
+	while (read(fd, buf, 64) > 0);
+}
+
 void uwsgi_mule(int id) {
 
 	int i;
 
+	// the previous mule could have left signals behind
+	uwsgi_signal_kick_all();
+
 	pid_t pid = uwsgi_fork(uwsgi.mules[id - 1].name);
 	if (pid == 0) {
 #ifdef __linux__
@@ -62,6 +257,8 @@ void uwsgi_mule(int id) {
 
 		uwsgi.my_signal_socket = uwsgi.mules[id - 1].signal_pipe[1];
 		uwsgi.signal_socket = uwsgi.shared->mule_signal_pipe[1];
+		uwsgi.my_signal_bitmap = &uwsgi.mules[id - 1].signals_pending;
+		uwsgi.signal_bitmap = &uwsgi.shared->mule_signals;
 
 		uwsgi_close_all_sockets();
 
@@ -77,6 +274,8 @@ void uwsgi_mule(int id) {
 			}
 		}
 
+		uwsgi_rpc_mule_recover();
+
 		uwsgi_hooks_run(uwsgi.hook_as_mule, "as-mule", 1);
 		uwsgi_mule_run();
 
@@ -119,6 +318,16 @@ int uwsgi_farm_has_mule(struct uwsgi_farm *farm, int muleid) {
 	return 0;
 }
 
+// the copies of the messages of a fan-out farm are sent to the own queue of its mules
+int uwsgi_mule_in_fanout_farm(int muleid) {
+	int i;
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
+		if (uwsgi.farms[i].fanout && uwsgi_farm_has_mule(&uwsgi.farms[i], muleid))
+			return 1;
+	}
+	return 0;
+}
+
 int farm_has_signaled(int fd) {
 
 	int i;
@@ -163,6 +372,18 @@ void uwsgi_mule_add_farm_to_queue(int queue) {
 	}
 }
 
+static void uwsgi_mule_dispatch_msg(char *message, ssize_t len) {
+	int i;
+	for (i = 0; i < 256; i++) {
+		if (uwsgi.p[i]->mule_msg) {
+			if (uwsgi.p[i]->mule_msg(message, len)) {
+				return;
+			}
+		}
+	}
+	uwsgi_log("*** mule %d received a %ld bytes message ***\n", uwsgi.muleid, (long) len);
+}
+
 void uwsgi_mule_handler() {
 
 	ssize_t len;
@@ -182,27 +403,66 @@ void uwsgi_mule_handler() {
 
 	uwsgi_mule_add_farm_to_queue(mule_queue);
 
+	int rpc_fd = uwsgi_rpc_mule_fd();
+	if (rpc_fd > -1) {
+		event_queue_add_fd_read(mule_queue, rpc_fd);
+	}
+
+	int ring_sources = UWSGI_MULE_MSG_SHARED | UWSGI_MULE_MSG_OWN | UWSGI_MULE_MSG_FARMS;
+
 	for (;;) {
-		rlen = event_queue_wait(mule_queue, -1, &interesting_fd);
+		int timeout = -1;
+		int sleeping = 0;
+		if (uwsgi.mule_msg_ring) {
+			// dispatch a batch of messages, then give signals a chance
+			int batch = 0;
+			while (batch < 64 && (len = uwsgi_mule_ring_get(ring_sources, message, 65536)) >= 0) {
+				uwsgi_mule_dispatch_msg(message, len);
+				batch++;
+			}
+			if (batch == 64) {
+				timeout = 0;
+			}
+			else {
+				uwsgi_mule_ring_sleeping(ring_sources, 1);
+				sleeping = 1;
+				// a message could have been pushed before we announced the sleep
+				len = uwsgi_mule_ring_get(ring_sources, message, 65536);
+				if (len >= 0) {
+					uwsgi_mule_ring_sleeping(ring_sources, -1);
+					sleeping = 0;
+					uwsgi_mule_dispatch_msg(message, len);
+					timeout = 0;
+				}
+			}
+		}
+
+		rlen = event_queue_wait(mule_queue, timeout, &interesting_fd);
+		if (sleeping) {
+			uwsgi_mule_ring_sleeping(ring_sources, -1);
+		}
 		if (rlen <= 0) {
 			continue;
 		}
 
-		if (interesting_fd == uwsgi.signal_socket || interesting_fd == uwsgi.my_signal_socket || farm_has_signaled(interesting_fd)) {
+		if (rpc_fd > -1 && interesting_fd == rpc_fd) {
+			uwsgi_rpc_mule_serve();
+		}
+		else if (interesting_fd == uwsgi.signal_socket || interesting_fd == uwsgi.my_signal_socket || farm_has_signaled(interesting_fd)) {
 			len = read(interesting_fd, &uwsgi_signal, 1);
 			if (len <= 0) {
 				if (len < 0 && (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)) continue;
 				uwsgi_log_verbose("uWSGI mule %d braying: my master died, i will follow him...\n", uwsgi.muleid);
 				end_me(0);
 			}
-#ifdef UWSGI_DEBUG
-			uwsgi_log_verbose("master sent signal %d to mule %d\n", uwsgi_signal, uwsgi.muleid);
-#endif
-			if (uwsgi_signal_handler(NULL, uwsgi_signal)) {
-				uwsgi_log_verbose("error managing signal %d on mule %d\n", uwsgi_signal, uwsgi.muleid);
-			}
+			uwsgi_signal_dispatch(NULL, interesting_fd, "mule", uwsgi.muleid, -1);
 		}
 		else if (interesting_fd == uwsgi.mules[uwsgi.muleid - 1].queue_pipe[1] || interesting_fd == uwsgi.shared->mule_queue_pipe[1] || farm_has_msg(interesting_fd)) {
+			// only wakeups, the messages are in the rings
+			if (uwsgi.mule_msg_ring) {
+				uwsgi_mule_ring_drain(interesting_fd);
+				continue;
+			}
 			len = read(interesting_fd, message, 65536);
 			if (len < 0) {
 				if (errno != EAGAIN && errno != EINTR && errno != EWOULDBLOCK) {
@@ -210,17 +470,7 @@ void uwsgi_mule_handler() {
 				}
 			}
 			else {
-				int i, found = 0;
-				for (i = 0; i < 256; i++) {
-					if (uwsgi.p[i]->mule_msg) {
-						if (uwsgi.p[i]->mule_msg(message, len)) {
-							found = 1;
-							break;
-						}
-					}
-				}
-				if (!found)
-					uwsgi_log("*** mule %d received a %ld bytes message ***\n", uwsgi.muleid, (long) len);
+				uwsgi_mule_dispatch_msg(message, len);
 			}
 		}
 	}
@@ -305,7 +555,8 @@ next:
 	if (timeout > -1)
 		timeout = timeout * 1000;
 
-	mulepoll = uwsgi_malloc(sizeof(struct pollfd) * (count + farms_count));
+	// the last slot is the doorbell of the rpc channel (ignored by poll() when -1)
+	mulepoll = uwsgi_malloc(sizeof(struct pollfd) * (count + farms_count + 1));
 
 	mulepoll[0].fd = uwsgi.mules[uwsgi.muleid - 1].queue_pipe[1];
 	mulepoll[0].events = POLLIN;
@@ -329,13 +580,60 @@ next:
 		}
 	}
 
+	mulepoll[count + farms_count].fd = uwsgi_rpc_mule_fd();
+	mulepoll[count + farms_count].events = POLLIN;
+
+	int ring_sources = UWSGI_MULE_MSG_SHARED | UWSGI_MULE_MSG_OWN | (farms_count > 0 ? UWSGI_MULE_MSG_FARMS : 0);
+
 	int ret = -1;
 retry:
-	ret = poll(mulepoll, count + farms_count, timeout);
+	if (uwsgi.mule_msg_ring) {
+		len = uwsgi_mule_ring_get(ring_sources, message, buffer_size);
+		if (len < 0) {
+			uwsgi_mule_ring_sleeping(ring_sources, 1);
+			// a message could have been pushed before we announced the sleep
+			len = uwsgi_mule_ring_get(ring_sources, message, buffer_size);
+			if (len >= 0)
+				uwsgi_mule_ring_sleeping(ring_sources, -1);
+		}
+		if (len >= 0)
+			goto clear;
+		len = 0;
+	}
+	ret = poll(mulepoll, count + farms_count + 1, timeout);
+	if (uwsgi.mule_msg_ring) {
+		uwsgi_mule_ring_sleeping(ring_sources, -1);
+	}
 	if (ret < 0) {
+		// in ring mode the sockets only carry wakeups, never read them as messages
+		if (uwsgi.mule_msg_ring) {
+			if (errno == EINTR) goto retry;
+			uwsgi_error("uwsgi_mule_get_msg()/poll()");
+			len = -1;
+			goto clear;
+		}
 		uwsgi_error("uwsgi_mule_get_msg()/poll()");
 	}
 	else if (ret > 0 ) {
+		int handled = 0;
+		if (mulepoll[count + farms_count].revents & POLLIN) {
+			uwsgi_rpc_mule_serve();
+			handled++;
+		}
+		// the queue sockets only carry wakeups, the messages are in the rings
+		if (uwsgi.mule_msg_ring) {
+			for (i = 0; i < count + farms_count; i++) {
+				// skip the signal sockets
+				if (i >= 2 && i < count)
+					continue;
+				if (mulepoll[i].revents & POLLIN) {
+					uwsgi_mule_ring_drain(mulepoll[i].fd);
+					mulepoll[i].revents = 0;
+					handled++;
+				}
+			}
+		}
+		if (handled == ret) goto retry;
 		if (mulepoll[0].revents & POLLIN) {
 			len = read(uwsgi.mules[uwsgi.muleid - 1].queue_pipe[1], message, buffer_size);
 		}
@@ -359,12 +657,7 @@ retry:
 						uwsgi_log_verbose("uWSGI mule %d braying: my master died, i will follow him...\n", uwsgi.muleid);
 						end_me(0);
 					}
-#ifdef UWSGI_DEBUG
-					uwsgi_log_verbose("master sent signal %d to mule %d\n", uwsgi_signal, uwsgi.muleid);
-#endif
-					if (uwsgi_signal_handler(NULL, uwsgi_signal)) {
-						uwsgi_log_verbose("error managing signal %d on mule %d\n", uwsgi_signal, uwsgi.muleid);
-					}
+					uwsgi_signal_dispatch(NULL, interesting_fd, "mule", uwsgi.muleid, -1);
 					// set the error condition
 					len = -1;
 					goto clear;
@@ -416,6 +709,9 @@ void uwsgi_opt_add_farm(char *opt, char *value, void *foobar) {
 
 void uwsgi_setup_mules_and_farms() {
 	int i;
+	// ring records are 16 bytes aligned
+	uwsgi.mule_msg_ring = (uwsgi.mule_msg_ring + 15) & ~15ULL;
+
 	if (uwsgi.mules_cnt > 0) {
 		uwsgi.mules = (struct uwsgi_mule *) uwsgi_calloc_shared(sizeof(struct uwsgi_mule) * uwsgi.mules_cnt);
 
@@ -430,6 +726,15 @@ void uwsgi_setup_mules_and_farms() {
 			uwsgi.mules[i].id = i + 1;
 
 			snprintf(uwsgi.mules[i].name, 0xff, "uWSGI mule %d", i + 1);
+
+			if (uwsgi.mule_msg_ring) {
+				uwsgi.mules[i].msg_ring = uwsgi_mule_ring_new(uwsgi.mules[i].name, uwsgi.mules[i].queue_pipe[0]);
+			}
+		}
+
+		if (uwsgi.mule_msg_ring) {
+			uwsgi.mules_msg_ring = uwsgi_mule_ring_new("mules", uwsgi.shared->mule_queue_pipe[0]);
+			uwsgi_log("mule messages rings enabled (%llu bytes each)\n", (unsigned long long) uwsgi.mule_msg_ring);
 		}
 	}
 
@@ -467,7 +772,13 @@ void uwsgi_setup_mules_and_farms() {
 
 				uwsgi_mule_farm_new(&uwsgi.farms[i].mules, um);
 			}
-			uwsgi_log("created farm %d name: %s mules:%s\n", i + 1, uwsgi.farms[i].name, strchr(farm_name->value, ':') + 1);
+			uwsgi.farms[i].fanout = uwsgi_string_list_has_item(uwsgi.farms_fanout, uwsgi.farms[i].name, strlen(uwsgi.farms[i].name)) ? 1 : 0;
+
+			if (uwsgi.mule_msg_ring) {
+				uwsgi.farms[i].msg_ring = uwsgi_mule_ring_new(uwsgi.farms[i].name, uwsgi.farms[i].queue_pipe[0]);
+			}
+
+			uwsgi_log("created farm %d name: %s mules:%s%s\n", i + 1, uwsgi.farms[i].name, strchr(farm_name->value, ':') + 1, uwsgi.farms[i].fanout ? " (fan-out)" : "");
 
 			farm_name = farm_name->next;
 			free(farm_value);
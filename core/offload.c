@@ -163,6 +163,12 @@ static int u_offload_sendfile_prepare(struct wsgi_request *wsgi_req, struct uwsg
 
 static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
 
+	UWSGI_PROBE3(offload__done, uwsgi.mywid, uor->fd, uor->written);
+
+	if (uor->trace_start) {
+		uwsgi_trace_span_push(&uor->trace, UWSGI_TRACE_SPAN_OFFLOAD, uwsgi_trace_new_id(), uor->trace.span_id, uor->trace_start, uwsgi_micros(), uor->trace_core, uor->status);
+	}
+
 	// call the free function asap
 	if (uor->free) {
 		uor->free(uor);
@@ -601,6 +607,12 @@ int uwsgi_offload_run(struct wsgi_request *wsgi_req, struct uwsgi_offload_reques
 		return -1;
 	}
 
+	if (uwsgi.trace_spans) {
+		memcpy(&uor->trace, uwsgi_trace_request_context(wsgi_req), sizeof(struct uwsgi_trace_context));
+		uor->trace_start = uwsgi_micros();
+		uor->trace_core = wsgi_req->async_id;
+	}
+
 	if (wait) {
                 if (pipe(uor->pipe)) {
                         uwsgi_error("uwsgi_offload_setup()/pipe()");
@@ -612,6 +624,14 @@ int uwsgi_offload_run(struct wsgi_request *wsgi_req, struct uwsgi_offload_reques
         }
 
         if (uor->takeover) {
+		// the offload thread will write to the socket, send the pending response data
+		if (uwsgi_response_flush(wsgi_req)) {
+			if (wait) {
+				close(uor->pipe[0]);
+				close(uor->pipe[1]);
+			}
+			return -1;
+		}
                 wsgi_req->fd_closed = 1;
 		// avoid edge-triggered mode
 		if (wsgi_req->socket->retry)
@@ -627,6 +647,8 @@ int uwsgi_offload_run(struct wsgi_request *wsgi_req, struct uwsgi_offload_reques
 		return -1;
         }
 
+	UWSGI_PROBE3(offload__enqueue, uwsgi.mywid, wsgi_req->async_id, uor->fd);
+
         return 0;
 	
 };
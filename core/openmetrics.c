@@ -0,0 +1,455 @@
+/*
+
+	uWSGI OpenMetrics/Prometheus exporter (--metrics-http)
+
+	the master serves (on a dedicated socket) a text exposition of:
+
+		workers, cores and sockets stats (directly from the shared memory, always available)
+		the metrics subsystem tree (when --enable-metrics is in place)
+		the request histograms (when --histograms is in place)
+
+	clients asking for application/openmetrics-text get the OpenMetrics 1.0 format,
+	the others the Prometheus 0.0.4 text format.
+
+	Generating it is way cheaper than the stats server json.
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+struct uwsgi_openmetrics {
+	struct uwsgi_buffer *ub;
+	int openmetrics;
+};
+
+// counters samples always have the _total suffix, in the prometheus format the family name has it too
+static int uwsgi_openmetrics_family(struct uwsgi_openmetrics *uom, char *name, char *type) {
+	if (uwsgi_buffer_append(uom->ub, "# TYPE ", 7))
+		return -1;
+	if (uwsgi_buffer_append(uom->ub, name, strlen(name)))
+		return -1;
+	if (!uom->openmetrics && !strcmp(type, "counter")) {
+		if (uwsgi_buffer_append(uom->ub, "_total", 6))
+			return -1;
+	}
+	if (uwsgi_buffer_append(uom->ub, " ", 1))
+		return -1;
+	if (uwsgi_buffer_append(uom->ub, type, strlen(type)))
+		return -1;
+	return uwsgi_buffer_append(uom->ub, "\n", 1);
+}
+
+static int uwsgi_openmetrics_label_value(struct uwsgi_buffer *ub, char *value, size_t len) {
+	size_t i;
+	for (i = 0; i < len; i++) {
+		if (value[i] == '\\' || value[i] == '"') {
+			if (uwsgi_buffer_append(ub, "\\", 1))
+				return -1;
+		}
+		else if (value[i] == '\n') {
+			if (uwsgi_buffer_append(ub, "\\n", 2))
+				return -1;
+			continue;
+		}
+		if (uwsgi_buffer_append(ub, value + i, 1))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+	name{labels} value
+
+	labels is an already formatted string (could be NULL), suffix is appended to the name
+*/
+static int uwsgi_openmetrics_sample_start(struct uwsgi_openmetrics *uom, char *name, char *suffix, char *labels) {
+	if (uwsgi_buffer_append(uom->ub, name, strlen(name)))
+		return -1;
+	if (suffix) {
+		if (uwsgi_buffer_append(uom->ub, suffix, strlen(suffix)))
+			return -1;
+	}
+	if (labels && *labels) {
+		if (uwsgi_buffer_append(uom->ub, "{", 1))
+			return -1;
+		if (uwsgi_buffer_append(uom->ub, labels, strlen(labels)))
+			return -1;
+		if (uwsgi_buffer_append(uom->ub, "}", 1))
+			return -1;
+	}
+	return uwsgi_buffer_append(uom->ub, " ", 1);
+}
+
+static int uwsgi_openmetrics_sample(struct uwsgi_openmetrics *uom, char *name, char *suffix, char *labels, int64_t value) {
+	if (uwsgi_openmetrics_sample_start(uom, name, suffix, labels))
+		return -1;
+	if (uwsgi_buffer_num64(uom->ub, value))
+		return -1;
+	return uwsgi_buffer_append(uom->ub, "\n", 1);
+}
+
+// values are stored in microseconds, exported in seconds
+static int uwsgi_openmetrics_sample_micros(struct uwsgi_openmetrics *uom, char *name, char *suffix, char *labels, uint64_t value) {
+	char buf[64];
+	if (uwsgi_openmetrics_sample_start(uom, name, suffix, labels))
+		return -1;
+	int ret = snprintf(buf, 64, "%llu.%06llu\n", (unsigned long long) (value / 1000000), (unsigned long long) (value % 1000000));
+	if (ret <= 0 || ret >= 64)
+		return -1;
+	return uwsgi_buffer_append(uom->ub, buf, ret);
+}
+
+static int uwsgi_openmetrics_counter(struct uwsgi_openmetrics *uom, char *name, char *labels, int64_t value) {
+	return uwsgi_openmetrics_sample(uom, name, "_total", labels, value);
+}
+
+#define uwsgi_om_worker_labels(i) snprintf(labels, sizeof(labels), "worker=\"%d\"", i)
+
+#define uwsgi_om_workers_family(name, type, func, field) \
+	if (uwsgi_openmetrics_family(uom, name, type)) return -1;\
+	for (i = 1; i <= uwsgi.numproc; i++) {\
+		uwsgi_om_worker_labels(i);\
+		if (func(uom, name, labels, uwsgi.workers[i].field)) return -1;\
+	}
+
+#define uwsgi_om_gauge(uom, name, labels, value) uwsgi_openmetrics_sample(uom, name, NULL, labels, value)
+
+#define uwsgi_om_cores_family(name, type, func, field) \
+	if (uwsgi_openmetrics_family(uom, name, type)) return -1;\
+	for (i = 1; i <= uwsgi.numproc; i++) {\
+		for (j = 0; j < uwsgi.cores; j++) {\
+			snprintf(labels, sizeof(labels), "worker=\"%d\",core=\"%d\"", i, j);\
+			if (func(uom, name, labels, uwsgi.workers[i].cores[j].field)) return -1;\
+		}\
+	}
+
+static int uwsgi_openmetrics_sockets(struct uwsgi_openmetrics *uom, char *name, int max) {
+	struct uwsgi_socket *uwsgi_sock;
+	if (uwsgi_openmetrics_family(uom, name, "gauge"))
+		return -1;
+	for (uwsgi_sock = uwsgi.sockets; uwsgi_sock; uwsgi_sock = uwsgi_sock->next) {
+		struct uwsgi_buffer *ub = uwsgi_buffer_new(64);
+		// the trailing zero is included, so the buffer can be used as a string
+		if (uwsgi_buffer_append(ub, "socket=\"", 8) || uwsgi_openmetrics_label_value(ub, uwsgi_sock->name, strlen(uwsgi_sock->name)) || uwsgi_buffer_append(ub, "\"", 2)) {
+			uwsgi_buffer_destroy(ub);
+			return -1;
+		}
+		int ret = uwsgi_om_gauge(uom, name, ub->buf, max ? uwsgi_sock->max_queue : uwsgi_sock->queue);
+		uwsgi_buffer_destroy(ub);
+		if (ret)
+			return -1;
+	}
+	return 0;
+}
+
+static int uwsgi_openmetrics_stats(struct uwsgi_openmetrics *uom) {
+	int i, j;
+	char labels[256];
+
+	uwsgi_om_workers_family("uwsgi_worker_requests", "counter", uwsgi_openmetrics_counter, requests);
+	uwsgi_om_workers_family("uwsgi_worker_failed_requests", "counter", uwsgi_openmetrics_counter, failed_requests);
+	uwsgi_om_workers_family("uwsgi_worker_respawns", "counter", uwsgi_openmetrics_counter, respawn_count);
+	uwsgi_om_workers_family("uwsgi_worker_harakiris", "counter", uwsgi_openmetrics_counter, harakiri_count);
+	uwsgi_om_workers_family("uwsgi_worker_tx_bytes", "counter", uwsgi_openmetrics_counter, tx);
+	uwsgi_om_workers_family("uwsgi_worker_rss_bytes", "gauge", uwsgi_om_gauge, rss_size);
+	uwsgi_om_workers_family("uwsgi_worker_vsz_bytes", "gauge", uwsgi_om_gauge, vsz_size);
+
+	if (uwsgi_openmetrics_family(uom, "uwsgi_worker_request_time_seconds", "counter"))
+		return -1;
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		uwsgi_om_worker_labels(i);
+		if (uwsgi_openmetrics_sample_micros(uom, "uwsgi_worker_request_time_seconds", "_total", labels, uwsgi.workers[i].running_time))
+			return -1;
+	}
+
+	if (uwsgi_openmetrics_family(uom, "uwsgi_worker_avg_response_time_seconds", "gauge"))
+		return -1;
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		uwsgi_om_worker_labels(i);
+		if (uwsgi_openmetrics_sample_micros(uom, "uwsgi_worker_avg_response_time_seconds", NULL, labels, uwsgi.workers[i].avg_response_time))
+			return -1;
+	}
+
+	if (uwsgi_openmetrics_family(uom, "uwsgi_worker_busy", "gauge"))
+		return -1;
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		uwsgi_om_worker_labels(i);
+		if (uwsgi_om_gauge(uom, "uwsgi_worker_busy", labels, uwsgi_worker_is_busy(i)))
+			return -1;
+	}
+
+	if (!uwsgi.stats_no_cores) {
+		uwsgi_om_cores_family("uwsgi_core_requests", "counter", uwsgi_openmetrics_counter, requests);
+		uwsgi_om_cores_family("uwsgi_core_static_requests", "counter", uwsgi_openmetrics_counter, static_requests);
+		uwsgi_om_cores_family("uwsgi_core_routed_requests", "counter", uwsgi_openmetrics_counter, routed_requests);
+		uwsgi_om_cores_family("uwsgi_core_offloaded_requests", "counter", uwsgi_openmetrics_counter, offloaded_requests);
+		uwsgi_om_cores_family("uwsgi_core_write_errors", "counter", uwsgi_openmetrics_counter, write_errors);
+		uwsgi_om_cores_family("uwsgi_core_read_errors", "counter", uwsgi_openmetrics_counter, read_errors);
+		uwsgi_om_cores_family("uwsgi_core_exceptions", "counter", uwsgi_openmetrics_counter, exceptions);
+		uwsgi_om_cores_family("uwsgi_core_in_request", "gauge", uwsgi_om_gauge, in_request);
+	}
+
+	if (uwsgi_openmetrics_sockets(uom, "uwsgi_socket_listen_queue", 0))
+		return -1;
+	return uwsgi_openmetrics_sockets(uom, "uwsgi_socket_max_listen_queue", 1);
+}
+
+/*
+	the metrics tree, the worker.* and socket.* namespaces are already exported
+	(with labels) by uwsgi_openmetrics_stats(), the core.* namespace is mapped to uwsgi_*
+*/
+static int uwsgi_openmetrics_tree(struct uwsgi_openmetrics *uom) {
+	char name[4096];
+	int ret = 0;
+	struct uwsgi_metric_collector *histogram_collector = NULL;
+	struct uwsgi_metric_collector *umc = uwsgi.metric_collectors;
+	while (umc) {
+		if (!strcmp(umc->name, "histogram")) {
+			histogram_collector = umc;
+			break;
+		}
+		umc = umc->next;
+	}
+
+	uwsgi_rlock(uwsgi.metrics_lock);
+	struct uwsgi_metric *um = uwsgi.metrics;
+	while (um) {
+		if (um->type == UWSGI_METRIC_ALIAS)
+			goto next;
+		if (um->collector && um->collector == histogram_collector)
+			goto next;
+		if (!uwsgi_starts_with(um->name, um->name_len, "worker.", 7) || !uwsgi_starts_with(um->name, um->name_len, "socket.", 7))
+			goto next;
+
+		char *mname = um->name;
+		size_t mname_len = um->name_len;
+		if (!uwsgi_starts_with(mname, mname_len, "core.", 5)) {
+			mname += 5;
+			mname_len -= 5;
+		}
+		if (mname_len + 7 > sizeof(name))
+			goto next;
+		memcpy(name, "uwsgi_", 6);
+		size_t i;
+		for (i = 0; i < mname_len; i++) {
+			char c = mname[i];
+			name[6 + i] = (c == '.' || c == '-') ? '_' : c;
+		}
+		name[6 + mname_len] = 0;
+
+		if (um->type == UWSGI_METRIC_COUNTER) {
+			if (uwsgi_openmetrics_family(uom, name, "counter") || uwsgi_openmetrics_counter(uom, name, NULL, *um->value)) {
+				ret = -1;
+				break;
+			}
+		}
+		else {
+			if (uwsgi_openmetrics_family(uom, name, "gauge") || uwsgi_om_gauge(uom, name, NULL, *um->value)) {
+				ret = -1;
+				break;
+			}
+		}
+next:
+		um = um->next;
+	}
+	uwsgi_rwunlock(uwsgi.metrics_lock);
+	return ret;
+}
+
+/*
+	the buckets are exported at the powers of two (the le values are the highest value in the bucket),
+	the set is always the same (across series and scrapes) so they can be aggregated by le
+*/
+static int uwsgi_openmetrics_histogram(struct uwsgi_openmetrics *uom, char *name, char *labels, struct uwsgi_histogram *live, int micros) {
+	struct uwsgi_histogram uh;
+	char buf[512];
+	int k;
+	memset(&uh, 0, sizeof(struct uwsgi_histogram));
+	uwsgi_histogram_merge(&uh, live);
+	uint64_t count = uwsgi_histogram_count(&uh);
+
+	for (k = 0; k < UWSGI_HISTOGRAM_MAX_EXP; k++) {
+		uint64_t value = 1ULL << k;
+		uint64_t below = uwsgi_histogram_count_below(&uh, value);
+		int ret;
+		if (micros) {
+			ret = snprintf(buf, sizeof(buf), "%s%sle=\"%llu.%06llu\"", labels, *labels ? "," : "", (unsigned long long) ((value - 1) / 1000000), (unsigned long long) ((value - 1) % 1000000));
+		}
+		else {
+			ret = snprintf(buf, sizeof(buf), "%s%sle=\"%llu\"", labels, *labels ? "," : "", (unsigned long long) (value - 1));
+		}
+		if (ret <= 0 || ret >= (int) sizeof(buf))
+			return -1;
+		if (uwsgi_openmetrics_sample(uom, name, "_bucket", buf, below))
+			return -1;
+	}
+	int ret = snprintf(buf, sizeof(buf), "%s%sle=\"+Inf\"", labels, *labels ? "," : "");
+	if (ret <= 0 || ret >= (int) sizeof(buf))
+		return -1;
+	if (uwsgi_openmetrics_sample(uom, name, "_bucket", buf, count))
+		return -1;
+	if (uwsgi_openmetrics_sample(uom, name, "_count", labels, count))
+		return -1;
+	if (micros)
+		return uwsgi_openmetrics_sample_micros(uom, name, "_sum", labels, uh.sum);
+	return uwsgi_openmetrics_sample(uom, name, "_sum", labels, uh.sum);
+}
+
+// 0 -> workers, 1 -> apps, 2 -> route labels
+static int uwsgi_openmetrics_histograms_family(struct uwsgi_openmetrics *uom, char *name, int kind, int type) {
+	int i, j;
+	char labels[512];
+	if (uwsgi_openmetrics_family(uom, name, "histogram"))
+		return -1;
+	struct uwsgi_request_histograms *urh = NULL;
+	if (kind == 2) {
+		struct uwsgi_string_list *usl;
+		i = 0;
+		uwsgi_foreach(usl, uwsgi.histograms_labels) {
+			snprintf(labels, sizeof(labels), "route=\"%s\"", usl->value);
+			urh = &uwsgi.histograms_routes[i++];
+			if (uwsgi_openmetrics_histogram(uom, name, labels, type == 0 ? &urh->rt : (type == 1 ? &urh->queue : &urh->size), type < 2))
+				return -1;
+		}
+		return 0;
+	}
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		if (kind == 0) {
+			uwsgi_om_worker_labels(i);
+			urh = &uwsgi.histograms_workers[i];
+			if (uwsgi_openmetrics_histogram(uom, name, labels, type == 0 ? &urh->rt : (type == 1 ? &urh->queue : &urh->size), type < 2))
+				return -1;
+			continue;
+		}
+		for (j = 0; j < uwsgi.workers[i].apps_cnt && j < uwsgi.max_apps; j++) {
+			struct uwsgi_app *ua = &uwsgi.workers[i].apps[j];
+			struct uwsgi_buffer *ub = uwsgi_buffer_new(64);
+			int ret = snprintf(labels, sizeof(labels), "worker=\"%d\",app=\"%d\",mountpoint=\"", i, j);
+			if (uwsgi_buffer_append(ub, labels, ret) || uwsgi_openmetrics_label_value(ub, ua->mountpoint, ua->mountpoint_len) || uwsgi_buffer_append(ub, "\"", 2)) {
+				uwsgi_buffer_destroy(ub);
+				return -1;
+			}
+			urh = &uwsgi.histograms_apps[(i * uwsgi.max_apps) + j];
+			ret = uwsgi_openmetrics_histogram(uom, name, ub->buf, type == 0 ? &urh->rt : (type == 1 ? &urh->queue : &urh->size), type < 2);
+			uwsgi_buffer_destroy(ub);
+			if (ret)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static int uwsgi_openmetrics_histograms(struct uwsgi_openmetrics *uom) {
+	char *names[3][3] = {
+		{"uwsgi_request_duration_seconds", "uwsgi_request_queue_seconds", "uwsgi_response_size_bytes"},
+		{"uwsgi_app_request_duration_seconds", "uwsgi_app_request_queue_seconds", "uwsgi_app_response_size_bytes"},
+		{"uwsgi_route_request_duration_seconds", "uwsgi_route_request_queue_seconds", "uwsgi_route_response_size_bytes"},
+	};
+	int kind, type;
+	for (kind = 0; kind < 3; kind++) {
+		if (kind == 2 && !uwsgi.histograms_routes)
+			break;
+		for (type = 0; type < 3; type++) {
+			if (uwsgi_openmetrics_histograms_family(uom, names[kind][type], kind, type))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+struct uwsgi_buffer *uwsgi_openmetrics_render(int openmetrics) {
+	struct uwsgi_openmetrics uom;
+	uom.ub = uwsgi_buffer_new(uwsgi.page_size * 4);
+	uom.openmetrics = openmetrics;
+
+	if (uwsgi_openmetrics_stats(&uom))
+		goto error;
+	if (uwsgi.has_metrics && uwsgi.metrics_lock) {
+		if (uwsgi_openmetrics_tree(&uom))
+			goto error;
+	}
+	if (uwsgi.histograms) {
+		if (uwsgi_openmetrics_histograms(&uom))
+			goto error;
+	}
+	if (openmetrics) {
+		if (uwsgi_buffer_append(uom.ub, "# EOF\n", 6))
+			goto error;
+	}
+	return uom.ub;
+error:
+	uwsgi_buffer_destroy(uom.ub);
+	return NULL;
+}
+
+void uwsgi_openmetrics_bind() {
+	char *tcp_port = strrchr(uwsgi.metrics_http, ':');
+	if (tcp_port) {
+		int current_defer_accept = uwsgi.no_defer_accept;
+		uwsgi.no_defer_accept = 1;
+		uwsgi.metrics_http_fd = bind_to_tcp(uwsgi.metrics_http, uwsgi.listen_queue, tcp_port);
+		uwsgi.no_defer_accept = current_defer_accept;
+	}
+	else {
+		uwsgi.metrics_http_fd = bind_to_unix(uwsgi.metrics_http, uwsgi.listen_queue, uwsgi.chmod_socket, uwsgi.abstract_socket);
+	}
+	event_queue_add_fd_read(uwsgi.master_queue, uwsgi.metrics_http_fd);
+	uwsgi_log("*** OpenMetrics exporter enabled on %s fd: %d ***\n", uwsgi.metrics_http, uwsgi.metrics_http_fd);
+}
+
+// serve a scrape (called by the master)
+void uwsgi_openmetrics_send(int fd) {
+	char buf[4096];
+	struct sockaddr_un client_src;
+	socklen_t client_src_len = 0;
+
+	int client_fd = accept(fd, (struct sockaddr *) &client_src, &client_src_len);
+	if (client_fd < 0) {
+		uwsgi_error("uwsgi_openmetrics_send()/accept()");
+		return;
+	}
+
+	if (uwsgi_waitfd(client_fd, uwsgi.socket_timeout) <= 0)
+		goto end;
+	ssize_t rlen = read(client_fd, buf, sizeof(buf) - 1);
+	if (rlen <= 0)
+		goto end;
+	buf[rlen] = 0;
+
+	// the request is not parsed, only the Accept header is checked
+	int openmetrics = strstr(buf, "application/openmetrics-text") != NULL;
+
+	struct uwsgi_buffer *body = uwsgi_openmetrics_render(openmetrics);
+	if (!body)
+		goto end;
+
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(256);
+	if (uwsgi_buffer_append(ub, "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: ", 50))
+		goto end2;
+	if (openmetrics) {
+		if (uwsgi_buffer_append(ub, "application/openmetrics-text; version=1.0.0; charset=utf-8\r\n", 60))
+			goto end2;
+	}
+	else {
+		if (uwsgi_buffer_append(ub, "text/plain; version=0.0.4; charset=utf-8\r\n", 42))
+			goto end2;
+	}
+	if (uwsgi_buffer_append(ub, "Content-Length: ", 16))
+		goto end2;
+	if (uwsgi_buffer_num64(ub, body->pos))
+		goto end2;
+	if (uwsgi_buffer_append(ub, "\r\n\r\n", 4))
+		goto end2;
+
+	if (uwsgi_buffer_send(ub, client_fd))
+		goto end2;
+	uwsgi_buffer_send(body, client_fd);
+
+end2:
+	uwsgi_buffer_destroy(ub);
+	uwsgi_buffer_destroy(body);
+end:
+	close(client_fd);
+}
@@ -588,6 +588,12 @@ int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 	if (wsgi_req->parsed)
 		return 0;
 
+	if (uwsgi.trace_spans) {
+		wsgi_req->trace_parse_start = uwsgi_micros();
+	}
+
+	UWSGI_PROBE2(request__parse__start, uwsgi.mywid, wsgi_req->async_id);
+
 	// has the protocol already parsed the request ?
 	if (wsgi_req->uri_len > 0) {
 		wsgi_req->parsed = 1;
@@ -894,6 +900,12 @@ nextsm2:
 		free(real_docroot);
 	}
 
+	if (uwsgi.trace_spans) {
+		wsgi_req->trace_parse_end = uwsgi_micros();
+	}
+
+	UWSGI_PROBE4(request__parse__done, uwsgi.mywid, wsgi_req->async_id, wsgi_req->uri, wsgi_req->uri_len);
+
 	return 0;
 }
 
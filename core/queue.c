@@ -2,6 +2,26 @@
 
 extern struct uwsgi_server uwsgi;
 
+// the upper bits of the record length are flags
+#define UWSGI_QUEUE_RING_WRAP 0x80000000
+#define UWSGI_QUEUE_RING_SKIP 0x40000000
+#define UWSGI_QUEUE_RING_LEN 0x3fffffff
+
+// a process waiting for a stalled reservation checks if its owner is still alive every 100ms, and gives up after 5 seconds
+#define UWSGI_QUEUE_RING_CHECK 100000
+#define UWSGI_QUEUE_RING_TIMEOUT 5000000
+
+// every ring message is prefixed by this header and padded to 16 bytes
+struct uwsgi_queue_ring_record {
+	// the ring position of the reservation (memory left by older laps never matches it)
+	uint64_t pos;
+	uint32_t len;
+	// the producer, then the consumer, of the record (-1 when abandoned, 0 when skipped)
+	int32_t owner;
+};
+
+static void uwsgi_queue_ring_init(uint64_t);
+
 void uwsgi_init_queue() {
 	if (!uwsgi.queue_blocksize)
 		uwsgi.queue_blocksize = 8192;
@@ -13,8 +33,11 @@ void uwsgi_init_queue() {
 
 
 
+	// the ring counters need more room (and their own cache lines)
+	size_t header_size = uwsgi.queue_ring ? sizeof(struct uwsgi_queue_ring) : 16;
+
 	if (uwsgi.queue_store) {
-		uwsgi.queue_filesize = uwsgi.queue_blocksize * uwsgi.queue_size + 16;
+		uwsgi.queue_filesize = uwsgi.queue_blocksize * uwsgi.queue_size + header_size;
 		int queue_fd;
 		struct stat qst;
 
@@ -46,14 +69,14 @@ void uwsgi_init_queue() {
 
 		// fix header
 		uwsgi.queue_header = uwsgi.queue;
-		uwsgi.queue += 16;
+		uwsgi.queue += header_size;
 		close(queue_fd);
 	}
 	else {
-		uwsgi.queue = mmap(NULL, (uwsgi.queue_blocksize * uwsgi.queue_size) + 16, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+		uwsgi.queue = mmap(NULL, (uwsgi.queue_blocksize * uwsgi.queue_size) + header_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
 		// fix header
 		uwsgi.queue_header = uwsgi.queue;
-		uwsgi.queue += 16;
+		uwsgi.queue += header_size;
 		uwsgi.queue_header->pos = 0;
 		uwsgi.queue_header->pull_pos = 0;
 	}
@@ -64,6 +87,10 @@ void uwsgi_init_queue() {
 
 
 
+	if (uwsgi.queue_ring) {
+		uwsgi_queue_ring_init(uwsgi.queue_blocksize * uwsgi.queue_size);
+	}
+
 	uwsgi.queue_lock = uwsgi_rwlock_init("queue");
 
 	uwsgi_log("*** Queue subsystem initialized: %luMB preallocated ***\n", (uwsgi.queue_blocksize * uwsgi.queue_size) / (1024 * 1024));
@@ -192,3 +219,332 @@ int uwsgi_queue_set(uint64_t pos, char *message, uint64_t size) {
 
 	return 1;
 }
+
+/*
+	--queue-ring
+
+	the queue memory is used as a multi-producer/multi-consumer ring of
+	variable-length messages (the same scheme of DPDK's rte_ring, applied to bytes):
+
+	- a producer reserves space moving prod_head with a CAS, copies the message and
+	  then publishes it moving prod_tail (once the previous reservations are published)
+	- a consumer reserves the first message moving cons_head with a CAS, copies it out and
+	  then releases its space moving cons_tail (in the same way)
+
+	a process can only wait (spinning, then yielding) for the publication of the
+	reservations made before its own. When a message does not fit
+	before the end of the memory, a wrap marker is written and the message starts at the
+	beginning. Pushes fail when the ring is full (messages are never overwritten).
+
+	A process dying between the two steps would leave a reservation that is never
+	published (or released), so every record header stores its position and the pid of
+	the process working on it: the waiters behind a stalled reservation skip it when its
+	owner is dead. After UWSGI_QUEUE_RING_TIMEOUT without progress a waiter abandons its
+	own reservation (it will be skipped in the same way) and reports an error.
+
+	The header must exist as soon as the reservation does (a producer dying between the
+	two would leave nothing telling who stalled the ring), so producers take turns: the
+	reservation is made holding prod_owner (the pid of the reserving process), the header
+	is written before prod_head moves, and a dead holder is replaced by the next producer.
+
+	Blocking pulls sleep on a futex bumped by every push.
+*/
+
+static void uwsgi_queue_ring_init(uint64_t size) {
+	struct uwsgi_queue_ring *ring = (struct uwsgi_queue_ring *) uwsgi.queue_header;
+	// records are 16 bytes aligned, so a wrap marker always fits before the end of the memory
+	size &= ~15ULL;
+	if (!ring->magic) {
+		ring->magic = UWSGI_QUEUE_RING_MAGIC;
+		ring->size = size;
+		ring->prod_head = ring->prod_tail = 0;
+		ring->cons_head = ring->cons_tail = 0;
+		ring->futex = 0;
+		ring->prod_owner = 0;
+	}
+	else if (ring->magic != UWSGI_QUEUE_RING_MAGIC || ring->size != size) {
+		uwsgi_log("invalid queue ring store file. Please remove it or fix queue blocksize/items to match its size\n");
+		exit(1);
+	}
+	else {
+		// operations interrupted by the last shutdown: half-written messages are dropped, the ones being pulled are kept
+		ring->prod_head = ring->prod_tail;
+		ring->cons_head = ring->cons_tail;
+		ring->prod_owner = 0;
+		// the next reservation starts where a dropped one did, its header must not look valid
+		memset(((char *) uwsgi.queue) + (ring->prod_tail % size), 0, sizeof(struct uwsgi_queue_ring_record));
+		uwsgi_log("recovered %llu bytes of queue ring messages\n", (unsigned long long) (ring->prod_tail - ring->cons_tail));
+	}
+	ring->waiters = 0;
+	uwsgi.queue_ring_header = ring;
+}
+
+// the first header of the reservation at pos (NULL if not written yet) and its size
+static struct uwsgi_queue_ring_record *uwsgi_queue_ring_record(struct uwsgi_queue_ring *ring, char *base, uint64_t pos, uint64_t *total) {
+	uint64_t off = pos % ring->size;
+	struct uwsgi_queue_ring_record *first = (struct uwsgi_queue_ring_record *) (base + off);
+	if (uwsgi_atomic_load(first->pos) != pos)
+		return NULL;
+	struct uwsgi_queue_ring_record *urr = first;
+	*total = 0;
+	if (first->len & UWSGI_QUEUE_RING_WRAP) {
+		*total = ring->size - off;
+		urr = (struct uwsgi_queue_ring_record *) base;
+	}
+	*total += sizeof(struct uwsgi_queue_ring_record) + (((urr->len & UWSGI_QUEUE_RING_LEN) + 15) & ~15ULL);
+	return first;
+}
+
+// move the tail over the reservation at pos if its owner is dead (or abandoned it)
+static void uwsgi_queue_ring_skip(struct uwsgi_queue_ring *ring, char *base, uint64_t *tail, uint64_t pos) {
+	uint64_t total;
+	struct uwsgi_queue_ring_record *urr = uwsgi_queue_ring_record(ring, base, pos, &total);
+	if (!urr)
+		return;
+	int32_t owner = uwsgi_atomic_load(urr->owner);
+	// 0 means another process is already skipping it
+	if (owner == 0)
+		return;
+	if (owner > 0 && (!kill(owner, 0) || errno != ESRCH))
+		return;
+	if (!uwsgi_atomic_cas(urr->owner, &owner, 0))
+		return;
+	// consumers will drop the message
+	if (tail == &ring->prod_tail)
+		urr->len |= UWSGI_QUEUE_RING_SKIP;
+	if (owner > 0)
+		uwsgi_log("[ring] skipping %llu bytes left by dead process %d\n", (unsigned long long) total, (int) owner);
+	uwsgi_atomic_store(*tail, pos + total);
+}
+
+// wait for the publication of the previous reservations, 0 on timeout
+static int uwsgi_queue_ring_wait(struct uwsgi_queue_ring *ring, char *base, uint64_t *tail, uint64_t pos) {
+	int spins = 0;
+	uint64_t last = 0, since = 0, checked = 0;
+	for (;;) {
+		uint64_t current = uwsgi_atomic_load(*tail);
+		if (current == pos)
+			return 1;
+		if (++spins < 64)
+			continue;
+		spins = 0;
+		sched_yield();
+		uint64_t now = uwsgi_micros();
+		// the timeout counts from the last progress
+		if (!since || current != last) {
+			last = current;
+			since = checked = now;
+			continue;
+		}
+		if (now - checked >= UWSGI_QUEUE_RING_CHECK) {
+			uwsgi_queue_ring_skip(ring, base, tail, current);
+			checked = now;
+		}
+		if (now - since >= UWSGI_QUEUE_RING_TIMEOUT) {
+			uwsgi_log("[ring] no progress after %d seconds waiting for the reservation at %llu, giving up\n", UWSGI_QUEUE_RING_TIMEOUT / 1000000, (unsigned long long) current);
+			return 0;
+		}
+	}
+}
+
+// leave our own reservation to the processes behind us
+static void uwsgi_queue_ring_abandon(struct uwsgi_queue_ring *ring, char *base, struct uwsgi_ring_slot *slot, uint32_t flags) {
+	struct uwsgi_queue_ring_record *urr = (struct uwsgi_queue_ring_record *) (base + (slot->head % ring->size));
+	urr->len |= flags;
+	uwsgi_atomic_store(urr->owner, -1);
+}
+
+/*
+	the ring primitives work on any uwsgi_queue_ring header + memory (they are used by the mule
+	message rings too): messages are written and read in place between a reserve/publish or
+	consume/release pair. All of them return 0 when the ring is full (or empty), publish and
+	release return 0 when they timed out waiting for a stalled process (a published message is lost,
+	a released one has been already read).
+*/
+// take prod_owner (replacing a dead holder), 0 on timeout
+static int uwsgi_queue_ring_claim(struct uwsgi_queue_ring *ring) {
+	int spins = 0;
+	uint64_t since = 0, checked = 0;
+	for (;;) {
+		int32_t owner = 0;
+		if (uwsgi_atomic_cas(ring->prod_owner, &owner, uwsgi.mypid))
+			return 1;
+		if (++spins < 64)
+			continue;
+		spins = 0;
+		sched_yield();
+		uint64_t now = uwsgi_micros();
+		if (!since) {
+			since = checked = now;
+			continue;
+		}
+		if (now - checked >= UWSGI_QUEUE_RING_CHECK) {
+			checked = now;
+			if (owner > 0 && kill(owner, 0) && errno == ESRCH && uwsgi_atomic_cas(ring->prod_owner, &owner, uwsgi.mypid)) {
+				uwsgi_log("[ring] process %d died while reserving, taking over\n", (int) owner);
+				return 1;
+			}
+		}
+		if (now - since >= UWSGI_QUEUE_RING_TIMEOUT) {
+			uwsgi_log("[ring] process %d has been reserving for %d seconds, giving up\n", (int) owner, UWSGI_QUEUE_RING_TIMEOUT / 1000000);
+			return 0;
+		}
+	}
+}
+
+int uwsgi_ring_reserve(struct uwsgi_queue_ring *ring, char *base, uint64_t size, struct uwsgi_ring_slot *slot) {
+	uint64_t need = sizeof(struct uwsgi_queue_ring_record) + ((size + 15) & ~15ULL);
+	uint64_t head, off, pad, total;
+
+	if (!size || size > UWSGI_QUEUE_RING_LEN || need > ring->size)
+		return 0;
+
+	if (!uwsgi_queue_ring_claim(ring))
+		return 0;
+
+	// only the owner moves prod_head
+	head = ring->prod_head;
+	uint64_t tail = uwsgi_atomic_load(ring->cons_tail);
+	off = head % ring->size;
+	pad = off + need > ring->size ? ring->size - off : 0;
+	total = pad + need;
+	// full
+	if (head + total - tail > ring->size) {
+		uwsgi_atomic_store(ring->prod_owner, 0);
+		return 0;
+	}
+
+	// the first header is written last: once its position is valid the whole reservation can be parsed
+	struct uwsgi_queue_ring_record *first = (struct uwsgi_queue_ring_record *) (base + off);
+	struct uwsgi_queue_ring_record *urr = pad ? (struct uwsgi_queue_ring_record *) base : first;
+	urr->len = size;
+	urr->owner = uwsgi.mypid;
+	if (pad) {
+		urr->pos = head;
+		first->len = UWSGI_QUEUE_RING_WRAP;
+		first->owner = uwsgi.mypid;
+	}
+	uwsgi_atomic_store(first->pos, head);
+	// from now on a stalled reservation can be skipped
+	uwsgi_atomic_store(ring->prod_head, head + total);
+	uwsgi_atomic_store(ring->prod_owner, 0);
+
+	slot->head = head;
+	slot->total = total;
+	slot->data = ((char *) urr) + sizeof(struct uwsgi_queue_ring_record);
+	slot->len = size;
+	return 1;
+}
+
+int uwsgi_ring_publish(struct uwsgi_queue_ring *ring, char *base, struct uwsgi_ring_slot *slot) {
+	if (!uwsgi_queue_ring_wait(ring, base, &ring->prod_tail, slot->head)) {
+		uwsgi_queue_ring_abandon(ring, base, slot, UWSGI_QUEUE_RING_SKIP);
+		return 0;
+	}
+	uwsgi_atomic_store(ring->prod_tail, slot->head + slot->total);
+	return 1;
+}
+
+int uwsgi_ring_consume(struct uwsgi_queue_ring *ring, char *base, struct uwsgi_ring_slot *slot) {
+	struct uwsgi_queue_ring_record *first;
+	uint64_t head, total;
+
+	for (;;) {
+		head = uwsgi_atomic_load(ring->cons_head);
+		uint64_t tail = uwsgi_atomic_load(ring->prod_tail);
+		// empty
+		if (head >= tail)
+			return 0;
+		first = uwsgi_queue_ring_record(ring, base, head, &total);
+		// a stale head (the CAS would fail too)
+		if (!first || head + total > tail)
+			continue;
+		if (!uwsgi_atomic_cas(ring->cons_head, &head, head + total))
+			continue;
+		uwsgi_atomic_store(first->owner, uwsgi.mypid);
+		slot->head = head;
+		slot->total = total;
+		// the reservation of a dead producer
+		if (first->len & UWSGI_QUEUE_RING_SKIP) {
+			uwsgi_ring_release(ring, base, slot);
+			continue;
+		}
+		break;
+	}
+
+	struct uwsgi_queue_ring_record *urr = first->len & UWSGI_QUEUE_RING_WRAP ? (struct uwsgi_queue_ring_record *) base : first;
+	slot->data = ((char *) urr) + sizeof(struct uwsgi_queue_ring_record);
+	slot->len = urr->len & UWSGI_QUEUE_RING_LEN;
+	return 1;
+}
+
+int uwsgi_ring_release(struct uwsgi_queue_ring *ring, char *base, struct uwsgi_ring_slot *slot) {
+	if (!uwsgi_queue_ring_wait(ring, base, &ring->cons_tail, slot->head)) {
+		uwsgi_queue_ring_abandon(ring, base, slot, 0);
+		return 0;
+	}
+	uwsgi_atomic_store(ring->cons_tail, slot->head + slot->total);
+	return 1;
+}
+
+int uwsgi_queue_ring_push(char *message, uint64_t size) {
+	struct uwsgi_queue_ring *ring = uwsgi.queue_ring_header;
+	struct uwsgi_ring_slot slot;
+
+	if (!uwsgi_ring_reserve(ring, (char *) uwsgi.queue, size, &slot))
+		return 0;
+	memcpy(slot.data, message, size);
+	if (!uwsgi_ring_publish(ring, (char *) uwsgi.queue, &slot))
+		return 0;
+
+	uwsgi_atomic_add(ring->futex, 1);
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(ring->waiters)) {
+		uwsgi_futex_wake(&ring->futex, 1);
+	}
+	return 1;
+}
+
+static char *uwsgi_queue_ring_pull_nb(struct uwsgi_queue_ring *ring, uint64_t *size) {
+	struct uwsgi_ring_slot slot;
+
+	if (!uwsgi_ring_consume(ring, (char *) uwsgi.queue, &slot))
+		return NULL;
+
+	char *message = uwsgi_malloc(slot.len);
+	memcpy(message, slot.data, slot.len);
+	*size = slot.len;
+
+	// on failure the space is released by the next consumer
+	uwsgi_ring_release(ring, (char *) uwsgi.queue, &slot);
+	return message;
+}
+
+/*
+	returns a copy of the oldest message (to be freed) or NULL,
+	timeout is in seconds (0 does not wait, < 0 waits forever)
+*/
+char *uwsgi_queue_ring_pull(uint64_t *size, int timeout) {
+	struct uwsgi_queue_ring *ring = uwsgi.queue_ring_header;
+	uint64_t deadline = timeout > 0 ? uwsgi_micros() + (timeout * 1000000ULL) : 0;
+
+	for (;;) {
+		uint32_t seq = uwsgi_atomic_load(ring->futex);
+		char *message = uwsgi_queue_ring_pull_nb(ring, size);
+		if (message || !timeout)
+			return message;
+
+		int ms = -1;
+		if (deadline) {
+			uint64_t now = uwsgi_micros();
+			if (now >= deadline)
+				return NULL;
+			ms = ((deadline - now) / 1000) + 1;
+		}
+
+		uwsgi_atomic_add(ring->waiters, 1);
+		// no wait if a message has been pushed in the meantime
+		uwsgi_futex_wait(&ring->futex, seq, ms);
+		uwsgi_atomic_sub(ring->waiters, 1);
+	}
+}
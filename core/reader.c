@@ -6,6 +6,8 @@ int uwsgi_simple_wait_read_hook(int fd, int timeout) {
 	struct pollfd upoll;
 	timeout = timeout * 1000;
 
+	uwsgi_response_flush_current();
+
         upoll.fd = fd;
         upoll.events = POLLIN;
         upoll.revents = 0;
@@ -28,6 +30,8 @@ int uwsgi_simple_wait_read2_hook(int fd0, int fd1, int timeout, int *fd) {
         struct pollfd upoll[2];
         timeout = timeout * 1000;
 
+        uwsgi_response_flush_current();
+
         upoll[0].fd = fd0;
         upoll[0].events = POLLIN;
         upoll[0].revents = 0;
@@ -55,7 +55,8 @@ struct uwsgi_buffer *uwsgi_routing_translate(struct wsgi_request *wsgi_req, stru
 		pass1_len = strlen(pass1);
 	}
 
-	struct uwsgi_buffer *ub = uwsgi_buffer_new(pass1_len);
+	// released at the end of the request
+	struct uwsgi_buffer *ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), pass1_len);
 	size_t i;
 	int status = 0;
 	char *key = NULL;
@@ -808,6 +809,28 @@ static int uwsgi_router_donotlog(struct uwsgi_route *ur, char *arg) {
         return 0;
 }
 
+// account the request in the histograms of a label
+static int uwsgi_router_histogram_func(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
+	wsgi_req->histogram_label = ur->custom;
+	return UWSGI_ROUTE_NEXT;
+}
+static int uwsgi_router_histogram(struct uwsgi_route *ur, char *arg) {
+	size_t i, len = strlen(arg);
+	if (len == 0) {
+		uwsgi_log("the histogram routing action requires a label\n");
+		exit(1);
+	}
+	for (i = 0; i < len; i++) {
+		if (!isalnum((int) arg[i]) && arg[i] != '_' && arg[i] != '-') {
+			uwsgi_log("invalid histogram label: %s\n", arg);
+			exit(1);
+		}
+	}
+	ur->func = uwsgi_router_histogram_func;
+	ur->custom = uwsgi_histogram_label(arg);
+	return 0;
+}
+
 // logvar route
 static int uwsgi_router_logvar_func(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
 
@@ -1858,6 +1881,36 @@ static char *uwsgi_route_var_base64(struct wsgi_request *wsgi_req, char *key, ui
         return ret;
 }
 
+/*
+	${sharedarea[id,pos]} -> the 64bit value at pos (read atomically)
+	${sharedareainc[id,pos]} -> atomically increments it, returning the new value
+*/
+static char *uwsgi_route_var_sharedarea_do(char *key, uint16_t keylen, uint16_t *vallen, int64_t amount) {
+	char *comma = memchr(key, ',', keylen);
+	if (!comma) return NULL;
+	int id = uwsgi_str_num(key, comma - key);
+	uint64_t pos = uwsgi_str_num(comma + 1, keylen - ((comma + 1) - key));
+	int64_t value = 0;
+	if (amount) {
+		if (uwsgi_sharedarea_fetch_add64(id, pos, amount, &value)) return NULL;
+		value += amount;
+	}
+	else if (uwsgi_sharedarea_load64(id, pos, &value)) {
+		return NULL;
+	}
+	char *ret = uwsgi_64bit2str(value);
+	*vallen = strlen(ret);
+	return ret;
+}
+
+static char *uwsgi_route_var_sharedarea(struct wsgi_request *wsgi_req, char *key, uint16_t keylen, uint16_t *vallen) {
+	return uwsgi_route_var_sharedarea_do(key, keylen, vallen, 0);
+}
+
+static char *uwsgi_route_var_sharedareainc(struct wsgi_request *wsgi_req, char *key, uint16_t keylen, uint16_t *vallen) {
+	return uwsgi_route_var_sharedarea_do(key, keylen, vallen, 1);
+}
+
 static char *uwsgi_route_var_hex(struct wsgi_request *wsgi_req, char *key, uint16_t keylen, uint16_t *vallen) {
         char *ret = NULL;
         uint16_t var_vallen = 0;
@@ -1905,6 +1958,7 @@ void uwsgi_register_embedded_routers() {
         uwsgi_register_router("log", uwsgi_router_log);
         uwsgi_register_router("donotlog", uwsgi_router_donotlog);
         uwsgi_register_router("logvar", uwsgi_router_logvar);
+        uwsgi_register_router("histogram", uwsgi_router_histogram);
         uwsgi_register_router("goto", uwsgi_router_goto);
         uwsgi_register_router("addvar", uwsgi_router_addvar);
         uwsgi_register_router("addheader", uwsgi_router_addheader);
@@ -1993,6 +2047,10 @@ void uwsgi_register_embedded_routers() {
     urv->need_free = 1;
     urv = uwsgi_register_route_var("lower", uwsgi_route_var_lower);
     urv->need_free = 1;
+        urv = uwsgi_register_route_var("sharedarea", uwsgi_route_var_sharedarea);
+	urv->need_free = 1;
+        urv = uwsgi_register_route_var("sharedareainc", uwsgi_route_var_sharedareainc);
+	urv->need_free = 1;
 }
 
 struct uwsgi_router *uwsgi_register_router(char *name, int (*func) (struct uwsgi_route *, char *)) {
@@ -2,6 +2,119 @@
 
 extern struct uwsgi_server uwsgi;
 
+/*
+
+	RPC subsystem
+
+	every process has a row of uwsgi.rpc_table: row 0 is the master (its functions are copied to
+	all of the other rows), rows 1..numproc are the workers and the last mules_cnt rows are the mules.
+
+	Lookups go through a process-local hash index of the row, rebuilt whenever a function is registered
+	anywhere (uwsgi.shared->rpc_generation changes).
+
+	Functions registered by a mule can be called by the workers via a shared memory channel:
+	every mule has rpc_mule_slots request/response slots and a doorbell pipe. The caller serializes
+	the request (a uwsgi array) directly in the slot, rings the doorbell and sleeps on the slot futex
+	until the mule stores the response in the same slot (async cores cannot block the whole process,
+	so they poll the slot via the wait_milliseconds hook of the loop engine).
+
+	A slot is claimed by setting its owner (0 -> pid), the state is reset to FREE before the owner is
+	cleared, so a slot without owner is always free.
+
+*/
+
+// the state of a mule channel slot
+#define UWSGI_RPC_SLOT_FREE 0
+#define UWSGI_RPC_SLOT_WRITING 1
+#define UWSGI_RPC_SLOT_REQUEST 2
+#define UWSGI_RPC_SLOT_RUNNING 3
+#define UWSGI_RPC_SLOT_DONE 4
+#define UWSGI_RPC_SLOT_ABANDONED 5
+
+struct uwsgi_rpc_index {
+	uint64_t generation;
+	uint32_t mask;
+	// offset+1 of the function in the row, 0 is an empty slot
+	uint32_t slots[];
+};
+
+// process-local, one per row
+static struct uwsgi_rpc_index **rpc_indexes;
+
+// idle persistent connections to remote nodes (process-local)
+struct uwsgi_rpc_conn {
+	char *node;
+	int fd;
+	struct uwsgi_rpc_conn *next;
+};
+
+static pthread_mutex_t rpc_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct uwsgi_rpc_conn *rpc_pool;
+static pid_t rpc_pool_pid;
+
+static int uwsgi_rpc_rows() {
+	return uwsgi.numproc + 1 + uwsgi.mules_cnt;
+}
+
+// the row of the current process
+static int uwsgi_rpc_row() {
+	if (uwsgi.muleid > 0) {
+		return uwsgi.numproc + uwsgi.muleid;
+	}
+	return uwsgi.mywid;
+}
+
+static struct uwsgi_rpc_index *uwsgi_rpc_index_build(int row, uint64_t generation) {
+	uint32_t size = 2;
+	while (size < uwsgi.rpc_max * 2) {
+		size *= 2;
+	}
+
+	struct uwsgi_rpc_index *index = uwsgi_calloc(sizeof(struct uwsgi_rpc_index) + (sizeof(uint32_t) * size));
+	index->generation = generation;
+	index->mask = size - 1;
+
+	uint64_t i;
+	uint64_t count = uwsgi.shared->rpc_count[row];
+	for (i = 0; i < count; i++) {
+		struct uwsgi_rpc *urpc = &uwsgi.rpc_table[(row * uwsgi.rpc_max) + i];
+		if (urpc->name[0] == 0)
+			continue;
+		uint32_t pos = djb33x_hash(urpc->name, strlen(urpc->name)) & index->mask;
+		while (index->slots[pos]) {
+			pos = (pos + 1) & index->mask;
+		}
+		index->slots[pos] = i + 1;
+	}
+
+	// the previous index could still be in use by another thread, so it is leaked
+	// (it happens only when functions are registered)
+	uwsgi_atomic_store(rpc_indexes[row], index);
+	return index;
+}
+
+static struct uwsgi_rpc *uwsgi_rpc_lookup(int row, char *name) {
+	if (!rpc_indexes || !uwsgi.shared->rpc_count[row])
+		return NULL;
+
+	uint64_t generation = uwsgi_atomic_load(uwsgi.shared->rpc_generation);
+	struct uwsgi_rpc_index *index = uwsgi_atomic_load(rpc_indexes[row]);
+	if (!index || index->generation != generation) {
+		index = uwsgi_rpc_index_build(row, generation);
+	}
+
+	uint32_t pos = djb33x_hash(name, strlen(name)) & index->mask;
+	while (index->slots[pos]) {
+		struct uwsgi_rpc *urpc = &uwsgi.rpc_table[(row * uwsgi.rpc_max) + index->slots[pos] - 1];
+		if (!strcmp(urpc->name, name)) {
+			return urpc;
+		}
+		pos = (pos + 1) & index->mask;
+	}
+
+	return NULL;
+}
+
 int uwsgi_register_rpc(char *name, struct uwsgi_plugin *plugin, uint8_t args, void *func) {
 
 	struct uwsgi_rpc *urpc;
@@ -12,96 +125,433 @@ int uwsgi_register_rpc(char *name, struct uwsgi_plugin *plugin, uint8_t args, vo
 		return -1;
 	}
 
-	if (uwsgi.mywid == 0 && uwsgi.workers[0].pid != uwsgi.mypid) {
-		uwsgi_log("only the master and the workers can register RPC functions\n");
+	if (uwsgi.mywid == 0 && !uwsgi.muleid && uwsgi.workers[0].pid != uwsgi.mypid) {
+		uwsgi_log("only the master, the workers and the mules can register RPC functions\n");
+		return -1;
+	}
+
+	if (strlen(name) >= UMAX8) {
+		uwsgi_log("RPC function name \"%s\" is too long\n", name);
 		return -1;
 	}
 
+	int row = uwsgi_rpc_row();
+
 	uwsgi_lock(uwsgi.rpc_table_lock);
 
 	// first check if a function is already registered
 	size_t i;
-	for(i=0;i<uwsgi.shared->rpc_count[uwsgi.mywid];i++) {
-		int pos = (uwsgi.mywid * uwsgi.rpc_max) + i;
+	for(i=0;i<uwsgi.shared->rpc_count[row];i++) {
+		int pos = (row * uwsgi.rpc_max) + i;
 		urpc = &uwsgi.rpc_table[pos];
 		if (!strcmp(name, urpc->name)) {
 			goto already;
 		}
 	}
 
-	if (uwsgi.shared->rpc_count[uwsgi.mywid] < uwsgi.rpc_max) {
-		int pos = (uwsgi.mywid * uwsgi.rpc_max) + uwsgi.shared->rpc_count[uwsgi.mywid];
+	if (uwsgi.shared->rpc_count[row] < uwsgi.rpc_max) {
+		int pos = (row * uwsgi.rpc_max) + uwsgi.shared->rpc_count[row];
 		urpc = &uwsgi.rpc_table[pos];
-		uwsgi.shared->rpc_count[uwsgi.mywid]++;
+		uwsgi.shared->rpc_count[row]++;
 already:
 		memcpy(urpc->name, name, strlen(name));
 		urpc->plugin = plugin;
 		urpc->args = args;
 		urpc->func = func;
-		urpc->shared = uwsgi.mywid == 0 ? 1 : 0;
+		urpc->shared = row == 0 ? 1 : 0;
 
 		ret = 0;
-		if (uwsgi.mywid == 0) {
+		if (row == 0) {
 			uwsgi_log("registered shared/inherited RPC function \"%s\"\n", name);
 		}
+		else if (uwsgi.muleid > 0) {
+			uwsgi_log("registered RPC function \"%s\" on mule %d\n", name, uwsgi.muleid);
+		}
 		else {
 			uwsgi_log("registered RPC function \"%s\" on worker %d\n", name, uwsgi.mywid);
 		}
 	}
 
 	// implement cow
-	if (uwsgi.mywid == 0) {
+	if (row == 0) {
 		int i;
-		for(i=1;i<=uwsgi.numproc;i++) {
+		for(i=1;i<uwsgi_rpc_rows();i++) {
 			uwsgi.shared->rpc_count[i] = uwsgi.shared->rpc_count[0];
 			int pos = (i * uwsgi.rpc_max);
 			memcpy(&uwsgi.rpc_table[pos], uwsgi.rpc_table, sizeof(struct uwsgi_rpc) * uwsgi.rpc_max);
 		}
 	}
 
+	// invalidate the lookup indexes of all of the processes
+	uwsgi_atomic_add(uwsgi.shared->rpc_generation, 1);
+
 	uwsgi_unlock(uwsgi.rpc_table_lock);
 
 	return ret;
 }
 
-uint64_t uwsgi_rpc(char *name, uint8_t argc, char *argv[], uint16_t argvs[], char **output) {
+// append an item to a uwsgi array
+static char *uwsgi_rpc_array_add(char *ptr, char *item, uint16_t len) {
+	*ptr++ = (uint8_t) (len & 0xff);
+	*ptr++ = (uint8_t) ((len >> 8) & 0xff);
+	memcpy(ptr, item, len);
+	return ptr + len;
+}
 
-	struct uwsgi_rpc *urpc = NULL;
-	uint64_t i;
-	uint64_t ret = 0;
+static uint64_t uwsgi_rpc_array_size(char *func, uint8_t argc, uint16_t argvs[]) {
+	uint8_t i;
+	uint64_t size = 2 + strlen(func);
+	for (i = 0; i < argc; i++) {
+		size += 2 + argvs[i];
+	}
+	return size;
+}
+
+static size_t uwsgi_rpc_slot_size() {
+	return (sizeof(struct uwsgi_rpc_slot) + uwsgi.rpc_mule_bufsize + 63) & ~((size_t) 63);
+}
+
+static struct uwsgi_rpc_slot *uwsgi_rpc_slot_get(struct uwsgi_rpc_channel *channel, int n) {
+	return (struct uwsgi_rpc_slot *) (channel->slots + (n * uwsgi_rpc_slot_size()));
+}
 
-	int pos = (uwsgi.mywid * uwsgi.rpc_max);
+static void uwsgi_rpc_slot_release(struct uwsgi_rpc_slot *slot) {
+	uwsgi_atomic_store(slot->state, UWSGI_RPC_SLOT_FREE);
+	uwsgi_atomic_store(slot->owner, 0);
+}
+
+static struct uwsgi_rpc_slot *uwsgi_rpc_slot_claim(struct uwsgi_rpc_channel *channel, int reclaim) {
+	int i;
+	for (i = 0; i < uwsgi.rpc_mule_slots; i++) {
+		struct uwsgi_rpc_slot *slot = uwsgi_rpc_slot_get(channel, i);
+		pid_t owner = 0;
+		if (uwsgi_atomic_cas(slot->owner, &owner, uwsgi.mypid))
+			goto claimed;
+		if (!reclaim)
+			continue;
+		// a caller died while writing the request, before consuming the response or while releasing the slot
+		// (in those states the mule does not touch the slot)
+		uint32_t state = uwsgi_atomic_load(slot->state);
+		if (state != UWSGI_RPC_SLOT_WRITING && state != UWSGI_RPC_SLOT_DONE && state != UWSGI_RPC_SLOT_FREE)
+			continue;
+		if (owner <= 0 || kill(owner, 0) == 0 || errno != ESRCH)
+			continue;
+		// fails if another caller reclaimed it in the meantime
+		if (uwsgi_atomic_cas(slot->owner, &owner, uwsgi.mypid))
+			goto claimed;
+		continue;
+claimed:
+		uwsgi_atomic_store(slot->state, UWSGI_RPC_SLOT_WRITING);
+		return slot;
+	}
+	return NULL;
+}
+
+// wait for a slot change, without blocking the other cores of async/green threads engines
+static void uwsgi_rpc_mule_pause(uint32_t *futex, uint32_t val, int timeout) {
+	if (uwsgi.wait_milliseconds_hook != uwsgi_simple_wait_milliseconds_hook) {
+		uwsgi.wait_milliseconds_hook(1);
+		return;
+	}
+	if (futex) {
+		uwsgi_futex_wait(futex, val, timeout);
+		return;
+	}
+	usleep(100);
+}
+
+// call a function registered in a mule (0-based) via its shared memory channel
+static uint64_t uwsgi_rpc_mule(int mule, char *name, uint8_t argc, char *argv[], uint16_t argvs[], char **output) {
+	struct uwsgi_rpc_channel *channel = &uwsgi.rpc_channels[mule];
+	uint8_t i;
+
+	uint64_t size = uwsgi_rpc_array_size(name, argc, argvs);
+	if (size > uwsgi.rpc_mule_bufsize || size > 0xffff) {
+		uwsgi_log("[rpc] request for \"%s\" is too big for the mule channel (%llu bytes)\n", name, (unsigned long long) size);
+		return 0;
+	}
+
+	uint64_t deadline = uwsgi_micros() + ((uint64_t) uwsgi.socket_timeout * 1000000);
+	int reclaim = 0;
+	struct uwsgi_rpc_slot *slot = NULL;
+	while (!(slot = uwsgi_rpc_slot_claim(channel, reclaim))) {
+		if (uwsgi_micros() > deadline) {
+			uwsgi_log("[rpc] no free slot in the channel of mule %d\n", mule + 1);
+			return 0;
+		}
+		reclaim = 1;
+		uwsgi_rpc_mule_pause(NULL, 0, 0);
+	}
+
+	// the request is written directly in the shared memory slot
+	char *ptr = uwsgi_rpc_array_add(slot->buf, name, strlen(name));
+	for (i = 0; i < argc; i++) {
+		ptr = uwsgi_rpc_array_add(ptr, argv[i], argvs[i]);
+	}
+	slot->len = size;
+	uwsgi_atomic_store(slot->state, UWSGI_RPC_SLOT_REQUEST);
+
+	// ring the doorbell, a full pipe means the mule has still to wake up
+	if (write(channel->doorbell[1], "", 1) < 0 && !uwsgi_is_again()) {
+		uwsgi_error("uwsgi_rpc_mule()/write()");
+	}
 
-	for (i = 0; i < uwsgi.shared->rpc_count[uwsgi.mywid]; i++) {
-		if (uwsgi.rpc_table[pos + i].name[0] != 0) {
-			if (!strcmp(uwsgi.rpc_table[pos + i].name, name)) {
-				urpc = &uwsgi.rpc_table[pos + i];
-				break;
+	for (;;) {
+		uint32_t state = uwsgi_atomic_load(slot->state);
+		if (state == UWSGI_RPC_SLOT_DONE)
+			break;
+		uint64_t now = uwsgi_micros();
+		if (now >= deadline) {
+			// give up: if the mule did not pick up the request the slot is immediately free,
+			// otherwise the mule will release it when done
+			state = UWSGI_RPC_SLOT_REQUEST;
+			if (uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_FREE)) {
+				uwsgi_atomic_store(slot->owner, 0);
+				goto timeout;
 			}
+			state = UWSGI_RPC_SLOT_RUNNING;
+			if (uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_ABANDONED))
+				goto timeout;
+			// the response arrived in the meantime
+			continue;
 		}
+		uwsgi_rpc_mule_pause(&slot->state, state, (int) ((deadline - now) / 1000) + 1);
 	}
 
+	uint64_t len = slot->len;
+	if (len > 0) {
+		*output = uwsgi_malloc(len);
+		memcpy(*output, slot->buf, len);
+	}
+	uwsgi_rpc_slot_release(slot);
+	return len;
+
+timeout:
+	uwsgi_log("[rpc] timeout calling \"%s\" on mule %d\n", name, mule + 1);
+	return 0;
+}
+
+// the doorbell of the current mule (-1 if the mule has no channel)
+int uwsgi_rpc_mule_fd() {
+	if (!uwsgi.rpc_channels || uwsgi.muleid <= 0)
+		return -1;
+	return uwsgi.rpc_channels[uwsgi.muleid - 1].doorbell[0];
+}
+
+// run by the mule: serve all of the pending requests of its channel
+void uwsgi_rpc_mule_serve() {
+	if (!uwsgi.rpc_channels || uwsgi.muleid <= 0)
+		return;
+
+	struct uwsgi_rpc_channel *channel = &uwsgi.rpc_channels[uwsgi.muleid - 1];
+	char bell[64];
+	while (read(channel->doorbell[0], bell, 64) > 0);
+
+	int i;
+	for (i = 0; i < uwsgi.rpc_mule_slots; i++) {
+		struct uwsgi_rpc_slot *slot = uwsgi_rpc_slot_get(channel, i);
+		uint32_t state = UWSGI_RPC_SLOT_REQUEST;
+		if (!uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_RUNNING))
+			continue;
+
+		char *argv[UMAX8];
+		uint16_t argvs[UMAX8];
+		uint8_t argc = 0xff;
+		char *response = NULL;
+		uint64_t len = 0;
+
+		if (!uwsgi_parse_array(slot->buf, slot->len, argv, argvs, &argc) && argc > 0) {
+			len = uwsgi_rpc(argv[0], argc - 1, argv + 1, argvs + 1, &response);
+		}
+
+		if (len > uwsgi.rpc_mule_bufsize) {
+			uwsgi_log("[rpc] response too big for the mule channel (%llu bytes)\n", (unsigned long long) len);
+			len = 0;
+		}
+
+		if (response) {
+			memcpy(slot->buf, response, len);
+			free(response);
+		}
+		slot->len = len;
+
+		state = UWSGI_RPC_SLOT_RUNNING;
+		if (!uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_DONE)) {
+			// the caller is gone
+			uwsgi_rpc_slot_release(slot);
+			continue;
+		}
+		uwsgi_futex_wake(&slot->state, 1);
+	}
+}
+
+// run by a (re)spawned mule: complete the requests left behind by the previous instance
+void uwsgi_rpc_mule_recover() {
+	if (!uwsgi.rpc_channels || uwsgi.muleid <= 0)
+		return;
+
+	struct uwsgi_rpc_channel *channel = &uwsgi.rpc_channels[uwsgi.muleid - 1];
+	int i;
+	for (i = 0; i < uwsgi.rpc_mule_slots; i++) {
+		struct uwsgi_rpc_slot *slot = uwsgi_rpc_slot_get(channel, i);
+		uint32_t state = UWSGI_RPC_SLOT_ABANDONED;
+		if (uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_FREE)) {
+			uwsgi_atomic_store(slot->owner, 0);
+			continue;
+		}
+		if (state != UWSGI_RPC_SLOT_RUNNING)
+			continue;
+		// the caller gets an empty response
+		slot->len = 0;
+		if (uwsgi_atomic_cas(slot->state, &state, UWSGI_RPC_SLOT_DONE)) {
+			uwsgi_futex_wake(&slot->state, 1);
+		}
+		else if (state == UWSGI_RPC_SLOT_ABANDONED) {
+			uwsgi_rpc_slot_release(slot);
+		}
+	}
+}
+
+uint64_t uwsgi_rpc(char *name, uint8_t argc, char *argv[], uint16_t argvs[], char **output) {
+
+	uint64_t ret = 0;
+
+	struct uwsgi_rpc *urpc = uwsgi_rpc_lookup(uwsgi_rpc_row(), name);
+
 	if (urpc) {
 		if (urpc->plugin->rpc) {
 			ret = urpc->plugin->rpc(urpc->func, argc, argv, argvs, output);
 		}
+		return ret;
+	}
+
+	// not found, check the functions registered by the mules
+	if (uwsgi.rpc_channels && uwsgi.muleid == 0) {
+		int i;
+		for (i = 0; i < uwsgi.mules_cnt; i++) {
+			if (uwsgi_rpc_lookup(uwsgi.numproc + 1 + i, name)) {
+				return uwsgi_rpc_mule(i, name, argc, argv, argvs, output);
+			}
+		}
 	}
 
 	return ret;
 }
 
+struct uwsgi_rpc_response {
+	size_t content_len;
+	int keepalive;
+};
+
 static void rpc_context_hook(char *key, uint16_t kl, char *value, uint16_t vl, void *data) {
-	size_t *r = (size_t *) data;
+	struct uwsgi_rpc_response *r = (struct uwsgi_rpc_response *) data;
 
 	if (!uwsgi_strncmp(key, kl, "CONTENT_LENGTH", 14)) {
-		*r = uwsgi_str_num(value, vl);
+		r->content_len = uwsgi_str_num(value, vl);
+	}
+	else if (!uwsgi_strncmp(key, kl, "KEEPALIVE", 9)) {
+		r->keepalive = uwsgi_str_num(value, vl);
+	}
+}
+
+// get an idle connection to the node from the pool (-1 if none)
+static int uwsgi_rpc_pool_get(char *node) {
+	int fd = -1;
+
+	if (!uwsgi.rpc_pool)
+		return -1;
+
+	pthread_mutex_lock(&rpc_pool_lock);
+	struct uwsgi_rpc_conn *conn = rpc_pool, *prev = NULL;
+	// the connections inherited from the parent are not ours
+	if (rpc_pool_pid != uwsgi.mypid) {
+		while (conn) {
+			struct uwsgi_rpc_conn *next = conn->next;
+			close(conn->fd);
+			free(conn->node);
+			free(conn);
+			conn = next;
+		}
+		rpc_pool = NULL;
+		rpc_pool_pid = uwsgi.mypid;
 	}
+
+	while (conn) {
+		if (!strcmp(conn->node, node)) {
+			if (prev) {
+				prev->next = conn->next;
+			}
+			else {
+				rpc_pool = conn->next;
+			}
+			fd = conn->fd;
+			free(conn->node);
+			free(conn);
+			break;
+		}
+		prev = conn;
+		conn = conn->next;
+	}
+	pthread_mutex_unlock(&rpc_pool_lock);
+
+	if (fd > -1) {
+		// an idle connection must not be readable (the peer closed it)
+		struct pollfd upoll;
+		upoll.fd = fd;
+		upoll.events = POLLIN;
+		upoll.revents = 0;
+		if (poll(&upoll, 1, 0) != 0) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+static void uwsgi_rpc_pool_put(char *node, int fd) {
+	int count = 0;
+
+	pthread_mutex_lock(&rpc_pool_lock);
+	struct uwsgi_rpc_conn *conn = rpc_pool;
+	while (conn) {
+		if (!strcmp(conn->node, node))
+			count++;
+		conn = conn->next;
+	}
+
+	if (rpc_pool_pid != uwsgi.mypid || count >= uwsgi.rpc_pool) {
+		pthread_mutex_unlock(&rpc_pool_lock);
+		close(fd);
+		return;
+	}
+
+	conn = uwsgi_malloc(sizeof(struct uwsgi_rpc_conn));
+	conn->node = uwsgi_str(node);
+	conn->fd = fd;
+	conn->next = rpc_pool;
+	rpc_pool = conn;
+	pthread_mutex_unlock(&rpc_pool_lock);
+}
+
+static int uwsgi_rpc_connect(char *node) {
+	// connect to node (async way)
+	int fd = uwsgi_connect(node, 0, 1);
+	if (fd < 0)
+		return -1;
+
+	// wait for connection;
+	int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+	if (ret <= 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
 }
 
 char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t argvs[], uint64_t * len) {
 
 	uint8_t i;
-	uint16_t ulen;
 	struct uwsgi_header *uh = NULL;
 	char *buffer = NULL;
 
@@ -119,49 +569,37 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
 		return NULL;
 	}
 
-
-	// connect to node (async way)
-	int fd = uwsgi_connect(node, 0, 1);
-	if (fd < 0)
-		return NULL;
-
-	// wait for connection;
-	int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
-	if (ret <= 0) {
-		close(fd);
+	// prepare a uwsgi array
+	uint64_t array_size = uwsgi_rpc_array_size(func, argc, argvs);
+	if (array_size > 0xffff) {
+		uwsgi_log("[rpc] request for \"%s\" is too big (%llu bytes)\n", func, (unsigned long long) array_size);
 		return NULL;
 	}
-
-	// prepare a uwsgi array
-	uint16_t buffer_size = 2 + strlen(func);
-
-	for (i = 0; i < argc; i++) {
-		buffer_size += 2 + argvs[i];
+	uint16_t buffer_size = array_size;
+
+	int fd = uwsgi_rpc_pool_get(node);
+	int reused = fd > -1;
+	if (!reused) {
+		fd = uwsgi_rpc_connect(node);
+		if (fd < 0)
+			return NULL;
 	}
 
+retry:
 	// allocate the whole buffer
 	buffer = uwsgi_malloc(4+buffer_size);
 
-	// set the uwsgi header
+	// set the uwsgi header (modifier2 6 asks for a persistent connection)
 	uh = (struct uwsgi_header *) buffer;
 	uh->modifier1 = 173;
 	uh->_pktsize = buffer_size;
-	uh->modifier2 = 0;
+	uh->modifier2 = uwsgi.rpc_pool ? 6 : 0;
 
 	// add func to the array
-	char *bufptr = buffer + 4;
-	ulen = strlen(func);
-	*bufptr++ = (uint8_t) (ulen & 0xff);
-	*bufptr++ = (uint8_t) ((ulen >> 8) & 0xff);
-	memcpy(bufptr, func, ulen);
-	bufptr += ulen;
+	char *bufptr = uwsgi_rpc_array_add(buffer + 4, func, strlen(func));
 
 	for (i = 0; i < argc; i++) {
-		ulen = argvs[i];
-		*bufptr++ = (uint8_t) (ulen & 0xff);
-		*bufptr++ = (uint8_t) ((ulen >> 8) & 0xff);
-		memcpy(bufptr, argv[i], ulen);
-		bufptr += ulen;
+		bufptr = uwsgi_rpc_array_add(bufptr, argv[i], argvs[i]);
 	}
 
 	// ok the request is ready, let's send it in non blocking way
@@ -169,6 +607,21 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
 		goto error;
 	}
 
+	// the function could be already running, a pooled connection is retried only if the peer
+	// closed (or reset) it without sending a single byte of the response
+	if (reused) {
+		reused = 0;
+		if (uwsgi.wait_read_hook(fd, uwsgi.socket_timeout) <= 0) {
+			goto error;
+		}
+		char peek;
+		ssize_t plen = recv(fd, &peek, 1, MSG_PEEK);
+		if (plen == 0 || (plen < 0 && errno == ECONNRESET)) {
+			reused = 1;
+			goto error;
+		}
+	}
+
 	// ok time to wait for the response in non blocking way
 	size_t rlen = buffer_size+4;
 	uint8_t modifier2 = 0;
@@ -176,18 +629,20 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
 		goto error;
 	}
 
+	struct uwsgi_rpc_response response;
+	memset(&response, 0, sizeof(struct uwsgi_rpc_response));
+
 	// 64bit response ?
 	if (modifier2 == 5) {
-		size_t content_len = 0;
-		if (uwsgi_hooked_parse(buffer, rlen, rpc_context_hook, &content_len )) goto error;
+		if (uwsgi_hooked_parse(buffer, rlen, rpc_context_hook, &response)) goto error;
 
-		if (content_len > rlen) {
-			char *tmp_buf = realloc(buffer, content_len);
+		if (response.content_len > rlen) {
+			char *tmp_buf = realloc(buffer, response.content_len);
 			if (!tmp_buf) goto error;
 			buffer = tmp_buf;
 		}
 
-		rlen = content_len;
+		rlen = response.content_len;
 
 		// read the raw value from the socket
                 if (uwsgi_read_whole_true_nb(fd, buffer, rlen, uwsgi.socket_timeout)) {
@@ -195,7 +650,12 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
                 }
 	}
 
-	close(fd);
+	if (response.keepalive && uwsgi.rpc_pool) {
+		uwsgi_rpc_pool_put(node, fd);
+	}
+	else {
+		close(fd);
+	}
 	*len = rlen;
 	if (*len == 0) {
 		goto error2;
@@ -204,6 +664,15 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
 
 error:
 	close(fd);
+	// a stale pooled connection (the request has not been processed), try again with a new one
+	if (reused) {
+		free(buffer);
+		reused = 0;
+		fd = uwsgi_rpc_connect(node);
+		if (fd > -1)
+			goto retry;
+		return NULL;
+	}
 error2:
 	free(buffer);
 	return NULL;
@@ -212,6 +681,22 @@ error2:
 
 
 void uwsgi_rpc_init() {
-	uwsgi.rpc_table = uwsgi_calloc_shared((sizeof(struct uwsgi_rpc) * uwsgi.rpc_max) * (uwsgi.numproc+1));
-	uwsgi.shared->rpc_count = uwsgi_calloc_shared(sizeof(uint64_t) * (uwsgi.numproc+1));
+	int rows = uwsgi_rpc_rows();
+	uwsgi.rpc_table = uwsgi_calloc_shared((sizeof(struct uwsgi_rpc) * uwsgi.rpc_max) * rows);
+	uwsgi.shared->rpc_count = uwsgi_calloc_shared(sizeof(uint64_t) * rows);
+	rpc_indexes = uwsgi_calloc(sizeof(struct uwsgi_rpc_index *) * rows);
+
+	if (uwsgi.mules_cnt > 0 && uwsgi.rpc_mule_slots > 0) {
+		uwsgi.rpc_channels = uwsgi_calloc(sizeof(struct uwsgi_rpc_channel) * uwsgi.mules_cnt);
+		int i;
+		for (i = 0; i < uwsgi.mules_cnt; i++) {
+			if (pipe(uwsgi.rpc_channels[i].doorbell)) {
+				uwsgi_error("uwsgi_rpc_init()/pipe()");
+				exit(1);
+			}
+			uwsgi_socket_nb(uwsgi.rpc_channels[i].doorbell[0]);
+			uwsgi_socket_nb(uwsgi.rpc_channels[i].doorbell[1]);
+			uwsgi.rpc_channels[i].slots = uwsgi_calloc_shared(uwsgi_rpc_slot_size() * uwsgi.rpc_mule_slots);
+		}
+	}
 }
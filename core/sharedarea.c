@@ -1,4 +1,7 @@
 #include <uwsgi.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 extern struct uwsgi_server uwsgi;
 
@@ -19,6 +22,18 @@ This is a very low-level api, try to use it to build higher-level primitives or
 
 */
 
+/*
+	every update bumps the futex of the area, waking the processes sleeping on it
+	(for async cores, the notifier thread of their process)
+*/
+static void uwsgi_sharedarea_notify(struct uwsgi_sharedarea *sa) {
+	uwsgi_atomic_add(sa->futex, 1);
+	uwsgi_atomic_fence();
+	if (uwsgi_atomic_load(sa->waiters)) {
+		uwsgi_futex_wake(&sa->futex, INT_MAX);
+	}
+}
+
 struct uwsgi_sharedarea *uwsgi_sharedarea_get_by_id(int id, uint64_t pos) {
 	if (id > uwsgi.sharedareas_cnt-1) return NULL;
 	struct uwsgi_sharedarea *sa = uwsgi.sharedareas[id];
@@ -30,6 +45,7 @@ int uwsgi_sharedarea_update(int id) {
         struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, 0);
         if (!sa) return -1;
 	sa->updates++;
+	uwsgi_sharedarea_notify(sa);
         return 0;
 }
 
@@ -76,6 +92,7 @@ int uwsgi_sharedarea_write(int id, uint64_t pos, char *blob, uint64_t len) {
 	memcpy(sa->area + pos, blob, len);	
 	sa->updates++;
 	uwsgi_rwunlock(sa->lock);
+	uwsgi_sharedarea_notify(sa);
 	return 0;
 } 
 
@@ -116,135 +133,677 @@ int uwsgi_sharedarea_write32(int id, uint64_t pos, int32_t *value) {
 	return uwsgi_sharedarea_write(id, pos, (char *) value, 4);
 }
 
-int uwsgi_sharedarea_inc8(int id, uint64_t pos, int8_t amount) {
+/*
+	counters are updated with atomic instructions (without taking the area lock),
+	unaligned values (that cannot be updated atomically) fall back to the locked path
+
+	so aligned counters are not serialized with read-modify-write cycles done under
+	uwsgi_sharedarea_wlock(): code updating the same values in both ways must use the
+	atomic ops (or its own locking) for all of them
+*/
+static int uwsgi_sharedarea_add(int id, uint64_t pos, uint8_t bytes, int64_t amount) {
 	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 1 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-	int8_t *n_ptr = (int8_t *) (sa->area + pos);
-        *n_ptr+=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	if (!sa) return -1;
+	if (pos + bytes > sa->max_pos + 1) return -1;
+	char *ptr = sa->area + pos;
+	if ((uintptr_t) ptr % bytes) {
+		int16_t n16; int32_t n32; int64_t n64;
+		uwsgi_wlock(sa->lock);
+		switch(bytes) {
+			case 2:
+				memcpy(&n16, ptr, 2); n16 += amount; memcpy(ptr, &n16, 2);
+				break;
+			case 4:
+				memcpy(&n32, ptr, 4); n32 += amount; memcpy(ptr, &n32, 4);
+				break;
+			default:
+				memcpy(&n64, ptr, 8); n64 += amount; memcpy(ptr, &n64, 8);
+				break;
+		}
+		sa->updates++;
+		uwsgi_rwunlock(sa->lock);
+	}
+	else {
+		switch(bytes) {
+			case 1:
+				uwsgi_atomic_add(*((int8_t *) ptr), (int8_t) amount);
+				break;
+			case 2:
+				uwsgi_atomic_add(*((int16_t *) ptr), (int16_t) amount);
+				break;
+			case 4:
+				uwsgi_atomic_add(*((int32_t *) ptr), (int32_t) amount);
+				break;
+			default:
+				uwsgi_atomic_add(*((int64_t *) ptr), amount);
+				break;
+		}
+	}
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+int uwsgi_sharedarea_inc8(int id, uint64_t pos, int8_t amount) {
+	return uwsgi_sharedarea_add(id, pos, 1, amount);
 }
 
 int uwsgi_sharedarea_inc16(int id, uint64_t pos, int16_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 2 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int16_t *n_ptr = (int16_t *) (sa->area + pos);
-        *n_ptr+=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 2, amount);
 }
 
 int uwsgi_sharedarea_inc32(int id, uint64_t pos, int32_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 4 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int32_t *n_ptr = (int32_t *) (sa->area + pos);
-        *n_ptr+=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 4, amount);
 }
 
 int uwsgi_sharedarea_inc64(int id, uint64_t pos, int64_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 4 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int64_t *n_ptr = (int64_t *) (sa->area + pos);
-        *n_ptr+=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 8, amount);
 }
 
-
 int uwsgi_sharedarea_dec8(int id, uint64_t pos, int8_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 1 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int8_t *n_ptr = (int8_t *) (sa->area + pos);
-        *n_ptr-=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 1, -amount);
 }
 
 int uwsgi_sharedarea_dec16(int id, uint64_t pos, int16_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 2 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int16_t *n_ptr = (int16_t *) (sa->area + pos);
-        *n_ptr-=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 2, -amount);
 }
 
 int uwsgi_sharedarea_dec32(int id, uint64_t pos, int32_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 4 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int32_t *n_ptr = (int32_t *) (sa->area + pos);
-        *n_ptr-=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 4, -amount);
 }
 
 int uwsgi_sharedarea_dec64(int id, uint64_t pos, int64_t amount) {
-        struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, pos);
-        if (!sa) return -1;
-        if (pos + 4 > sa->max_pos + 1) return -1;
-        uwsgi_wlock(sa->lock);
-        int64_t *n_ptr = (int64_t *) (sa->area + pos);
-        *n_ptr-=amount;
-        sa->updates++;
-        uwsgi_rwunlock(sa->lock);
-        return 0;
+	return uwsgi_sharedarea_add(id, pos, 8, -amount);
+}
+
+/*
+	lock-free operations on aligned 64bit values (they return -1 on unaligned positions)
+
+	they are not serialized with the locked writes, so do not mix them on the same values
+*/
+static int64_t *uwsgi_sharedarea_ptr64(int id, uint64_t pos, struct uwsgi_sharedarea **sa) {
+	*sa = uwsgi_sharedarea_get_by_id(id, pos);
+	if (!*sa) return NULL;
+	if (pos + 8 > (*sa)->max_pos + 1) return NULL;
+	char *ptr = (*sa)->area + pos;
+	if ((uintptr_t) ptr % 8) return NULL;
+	return (int64_t *) ptr;
+}
+
+int uwsgi_sharedarea_load64(int id, uint64_t pos, int64_t *value) {
+	struct uwsgi_sharedarea *sa = NULL;
+	int64_t *ptr = uwsgi_sharedarea_ptr64(id, pos, &sa);
+	if (!ptr) return -1;
+	*value = uwsgi_atomic_load(*ptr);
+	return 0;
+}
+
+// old gets the value before the addition
+int uwsgi_sharedarea_fetch_add64(int id, uint64_t pos, int64_t amount, int64_t *old) {
+	struct uwsgi_sharedarea *sa = NULL;
+	int64_t *ptr = uwsgi_sharedarea_ptr64(id, pos, &sa);
+	if (!ptr) return -1;
+	*old = uwsgi_atomic_add(*ptr, amount);
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+// returns 1 (and the current value in old) when the value is not the expected one
+int uwsgi_sharedarea_cas64(int id, uint64_t pos, int64_t expected, int64_t desired, int64_t *old) {
+	struct uwsgi_sharedarea *sa = NULL;
+	int64_t *ptr = uwsgi_sharedarea_ptr64(id, pos, &sa);
+	if (!ptr) return -1;
+	*old = expected;
+	if (!uwsgi_atomic_cas(*ptr, old, desired)) return 1;
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+int uwsgi_sharedarea_swap64(int id, uint64_t pos, int64_t value, int64_t *old) {
+	struct uwsgi_sharedarea *sa = NULL;
+	int64_t *ptr = uwsgi_sharedarea_ptr64(id, pos, &sa);
+	if (!ptr) return -1;
+	*old = __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+static int uwsgi_sharedarea_minmax64(int id, uint64_t pos, int64_t value, int64_t *old, int max) {
+	struct uwsgi_sharedarea *sa = NULL;
+	int64_t *ptr = uwsgi_sharedarea_ptr64(id, pos, &sa);
+	if (!ptr) return -1;
+	*old = uwsgi_atomic_load(*ptr);
+	for (;;) {
+		if (max ? *old >= value : *old <= value) return 0;
+		if (uwsgi_atomic_cas(*ptr, old, value)) break;
+	}
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+int uwsgi_sharedarea_max64(int id, uint64_t pos, int64_t value, int64_t *old) {
+	return uwsgi_sharedarea_minmax64(id, pos, value, old, 1);
+}
+
+int uwsgi_sharedarea_min64(int id, uint64_t pos, int64_t value, int64_t *old) {
+	return uwsgi_sharedarea_minmax64(id, pos, value, old, 0);
+}
+
+/*
+	hashmaps
+
+	an area created with the items option is formatted as a hash map of fixed size entries
+	(keysize and valuesize bytes). The entries are split in stripes, each one being an
+	independent open addressing (linear probing) table with its own lock.
+
+	Writers take the lock of the stripe and make its sequence counter odd while modifying it,
+	readers do not lock: they copy what they need and retry if the counter changed in the meantime.
+
+	Entries are removed with backward shifting, so there are no tombstones.
+*/
+
+#define UWSGI_SHAREDAREA_HASHMAP_USED 1
+#define uwsgi_sharedarea_hashmap_stripe_get(hm, i) (((struct uwsgi_sharedarea_hashmap_stripe *) (((char *) hm) + sizeof(struct uwsgi_sharedarea_hashmap))) + i)
+#define uwsgi_sharedarea_hashmap_entry_get(hm, i, slot) ((struct uwsgi_sharedarea_hashmap_entry *) (((char *) uwsgi_sharedarea_hashmap_stripe_get(hm, hm->stripes)) + ((((i) * (hm->items / hm->stripes)) + (slot)) * hm->entry_size)))
+#define uwsgi_sharedarea_hashmap_value(hm, e) ((e)->data + ((hm->keysize + 7) & ~7ULL))
+
+static struct uwsgi_sharedarea *uwsgi_sharedarea_hashmap_sa(int id) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, 0);
+	if (!sa || !sa->hashmap) return NULL;
+	return sa;
+}
+
+/*
+	returns the slot of the key (found = 1) or the first empty one (found = 0),
+	-1 when the stripe is full. Readers can run it on a changing stripe, so lengths are checked
+*/
+static int64_t uwsgi_sharedarea_hashmap_probe(struct uwsgi_sharedarea_hashmap *hm, uint64_t i, uint32_t hash, char *key, uint16_t keylen, int *found) {
+	uint64_t slots = hm->items / hm->stripes;
+	uint64_t home = (hash / hm->stripes) % slots;
+	uint64_t n;
+	*found = 0;
+	for (n = 0; n < slots; n++) {
+		uint64_t slot = (home + n) % slots;
+		struct uwsgi_sharedarea_hashmap_entry *e = uwsgi_sharedarea_hashmap_entry_get(hm, i, slot);
+		if (!(e->flags & UWSGI_SHAREDAREA_HASHMAP_USED)) return slot;
+		uint16_t e_keylen = e->keylen;
+		if (e->hash == hash && e_keylen == keylen && keylen <= hm->keysize && !memcmp(e->data, key, keylen)) {
+			*found = 1;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+static struct uwsgi_sharedarea_hashmap_stripe *uwsgi_sharedarea_hashmap_wlock(struct uwsgi_sharedarea *sa, uint64_t i) {
+	struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_stripe_get(sa->hashmap, i);
+	uwsgi_lock(sa->hashmap_locks[i]);
+	// already odd if the last writer died while holding the (robust) lock
+	uwsgi_atomic_store(st->seq, st->seq | 1);
+	uwsgi_atomic_fence();
+	return st;
+}
+
+static void uwsgi_sharedarea_hashmap_wunlock(struct uwsgi_sharedarea *sa, uint64_t i, struct uwsgi_sharedarea_hashmap_stripe *st) {
+	uwsgi_atomic_store(st->seq, st->seq + 1);
+	uwsgi_unlock(sa->hashmap_locks[i]);
+}
+
+// wait for the current writer, returns the (even) sequence to check after the read
+static uint64_t uwsgi_sharedarea_hashmap_rbegin(struct uwsgi_sharedarea *sa, uint64_t i, struct uwsgi_sharedarea_hashmap_stripe *st) {
+	int spins = 0;
+	for (;;) {
+		uint64_t seq = uwsgi_atomic_load(st->seq);
+		if (!(seq & 1)) return seq;
+		if (++spins < 1000) continue;
+		// the writer is slow (or dead): wait for it on the lock (fixing the counter if needed)
+		uwsgi_sharedarea_hashmap_wunlock(sa, i, uwsgi_sharedarea_hashmap_wlock(sa, i));
+		spins = 0;
+	}
+}
+
+static int uwsgi_sharedarea_hashmap_rend(struct uwsgi_sharedarea_hashmap_stripe *st, uint64_t seq) {
+	uwsgi_atomic_fence();
+	return uwsgi_atomic_load(st->seq) == seq;
 }
 
+// returns the size of the value (copied in value, at most len bytes) or -1 if the key does not exist
+int64_t uwsgi_sharedarea_hashmap_get(int id, char *key, uint16_t keylen, char *value, uint64_t len) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	struct uwsgi_sharedarea_hashmap *hm = sa->hashmap;
+	uint32_t hash = djb33x_hash(key, keylen);
+	uint64_t i = hash % hm->stripes;
+	struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_stripe_get(hm, i);
+	for (;;) {
+		int64_t ret = -1;
+		int found = 0;
+		uint64_t seq = uwsgi_sharedarea_hashmap_rbegin(sa, i, st);
+		int64_t slot = uwsgi_sharedarea_hashmap_probe(hm, i, hash, key, keylen, &found);
+		if (found) {
+			struct uwsgi_sharedarea_hashmap_entry *e = uwsgi_sharedarea_hashmap_entry_get(hm, i, slot);
+			uint64_t vallen = e->vallen;
+			if (vallen > hm->valuesize) vallen = hm->valuesize;
+			memcpy(value, uwsgi_sharedarea_hashmap_value(hm, e), vallen > len ? len : vallen);
+			ret = vallen;
+		}
+		if (uwsgi_sharedarea_hashmap_rend(st, seq)) {
+			if (ret >= 0) sa->hits++;
+			return ret;
+		}
+	}
+}
+
+int uwsgi_sharedarea_hashmap_set(int id, char *key, uint16_t keylen, char *value, uint64_t vallen) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	struct uwsgi_sharedarea_hashmap *hm = sa->hashmap;
+	if (!keylen || keylen > hm->keysize || vallen > hm->valuesize) return -1;
+	uint32_t hash = djb33x_hash(key, keylen);
+	uint64_t i = hash % hm->stripes;
+	int found = 0;
+	struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_wlock(sa, i);
+	int64_t slot = uwsgi_sharedarea_hashmap_probe(hm, i, hash, key, keylen, &found);
+	if (slot < 0) {
+		uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+		return -1;
+	}
+	struct uwsgi_sharedarea_hashmap_entry *e = uwsgi_sharedarea_hashmap_entry_get(hm, i, slot);
+	memcpy(uwsgi_sharedarea_hashmap_value(hm, e), value, vallen);
+	e->vallen = vallen;
+	if (!found) {
+		e->hash = hash;
+		e->keylen = keylen;
+		memcpy(e->data, key, keylen);
+		e->flags = UWSGI_SHAREDAREA_HASHMAP_USED;
+		st->count++;
+	}
+	sa->updates++;
+	uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+// the value is a 64bit counter created (as 0) if the key does not exist, value gets the result
+int uwsgi_sharedarea_hashmap_inc(int id, char *key, uint16_t keylen, int64_t amount, int64_t *value) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	struct uwsgi_sharedarea_hashmap *hm = sa->hashmap;
+	if (!keylen || keylen > hm->keysize || hm->valuesize < 8) return -1;
+	uint32_t hash = djb33x_hash(key, keylen);
+	uint64_t i = hash % hm->stripes;
+	int found = 0;
+	struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_wlock(sa, i);
+	int64_t slot = uwsgi_sharedarea_hashmap_probe(hm, i, hash, key, keylen, &found);
+	if (slot < 0) {
+		uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+		return -1;
+	}
+	struct uwsgi_sharedarea_hashmap_entry *e = uwsgi_sharedarea_hashmap_entry_get(hm, i, slot);
+	int64_t *n_ptr = (int64_t *) uwsgi_sharedarea_hashmap_value(hm, e);
+	if (!found) {
+		*n_ptr = 0;
+		e->hash = hash;
+		e->keylen = keylen;
+		memcpy(e->data, key, keylen);
+		e->flags = UWSGI_SHAREDAREA_HASHMAP_USED;
+		st->count++;
+	}
+	*n_ptr += amount;
+	e->vallen = 8;
+	*value = *n_ptr;
+	sa->updates++;
+	uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
 
+// returns -1 if the key does not exist
+int uwsgi_sharedarea_hashmap_del(int id, char *key, uint16_t keylen) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	struct uwsgi_sharedarea_hashmap *hm = sa->hashmap;
+	uint32_t hash = djb33x_hash(key, keylen);
+	uint64_t i = hash % hm->stripes;
+	uint64_t slots = hm->items / hm->stripes;
+	int found = 0;
+	struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_wlock(sa, i);
+	int64_t slot = uwsgi_sharedarea_hashmap_probe(hm, i, hash, key, keylen, &found);
+	if (!found) {
+		uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+		return -1;
+	}
+	// move back the following entries of the cluster that would become unreachable
+	uint64_t hole = slot;
+	uint64_t j = slot;
+	for (;;) {
+		j = (j + 1) % slots;
+		struct uwsgi_sharedarea_hashmap_entry *e = uwsgi_sharedarea_hashmap_entry_get(hm, i, j);
+		if (!(e->flags & UWSGI_SHAREDAREA_HASHMAP_USED)) break;
+		uint64_t home = (e->hash / hm->stripes) % slots;
+		// is home cyclically in (hole, j] ?
+		int keep = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+		if (keep) continue;
+		memcpy(uwsgi_sharedarea_hashmap_entry_get(hm, i, hole), e, hm->entry_size);
+		hole = j;
+	}
+	uwsgi_sharedarea_hashmap_entry_get(hm, i, hole)->flags = 0;
+	st->count--;
+	sa->updates++;
+	uwsgi_sharedarea_hashmap_wunlock(sa, i, st);
+	uwsgi_sharedarea_notify(sa);
+	return 0;
+}
+
+/*
+	calls func for each entry (stopping when it returns non-zero)
+
+	every stripe is copied (consistently) before walking it, so func can safely access the hashmap,
+	but changes made to a stripe during the iteration are not seen
+*/
+int uwsgi_sharedarea_hashmap_foreach(int id, int (*func)(char *, uint16_t, char *, uint64_t, void *), void *data) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	struct uwsgi_sharedarea_hashmap *hm = sa->hashmap;
+	uint64_t slots = hm->items / hm->stripes;
+	char *buf = uwsgi_malloc(slots * hm->entry_size);
+	uint64_t i, slot;
+	for (i = 0; i < hm->stripes; i++) {
+		struct uwsgi_sharedarea_hashmap_stripe *st = uwsgi_sharedarea_hashmap_stripe_get(hm, i);
+		for (;;) {
+			uint64_t seq = uwsgi_sharedarea_hashmap_rbegin(sa, i, st);
+			memcpy(buf, uwsgi_sharedarea_hashmap_entry_get(hm, i, 0), slots * hm->entry_size);
+			if (uwsgi_sharedarea_hashmap_rend(st, seq)) break;
+		}
+		for (slot = 0; slot < slots; slot++) {
+			struct uwsgi_sharedarea_hashmap_entry *e = (struct uwsgi_sharedarea_hashmap_entry *) (buf + (slot * hm->entry_size));
+			if (!(e->flags & UWSGI_SHAREDAREA_HASHMAP_USED)) continue;
+			if (func(e->data, e->keylen, uwsgi_sharedarea_hashmap_value(hm, e), e->vallen, data)) goto end;
+		}
+	}
+end:
+	free(buf);
+	return 0;
+}
+
+int64_t uwsgi_sharedarea_hashmap_count(int id) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return -1;
+	int64_t count = 0;
+	uint64_t i;
+	for (i = 0; i < sa->hashmap->stripes; i++) {
+		count += uwsgi_atomic_load(uwsgi_sharedarea_hashmap_stripe_get(sa->hashmap, i)->count);
+	}
+	return count;
+}
+
+uint64_t uwsgi_sharedarea_hashmap_valuesize(int id) {
+	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_hashmap_sa(id);
+	if (!sa) return 0;
+	return sa->hashmap->valuesize;
+}
+
+static uint64_t uwsgi_sharedarea_hashmap_size(uint64_t items, uint64_t keysize, uint64_t valuesize, uint64_t stripes) {
+	uint64_t entry_size = sizeof(struct uwsgi_sharedarea_hashmap_entry) + ((keysize + 7) & ~7ULL) + ((valuesize + 7) & ~7ULL);
+	return sizeof(struct uwsgi_sharedarea_hashmap) + (stripes * sizeof(struct uwsgi_sharedarea_hashmap_stripe)) + (items * entry_size);
+}
+
+static void uwsgi_sharedarea_hashmap_init(struct uwsgi_sharedarea *sa, uint64_t items, uint64_t keysize, uint64_t valuesize, uint64_t stripes) {
+	uint64_t size = uwsgi_sharedarea_hashmap_size(items, keysize, valuesize, stripes);
+	if (size > sa->max_pos + 1) {
+		uwsgi_log("sharedarea %d is too small for a hashmap of %llu items (%llu bytes needed)\n", sa->id, (unsigned long long) items, (unsigned long long) size);
+		exit(1);
+	}
+	struct uwsgi_sharedarea_hashmap *hm = (struct uwsgi_sharedarea_hashmap *) sa->area;
+	uint64_t i;
+	if (hm->magic == UWSGI_SHAREDAREA_HASHMAP_MAGIC) {
+		if (hm->items != items || hm->keysize != keysize || hm->valuesize != valuesize || hm->stripes != stripes) {
+			uwsgi_log("sharedarea %d contains a hashmap with a different layout\n", sa->id);
+			exit(1);
+		}
+		// writers killed during the last run
+		for (i = 0; i < stripes; i++) {
+			uwsgi_sharedarea_hashmap_stripe_get(hm, i)->seq &= ~1ULL;
+		}
+	}
+	else if (hm->magic) {
+		uwsgi_log("sharedarea %d does not contain a valid hashmap\n", sa->id);
+		exit(1);
+	}
+	else {
+		memset(sa->area, 0, size);
+		hm->items = items;
+		hm->keysize = keysize;
+		hm->valuesize = valuesize;
+		hm->stripes = stripes;
+		hm->entry_size = sizeof(struct uwsgi_sharedarea_hashmap_entry) + ((keysize + 7) & ~7ULL) + ((valuesize + 7) & ~7ULL);
+		hm->magic = UWSGI_SHAREDAREA_HASHMAP_MAGIC;
+	}
+	sa->hashmap = hm;
+	sa->hashmap_locks = uwsgi_malloc(sizeof(struct uwsgi_lock_item *) * stripes);
+	char *id_str = uwsgi_num2str(sa->id);
+	char *name = uwsgi_concat2("sharedarea hashmap ", id_str);
+	free(id_str);
+	for (i = 0; i < stripes; i++) {
+		sa->hashmap_locks[i] = uwsgi_lock_init(name);
+	}
+	uwsgi_log("sharedarea %d formatted as hashmap: %llu items (keysize: %llu valuesize: %llu stripes: %llu)\n", sa->id, (unsigned long long) items, (unsigned long long) keysize, (unsigned long long) valuesize, (unsigned long long) stripes);
+}
+
+#ifdef __linux__
+/*
+	async cores cannot block on the futex (they would stop the whole loop), so every process
+	runs a notifier thread for each area they wait on: it sleeps on the futex and on every update
+	wakes the waiting cores writing to their eventfd (monitored by the loop engine)
+
+	the thread is a futex waiter only while some core of its process is waiting, otherwise
+	every update of the area (counters included) would pay a futex wake syscall
+*/
+struct uwsgi_sharedarea_notifier {
+	pid_t pid;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	// the eventfd of each core waiting for the area, -1 when not waiting
+	int *fds;
+	// number of waiting cores
+	int waiting;
+	struct uwsgi_sharedarea *sa;
+	// the sequence seen by the first core waiting after an idle period (its updates are not lost)
+	uint32_t seq;
+};
+
+static struct uwsgi_sharedarea_notifier **sa_notifiers;
+static int *sa_core_fds;
+static pthread_mutex_t sa_notifiers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *uwsgi_sharedarea_notifier_loop(void *arg) {
+	struct uwsgi_sharedarea_notifier *usn = (struct uwsgi_sharedarea_notifier *) arg;
+	struct uwsgi_sharedarea *sa = usn->sa;
+	sigset_t smask;
+	sigfillset(&smask);
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	uint32_t seq = 0;
+	int active = 0;
+	for (;;) {
+		pthread_mutex_lock(&usn->lock);
+		if (!usn->waiting)
+			active = 0;
+		while (!usn->waiting)
+			pthread_cond_wait(&usn->cond, &usn->lock);
+		if (!active) {
+			seq = usn->seq;
+			active = 1;
+		}
+		pthread_mutex_unlock(&usn->lock);
+
+		uwsgi_atomic_add(sa->waiters, 1);
+		// bounded, to stop being a waiter soon after the last core is gone
+		uwsgi_futex_wait(&sa->futex, seq, 1000);
+		uwsgi_atomic_sub(sa->waiters, 1);
+		uint32_t current = uwsgi_atomic_load(sa->futex);
+		if (current == seq) continue;
+		seq = current;
+		pthread_mutex_lock(&usn->lock);
+		int i;
+		for (i = 0; i < uwsgi.cores; i++) {
+			if (usn->fds[i] < 0) continue;
+			uint64_t one = 1;
+			if (write(usn->fds[i], &one, sizeof(uint64_t)) != sizeof(uint64_t)) {
+				uwsgi_error("uwsgi_sharedarea_notifier_loop()/write()");
+			}
+		}
+		pthread_mutex_unlock(&usn->lock);
+	}
+	return NULL;
+}
+
+// the notifier of the area for the current process (started on the first wait)
+static struct uwsgi_sharedarea_notifier *uwsgi_sharedarea_notifier_get(struct uwsgi_sharedarea *sa) {
+	pid_t pid = getpid();
+	struct uwsgi_sharedarea_notifier *usn = NULL;
+	pthread_mutex_lock(&sa_notifiers_lock);
+	if (!sa_notifiers) {
+		sa_notifiers = uwsgi_calloc(sizeof(struct uwsgi_sharedarea_notifier *) * uwsgi.sharedareas_cnt);
+	}
+	if (!sa_core_fds) {
+		sa_core_fds = uwsgi_malloc(sizeof(int) * uwsgi.cores);
+		memset(sa_core_fds, -1, sizeof(int) * uwsgi.cores);
+	}
+	// threads do not survive fork()
+	if (sa_notifiers[sa->id] && sa_notifiers[sa->id]->pid == pid) {
+		usn = sa_notifiers[sa->id];
+		goto end;
+	}
+	usn = uwsgi_calloc(sizeof(struct uwsgi_sharedarea_notifier));
+	usn->pid = pid;
+	usn->sa = sa;
+	pthread_mutex_init(&usn->lock, NULL);
+	pthread_cond_init(&usn->cond, NULL);
+	usn->fds = uwsgi_malloc(sizeof(int) * uwsgi.cores);
+	memset(usn->fds, -1, sizeof(int) * uwsgi.cores);
+	pthread_t tid;
+	if (pthread_create(&tid, NULL, uwsgi_sharedarea_notifier_loop, usn)) {
+		uwsgi_error("uwsgi_sharedarea_notifier_get()/pthread_create()");
+		free(usn->fds);
+		free(usn);
+		usn = NULL;
+		goto end;
+	}
+	pthread_detach(tid);
+	sa_notifiers[sa->id] = usn;
+end:
+	pthread_mutex_unlock(&sa_notifiers_lock);
+	return usn;
+}
+
+static int uwsgi_sharedarea_wait_async(struct uwsgi_sharedarea *sa, uint32_t seq, int timeout) {
+	struct wsgi_request *wsgi_req = current_wsgi_req();
+	int core_id = wsgi_req->async_id;
+	struct uwsgi_sharedarea_notifier *usn = uwsgi_sharedarea_notifier_get(sa);
+	if (!usn) return -1;
+
+	int fd = sa_core_fds[core_id];
+	if (fd < 0) {
+		fd = eventfd(0, EFD_NONBLOCK);
+		if (fd < 0) {
+			uwsgi_error("uwsgi_sharedarea_wait_async()/eventfd()");
+			return -1;
+		}
+		sa_core_fds[core_id] = fd;
+	}
+
+	pthread_mutex_lock(&usn->lock);
+	usn->fds[core_id] = fd;
+	if (!usn->waiting++) {
+		usn->seq = seq;
+		pthread_cond_signal(&usn->cond);
+	}
+	pthread_mutex_unlock(&usn->lock);
+
+	int ret = -2;
+	time_t deadline = timeout > 0 ? uwsgi_now() + timeout : 0;
+	for (;;) {
+		// the notifier could have missed updates made before the registration
+		if (uwsgi_atomic_load(sa->futex) != seq) {
+			ret = 0;
+			break;
+		}
+		// 0 waits forever: loop on a long timeout (some hooks, like gevent, treat 0 as 'expire now')
+		int remains = 3600;
+		if (deadline) {
+			remains = deadline - uwsgi_now();
+			if (remains <= 0) break;
+		}
+		int rlen = uwsgi.wait_read_hook(fd, remains);
+		if (rlen < 0) {
+			ret = -1;
+			break;
+		}
+		if (rlen > 0) {
+			uint64_t counter;
+			if (read(fd, &counter, sizeof(uint64_t)) < 0 && errno != EAGAIN) {
+				uwsgi_error("uwsgi_sharedarea_wait_async()/read()");
+				ret = -1;
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_lock(&usn->lock);
+	usn->fds[core_id] = -1;
+	usn->waiting--;
+	pthread_mutex_unlock(&usn->lock);
+	return ret;
+}
+#endif
 
 /*
 	returns:
 		0 -> on updates
 		-1 -> on error
 		-2 -> on timeout
+
+	timeout is in seconds (0 waits forever, < 0 waits freq milliseconds)
 */
 int uwsgi_sharedarea_wait(int id, int freq, int timeout) {
-	int waiting = 0;
 	struct uwsgi_sharedarea *sa = uwsgi_sharedarea_get_by_id(id, 0);
 	if (!sa) return -1;
 	if (!freq) freq = 100;
-	uwsgi_rlock(sa->lock);
-	uint64_t updates = sa->updates;
-	uwsgi_rwunlock(sa->lock);
-	while(timeout == 0 || waiting == 0 || (timeout > 0 && waiting > 0 && (waiting/1000) < timeout)) {
-		if (uwsgi.wait_milliseconds_hook(freq)) {
-			uwsgi_rwunlock(sa->lock);
-			return -1;
+	uint32_t seq = uwsgi_atomic_load(sa->futex);
+
+	if (timeout < 0) {
+		if (uwsgi.wait_milliseconds_hook(freq)) return -1;
+		return uwsgi_atomic_load(sa->futex) != seq ? 0 : -2;
+	}
+
+	// suspend engines get notified via their loop
+	if (uwsgi.wait_read_hook != uwsgi_simple_wait_read_hook) {
+#ifdef __linux__
+		return uwsgi_sharedarea_wait_async(sa, seq, timeout);
+#else
+		int waiting = 0;
+		while (timeout == 0 || (waiting / 1000) < timeout) {
+			if (uwsgi.wait_milliseconds_hook(freq)) return -1;
+			waiting += freq;
+			if (uwsgi_atomic_load(sa->futex) != seq) return 0;
 		}
-		waiting += freq;
-		// lock sa
-		uwsgi_rlock(sa->lock);
-		if (sa->updates != updates) {
-			uwsgi_rwunlock(sa->lock);
-			return 0;
+		return -2;
+#endif
+	}
+
+	uint64_t deadline = timeout > 0 ? uwsgi_micros() + (timeout * 1000000ULL) : 0;
+	for (;;) {
+		int ms = -1;
+		if (deadline) {
+			uint64_t now = uwsgi_micros();
+			if (now >= deadline) return -2;
+			ms = ((deadline - now) / 1000) + 1;
 		}
-		// unlock sa
-		uwsgi_rwunlock(sa->lock);
+		uwsgi_atomic_add(sa->waiters, 1);
+		uwsgi_futex_wait(&sa->futex, seq, ms);
+		uwsgi_atomic_sub(sa->waiters, 1);
+		if (uwsgi_atomic_load(sa->futex) != seq) return 0;
 	}
-	return -2;
 }
 
 int uwsgi_sharedarea_new_id() {
@@ -326,6 +885,10 @@ struct uwsgi_sharedarea *uwsgi_sharedarea_init_keyval(char *arg) {
 	char *s_ptr = NULL;
 	char *s_size = NULL;
 	char *s_offset = NULL;
+	char *s_items = NULL;
+	char *s_keysize = NULL;
+	char *s_valuesize = NULL;
+	char *s_stripes = NULL;
 	if (uwsgi_kvlist_parse(arg, strlen(arg), ',', '=',
 		"pages", &s_pages,
 		"file", &s_file,
@@ -333,6 +896,10 @@ struct uwsgi_sharedarea *uwsgi_sharedarea_init_keyval(char *arg) {
 		"ptr", &s_ptr,
 		"size", &s_size,
 		"offset", &s_offset,
+		"items", &s_items,
+		"keysize", &s_keysize,
+		"valuesize", &s_valuesize,
+		"stripes", &s_stripes,
 		NULL)) {
 		uwsgi_log("invalid sharedarea keyval syntax\n");
 		exit(1);
@@ -365,16 +932,46 @@ struct uwsgi_sharedarea *uwsgi_sharedarea_init_keyval(char *arg) {
 		pages = atoi(s_pages);	
 	}
 
+	uint64_t items = 0, keysize = 64, valuesize = 64, stripes = 64;
+	if (s_items) {
+		items = uwsgi_n64(s_items);
+		if (s_keysize) keysize = uwsgi_n64(s_keysize);
+		if (s_valuesize) valuesize = uwsgi_n64(s_valuesize);
+		if (s_stripes) stripes = uwsgi_n64(s_stripes);
+		if (!items || !keysize || keysize > 0xffff || !stripes) {
+			uwsgi_log("invalid sharedarea hashmap parameters !!! [%s]\n", arg);
+			exit(1);
+		}
+		if (stripes > items) stripes = items;
+		// every stripe gets the same number of entries
+		if (items % stripes) items += stripes - (items % stripes);
+		// size the area for the hashmap if not specified
+		if (!len && !pages) {
+			len = uwsgi_sharedarea_hashmap_size(items, keysize, valuesize, stripes);
+			pages = len / (size_t) uwsgi.page_size;
+			if (len % (size_t) uwsgi.page_size != 0) pages++;
+		}
+	}
+
 	char *area = NULL;
 	struct uwsgi_sharedarea *sa = NULL;
 
 	int fd = -1;
 	if (s_file) {
-		fd = open(s_file, O_RDWR|O_SYNC);
+		// hashmap stores are created on the first run
+		fd = open(s_file, O_RDWR|O_SYNC|(s_items ? O_CREAT : 0), S_IRUSR|S_IWUSR);
 		if (fd < 0) {
 			uwsgi_error_open(s_file);
 			exit(1);
 		}	
+		// a new hashmap store
+		struct stat st;
+		if (s_items && !fstat(fd, &st) && st.st_size < (off_t) (offset + len)) {
+			if (ftruncate(fd, offset + len)) {
+				uwsgi_error("uwsgi_sharedarea_init_keyval()/ftruncate()");
+				exit(1);
+			}
+		}
 	}
 	else if (s_fd) {
 		fd = atoi(s_fd);
@@ -405,6 +1002,14 @@ struct uwsgi_sharedarea *uwsgi_sharedarea_init_keyval(char *arg) {
 	if (s_size) free(s_size);
 	if (s_offset) free(s_offset);
 
+	if (s_items) {
+		uwsgi_sharedarea_hashmap_init(sa, items, keysize, valuesize, stripes);
+		free(s_items);
+	}
+	if (s_keysize) free(s_keysize);
+	if (s_valuesize) free(s_valuesize);
+	if (s_stripes) free(s_stripes);
+
 	return sa;
 }
 
@@ -288,11 +288,121 @@ end:
 
 }
 
+/*
+	mark a signal as pending in the shared memory bitmap of a signal socket
+
+	the wakeup byte is written only by the first signal of a batch (the one arming the receiver),
+	the following ones are only bits in memory until the receiver takes the whole bitmap
+*/
+static int uwsgi_signal_post(struct uwsgi_signal_bitmap *usb, int fd, uint8_t sig) {
+
+	uint64_t bit = 1ULL << (sig & 63);
+	if (uwsgi_atomic_or(usb->pending[sig >> 6], bit) & bit) {
+		uwsgi_atomic_add(uwsgi.shared->coalesced_signals, 1);
+	}
+
+	if (uwsgi_atomic_xchg(usb->armed, 1)) {
+		uwsgi.shared->routed_signals++;
+		return 0;
+	}
+
+	if (write(fd, &sig, 1) != 1) {
+		// a full socket means the receiver has already been woken up
+		if (!uwsgi_is_again()) {
+			uwsgi_error("uwsgi_signal_post()");
+			uwsgi_atomic_store(usb->armed, 0);
+			uwsgi.shared->unrouted_signals++;
+			return -1;
+		}
+	}
+	uwsgi.shared->routed_signals++;
+	return 0;
+}
+
+// take (and clear) all of the signals pending on a bitmap
+static void uwsgi_signal_take(struct uwsgi_signal_bitmap *usb, uint64_t *pending) {
+	int i;
+	// disarm before taking the bits, a signal posted from now on writes a new wakeup byte
+	uwsgi_atomic_store(usb->armed, 0);
+	uwsgi_atomic_fence();
+	for (i = 0; i < 4; i++) {
+		pending[i] = uwsgi_atomic_load(usb->pending[i]) ? uwsgi_atomic_xchg(usb->pending[i], 0) : 0;
+	}
+}
+
+int uwsgi_signal_pending(struct uwsgi_signal_bitmap *usb) {
+	int i, count = 0;
+	for (i = 0; i < 4; i++) {
+		count += __builtin_popcountll(uwsgi_atomic_load(usb->pending[i]));
+	}
+	return count;
+}
+
+/*
+	post again the signals left behind on a bitmap (master only)
+
+	a receiver dying (or dropping its queue) between reading the wakeup byte and taking the bitmap
+	leaves it armed forever, so if no wakeup byte is in the socket (rfd is the receiver side)
+	the bitmap is disarmed and, if some signal is pending, a new wakeup byte is written
+*/
+static void uwsgi_signal_kick(struct uwsgi_signal_bitmap *usb, int fd, int rfd) {
+	int queued = 0;
+	uint8_t wakeup = 0;
+
+	if (fd < 0 || rfd < 0)
+		return;
+
+	if (ioctl(rfd, FIONREAD, &queued)) {
+		uwsgi_error("uwsgi_signal_kick()/ioctl()");
+		return;
+	}
+	if (queued > 0)
+		return;
+
+	uwsgi_atomic_store(usb->armed, 0);
+	uwsgi_atomic_fence();
+	if (!uwsgi_signal_pending(usb))
+		return;
+	// a concurrent uwsgi_signal_post() already woke up the receiver
+	if (uwsgi_atomic_xchg(usb->armed, 1))
+		return;
+	if (write(fd, &wakeup, 1) != 1 && !uwsgi_is_again()) {
+		uwsgi_error("uwsgi_signal_kick()/write()");
+		uwsgi_atomic_store(usb->armed, 0);
+	}
+}
+
+// called by the master on every cycle and before (re)spawning workers, mules and spoolers
+void uwsgi_signal_kick_all() {
+	int i;
+
+	if (!uwsgi.master_process)
+		return;
+
+	uwsgi_signal_kick(&uwsgi.shared->worker_signals, uwsgi.shared->worker_signal_pipe[0], uwsgi.shared->worker_signal_pipe[1]);
+	uwsgi_signal_kick(&uwsgi.shared->spooler_signals, uwsgi.shared->spooler_signal_pipe[0], uwsgi.shared->spooler_signal_pipe[1]);
+	uwsgi_signal_kick(&uwsgi.shared->mule_signals, uwsgi.shared->mule_signal_pipe[0], uwsgi.shared->mule_signal_pipe[1]);
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		uwsgi_signal_kick(&uwsgi.workers[i].signals_pending, uwsgi.workers[i].signal_pipe[0], uwsgi.workers[i].signal_pipe[1]);
+	}
+	for (i = 0; i < uwsgi.mules_cnt; i++) {
+		uwsgi_signal_kick(&uwsgi.mules[i].signals_pending, uwsgi.mules[i].signal_pipe[0], uwsgi.mules[i].signal_pipe[1]);
+	}
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
+		uwsgi_signal_kick(&uwsgi.farms[i].signals_pending, uwsgi.farms[i].signal_pipe[0], uwsgi.farms[i].signal_pipe[1]);
+	}
+}
+
 int uwsgi_signal_send(int fd, uint8_t sig) {
 
 	socklen_t so_bufsize_len = sizeof(int);
 	int so_bufsize = 0;
 
+	// signals raised by workers, spoolers and mules are coalesced in the master bitmap
+	if (fd == uwsgi.signal_socket) {
+		return uwsgi_signal_post(&uwsgi.shared->master_signals, fd, sig);
+	}
+
 	if (write(fd, &sig, 1) != 1) {
 		if (errno == EAGAIN || errno == EWOULDBLOCK) {
 			if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &so_bufsize, &so_bufsize_len)) {
@@ -311,6 +421,22 @@ int uwsgi_signal_send(int fd, uint8_t sig) {
 
 }
 
+// route all of the signals raised by workers, spoolers and mules
+void uwsgi_route_pending_signals() {
+
+	uint64_t pending[4];
+	int i;
+
+	uwsgi_signal_take(&uwsgi.shared->master_signals, pending);
+	for (i = 0; i < 4; i++) {
+		while (pending[i]) {
+			uint8_t sig = (i << 6) + __builtin_ctzll(pending[i]);
+			pending[i] &= pending[i] - 1;
+			uwsgi_route_signal(sig);
+		}
+	}
+}
+
 void uwsgi_route_signal(uint8_t sig) {
 
 	int pos = (uwsgi.mywid * 256) + sig;
@@ -319,14 +445,14 @@ void uwsgi_route_signal(uint8_t sig) {
 
 	// send to first available worker
 	if (use->receiver[0] == 0 || !strcmp(use->receiver, "worker") || !strcmp(use->receiver, "worker0")) {
-		if (uwsgi_signal_send(ushared->worker_signal_pipe[0], sig)) {
+		if (uwsgi_signal_post(&ushared->worker_signals, ushared->worker_signal_pipe[0], sig)) {
 			uwsgi_log("could not deliver signal %d to workers pool\n", sig);
 		}
 	}
 	// send to all workers
 	else if (!strcmp(use->receiver, "workers")) {
 		for (i = 1; i <= uwsgi.numproc; i++) {
-			if (uwsgi_signal_send(uwsgi.workers[i].signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&uwsgi.workers[i].signals_pending, uwsgi.workers[i].signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to worker %d\n", sig, i);
 			}
 		}
@@ -335,7 +461,7 @@ void uwsgi_route_signal(uint8_t sig) {
 	else if (!strcmp(use->receiver, "active-workers")) {
                 for (i = 1; i <= uwsgi.numproc; i++) {
 			if (uwsgi.workers[i].pid > 0 && !uwsgi.workers[i].cheaped && !uwsgi.workers[i].suspended) {
-                        	if (uwsgi_signal_send(uwsgi.workers[i].signal_pipe[0], sig)) {
+                        	if (uwsgi_signal_post(&uwsgi.workers[i].signals_pending, uwsgi.workers[i].signal_pipe[0], sig)) {
                                 	uwsgi_log("could not deliver signal %d to worker %d\n", sig, i);
                         	}
 			}
@@ -347,7 +473,7 @@ void uwsgi_route_signal(uint8_t sig) {
 		if (i > uwsgi.numproc) {
 			uwsgi_log("invalid signal target: %s\n", use->receiver);
 		}
-		if (uwsgi_signal_send(uwsgi.workers[i].signal_pipe[0], sig)) {
+		else if (uwsgi_signal_post(&uwsgi.workers[i].signals_pending, uwsgi.workers[i].signal_pipe[0], sig)) {
 			uwsgi_log("could not deliver signal %d to worker %d\n", sig, i);
 		}
 	}
@@ -357,14 +483,14 @@ void uwsgi_route_signal(uint8_t sig) {
 	// route to spooler
 	else if (!strcmp(use->receiver, "spooler")) {
 		if (ushared->worker_signal_pipe[0] != -1) {
-			if (uwsgi_signal_send(ushared->spooler_signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&ushared->spooler_signals, ushared->spooler_signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to the spooler\n", sig);
 			}
 		}
 	}
 	else if (!strcmp(use->receiver, "mules")) {
 		for (i = 0; i < uwsgi.mules_cnt; i++) {
-			if (uwsgi_signal_send(uwsgi.mules[i].signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&uwsgi.mules[i].signals_pending, uwsgi.mules[i].signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to mule %d\n", sig, i + 1);
 			}
 		}
@@ -375,12 +501,12 @@ void uwsgi_route_signal(uint8_t sig) {
 			uwsgi_log("invalid signal target: %s\n", use->receiver);
 		}
 		else if (i == 0) {
-			if (uwsgi_signal_send(ushared->mule_signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&ushared->mule_signals, ushared->mule_signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to a mule\n", sig);
 			}
 		}
 		else {
-			if (uwsgi_signal_send(uwsgi.mules[i - 1].signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&uwsgi.mules[i - 1].signals_pending, uwsgi.mules[i - 1].signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to mule %d\n", sig, i);
 			}
 		}
@@ -392,7 +518,7 @@ void uwsgi_route_signal(uint8_t sig) {
 			uwsgi_log("unknown farm: %s\n", name);
 			return;
 		}
-		if (uwsgi_signal_send(uf->signal_pipe[0], sig)) {
+		if (uwsgi_signal_post(&uf->signals_pending, uf->signal_pipe[0], sig)) {
 			uwsgi_log("could not deliver signal %d to farm %d (%s)\n", sig, uf->id, uf->name);
 		}
 	}
@@ -402,7 +528,7 @@ void uwsgi_route_signal(uint8_t sig) {
 			uwsgi_log("invalid signal target: %s\n", use->receiver);
 		}
 		else {
-			if (uwsgi_signal_send(uwsgi.farms[i - 1].signal_pipe[0], sig)) {
+			if (uwsgi_signal_post(&uwsgi.farms[i - 1].signals_pending, uwsgi.farms[i - 1].signal_pipe[0], sig)) {
 				uwsgi_log("could not deliver signal %d to farm %d (%s)\n", sig, i, uwsgi.farms[i - 1].name);
 			}
 		}
@@ -417,16 +543,10 @@ void uwsgi_route_signal(uint8_t sig) {
 
 int uwsgi_signal_wait(struct wsgi_request *wsgi_req, int signum) {
 
-	int wait_for_specific_signal = 0;
-	uint8_t uwsgi_signal = 0;
 	int received_signal = -1;
 	int ret;
 	struct pollfd pfd[2];
 
-	if (signum > -1) {
-		wait_for_specific_signal = 1;
-	}
-
 	pfd[0].fd = uwsgi.signal_socket;
 	pfd[0].events = POLLIN;
 	pfd[1].fd = uwsgi.my_signal_socket;
@@ -435,43 +555,35 @@ int uwsgi_signal_wait(struct wsgi_request *wsgi_req, int signum) {
 cycle:
 	ret = poll(pfd, 2, -1);
 	if (ret > 0) {
-		if (pfd[0].revents == POLLIN) {
-			if (read(uwsgi.signal_socket, &uwsgi_signal, 1) != 1) {
-				uwsgi_error("read()");
-			}
-			else {
-				(void) uwsgi_signal_handler(wsgi_req, uwsgi_signal);
-				if (wait_for_specific_signal) {
-					if (signum != uwsgi_signal)
-						goto cycle;
-				}
-				received_signal = uwsgi_signal;
-			}
-		}
-		if (pfd[1].revents == POLLIN) {
-			if (read(uwsgi.my_signal_socket, &uwsgi_signal, 1) != 1) {
-				uwsgi_error("read()");
-			}
-			else {
-				(void) uwsgi_signal_handler(wsgi_req, uwsgi_signal);
-				if (wait_for_specific_signal) {
-					if (signum != uwsgi_signal)
-						goto cycle;
-				}
-			}
-			received_signal = uwsgi_signal;
+		int i;
+		for (i = 0; i < 2; i++) {
+			if (pfd[i].revents != POLLIN)
+				continue;
+			if (uwsgi_read_signal(pfd[i].fd, "worker", uwsgi.mywid))
+				continue;
+			int sig = uwsgi_signal_dispatch(wsgi_req, pfd[i].fd, "worker", uwsgi.mywid, signum);
+			if (sig > -1)
+				received_signal = sig;
 		}
-
+		// spurious wakeup (or the pool signals have been taken by another worker)
+		if (received_signal < 0)
+			goto cycle;
+		if (signum > -1 && received_signal != signum)
+			goto cycle;
 	}
 
 	return received_signal;
 }
 
-void uwsgi_receive_signal(struct wsgi_request *wsgi_req, int fd, char *name, int id) {
+/*
+	consume the wakeup bytes of a signal socket (returns 0 if the socket has been signaled)
 
-	uint8_t uwsgi_signal;
+	if the master disconnected, the process is destroyed
+*/
+int uwsgi_read_signal(int fd, char *name, int id) {
 
-	ssize_t ret = read(fd, &uwsgi_signal, 1);
+	char wakeup[64];
+	ssize_t ret = read(fd, wakeup, 64);
 
 	if (ret == 0) {
 		goto destroy;
@@ -481,19 +593,81 @@ void uwsgi_receive_signal(struct wsgi_request *wsgi_req, int fd, char *name, int
 		goto destroy;
 	}
 	else if (ret > 0) {
-#ifdef UWSGI_DEBUG
-		uwsgi_log_verbose("master sent signal %d to %s %d\n", uwsgi_signal, name, id);
-#endif
-		if (uwsgi_signal_handler(wsgi_req, uwsgi_signal)) {
-			uwsgi_log_verbose("error managing signal %d on %s %d\n", uwsgi_signal, name, id);
-		}
+		return 0;
 	}
 
-	return;
+	return -1;
 
 destroy:
 	// better to kill the whole worker...
 	uwsgi_log_verbose("uWSGI %s %d screams: UAAAAAAH my master disconnected: I will kill myself!!!\n", name, id);
 	end_me(0);
+	// never here
+	return -1;
+}
+
+static struct uwsgi_signal_bitmap *uwsgi_signal_bitmap_by_fd(int fd) {
+	int i;
+	if (fd == uwsgi.signal_socket)
+		return uwsgi.signal_bitmap;
+	if (fd == uwsgi.my_signal_socket)
+		return uwsgi.my_signal_bitmap;
+	for (i = 0; i < uwsgi.farms_cnt; i++) {
+		if (uwsgi.farms[i].signal_pipe[1] == fd && uwsgi_farm_has_mule(&uwsgi.farms[i], uwsgi.muleid))
+			return &uwsgi.farms[i].signals_pending;
+	}
+	return NULL;
+}
+
+/*
+	the wakeup byte of a signal socket has been consumed but its signals will not be taken (the process is going away):
+	disarm the bitmap, so the next signal writes a new wakeup byte, the master posts the pending ones again
+*/
+void uwsgi_signal_disarm(int fd) {
+	struct uwsgi_signal_bitmap *usb = uwsgi_signal_bitmap_by_fd(fd);
+	if (usb)
+		uwsgi_atomic_store(usb->armed, 0);
+}
+
+/*
+	take all of the signals pending on a signal socket and run their handlers (in signal number order)
+
+	returns 'signum' if it was in the batch, otherwise the last managed signal (-1 if none)
+*/
+int uwsgi_signal_dispatch(struct wsgi_request *wsgi_req, int fd, char *name, int id, int signum) {
+
+	struct uwsgi_signal_bitmap *usb = uwsgi_signal_bitmap_by_fd(fd);
+	uint64_t pending[4];
+	int i, received_signal = -1, found = 0;
+
+	if (!usb)
+		return -1;
+
+	uwsgi_signal_take(usb, pending);
+
+	for (i = 0; i < 4; i++) {
+		while (pending[i]) {
+			uint8_t uwsgi_signal = (i << 6) + __builtin_ctzll(pending[i]);
+			pending[i] &= pending[i] - 1;
+#ifdef UWSGI_DEBUG
+			uwsgi_log_verbose("master sent signal %d to %s %d\n", uwsgi_signal, name, id);
+#endif
+			if (uwsgi_signal_handler(wsgi_req, uwsgi_signal)) {
+				uwsgi_log_verbose("error managing signal %d on %s %d\n", uwsgi_signal, name, id);
+			}
+			if (uwsgi_signal == signum)
+				found = 1;
+			received_signal = uwsgi_signal;
+		}
+	}
+
+	return found ? signum : received_signal;
+}
+
+void uwsgi_receive_signal(struct wsgi_request *wsgi_req, int fd, char *name, int id) {
+
+	if (uwsgi_read_signal(fd, name, id))
+		return;
 
+	uwsgi_signal_dispatch(wsgi_req, fd, name, id, -1);
 }
@@ -4,11 +4,31 @@
 #include "strings.h"
 #endif
 
+#ifdef UWSGI_EVENT_FILEMONITOR_USE_INOTIFY
+#ifndef OBSOLETE_LINUX_KERNEL
+#define UWSGI_SPOOLER_INDEX
+#include <sys/inotify.h>
+#endif
+#endif
+
 extern struct uwsgi_server uwsgi;
 
 static void spooler_readdir(struct uwsgi_spooler *, char *dir);
 static void spooler_scandir(struct uwsgi_spooler *, char *dir);
-static void spooler_manage_task(struct uwsgi_spooler *, char *, char *);
+struct uwsgi_spooler_task;
+static int spooler_manage_task(struct uwsgi_spooler *, char *, char *, struct uwsgi_spooler_task *);
+static void spooler_wakeup_spoolers(struct uwsgi_spooler *);
+static int spooler_index_timeout(int);
+static void spooler_log_start(struct uwsgi_spooler *);
+static void spooler_log_run(struct uwsgi_spooler *);
+static uint64_t spooler_log_pending(void);
+static void spooler_threads_init(struct uwsgi_spooler *, int);
+static void spooler_threads_collect(struct uwsgi_spooler *, int);
+#ifdef UWSGI_SPOOLER_INDEX
+static int spooler_index_init(struct uwsgi_spooler *, int);
+static void spooler_index_run(struct uwsgi_spooler *);
+static void spooler_index_requeue(struct uwsgi_spooler *, struct uwsgi_spooler_task *, char *);
+#endif
 
 // increment it whenever a signal is raised
 static uint64_t wakeup = 0;
@@ -28,6 +48,11 @@ void uwsgi_opt_add_spooler(char *opt, char *directory, void *mode) {
 		exit(1);
 	}
 
+	if ((long) mode == UWSGI_SPOOLER_LOG && uwsgi.spooler_numproc > 1) {
+		uwsgi_log("[spooler] log based spoolers (%s) can only run a single process\n", directory);
+		exit(1);
+	}
+
 	if (uwsgi.spooler_numproc > 0) {
 		for (i = 0; i < uwsgi.spooler_numproc; i++) {
 			us = uwsgi_new_spooler(directory);
@@ -68,6 +93,7 @@ struct uwsgi_spooler *uwsgi_new_spooler(char *dir) {
 		exit(1);
 	}
 
+	uspool->latency = uwsgi_calloc_shared(sizeof(struct uwsgi_histogram));
 	uspool->next = NULL;
 
 	return uspool;
@@ -92,6 +118,9 @@ pid_t spooler_start(struct uwsgi_spooler * uspool) {
 
 	int i;
 
+	// the previous spooler could have left signals behind
+	uwsgi_signal_kick_all();
+
 	pid_t pid = uwsgi_fork("uWSGI spooler");
 	if (pid < 0) {
 		uwsgi_error("fork()");
@@ -137,6 +166,7 @@ void uwsgi_spooler_run() {
 	int i;
 	struct uwsgi_spooler *uspool = uwsgi.i_am_a_spooler;
 	uwsgi.signal_socket = uwsgi.shared->spooler_signal_pipe[1];
+	uwsgi.signal_bitmap = &uwsgi.shared->spooler_signals;
 
                 for (i = 0; i < 256; i++) {
                         if (uwsgi.p[i]->spooler_init) {
@@ -202,6 +232,317 @@ static void spooler_req_parser_hook(char *key, uint16_t key_len, char *value, ui
 	}
 }
 
+/*
+	the log backend (--spooler-log)
+
+	tasks are appended to numbered segment files instead of getting a file each.
+	The spooler tracks their completion in a bitmap (one bit per record) stored in
+	a .ack file alongside each segment. Segments are rotated when they
+	reach --spooler-log-segment-size and removed when all of their tasks are done (the
+	few tasks left in a mostly done segment are moved to the active one).
+
+	Records are written at the offset tracked in shared memory (not appended), so the
+	bytes left by a writer dying in the middle of a record are overwritten by the next
+	one. Torn data can only be found after the last record of a segment (and every
+	instance starts writing a new one), where it is detected and skipped.
+
+	Records are in host byte order:
+
+	magic (32bit) | checksum (32bit) | at (64bit) | priority (64bit) | args_len (16bit) | flags (16bit) | body_len (32bit) | args | body
+*/
+
+#define UWSGI_SPOOLER_LOG_MAGIC 0x4c505355
+
+struct uwsgi_spooler_log_header {
+	uint32_t magic;
+	uint32_t checksum;
+	uint64_t at;
+	int64_t priority;
+	uint16_t args_len;
+	uint16_t flags;
+	uint32_t body_len;
+};
+
+// per-process writer state (allocated by the master, so every process inherits it)
+struct uwsgi_spooler_log_writer {
+	struct uwsgi_spooler *uspool;
+	int fd;
+	uint64_t segment;
+	struct uwsgi_spooler_log_writer *next;
+};
+
+static struct uwsgi_spooler_log_writer *spooler_log_writers;
+
+static uint32_t spooler_log_fnv(uint32_t hash, char *buf, size_t len) {
+	size_t i;
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) buf[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+// FNV-1a of the header (checksum excluded) and of the payload
+static uint32_t spooler_log_checksum(struct uwsgi_spooler_log_header *slh, char *args, char *body) {
+	uint32_t hash = spooler_log_fnv(2166136261U, (char *) &slh->at, sizeof(struct uwsgi_spooler_log_header) - 8);
+	hash = spooler_log_fnv(hash, args, slh->args_len);
+	return spooler_log_fnv(hash, body, slh->body_len);
+}
+
+static void spooler_log_path(struct uwsgi_spooler *uspool, uint64_t segment, char *ext, char *path) {
+	int ret = snprintf(path, PATH_MAX, "%s/%012llu.%s", uspool->dir, (unsigned long long) segment, ext);
+	if (ret <= 0 || ret >= PATH_MAX) {
+		uwsgi_log("[spooler-log] segment path too long\n");
+		exit(1);
+	}
+}
+
+// task names are "<dir>/<segment>.seg#<record>", truncated names are only cosmetic
+static void spooler_log_task_name(struct uwsgi_spooler *uspool, uint64_t segment, uint64_t record, char *task) {
+	int ret = snprintf(task, PATH_MAX, "%s/%012llu.seg#%llu", uspool->dir, (unsigned long long) segment, (unsigned long long) record);
+	if (ret <= 0 || ret >= PATH_MAX)
+		task[PATH_MAX - 1] = 0;
+}
+
+// parse a segment filename
+static int spooler_log_segment_id(char *name, uint64_t *segment) {
+	size_t len = strlen(name);
+	if (len != 16 || strcmp(name + 12, ".seg"))
+		return -1;
+	size_t i;
+	for (i = 0; i < 12; i++) {
+		if (!isdigit((int) name[i]))
+			return -1;
+	}
+	*segment = strtoull(name, NULL, 10);
+	return 0;
+}
+
+// returns the lowest and highest segment in the directory (0 if empty)
+static int spooler_log_segments_range(struct uwsgi_spooler *uspool, uint64_t *first, uint64_t *last) {
+	DIR *sdir = opendir(uspool->dir);
+	if (!sdir) {
+		uwsgi_error("spooler_log_segments_range()/opendir()");
+		return -1;
+	}
+	*first = 0;
+	*last = 0;
+	struct dirent *dp;
+	while ((dp = readdir(sdir)) != NULL) {
+		uint64_t segment;
+		if (spooler_log_segment_id(dp->d_name, &segment))
+			continue;
+		if (!*first || segment < *first)
+			*first = segment;
+		if (segment > *last)
+			*last = segment;
+	}
+	closedir(sdir);
+	return 0;
+}
+
+// called by the master, before any task can be enqueued
+void uwsgi_spooler_log_init(struct uwsgi_spooler *uspool) {
+	uint64_t first, last;
+	if (spooler_log_segments_range(uspool, &first, &last))
+		exit(1);
+
+	uspool->log_lock = uwsgi_lock_init(uwsgi_concat2("spooler log on ", uspool->dir));
+	// always start a new segment
+	uspool->log_segment = last + 1;
+	uspool->log_offset = 0;
+	uspool->log_records = 0;
+	uspool->log_synced_segment = uspool->log_segment;
+	uspool->log_synced_offset = 0;
+	uspool->log_dirty = first > 0;
+
+	struct uwsgi_spooler_log_writer *slw = uwsgi_calloc(sizeof(struct uwsgi_spooler_log_writer));
+	slw->uspool = uspool;
+	slw->fd = -1;
+	slw->next = spooler_log_writers;
+	spooler_log_writers = slw;
+
+	uwsgi_log("[spooler %s] log backend ready, writing segment %llu\n", uspool->dir, (unsigned long long) uspool->log_segment);
+}
+
+static int spooler_log_fsync_path(char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		uwsgi_error_open(path);
+		return -1;
+	}
+	int ret = fsync(fd);
+	if (ret)
+		uwsgi_error("spooler_log_fsync_path()/fsync()");
+	close(fd);
+	return ret;
+}
+
+// open the active segment, must be called with the spooler lock held
+static int spooler_log_open(struct uwsgi_spooler_log_writer *slw) {
+	struct uwsgi_spooler *uspool = slw->uspool;
+	if (slw->fd >= 0 && slw->segment == uspool->log_segment)
+		return 0;
+	if (slw->fd >= 0)
+		close(slw->fd);
+	char path[PATH_MAX];
+	spooler_log_path(uspool, uspool->log_segment, "seg", path);
+	slw->fd = open(path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	if (slw->fd < 0) {
+		uwsgi_error_open(path);
+		return -1;
+	}
+	slw->segment = uspool->log_segment;
+	// make the new segment itself durable
+	if (uwsgi.spooler_log_fsync && uspool->log_offset == 0) {
+		if (spooler_log_fsync_path(uspool->dir))
+			return -1;
+	}
+	return 0;
+}
+
+// seal the active segment, must be called with the spooler lock held
+static void spooler_log_rotate(struct uwsgi_spooler_log_writer *slw) {
+	struct uwsgi_spooler *uspool = slw->uspool;
+	// sealed segments are always on disk (group commits only look at the active one)
+	if (uwsgi.spooler_log_fsync && slw->fd >= 0 && slw->segment == uspool->log_segment) {
+		if (fsync(slw->fd))
+			uwsgi_error("spooler_log_rotate()/fsync()");
+	}
+	uspool->log_segment++;
+	uspool->log_offset = 0;
+	uspool->log_records = 0;
+}
+
+/*
+	group commit: the first enqueuer reaching this point fsync()s the active segment for
+	all of the records committed so far, the ones waiting for the log_lock will find their
+	record already on disk
+*/
+static int spooler_log_sync(struct uwsgi_spooler *uspool, uint64_t segment, uint64_t end) {
+	int ret = 0;
+	uwsgi_lock(uspool->log_lock);
+	if (uspool->log_synced_segment > segment || (uspool->log_synced_segment == segment && uspool->log_synced_offset >= end))
+		goto done;
+
+	uwsgi_lock(uspool->lock);
+	uint64_t active = uspool->log_segment;
+	uint64_t committed = uspool->log_offset;
+	uwsgi_unlock(uspool->lock);
+
+	// already sealed (and synced)
+	if (active != segment)
+		goto done;
+
+	char path[PATH_MAX];
+	spooler_log_path(uspool, segment, "seg", path);
+	ret = spooler_log_fsync_path(path);
+	if (!ret) {
+		uspool->log_synced_segment = segment;
+		uspool->log_synced_offset = committed;
+	}
+done:
+	uwsgi_unlock(uspool->log_lock);
+	return ret;
+}
+
+// append a record to the active segment
+static int spooler_log_write(struct uwsgi_spooler *uspool, struct uwsgi_spooler_log_header *slh, char *args, char *body, uint64_t *segment, uint64_t *record) {
+	struct uwsgi_spooler_log_writer *slw = spooler_log_writers;
+	while (slw) {
+		if (slw->uspool == uspool)
+			break;
+		slw = slw->next;
+	}
+	if (!slw) {
+		uwsgi_log("[uwsgi-spooler] %s is not a log spooler\n", uspool->dir);
+		return -1;
+	}
+
+	slh->magic = UWSGI_SPOOLER_LOG_MAGIC;
+	slh->flags = 0;
+	slh->checksum = spooler_log_checksum(slh, args, body);
+
+	struct iovec iov[3];
+	int iovcnt = 2;
+	iov[0].iov_base = slh;
+	iov[0].iov_len = sizeof(struct uwsgi_spooler_log_header);
+	iov[1].iov_base = args;
+	iov[1].iov_len = slh->args_len;
+	if (slh->body_len > 0) {
+		iov[2].iov_base = body;
+		iov[2].iov_len = slh->body_len;
+		iovcnt = 3;
+	}
+	size_t total = sizeof(struct uwsgi_spooler_log_header) + slh->args_len + slh->body_len;
+
+	uwsgi_lock(uspool->lock);
+	if (uspool->log_offset > 0 && uspool->log_offset + total > uwsgi.spooler_log_segment_size) {
+		spooler_log_rotate(slw);
+	}
+	if (spooler_log_open(slw)) {
+		uwsgi_unlock(uspool->lock);
+		return -1;
+	}
+	// a partial record is overwritten by the next one
+	int i;
+	off_t pos = uspool->log_offset;
+	for (i = 0; i < iovcnt; i++) {
+		if (pwrite(slw->fd, iov[i].iov_base, iov[i].iov_len, pos) != (ssize_t) iov[i].iov_len) {
+			uwsgi_error("spooler_log_write()/pwrite()");
+			uwsgi_unlock(uspool->lock);
+			return -1;
+		}
+		pos += iov[i].iov_len;
+	}
+	*segment = uspool->log_segment;
+	*record = uspool->log_records++;
+	uspool->log_offset += total;
+	uint64_t end = uspool->log_offset;
+	uspool->log_dirty = 1;
+	uwsgi_unlock(uspool->lock);
+
+	if (uwsgi.spooler_log_fsync)
+		return spooler_log_sync(uspool, *segment, end);
+	return 0;
+}
+
+static char *spooler_log_append(struct uwsgi_spooler *uspool, struct spooler_req *sr, char *buf, size_t len, char *body, size_t body_len) {
+	if (body_len > 0xffffffff) {
+		uwsgi_log("[uwsgi-spooler] the body of log spooler tasks is limited to 4GB\n");
+		return NULL;
+	}
+
+	struct uwsgi_spooler_log_header slh;
+	slh.at = sr->at > 0 ? sr->at : 0;
+	// non numeric priorities are ignored (as --spooler-ordered does with directories)
+	slh.priority = INT64_MAX;
+	if (sr->priority && sr->priority_len) {
+		size_t i;
+		for (i = 0; i < sr->priority_len; i++) {
+			if (!isdigit((int) sr->priority[i]))
+				break;
+		}
+		if (i == sr->priority_len)
+			slh.priority = uwsgi_str_num(sr->priority, sr->priority_len);
+	}
+	slh.args_len = len;
+	slh.body_len = body_len;
+
+	uint64_t segment, record;
+	if (spooler_log_write(uspool, &slh, buf, body, &segment, &record))
+		return NULL;
+
+	char *task = uwsgi_malloc(PATH_MAX);
+	spooler_log_task_name(uspool, segment, record, task);
+
+	if (!uwsgi.spooler_quiet)
+		uwsgi_log("[spooler] written %lu bytes to %s\n", (unsigned long) (sizeof(struct uwsgi_spooler_log_header) + len + body_len), task);
+
+	spooler_wakeup_spoolers(uspool);
+	return task;
+}
+
 /*
 CHANGED in 2.0.7: wsgi_req is useless !
 */
@@ -236,6 +577,10 @@ char *uwsgi_spool_request(struct wsgi_request *wsgi_req, char *buf, size_t len,
 		}
 	}
 
+	if (uspool->mode == UWSGI_SPOOLER_LOG) {
+		return spooler_log_append(uspool, &sr, buf, len, body, body_len);
+	}
+
 	// this lock is for threads, the pid value in filename will avoid multiprocess races
 	uwsgi_lock(uspool->lock);
 
@@ -360,11 +705,30 @@ char *uwsgi_spool_request(struct wsgi_request *wsgi_req, char *buf, size_t len,
 	// and here waiting threads can continue
 	uwsgi_unlock(uspool->lock);
 
+	spooler_wakeup_spoolers(uspool);
+
+	return filename;
+
+
+clear:
+	uwsgi_unlock(uspool->lock);
+	uwsgi_error("uwsgi_spool_request()/write()");
+	if (unlink(filename)) {
+		uwsgi_error("uwsgi_spool_request()/unlink()");
+	}
+	free(filename);
+	// unlock the file too
+	close(fd);
+	return NULL;
+}
+
+
+
 /*	wake up the spoolers attached to the specified dir ... (HACKY) 
 	no need to fear races, as USR1 is harmless an all of the uWSGI processes...
 	it could be a problem if a new process takes the old pid, but modern systems should avoid that
 */
-
+static void spooler_wakeup_spoolers(struct uwsgi_spooler *uspool) {
 	struct uwsgi_spooler *spoolers = uwsgi.spoolers;
 	while (spoolers) {
 		if (!strcmp(spoolers->dir, uspool->dir)) {
@@ -374,23 +738,63 @@ char *uwsgi_spool_request(struct wsgi_request *wsgi_req, char *buf, size_t len,
 		}
 		spoolers = spoolers->next;
 	}
+}
 
-	return filename;
+/*
+	--spooler-threads
 
+	the main thread of the spooler keeps scanning the directory (or the index/log) and
+	claiming tasks, the claimed ones are run by a pool of threads and handed back to the
+	main thread once done: the index, the log and the spool files are never touched
+	concurrently.
 
-clear:
-	uwsgi_unlock(uspool->lock);
-	uwsgi_error("uwsgi_spool_request()/write()");
-	if (unlink(filename)) {
-		uwsgi_error("uwsgi_spool_request()/unlink()");
-	}
-	free(filename);
-	// unlock the file too
-	close(fd);
-	return NULL;
-}
+	A claimed spool file stays open (and fcntl() locked, so other spooler processes on the
+	same directory skip it) until the main thread releases it. As fcntl() locks belong to
+	the process and are dropped by any close() of the file, the tasks in flight are never
+	reopened by the main thread.
+*/
+
+struct uwsgi_spooler_job {
+	// absolute path of the spool file (or the name of the log task)
+	char *path;
+	// the task name passed to the plugins
+	char *name;
+	// the locked spool file (-1 for log tasks)
+	int fd;
+	char *buf;
+	uint16_t len;
+	char *body;
+	size_t body_len;
+	// index and log backends
+	struct uwsgi_spooler_task *task;
+	int ret;
+	// called by the main thread once the task has been run
+	void (*done) (struct uwsgi_spooler *, struct uwsgi_spooler_job *);
+	struct uwsgi_spooler_job *next;
+};
 
+struct uwsgi_spooler_thread {
+	pthread_t tid;
+	int id;
+	time_t harakiri;
+};
 
+static struct uwsgi_spooler_threads {
+	int size;
+	// the following fields are managed by the main thread
+	int inflight;
+	int draining;
+	struct uwsgi_spooler_job **jobs;
+	// protected by lock
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct uwsgi_spooler_job *queue;
+	struct uwsgi_spooler_job *queue_tail;
+	struct uwsgi_spooler_job *done;
+	struct uwsgi_spooler_thread *threads;
+	// written by the threads whenever a task is done
+	int pipe[2];
+} ust;
 
 void spooler(struct uwsgi_spooler *uspool) {
 
@@ -433,6 +837,34 @@ void spooler(struct uwsgi_spooler *uspool) {
 
 	time_t last_task_managed = 0;
 
+	int spooler_log = uspool->mode == UWSGI_SPOOLER_LOG;
+	if (spooler_log) {
+		if (chdir(uspool->dir)) {
+			uwsgi_error("chdir()");
+			exit(1);
+		}
+		spooler_log_start(uspool);
+	}
+
+	int spooler_index = 0;
+#ifdef UWSGI_SPOOLER_INDEX
+	if (uwsgi.spooler_index && !spooler_log) {
+		if (chdir(uspool->dir)) {
+			uwsgi_error("chdir()");
+			exit(1);
+		}
+		spooler_index = !spooler_index_init(uspool, spooler_event_queue);
+	}
+#else
+	if (uwsgi.spooler_index && !spooler_log) {
+		uwsgi_log("[spooler %s pid: %d] the spooler index is not supported on this platform, scanning the directory\n", uspool->dir, (int) uwsgi.mypid);
+	}
+#endif
+
+	if (uwsgi.spooler_threads > 1) {
+		spooler_threads_init(uspool, spooler_event_queue);
+	}
+
 	for (;;) {
 
 		if (chdir(uspool->dir)) {
@@ -440,7 +872,15 @@ void spooler(struct uwsgi_spooler *uspool) {
 			exit(1);
 		}
 
-		if (uwsgi.spooler_ordered) {
+		if (spooler_log) {
+			spooler_log_run(uspool);
+		}
+#ifdef UWSGI_SPOOLER_INDEX
+		else if (spooler_index) {
+			spooler_index_run(uspool);
+		}
+#endif
+		else if (uwsgi.spooler_ordered) {
 			spooler_scandir(uspool, NULL);
 		}
 		else {
@@ -448,9 +888,12 @@ void spooler(struct uwsgi_spooler *uspool) {
 		}
 
 		// here we check (if in cheap mode), if the spooler has done its job
-		if (uwsgi.spooler_cheap) {
+		if (uwsgi.spooler_cheap && !ust.inflight) {
 			if (last_task_managed == uspool->last_task_managed) {
 				uwsgi_log_verbose("cheaping spooler %s ...\n", uspool->dir);
+				// delayed tasks are still in the log
+				if (spooler_log && spooler_log_pending())
+					uspool->log_dirty = 1;
 				exit(0);
 			}
 			last_task_managed = uspool->last_task_managed;
@@ -461,13 +904,27 @@ void spooler(struct uwsgi_spooler *uspool) {
 		if (wakeup > 0) {
 			timeout = 0;
 		}
+		else if (spooler_log || spooler_index) {
+			timeout = spooler_index_timeout(timeout);
+		}
 
+		time_t deadline = uwsgi_now() + timeout;
+wait:
 		if (event_queue_wait(spooler_event_queue, timeout, &interesting_fd) > 0) {
 			if (uwsgi.master_process) {
 				if (interesting_fd == uwsgi.shared->spooler_signal_pipe[1]) {
 					uwsgi_receive_signal(NULL, interesting_fd, "spooler", (int) getpid());
 				}
 			}
+			if (ust.size && interesting_fd == ust.pipe[0]) {
+				spooler_threads_collect(uspool, 0);
+				// directories are rescanned only at every cycle (or when woken up), otherwise retried tasks would run at every completion
+				if (!spooler_log && !spooler_index && !wakeup) {
+					timeout = deadline - uwsgi_now();
+					if (timeout > 0)
+						goto wait;
+				}
+			}
 		}
 
 		// avoid races
@@ -495,7 +952,7 @@ static void spooler_scandir(struct uwsgi_spooler *uspool, char *dir) {
 	}
 
 	for (i = 0; i < n; i++) {
-		spooler_manage_task(uspool, dir, tasklist[i]->d_name);
+		spooler_manage_task(uspool, dir, tasklist[i]->d_name, NULL);
 		free(tasklist[i]);
 	}
 
@@ -514,7 +971,7 @@ static void spooler_readdir(struct uwsgi_spooler *uspool, char *dir) {
 	sdir = opendir(dir);
 	if (sdir) {
 		while ((dp = readdir(sdir)) != NULL) {
-			spooler_manage_task(uspool, dir, dp->d_name);
+			spooler_manage_task(uspool, dir, dp->d_name, NULL);
 		}
 		closedir(sdir);
 	}
@@ -523,178 +980,1260 @@ static void spooler_readdir(struct uwsgi_spooler *uspool, char *dir) {
 	}
 }
 
-void spooler_manage_task(struct uwsgi_spooler *uspool, char *dir, char *task) {
+// with threads, the spooler harakiri is the nearest one of the running tasks
+static void spooler_harakiri(struct uwsgi_spooler_thread *thread, int sec) {
+	if (!thread) {
+		set_spooler_harakiri(sec);
+		return;
+	}
+	int i;
+	time_t harakiri = 0;
+	pthread_mutex_lock(&ust.lock);
+	thread->harakiri = sec ? uwsgi_now() + sec : 0;
+	for (i = 0; i < ust.size; i++) {
+		time_t t = ust.threads[i].harakiri;
+		if (t > 0 && (!harakiri || t < harakiri))
+			harakiri = t;
+	}
+	uwsgi.i_am_a_spooler->harakiri = harakiri;
+	pthread_mutex_unlock(&ust.lock);
+	if (!uwsgi.master_process) {
+		alarm(harakiri ? harakiri - uwsgi_now() : 0);
+	}
+}
 
+/*
+	run a task with the first plugin accepting it,
+	returns the plugin result (-2 means the task is done) or 0 if no plugin managed it
+*/
+static int spooler_run_task(struct uwsgi_spooler *uspool, struct uwsgi_spooler_thread *thread, char *task, char *buf, uint16_t len, char *body, size_t body_len) {
 	int i, ret;
 
-	char spool_buf[0xffff];
-	struct uwsgi_header uh;
-	char *body = NULL;
-	size_t body_len = 0;
+	// now the task is running and should not be woken up (the pool threads do not get signals)
+	if (!thread)
+		uspool->running = 1;
+	// this is used in cheap mode for making decision about who must die
+	uspool->last_task_managed = uwsgi_now();
 
-	int spool_fd;
+	if (!uwsgi.spooler_quiet)
+		uwsgi_log("[spooler %s pid: %d] managing request %s ...\n", uspool->dir, (int) uwsgi.mypid, task);
 
-	if (!dir)
-		dir = uspool->dir;
+	// chdir before running the task (if requested)
+	if (uwsgi.spooler_chdir) {
+		if (chdir(uwsgi.spooler_chdir)) {
+			uwsgi_error("spooler_manage_task()/chdir()");
+		}
+	}
 
-	if (!strncmp("uwsgi_spoolfile_on_", task, 19) || (uwsgi.spooler_ordered && is_a_number(task))) {
-		struct stat sf_lstat;
+	for (i = 0; i < 256; i++) {
+		if (uwsgi.p[i]->spooler) {
+			time_t now = uwsgi_now();
+			uint64_t start = uwsgi_micros();
+			if (uwsgi.harakiri_options.spoolers > 0) {
+				spooler_harakiri(thread, uwsgi.harakiri_options.spoolers);
+			}
+			UWSGI_PROBE2(spooler__task__start, uspool->dir, task);
+			ret = uwsgi.p[i]->spooler(task, buf, len, body, body_len);
+			UWSGI_PROBE3(spooler__task__done, uspool->dir, task, ret);
+			if (uwsgi.harakiri_options.spoolers > 0) {
+				spooler_harakiri(thread, 0);
+			}
+			if (ret == 0)
+				continue;
+			// increase task counter
+			uwsgi_atomic_add(uspool->tasks, 1);
+			uwsgi_histogram_add(uspool->latency, uwsgi_micros() - start, thread != NULL);
+			if (ret == -2) {
+				if (!uwsgi.spooler_quiet)
+					uwsgi_log("[spooler %s pid: %d] done with task %s after %lld seconds\n", uspool->dir, (int) uwsgi.mypid, task, (long long) uwsgi_now() - now);
+			}
+			// any other value means re-spool it
+			return ret;
+		}
+	}
 
-		if (lstat(task, &sf_lstat)) {
+	uwsgi_log("unable to find the spooler function, have you loaded it into the spooler process ?\n");
+	return 0;
+}
+
+// called once the task is released
+static void spooler_task_done(struct uwsgi_spooler *uspool) {
+	uspool->running = 0;
+
+	// need to recycle ?
+	if (uwsgi.spooler_max_tasks > 0 && uspool->tasks >= (uint64_t) uwsgi.spooler_max_tasks) {
+		// stop claiming tasks and wait for the ones in the pool
+		if (ust.inflight > 0) {
+			ust.draining = 1;
 			return;
 		}
+		uwsgi_log("[spooler %s pid: %d] maximum number of tasks reached (%d) recycling ...\n", uspool->dir, (int) uwsgi.mypid, uwsgi.spooler_max_tasks);
+		end_me(0);
+	}
+}
 
-		// a spool request for the future
-		if (sf_lstat.st_mtime > uwsgi_now()) {
-			return;
+static void *spooler_thread_loop(void *arg) {
+	struct uwsgi_spooler_thread *thread = (struct uwsgi_spooler_thread *) arg;
+	struct uwsgi_spooler *uspool = uwsgi.i_am_a_spooler;
+	sigset_t smask;
+	int i;
+
+	// signals (and wakeups) are managed by the main thread
+	sigfillset(&smask);
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	for (i = 0; i < 256; i++) {
+		if (uwsgi.p[i]->spooler && uwsgi.p[i]->init_thread) {
+			uwsgi.p[i]->init_thread(thread->id);
 		}
+	}
 
-		if (S_ISDIR(sf_lstat.st_mode) && uwsgi.spooler_ordered) {
-			if (chdir(task)) {
-				uwsgi_error("spooler_manage_task()/chdir()");
-				return;
-			}
-#ifdef __UCLIBC__ 
-			char *prio_path = uwsgi_malloc(PATH_MAX);
-			realpath(".", prio_path);		
-#else 
-			char *prio_path = realpath(".", NULL);
-#endif
-			spooler_scandir(uspool, prio_path);
-			free(prio_path);
-			if (chdir(dir)) {
-				uwsgi_error("spooler_manage_task()/chdir()");
-			}
-			return;
+	for (;;) {
+		pthread_mutex_lock(&ust.lock);
+		while (!ust.queue) {
+			pthread_cond_wait(&ust.cond, &ust.lock);
 		}
-		if (!S_ISREG(sf_lstat.st_mode)) {
-			return;
+		struct uwsgi_spooler_job *job = ust.queue;
+		ust.queue = job->next;
+		if (!ust.queue)
+			ust.queue_tail = NULL;
+		pthread_mutex_unlock(&ust.lock);
+
+		job->ret = spooler_run_task(uspool, thread, job->name, job->buf, job->len, job->body, job->body_len);
+
+		pthread_mutex_lock(&ust.lock);
+		job->next = ust.done;
+		ust.done = job;
+		pthread_mutex_unlock(&ust.lock);
+
+		// wake up the main thread (a full pipe means it already has to wake up)
+		if (write(ust.pipe[1], "x", 1) != 1 && !uwsgi_is_again()) {
+			uwsgi_error("spooler_thread_loop()/write()");
 		}
-		if (!access(task, R_OK | W_OK)) {
+	}
 
+	return NULL;
+}
 
-			spool_fd = open(task, O_RDWR);
+static void spooler_threads_init(struct uwsgi_spooler *uspool, int queue) {
+	int i;
 
-			if (spool_fd < 0) {
-				if (errno != ENOENT)
-					uwsgi_error_open(task);
-				return;
-			}
+	// the tasks cannot change the working directory of the whole process
+	if (uwsgi.spooler_chdir) {
+		uwsgi_log("--spooler-chdir cannot be used with --spooler-threads\n");
+		exit(1);
+	}
 
-			// check if the file is locked by another process
-			if (uwsgi_fcntl_is_locked(spool_fd)) {
-				uwsgi_protected_close(spool_fd);
-				return;
-			}
+	ust.size = uwsgi.spooler_threads;
+	ust.jobs = uwsgi_calloc(sizeof(struct uwsgi_spooler_job *) * ust.size);
+	ust.threads = uwsgi_calloc(sizeof(struct uwsgi_spooler_thread) * ust.size);
+	pthread_mutex_init(&ust.lock, NULL);
+	pthread_cond_init(&ust.cond, NULL);
 
-			// unlink() can destroy the lock !!!
-			if (access(task, R_OK | W_OK)) {
-				uwsgi_protected_close(spool_fd);
-				return;
-			}
+	if (pipe(ust.pipe)) {
+		uwsgi_error("spooler_threads_init()/pipe()");
+		exit(1);
+	}
+	uwsgi_socket_nb(ust.pipe[0]);
+	uwsgi_socket_nb(ust.pipe[1]);
 
+	if (event_queue_add_fd_read(queue, ust.pipe[0])) {
+		exit(1);
+	}
 
-			ssize_t rlen = uwsgi_protected_read(spool_fd, &uh, 4);
+	for (i = 0; i < ust.size; i++) {
+		ust.threads[i].id = i;
+		if (pthread_create(&ust.threads[i].tid, &uwsgi.threads_attr, spooler_thread_loop, &ust.threads[i])) {
+			uwsgi_error("spooler_threads_init()/pthread_create()");
+			exit(1);
+		}
+	}
 
-			if (rlen != 4) {
-				// it could be here for broken file or just opened one
-				if (rlen < 0)
-					uwsgi_error("spooler_manage_task()/read()");
-				uwsgi_protected_close(spool_fd);
-				return;
-			}
+	uwsgi_log("[spooler %s pid: %d] running up to %d tasks concurrently\n", uspool->dir, (int) uwsgi.mypid, ust.size);
+}
 
-#ifdef __BIG_ENDIAN__
-			uh._pktsize = uwsgi_swap16(uh._pktsize);
+// is the spool file already in the pool ?
+static int spooler_threads_running(char *path) {
+	int i;
+	for (i = 0; i < ust.size; i++) {
+		if (ust.jobs[i] && ust.jobs[i]->fd >= 0 && !strcmp(ust.jobs[i]->path, path))
+			return 1;
+	}
+	return 0;
+}
+
+// release the tasks run by the pool (waiting for at least one of them if requested)
+static void spooler_threads_collect(struct uwsgi_spooler *uspool, int wait) {
+	char buf[256];
+	int i;
+
+	if (wait) {
+		(void) uwsgi_waitfd(ust.pipe[0], -1);
+	}
+
+	while (read(ust.pipe[0], buf, sizeof(buf)) > 0);
+
+	pthread_mutex_lock(&ust.lock);
+	struct uwsgi_spooler_job *job = ust.done;
+	ust.done = NULL;
+	pthread_mutex_unlock(&ust.lock);
+
+	while (job) {
+		struct uwsgi_spooler_job *next = job->next;
+		for (i = 0; i < ust.size; i++) {
+			if (ust.jobs[i] == job) {
+				ust.jobs[i] = NULL;
+				break;
+			}
+		}
+		ust.inflight--;
+		uspool->inflight = ust.inflight;
+		job->done(uspool, job);
+		job = next;
+	}
+
+	if (ust.draining && !ust.inflight) {
+		uwsgi_log("[spooler %s pid: %d] maximum number of tasks reached (%d) recycling ...\n", uspool->dir, (int) uwsgi.mypid, uwsgi.spooler_max_tasks);
+		end_me(0);
+	}
+}
+
+// hand a task to the pool (waiting for a free thread)
+static void spooler_threads_dispatch(struct uwsgi_spooler *uspool, struct uwsgi_spooler_job *job) {
+	int i;
+
+	while (ust.inflight >= ust.size) {
+		spooler_threads_collect(uspool, 1);
+	}
+
+	for (i = 0; i < ust.size; i++) {
+		if (!ust.jobs[i]) {
+			ust.jobs[i] = job;
+			break;
+		}
+	}
+	ust.inflight++;
+	uspool->inflight = ust.inflight;
+
+	job->next = NULL;
+	pthread_mutex_lock(&ust.lock);
+	if (ust.queue_tail)
+		ust.queue_tail->next = job;
+	else
+		ust.queue = job;
+	ust.queue_tail = job;
+	pthread_cond_signal(&ust.cond);
+	pthread_mutex_unlock(&ust.lock);
+}
+
+// run a claimed task (or pass it to the pool)
+static void spooler_job_run(struct uwsgi_spooler *uspool, struct uwsgi_spooler_job *job) {
+	if (ust.size) {
+		spooler_threads_dispatch(uspool, job);
+		return;
+	}
+	job->ret = spooler_run_task(uspool, NULL, job->name, job->buf, job->len, job->body, job->body_len);
+	job->done(uspool, job);
+}
+
+static void spooler_file_done(struct uwsgi_spooler *uspool, struct uwsgi_spooler_job *job) {
+	if (job->ret == -2) {
+		if (unlink(job->path)) {
+			uwsgi_error("unlink()");
+			uwsgi_log("[spooler] something horrible happened to the spooler. Better to kill it.\n");
+			exit(1);
+		}
+	}
+
+	// here we free and unlock the task
+	uwsgi_protected_close(job->fd);
+
+#ifdef UWSGI_SPOOLER_INDEX
+	if (job->task)
+		spooler_index_requeue(uspool, job->task, job->path);
 #endif
 
-			if (uwsgi_protected_read(spool_fd, spool_buf, uh._pktsize) != uh._pktsize) {
-				uwsgi_error("spooler_manage_task()/read()");
-				destroy_spool(dir, task);
+	free(job->body);
+	free(job->buf);
+	free(job->path);
+	free(job);
+	spooler_task_done(uspool);
+}
+
+/*
+	returns 1 if the task has been claimed (its done hook will be called),
+	'indexed' is the spooler index item of the task (if any)
+*/
+static int spooler_manage_task(struct uwsgi_spooler *uspool, char *dir, char *task, struct uwsgi_spooler_task *indexed) {
+
+	struct uwsgi_header uh;
+
+	int spool_fd;
+
+	if (!dir)
+		dir = uspool->dir;
+
+	// recycling, wait for the running tasks
+	if (ust.draining)
+		return 0;
+
+	if (!strncmp("uwsgi_spoolfile_on_", task, 19) || (uwsgi.spooler_ordered && is_a_number(task))) {
+		struct stat sf_lstat;
+
+		if (lstat(task, &sf_lstat)) {
+			return 0;
+		}
+
+		// a spool request for the future
+		if (sf_lstat.st_mtime > uwsgi_now()) {
+			return 0;
+		}
+
+		if (S_ISDIR(sf_lstat.st_mode) && uwsgi.spooler_ordered) {
+			if (chdir(task)) {
+				uwsgi_error("spooler_manage_task()/chdir()");
+				return 0;
+			}
+#ifdef __UCLIBC__ 
+			char *prio_path = uwsgi_malloc(PATH_MAX);
+			realpath(".", prio_path);		
+#else 
+			char *prio_path = realpath(".", NULL);
+#endif
+			spooler_scandir(uspool, prio_path);
+			free(prio_path);
+			if (chdir(dir)) {
+				uwsgi_error("spooler_manage_task()/chdir()");
+			}
+			return 0;
+		}
+		if (!S_ISREG(sf_lstat.st_mode)) {
+			return 0;
+		}
+		if (!access(task, R_OK | W_OK)) {
+
+			char *path = uwsgi_concat3(dir, "/", task);
+			// reopening (and closing) it would drop its lock
+			if (ust.size && spooler_threads_running(path)) {
+				free(path);
+				return 0;
+			}
+
+			spool_fd = open(task, O_RDWR);
+
+			if (spool_fd < 0) {
+				if (errno != ENOENT)
+					uwsgi_error_open(task);
+				free(path);
+				return 0;
+			}
+
+			// check if the file is locked by another process
+			if (uwsgi_fcntl_is_locked(spool_fd)) {
 				uwsgi_protected_close(spool_fd);
-				return;
+				free(path);
+				return 0;
+			}
+
+			// unlink() can destroy the lock !!!
+			if (access(task, R_OK | W_OK)) {
+				uwsgi_protected_close(spool_fd);
+				free(path);
+				return 0;
+			}
+
+
+			ssize_t rlen = uwsgi_protected_read(spool_fd, &uh, 4);
+
+			if (rlen != 4) {
+				// it could be here for broken file or just opened one
+				if (rlen < 0)
+					uwsgi_error("spooler_manage_task()/read()");
+				uwsgi_protected_close(spool_fd);
+				free(path);
+				return 0;
+			}
+
+#ifdef __BIG_ENDIAN__
+			uh._pktsize = uwsgi_swap16(uh._pktsize);
+#endif
+
+			struct uwsgi_spooler_job *job = uwsgi_calloc(sizeof(struct uwsgi_spooler_job));
+			job->path = path;
+			job->name = path + strlen(dir) + 1;
+			job->fd = spool_fd;
+			job->buf = uwsgi_malloc(uh._pktsize + 1);
+			job->len = uh._pktsize;
+			job->task = indexed;
+			job->done = spooler_file_done;
+
+			if (uwsgi_protected_read(spool_fd, job->buf, uh._pktsize) != uh._pktsize) {
+				uwsgi_error("spooler_manage_task()/read()");
+				goto broken;
 			}
 
 			// body available ?
 			if (sf_lstat.st_size > (uh._pktsize + 4)) {
-				body_len = sf_lstat.st_size - (uh._pktsize + 4);
-				body = uwsgi_malloc(body_len);
-				if ((size_t) uwsgi_protected_read(spool_fd, body, body_len) != body_len) {
+				job->body_len = sf_lstat.st_size - (uh._pktsize + 4);
+				job->body = uwsgi_malloc(job->body_len);
+				if ((size_t) uwsgi_protected_read(spool_fd, job->body, job->body_len) != job->body_len) {
 					uwsgi_error("spooler_manage_task()/read()");
-					destroy_spool(dir, task);
-					uwsgi_protected_close(spool_fd);
-					free(body);
-					return;
+					goto broken;
 				}
 			}
 
-			// now the task is running and should not be woken up
-			uspool->running = 1;
-			// this is used in cheap mode for making decision about who must die
-			uspool->last_task_managed = uwsgi_now();
+			spooler_job_run(uspool, job);
+
+			if (!ust.size && chdir(dir)) {
+				uwsgi_error("chdir()");
+				uwsgi_log("[spooler] something horrible happened to the spooler. Better to kill it.\n");
+				exit(1);
+			}
+			return 1;
+
+broken:
+			destroy_spool(dir, task);
+			uwsgi_protected_close(spool_fd);
+			free(job->body);
+			free(job->buf);
+			free(job->path);
+			free(job);
+		}
+	}
+	return 0;
+}
+
+/*
+	the spooler index
 
-			if (!uwsgi.spooler_quiet)
-				uwsgi_log("[spooler %s pid: %d] managing request %s ...\n", uspool->dir, (int) uwsgi.mypid, task);
+	instead of rescanning (and lstat()ing) the whole spool directory at every
+	cycle, the tasks are tracked in memory and kept in two min-heaps:
 
+	ready -> tasks that can be run now, ordered by priority (with --spooler-ordered) and arrival
+	delayed -> tasks waiting for their 'at' (or for a retry), ordered by time
 
-			// chdir before running the task (if requested)
-			if (uwsgi.spooler_chdir) {
-				if (chdir(uwsgi.spooler_chdir)) {
-					uwsgi_error("spooler_manage_task()/chdir()");
-				}
+	the index is fed by inotify for file based spoolers (--spooler-index) and
+	by reading the segments for log based ones (--spooler-log)
+*/
+
+struct uwsgi_spooler_segment;
+
+struct uwsgi_spooler_task {
+	uint64_t seq;
+	time_t at;
+	int64_t priority;
+	struct uwsgi_spooler_task *next;
+	// log backend: where the task is stored
+	struct uwsgi_spooler_segment *segment;
+	uint64_t offset;
+	uint64_t record;
+	// offset of the filename in path (0 for tasks in the spooler dir)
+	uint16_t base;
+	char path[];
+};
+
+struct uwsgi_spooler_heap {
+	struct uwsgi_spooler_task **items;
+	uint64_t len;
+	uint64_t size;
+	int by_time;
+};
+
+#ifdef UWSGI_SPOOLER_INDEX
+struct uwsgi_spooler_watch {
+	int wd;
+	int64_t priority;
+	// NULL for the spooler dir, the priority subdirectory otherwise
+	char *name;
+	struct uwsgi_spooler_watch *next;
+};
+#endif
+
+static struct uwsgi_spooler_index {
+	uint64_t seq;
+	uint64_t count;
+	struct uwsgi_spooler_heap ready;
+	struct uwsgi_spooler_heap delayed;
+#ifdef UWSGI_SPOOLER_INDEX
+	int fd;
+	int overflow;
+	struct uwsgi_spooler_task **hashtable;
+	uint64_t hashtable_size;
+	struct uwsgi_spooler_watch *watches;
+#endif
+} usi = {.delayed.by_time = 1 };
+
+static int spooler_heap_less(struct uwsgi_spooler_heap *heap, struct uwsgi_spooler_task *a, struct uwsgi_spooler_task *b) {
+	if (heap->by_time) {
+		if (a->at != b->at)
+			return a->at < b->at;
+	}
+	else if (uwsgi.spooler_ordered && a->priority != b->priority) {
+		return a->priority < b->priority;
+	}
+	return a->seq < b->seq;
+}
+
+static void spooler_heap_push(struct uwsgi_spooler_heap *heap, struct uwsgi_spooler_task *task) {
+	if (heap->len >= heap->size) {
+		heap->size = heap->size ? heap->size * 2 : 1024;
+		heap->items = realloc(heap->items, sizeof(struct uwsgi_spooler_task *) * heap->size);
+		if (!heap->items) {
+			uwsgi_error("spooler_heap_push()/realloc()");
+			exit(1);
+		}
+	}
+	uint64_t pos = heap->len++;
+	while (pos > 0) {
+		uint64_t parent = (pos - 1) / 2;
+		if (!spooler_heap_less(heap, task, heap->items[parent]))
+			break;
+		heap->items[pos] = heap->items[parent];
+		pos = parent;
+	}
+	heap->items[pos] = task;
+}
+
+static struct uwsgi_spooler_task *spooler_heap_pop(struct uwsgi_spooler_heap *heap) {
+	if (!heap->len)
+		return NULL;
+	struct uwsgi_spooler_task *top = heap->items[0];
+	struct uwsgi_spooler_task *last = heap->items[--heap->len];
+	uint64_t pos = 0;
+	for (;;) {
+		uint64_t child = (pos * 2) + 1;
+		if (child >= heap->len)
+			break;
+		if (child + 1 < heap->len && spooler_heap_less(heap, heap->items[child + 1], heap->items[child]))
+			child++;
+		if (!spooler_heap_less(heap, heap->items[child], last))
+			break;
+		heap->items[pos] = heap->items[child];
+		pos = child;
+	}
+	if (heap->len)
+		heap->items[pos] = last;
+	return top;
+}
+
+// enqueue a task (ready or delayed)
+static void spooler_index_push(struct uwsgi_spooler_task *task) {
+	if (task->at > uwsgi_now())
+		spooler_heap_push(&usi.delayed, task);
+	else
+		spooler_heap_push(&usi.ready, task);
+}
+
+// get the next runnable task
+static struct uwsgi_spooler_task *spooler_index_pop() {
+	time_t now = uwsgi_now();
+	while (usi.delayed.len && usi.delayed.items[0]->at <= now) {
+		spooler_heap_push(&usi.ready, spooler_heap_pop(&usi.delayed));
+	}
+	return spooler_heap_pop(&usi.ready);
+}
+
+static time_t spooler_frequency() {
+	return uwsgi.shared->spooler_frequency ? uwsgi.shared->spooler_frequency : uwsgi.spooler_frequency;
+}
+
+// do not sleep past the next delayed task
+static int spooler_index_timeout(int timeout) {
+	if (!usi.delayed.len)
+		return timeout;
+	time_t now = uwsgi_now();
+	time_t at = usi.delayed.items[0]->at;
+	if (at <= now)
+		return 0;
+	if (at - now < timeout)
+		return at - now;
+	return timeout;
+}
+
+#ifdef UWSGI_SPOOLER_INDEX
+/*
+	file based spoolers: new tasks are reported by inotify (uwsgi_spool_request() closes
+	the file only after it has been fully written, external tools are expected to rename()
+	them in place). The 'at' of a task is discovered the first time it is managed, so a
+	task costs a single lstat() until it really runs.
+
+	The directory is fully rescanned only at startup and when the index
+	(or the inotify queue) overflows.
+*/
+
+static struct uwsgi_spooler_task **spooler_index_slot(char *path, size_t len) {
+	struct uwsgi_spooler_task **slot = &usi.hashtable[djb33x_hash(path, len) & (usi.hashtable_size - 1)];
+	while (*slot) {
+		if (!strcmp((*slot)->path, path))
+			break;
+		slot = &(*slot)->next;
+	}
+	return slot;
+}
+
+static void spooler_index_grow() {
+	uint64_t i;
+	uint64_t old_size = usi.hashtable_size;
+	struct uwsgi_spooler_task **old = usi.hashtable;
+	usi.hashtable_size = old_size ? old_size * 2 : 4096;
+	usi.hashtable = uwsgi_calloc(sizeof(struct uwsgi_spooler_task *) * usi.hashtable_size);
+	for (i = 0; i < old_size; i++) {
+		struct uwsgi_spooler_task *task = old[i];
+		while (task) {
+			struct uwsgi_spooler_task *next = task->next;
+			struct uwsgi_spooler_task **slot = &usi.hashtable[djb33x_hash(task->path, strlen(task->path)) & (usi.hashtable_size - 1)];
+			task->next = *slot;
+			*slot = task;
+			task = next;
+		}
+	}
+	free(old);
+}
+
+static void spooler_index_add(struct uwsgi_spooler *uspool, struct uwsgi_spooler_watch *watch, char *name) {
+	if (strncmp("uwsgi_spoolfile_on_", name, 19))
+		return;
+
+	size_t name_len = strlen(name);
+	size_t base = watch->name ? strlen(watch->name) + 1 : 0;
+	if (base + name_len > 0xffff)
+		return;
+
+	char *path = name;
+	if (watch->name) {
+		path = uwsgi_concat3(watch->name, "/", name);
+	}
+
+	struct uwsgi_spooler_task **slot = spooler_index_slot(path, base + name_len);
+	// already tracked
+	if (*slot)
+		goto end;
+
+	if (usi.count >= uwsgi.spooler_index_size) {
+		usi.overflow = 1;
+		goto end;
+	}
+
+	struct uwsgi_spooler_task *task = uwsgi_malloc(sizeof(struct uwsgi_spooler_task) + base + name_len + 1);
+	task->seq = usi.seq++;
+	task->at = 0;
+	task->priority = watch->priority;
+	task->next = NULL;
+	task->segment = NULL;
+	task->base = base;
+	memcpy(task->path, path, base + name_len + 1);
+	*slot = task;
+	spooler_heap_push(&usi.ready, task);
+
+	usi.count++;
+	uspool->indexed = usi.count;
+	if (usi.count > usi.hashtable_size * 2)
+		spooler_index_grow();
+end:
+	if (path != name)
+		free(path);
+}
+
+static void spooler_index_forget(struct uwsgi_spooler *uspool, struct uwsgi_spooler_task *task) {
+	struct uwsgi_spooler_task **slot = spooler_index_slot(task->path, strlen(task->path));
+	if (*slot)
+		*slot = task->next;
+	free(task);
+	usi.count--;
+	uspool->indexed = usi.count;
+}
+
+static void spooler_index_scan(struct uwsgi_spooler *uspool, struct uwsgi_spooler_watch *);
+
+static struct uwsgi_spooler_watch *spooler_index_watch(struct uwsgi_spooler *uspool, char *name) {
+	struct uwsgi_spooler_watch *watch = usi.watches, *last = NULL;
+	while (watch) {
+		if ((!name && !watch->name) || (name && watch->name && !strcmp(name, watch->name)))
+			return watch;
+		last = watch;
+		watch = watch->next;
+	}
+
+	uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+	// priority subdirectories are created on demand
+	if (!name && uwsgi.spooler_ordered)
+		mask |= IN_CREATE;
+
+	int wd = inotify_add_watch(usi.fd, name ? name : uspool->dir, mask);
+	if (wd < 0) {
+		uwsgi_error("spooler_index_watch()/inotify_add_watch()");
+		return NULL;
+	}
+
+	watch = uwsgi_calloc(sizeof(struct uwsgi_spooler_watch));
+	watch->wd = wd;
+	// tasks in the spooler dir run after the prioritized ones (as with --spooler-ordered scans)
+	watch->priority = name ? strtoll(name, NULL, 10) : INT64_MAX;
+	watch->name = name ? uwsgi_str(name) : NULL;
+	if (last)
+		last->next = watch;
+	else
+		usi.watches = watch;
+	return watch;
+}
+
+static void spooler_index_scan(struct uwsgi_spooler *uspool, struct uwsgi_spooler_watch *watch) {
+	DIR *sdir = opendir(watch->name ? watch->name : uspool->dir);
+	if (!sdir) {
+		uwsgi_error("spooler_index_scan()/opendir()");
+		return;
+	}
+	struct dirent *dp;
+	while ((dp = readdir(sdir)) != NULL) {
+		if (!watch->name && uwsgi.spooler_ordered && is_a_number(dp->d_name)) {
+			struct uwsgi_spooler_watch *subdir = spooler_index_watch(uspool, dp->d_name);
+			if (subdir)
+				spooler_index_scan(uspool, subdir);
+			continue;
+		}
+		spooler_index_add(uspool, watch, dp->d_name);
+	}
+	closedir(sdir);
+}
+
+static void spooler_index_rescan(struct uwsgi_spooler *uspool) {
+	usi.overflow = 0;
+	spooler_index_scan(uspool, usi.watches);
+	if (!uwsgi.spooler_quiet)
+		uwsgi_log("[spooler %s pid: %d] %llu tasks indexed\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) usi.count);
+}
+
+static void spooler_index_events(struct uwsgi_spooler *uspool) {
+	char buf[8192] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	for (;;) {
+		ssize_t len = read(usi.fd, buf, sizeof(buf));
+		if (len <= 0) {
+			if (len < 0 && !uwsgi_is_again())
+				uwsgi_error("spooler_index_events()/read()");
+			return;
+		}
+		char *ptr = buf;
+		while (ptr < buf + len) {
+			struct inotify_event *ie = (struct inotify_event *) ptr;
+			ptr += sizeof(struct inotify_event) + ie->len;
+
+			if (ie->mask & IN_Q_OVERFLOW) {
+				usi.overflow = 1;
+				continue;
 			}
 
-			int callable_found = 0;
-			for (i = 0; i < 256; i++) {
-				if (uwsgi.p[i]->spooler) {
-					time_t now = uwsgi_now();
-					if (uwsgi.harakiri_options.spoolers > 0) {
-						set_spooler_harakiri(uwsgi.harakiri_options.spoolers);
-					}
-					ret = uwsgi.p[i]->spooler(task, spool_buf, uh._pktsize, body, body_len);
-					if (uwsgi.harakiri_options.spoolers > 0) {
-						set_spooler_harakiri(0);
-					}
-					if (ret == 0)
-						continue;
-					callable_found = 1;
-					// increase task counter
-					uspool->tasks++;
-					if (ret == -2) {
-						if (!uwsgi.spooler_quiet)
-							uwsgi_log("[spooler %s pid: %d] done with task %s after %lld seconds\n", uspool->dir, (int) uwsgi.mypid, task, (long long) uwsgi_now() - now);
-						destroy_spool(dir, task);
-					}
-					// re-spool it
+			struct uwsgi_spooler_watch *watch = usi.watches, *prev = NULL;
+			while (watch) {
+				if (watch->wd == ie->wd)
 					break;
+				prev = watch;
+				watch = watch->next;
+			}
+			if (!watch)
+				continue;
+
+			// the directory has been removed
+			if (ie->mask & IN_IGNORED) {
+				// the spooler dir itself cannot be forgotten
+				if (!watch->name)
+					continue;
+				if (prev)
+					prev->next = watch->next;
+				else
+					usi.watches = watch->next;
+				free(watch->name);
+				free(watch);
+				continue;
+			}
+
+			if (!ie->len)
+				continue;
+
+			if (ie->mask & IN_ISDIR) {
+				if (!watch->name && uwsgi.spooler_ordered && is_a_number(ie->name)) {
+					// tasks could have been written before the watch was added
+					struct uwsgi_spooler_watch *subdir = spooler_index_watch(uspool, ie->name);
+					if (subdir)
+						spooler_index_scan(uspool, subdir);
 				}
+				continue;
 			}
 
-			if (body)
-				free(body);
+			if (ie->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+				spooler_index_add(uspool, watch, ie->name);
+		}
+	}
+}
 
-			// here we free and unlock the task
-			uwsgi_protected_close(spool_fd);
-			uspool->running = 0;
+static int spooler_index_init(struct uwsgi_spooler *uspool, int queue) {
+	usi.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (usi.fd < 0) {
+		uwsgi_error("spooler_index_init()/inotify_init1()");
+		return -1;
+	}
+	spooler_index_grow();
 
+	if (!spooler_index_watch(uspool, NULL)) {
+		close(usi.fd);
+		return -1;
+	}
 
-			// need to recycle ?
-			if (uwsgi.spooler_max_tasks > 0 && uspool->tasks >= (uint64_t) uwsgi.spooler_max_tasks) {
-				uwsgi_log("[spooler %s pid: %d] maximum number of tasks reached (%d) recycling ...\n", uspool->dir, (int) uwsgi.mypid, uwsgi.spooler_max_tasks);
-				end_me(0);
-			}
+	if (event_queue_add_fd_read(queue, usi.fd)) {
+		close(usi.fd);
+		return -1;
+	}
+
+	spooler_index_rescan(uspool);
+	return 0;
+}
+
+// still there ? (failed, retried, locked by another spooler or scheduled in the future)
+static void spooler_index_requeue(struct uwsgi_spooler *uspool, struct uwsgi_spooler_task *task, char *path) {
+	struct stat st;
+	if (lstat(path, &st)) {
+		spooler_index_forget(uspool, task);
+		return;
+	}
+	time_t now = uwsgi_now();
+	task->at = st.st_mtime > now ? st.st_mtime : now + spooler_frequency();
+	spooler_heap_push(&usi.delayed, task);
+}
+
+static void spooler_index_run(struct uwsgi_spooler *uspool) {
+	for (;;) {
+		// recycling, wait for the running tasks
+		if (ust.draining)
+			return;
+
+		// a new (maybe more important) task could have been spooled by the previous one
+		spooler_index_events(uspool);
 
+		if (usi.overflow && !usi.ready.len)
+			spooler_index_rescan(uspool);
 
+		struct uwsgi_spooler_task *task = spooler_index_pop();
+		if (!task)
+			return;
+
+		char *dir = uspool->dir;
+		if (task->base) {
+			dir = uwsgi_concat3n(uspool->dir, strlen(uspool->dir), "/", 1, task->path, task->base - 1);
 			if (chdir(dir)) {
+				// the priority directory is gone
+				spooler_index_forget(uspool, task);
+				goto next;
+			}
+		}
+
+		// not claimed (locked by another spooler, scheduled in the future or gone)
+		if (!spooler_manage_task(uspool, dir, task->path + task->base, task))
+			spooler_index_requeue(uspool, task, task->path + task->base);
+next:
+		if (dir != uspool->dir) {
+			free(dir);
+			if (chdir(uspool->dir)) {
 				uwsgi_error("chdir()");
-				uwsgi_log("[spooler] something horrible happened to the spooler. Better to kill it.\n");
 				exit(1);
 			}
+		}
+	}
+}
+#endif
+
+/*
+	log backend, the spooler side: the segments are read sequentially (up to the offset
+	committed by the enqueuers) and the tasks not yet acked are added to the index
+*/
+
+struct uwsgi_spooler_segment {
+	uint64_t id;
+	int fd;
+	int ack_fd;
+	uint8_t *acks;
+	uint64_t acks_size;
+	// read position
+	uint64_t offset;
+	uint64_t records;
+	// tasks indexed and not done yet
+	uint64_t live;
+	int sealed;
+	struct uwsgi_spooler_segment *next;
+};
+
+static struct uwsgi_spooler_segment *spooler_log_segments;
+// the segment being read and the next one to open
+static struct uwsgi_spooler_segment *spooler_log_tail;
+static uint64_t spooler_log_next;
+
+static struct uwsgi_spooler_segment *spooler_log_open_segment(struct uwsgi_spooler *uspool, uint64_t id) {
+	char path[PATH_MAX];
+	spooler_log_path(uspool, id, "seg", path);
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			uwsgi_error_open(path);
+		return NULL;
+	}
+
+	spooler_log_path(uspool, id, "ack", path);
+	int ack_fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (ack_fd < 0) {
+		uwsgi_error_open(path);
+		close(fd);
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(ack_fd, &st)) {
+		uwsgi_error("spooler_log_open_segment()/fstat()");
+		close(fd);
+		close(ack_fd);
+		return NULL;
+	}
+
+	struct uwsgi_spooler_segment *seg = uwsgi_calloc(sizeof(struct uwsgi_spooler_segment));
+	seg->id = id;
+	seg->fd = fd;
+	seg->ack_fd = ack_fd;
+	seg->acks_size = st.st_size;
+	if (seg->acks_size > 0) {
+		seg->acks = uwsgi_malloc(seg->acks_size);
+		if (pread(ack_fd, seg->acks, seg->acks_size, 0) != (ssize_t) seg->acks_size) {
+			uwsgi_error("spooler_log_open_segment()/pread()");
+			memset(seg->acks, 0, seg->acks_size);
+		}
+	}
 
-			if (!callable_found) {
-				uwsgi_log("unable to find the spooler function, have you loaded it into the spooler process ?\n");
+	if (spooler_log_tail) {
+		spooler_log_tail->next = seg;
+	}
+	else {
+		struct uwsgi_spooler_segment *last = spooler_log_segments;
+		while (last && last->next)
+			last = last->next;
+		if (last)
+			last->next = seg;
+		else
+			spooler_log_segments = seg;
+	}
+	spooler_log_tail = seg;
+	return seg;
+}
+
+// remove a sealed segment once all of its tasks are done
+static void spooler_log_release(struct uwsgi_spooler *uspool, struct uwsgi_spooler_segment *seg) {
+	if (!seg->sealed || seg->live)
+		return;
+
+	char path[PATH_MAX];
+	spooler_log_path(uspool, seg->id, "seg", path);
+	if (unlink(path))
+		uwsgi_error("spooler_log_release()/unlink()");
+	spooler_log_path(uspool, seg->id, "ack", path);
+	if (unlink(path))
+		uwsgi_error("spooler_log_release()/unlink()");
+
+	struct uwsgi_spooler_segment **prev = &spooler_log_segments;
+	while (*prev) {
+		if (*prev == seg) {
+			*prev = seg->next;
+			break;
+		}
+		prev = &(*prev)->next;
+	}
+	if (spooler_log_tail == seg)
+		spooler_log_tail = NULL;
+
+	close(seg->fd);
+	close(seg->ack_fd);
+	free(seg->acks);
+	free(seg);
+}
+
+static int spooler_log_acked(struct uwsgi_spooler_segment *seg, uint64_t record) {
+	if (record / 8 >= seg->acks_size)
+		return 0;
+	return seg->acks[record / 8] & (1 << (record % 8));
+}
+
+static void spooler_log_ack(struct uwsgi_spooler_segment *seg, uint64_t record) {
+	uint64_t pos = record / 8;
+	if (pos >= seg->acks_size) {
+		uint64_t size = UMAX(pos + 1, seg->acks_size * 2);
+		seg->acks = realloc(seg->acks, size);
+		if (!seg->acks) {
+			uwsgi_error("spooler_log_ack()/realloc()");
+			exit(1);
+		}
+		memset(seg->acks + seg->acks_size, 0, size - seg->acks_size);
+		seg->acks_size = size;
+	}
+	seg->acks[pos] |= 1 << (record % 8);
+	if (pwrite(seg->ack_fd, &seg->acks[pos], 1, pos) != 1) {
+		uwsgi_error("spooler_log_ack()/pwrite()");
+	}
+}
+
+// index the records of a segment up to the specified offset
+static void spooler_log_scan(struct uwsgi_spooler *uspool, struct uwsgi_spooler_segment *seg, uint64_t end) {
+	char buf[65536];
+	struct uwsgi_spooler_log_header slh;
+
+	while (seg->offset + sizeof(struct uwsgi_spooler_log_header) <= end) {
+		ssize_t rlen = pread(seg->fd, buf, UMIN(sizeof(buf), end - seg->offset), seg->offset);
+		if (rlen < (ssize_t) sizeof(struct uwsgi_spooler_log_header)) {
+			uwsgi_error("spooler_log_scan()/pread()");
+			return;
+		}
+		size_t pos = 0;
+		while (pos + sizeof(struct uwsgi_spooler_log_header) <= (size_t) rlen) {
+			memcpy(&slh, buf + pos, sizeof(struct uwsgi_spooler_log_header));
+			uint64_t size = sizeof(struct uwsgi_spooler_log_header) + slh.args_len + slh.body_len;
+			if (slh.magic != UWSGI_SPOOLER_LOG_MAGIC || seg->offset + pos + size > end) {
+				uwsgi_log("[spooler %s pid: %d] broken record at offset %llu of segment %llu, skipping the rest of it\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) (seg->offset + pos), (unsigned long long) seg->id);
+				seg->offset = end;
+				return;
+			}
+			uint64_t record = seg->records++;
+			if (!spooler_log_acked(seg, record)) {
+				struct uwsgi_spooler_task *task = uwsgi_malloc(sizeof(struct uwsgi_spooler_task) + 1);
+				task->seq = usi.seq++;
+				task->at = slh.at;
+				task->priority = slh.priority;
+				task->next = NULL;
+				task->segment = seg;
+				task->offset = seg->offset + pos;
+				task->record = record;
+				task->base = 0;
+				task->path[0] = 0;
+				spooler_index_push(task);
+				seg->live++;
+				usi.count++;
+			}
+			pos += size;
+		}
+		seg->offset += pos;
+	}
+
+	if (seg->offset < end) {
+		uwsgi_log("[spooler %s pid: %d] truncated record at offset %llu of segment %llu\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) seg->offset, (unsigned long long) seg->id);
+		seg->offset = end;
+	}
+}
+
+// index the tasks enqueued since the last call
+static void spooler_log_read(struct uwsgi_spooler *uspool) {
+	uwsgi_lock(uspool->lock);
+	uint64_t active = uspool->log_segment;
+	uint64_t committed = uspool->log_offset;
+	uwsgi_unlock(uspool->lock);
+
+	for (;;) {
+		struct uwsgi_spooler_segment *seg = spooler_log_tail;
+		if (!seg || seg->sealed) {
+			if (spooler_log_next > active)
+				break;
+			seg = spooler_log_open_segment(uspool, spooler_log_next);
+			if (!seg) {
+				// the active segment could have not been created yet
+				if (spooler_log_next == active)
+					break;
+				spooler_log_next++;
+				continue;
 			}
+			spooler_log_next++;
+		}
+
+		if (seg->id == active) {
+			spooler_log_scan(uspool, seg, committed);
+			break;
+		}
 
+		struct stat st;
+		if (fstat(seg->fd, &st)) {
+			uwsgi_error("spooler_log_read()/fstat()");
+			break;
+		}
+		spooler_log_scan(uspool, seg, st.st_size);
+		seg->sealed = 1;
+		spooler_log_release(uspool, seg);
+	}
+
+	uspool->indexed = usi.count;
+}
+
+// read a task (header and payload) from its segment
+static char *spooler_log_load(struct uwsgi_spooler *uspool, struct uwsgi_spooler_task *task, struct uwsgi_spooler_log_header *slh) {
+	struct uwsgi_spooler_segment *seg = task->segment;
+	if (pread(seg->fd, slh, sizeof(struct uwsgi_spooler_log_header), task->offset) != sizeof(struct uwsgi_spooler_log_header)) {
+		uwsgi_error("spooler_log_load()/pread()");
+		return NULL;
+	}
+	size_t len = slh->args_len + slh->body_len;
+	char *payload = uwsgi_malloc(len + 1);
+	if (pread(seg->fd, payload, len, task->offset + sizeof(struct uwsgi_spooler_log_header)) != (ssize_t) len) {
+		uwsgi_error("spooler_log_load()/pread()");
+		free(payload);
+		return NULL;
+	}
+	if (slh->magic != UWSGI_SPOOLER_LOG_MAGIC || slh->checksum != spooler_log_checksum(slh, payload, payload + slh->args_len)) {
+		uwsgi_log("[spooler %s pid: %d] corrupted task at offset %llu of segment %llu\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) task->offset, (unsigned long long) seg->id);
+		free(payload);
+		return NULL;
+	}
+	return payload;
+}
+
+static void spooler_log_forget(struct uwsgi_spooler *uspool, struct uwsgi_spooler_task *task) {
+	struct uwsgi_spooler_segment *seg = task->segment;
+	spooler_log_ack(seg, task->record);
+	seg->live--;
+	free(task);
+	usi.count--;
+	uspool->indexed = usi.count;
+}
+
+/*
+	a sealed segment is kept on disk until all of its tasks are done, so when only a
+	small part of it is still alive (delayed or retried tasks), the survivors are moved
+	to the active segment (the spooler will find them there) and the old one is removed.
+	A crash in the middle can only duplicate a task.
+*/
+static void spooler_log_compact(struct uwsgi_spooler *uspool, struct uwsgi_spooler_segment *seg) {
+	if (!seg->sealed || !seg->live || seg->live * 4 > seg->records)
+		return;
+
+	struct uwsgi_spooler_heap *heaps[] = { &usi.ready, &usi.delayed };
+	uint64_t moved = 0;
+	int i;
+	for (i = 0; i < 2; i++) {
+		struct uwsgi_spooler_heap *heap = heaps[i];
+		uint64_t j, kept = 0;
+		for (j = 0; j < heap->len; j++) {
+			struct uwsgi_spooler_task *task = heap->items[j];
+			if (task->segment != seg) {
+				heap->items[kept++] = task;
+				continue;
+			}
+			struct uwsgi_spooler_log_header slh;
+			char *payload = spooler_log_load(uspool, task, &slh);
+			uint64_t segment, record;
+			if (payload) {
+				slh.at = task->at;
+				if (spooler_log_write(uspool, &slh, payload, payload + slh.args_len, &segment, &record)) {
+					// keep it where it is
+					free(payload);
+					heap->items[kept++] = task;
+					continue;
+				}
+				free(payload);
+			}
+			spooler_log_ack(seg, task->record);
+			seg->live--;
+			free(task);
+			usi.count--;
+			moved++;
+		}
+		// restore the heap property
+		heap->len = 0;
+		for (j = 0; j < kept; j++) {
+			spooler_heap_push(heap, heap->items[j]);
+		}
+	}
+	uspool->indexed = usi.count;
+
+	if (!uwsgi.spooler_quiet)
+		uwsgi_log("[spooler %s pid: %d] moved %llu tasks out of segment %llu\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) moved, (unsigned long long) seg->id);
+}
+
+static void spooler_log_start(struct uwsgi_spooler *uspool) {
+	uint64_t first, last;
+	if (spooler_log_segments_range(uspool, &first, &last))
+		exit(1);
+
+	// from now on, every enqueue is in the index
+	uwsgi_lock(uspool->lock);
+	uspool->log_dirty = 0;
+	uwsgi_unlock(uspool->lock);
+
+	spooler_log_next = first ? first : uspool->log_segment;
+	spooler_log_read(uspool);
+	if (!uwsgi.spooler_quiet)
+		uwsgi_log("[spooler %s pid: %d] %llu tasks found in the log\n", uspool->dir, (int) uwsgi.mypid, (unsigned long long) usi.count);
+}
+
+static uint64_t spooler_log_pending() {
+	return usi.count;
+}
+
+static void spooler_log_done(struct uwsgi_spooler *uspool, struct uwsgi_spooler_job *job) {
+	struct uwsgi_spooler_task *task = job->task;
+	struct uwsgi_spooler_segment *seg = task->segment;
+
+	if (job->ret == -2) {
+		spooler_log_forget(uspool, task);
+	}
+	else {
+		task->at = uwsgi_now() + spooler_frequency();
+		spooler_heap_push(&usi.delayed, task);
+	}
+
+	// the body is part of buf
+	free(job->buf);
+	free(job->path);
+	free(job);
+	spooler_task_done(uspool);
+	spooler_log_release(uspool, seg);
+}
+
+static void spooler_log_run(struct uwsgi_spooler *uspool) {
+	for (;;) {
+		// recycling, wait for the running tasks
+		if (ust.draining)
+			return;
+
+		spooler_log_read(uspool);
+
+		struct uwsgi_spooler_task *task = spooler_index_pop();
+		if (!task) {
+			// only delayed tasks are left, time for compaction
+			struct uwsgi_spooler_segment *seg = spooler_log_segments;
+			while (seg) {
+				struct uwsgi_spooler_segment *next = seg->next;
+				spooler_log_compact(uspool, seg);
+				spooler_log_release(uspool, seg);
+				seg = next;
+			}
+			return;
+		}
+
+		struct uwsgi_spooler_segment *seg = task->segment;
+		struct uwsgi_spooler_log_header slh;
+		char *payload = spooler_log_load(uspool, task, &slh);
+		if (!payload) {
+			spooler_log_forget(uspool, task);
+			spooler_log_release(uspool, seg);
+			continue;
+		}
+
+		struct uwsgi_spooler_job *job = uwsgi_calloc(sizeof(struct uwsgi_spooler_job));
+		job->path = uwsgi_malloc(PATH_MAX);
+		spooler_log_task_name(uspool, seg->id, task->record, job->path);
+		job->name = job->path;
+		job->fd = -1;
+		job->buf = payload;
+		job->len = slh.args_len;
+		job->body = slh.body_len ? payload + slh.args_len : NULL;
+		job->body_len = slh.body_len;
+		job->task = task;
+		job->done = spooler_log_done;
+
+		spooler_job_run(uspool, job);
+
+		if (!ust.size && chdir(uspool->dir)) {
+			uwsgi_error("chdir()");
+			uwsgi_log("[spooler] something horrible happened to the spooler. Better to kill it.\n");
+			exit(1);
 		}
 	}
 }
@@ -706,6 +2245,14 @@ void uwsgi_spooler_cheap_check() {
 	while(uspool) {
 		// skip already active spoolers
 		if (uspool->pid > 0) goto next; 
+		// log based spoolers mark their directory when a task is enqueued
+		if (uspool->mode == UWSGI_SPOOLER_LOG) {
+			if (uspool->log_dirty) {
+				uspool->respawned++;
+				uspool->pid = spooler_start(uspool);
+			}
+			goto next;
+		}
 		// spooler dir names (in multiprocess mode, are ordered, so we can use
 		// this trick for avoiding spawning multiple processes for the same dir
 		// in the same cycle
@@ -14,6 +14,7 @@ struct uwsgi_stats *uwsgi_stats_new(size_t chunk_size) {
 	us->size = chunk_size;
 	us->tabs = 1;
 	us->dirty = 0;
+	us->fd = -1;
 	us->minified = uwsgi.stats_minified;
 	if (!us->minified) {
 		us->base[1] = '\n';
@@ -315,6 +316,59 @@ int uwsgi_stats_keylong_comma(struct uwsgi_stats *us, char *key, unsigned long l
 	return uwsgi_stats_comma(us);
 }
 
+int uwsgi_stats_long(struct uwsgi_stats *us, unsigned long long num) {
+
+	char *ptr = us->base + us->pos;
+	char *watermark = us->base + us->size;
+	size_t available = watermark - ptr;
+
+	int ret = snprintf(ptr, available, "%llu", num);
+	if (ret <= 0)
+		return -1;
+	while (ret >= (int) available) {
+		char *new_base = realloc(us->base, us->size + us->chunk);
+		if (!new_base)
+			return -1;
+		us->base = new_base;
+		us->size += us->chunk;
+		ptr = us->base + us->pos;
+		watermark = us->base + us->size;
+		available = watermark - ptr;
+		ret = snprintf(ptr, available, "%llu", num);
+		if (ret <= 0)
+			return -1;
+	}
+
+	us->pos += ret;
+	return 0;
+}
+
+// "key":[n0,n1,...] on a single line
+int uwsgi_stats_keylongs(struct uwsgi_stats *us, char *key, uint64_t *nums, size_t n) {
+	size_t i;
+
+	if (uwsgi_stats_key(us, key))
+		return -1;
+	if (uwsgi_stats_symbol(us, '['))
+		return -1;
+	for (i = 0; i < n; i++) {
+		if (i > 0) {
+			if (uwsgi_stats_symbol(us, ','))
+				return -1;
+		}
+		if (uwsgi_stats_long(us, (unsigned long long) nums[i]))
+			return -1;
+	}
+	return uwsgi_stats_symbol(us, ']');
+}
+
+int uwsgi_stats_keylongs_comma(struct uwsgi_stats *us, char *key, uint64_t *nums, size_t n) {
+	int ret = uwsgi_stats_keylongs(us, key, nums, n);
+	if (ret)
+		return -1;
+	return uwsgi_stats_comma(us);
+}
+
 int uwsgi_stats_keyslong(struct uwsgi_stats *us, char *key, long long num) {
 
         if (uwsgi_stats_apply_tabs(us))
@@ -402,6 +456,461 @@ end:
 	close(client_fd);
 }
 
+/*
+	streaming mode: send what has been generated so far and reuse the buffer
+*/
+int uwsgi_stats_flush(struct uwsgi_stats *us) {
+	if (us->fd < 0)
+		return 0;
+	off_t pos = 0;
+	while (pos < us->pos) {
+		int ret = uwsgi_waitfd_write(us->fd, uwsgi.socket_timeout);
+		if (ret <= 0)
+			return -1;
+		ssize_t res = write(us->fd, us->base + pos, us->pos - pos);
+		if (res <= 0) {
+			if (res < 0) {
+				uwsgi_error("uwsgi_stats_flush()/write()");
+			}
+			return -1;
+		}
+		pos += res;
+	}
+	us->pos = 0;
+	return 0;
+}
+
+/*
+	json -> msgpack transcoder
+
+	the stats json is generated by us, so only the subset we emit is supported.
+	maps and arrays headers are always 32bit (the items are counted while parsing)
+*/
+struct uwsgi_stats_msgpack {
+	char *ptr;
+	char *end;
+	struct uwsgi_buffer *ub;
+	struct uwsgi_buffer *str;
+};
+
+static void uwsgi_stats_msgpack_ws(struct uwsgi_stats_msgpack *usm) {
+	while (usm->ptr < usm->end && (*usm->ptr == ' ' || *usm->ptr == '\t' || *usm->ptr == '\n' || *usm->ptr == '\r'))
+		usm->ptr++;
+}
+
+static int uwsgi_stats_msgpack_uint(struct uwsgi_buffer *ub, uint64_t num) {
+	if (num < 128)
+		return uwsgi_buffer_byte(ub, num);
+	if (num <= 0xff) {
+		if (uwsgi_buffer_byte(ub, 0xcc))
+			return -1;
+		return uwsgi_buffer_byte(ub, num);
+	}
+	if (num <= 0xffff) {
+		if (uwsgi_buffer_byte(ub, 0xcd))
+			return -1;
+		return uwsgi_buffer_u16be(ub, num);
+	}
+	if (num <= 0xffffffff) {
+		if (uwsgi_buffer_byte(ub, 0xce))
+			return -1;
+		return uwsgi_buffer_u32be(ub, num);
+	}
+	if (uwsgi_buffer_byte(ub, 0xcf))
+		return -1;
+	return uwsgi_buffer_u64be(ub, num);
+}
+
+static int uwsgi_stats_msgpack_string(struct uwsgi_stats_msgpack *usm) {
+	// skip the opening quote
+	usm->ptr++;
+	usm->str->pos = 0;
+	while (usm->ptr < usm->end && *usm->ptr != '"') {
+		char c = *usm->ptr++;
+		if (c == '\\') {
+			if (usm->ptr >= usm->end)
+				return -1;
+			c = *usm->ptr++;
+			switch (c) {
+			case 'n':
+				c = '\n';
+				break;
+			case 'r':
+				c = '\r';
+				break;
+			case 't':
+				c = '\t';
+				break;
+			case 'b':
+				c = '\b';
+				break;
+			case 'f':
+				c = '\f';
+				break;
+			case 'u':
+				{
+					if (usm->end - usm->ptr < 4)
+						return -1;
+					char hex[5];
+					memcpy(hex, usm->ptr, 4);
+					hex[4] = 0;
+					usm->ptr += 4;
+					unsigned long cp = strtoul(hex, NULL, 16);
+					// utf-8 encoding (surrogate pairs are not generated by escape_json)
+					if (cp < 0x80) {
+						c = cp;
+						break;
+					}
+					if (cp < 0x800) {
+						if (uwsgi_buffer_byte(usm->str, 0xc0 | (cp >> 6)))
+							return -1;
+					}
+					else {
+						if (uwsgi_buffer_byte(usm->str, 0xe0 | (cp >> 12)))
+							return -1;
+						if (uwsgi_buffer_byte(usm->str, 0x80 | ((cp >> 6) & 0x3f)))
+							return -1;
+					}
+					c = 0x80 | (cp & 0x3f);
+				}
+				break;
+			default:
+				// \" \\ \/
+				break;
+			}
+		}
+		if (uwsgi_buffer_byte(usm->str, c))
+			return -1;
+	}
+	if (usm->ptr >= usm->end)
+		return -1;
+	// skip the closing quote
+	usm->ptr++;
+
+	size_t len = usm->str->pos;
+	if (len < 32) {
+		if (uwsgi_buffer_byte(usm->ub, 0xa0 | len))
+			return -1;
+	}
+	else if (len <= 0xff) {
+		if (uwsgi_buffer_byte(usm->ub, 0xd9) || uwsgi_buffer_byte(usm->ub, len))
+			return -1;
+	}
+	else if (len <= 0xffff) {
+		if (uwsgi_buffer_byte(usm->ub, 0xda) || uwsgi_buffer_u16be(usm->ub, len))
+			return -1;
+	}
+	else {
+		if (uwsgi_buffer_byte(usm->ub, 0xdb) || uwsgi_buffer_u32be(usm->ub, len))
+			return -1;
+	}
+	return uwsgi_buffer_append(usm->ub, usm->str->buf, len);
+}
+
+static int uwsgi_stats_msgpack_number(struct uwsgi_stats_msgpack *usm) {
+	char num[64];
+	size_t len = 0;
+	int is_float = 0;
+	while (usm->ptr < usm->end && len < sizeof(num) - 1) {
+		char c = *usm->ptr;
+		if (c == '.' || c == 'e' || c == 'E') {
+			is_float = 1;
+		}
+		else if (!isdigit((int) c) && c != '-' && c != '+') {
+			break;
+		}
+		num[len++] = c;
+		usm->ptr++;
+	}
+	num[len] = 0;
+	if (!len)
+		return -1;
+
+	if (is_float) {
+		double d = strtod(num, NULL);
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(uint64_t));
+		if (uwsgi_buffer_byte(usm->ub, 0xcb))
+			return -1;
+		return uwsgi_buffer_u64be(usm->ub, bits);
+	}
+
+	if (num[0] == '-') {
+		int64_t n = strtoll(num, NULL, 10);
+		if (n >= -32)
+			return uwsgi_buffer_byte(usm->ub, n);
+		if (uwsgi_buffer_byte(usm->ub, 0xd3))
+			return -1;
+		return uwsgi_buffer_u64be(usm->ub, (uint64_t) n);
+	}
+	return uwsgi_stats_msgpack_uint(usm->ub, strtoull(num, NULL, 10));
+}
+
+static int uwsgi_stats_msgpack_value(struct uwsgi_stats_msgpack *usm, int depth) {
+	if (depth > 64)
+		return -1;
+	uwsgi_stats_msgpack_ws(usm);
+	if (usm->ptr >= usm->end)
+		return -1;
+
+	char c = *usm->ptr;
+	if (c == '{' || c == '[') {
+		int is_map = c == '{';
+		char closing = is_map ? '}' : ']';
+		usm->ptr++;
+		if (uwsgi_buffer_byte(usm->ub, is_map ? 0xdf : 0xdd))
+			return -1;
+		size_t header = usm->ub->pos;
+		if (uwsgi_buffer_u32be(usm->ub, 0))
+			return -1;
+		uint32_t items = 0;
+		for (;;) {
+			uwsgi_stats_msgpack_ws(usm);
+			if (usm->ptr >= usm->end)
+				return -1;
+			if (*usm->ptr == closing) {
+				usm->ptr++;
+				break;
+			}
+			if (items > 0) {
+				if (*usm->ptr != ',')
+					return -1;
+				usm->ptr++;
+				uwsgi_stats_msgpack_ws(usm);
+			}
+			if (is_map) {
+				if (usm->ptr >= usm->end || *usm->ptr != '"')
+					return -1;
+				if (uwsgi_stats_msgpack_string(usm))
+					return -1;
+				uwsgi_stats_msgpack_ws(usm);
+				if (usm->ptr >= usm->end || *usm->ptr != ':')
+					return -1;
+				usm->ptr++;
+			}
+			if (uwsgi_stats_msgpack_value(usm, depth + 1))
+				return -1;
+			items++;
+		}
+		// patch the number of items
+		usm->ub->buf[header] = (items >> 24) & 0xff;
+		usm->ub->buf[header + 1] = (items >> 16) & 0xff;
+		usm->ub->buf[header + 2] = (items >> 8) & 0xff;
+		usm->ub->buf[header + 3] = items & 0xff;
+		return 0;
+	}
+
+	if (c == '"')
+		return uwsgi_stats_msgpack_string(usm);
+
+	if (usm->end - usm->ptr >= 4 && !memcmp(usm->ptr, "true", 4)) {
+		usm->ptr += 4;
+		return uwsgi_buffer_byte(usm->ub, 0xc3);
+	}
+	if (usm->end - usm->ptr >= 5 && !memcmp(usm->ptr, "false", 5)) {
+		usm->ptr += 5;
+		return uwsgi_buffer_byte(usm->ub, 0xc2);
+	}
+	if (usm->end - usm->ptr >= 4 && !memcmp(usm->ptr, "null", 4)) {
+		usm->ptr += 4;
+		return uwsgi_buffer_byte(usm->ub, 0xc0);
+	}
+
+	return uwsgi_stats_msgpack_number(usm);
+}
+
+struct uwsgi_buffer *uwsgi_stats_to_msgpack(char *json, size_t len) {
+	struct uwsgi_stats_msgpack usm;
+	usm.ptr = json;
+	usm.end = json + len;
+	usm.ub = uwsgi_buffer_new(len);
+	usm.str = uwsgi_buffer_new(256);
+	if (uwsgi_stats_msgpack_value(&usm, 0)) {
+		uwsgi_log("uwsgi_stats_to_msgpack(): unable to convert stats to msgpack\n");
+		uwsgi_buffer_destroy(usm.ub);
+		usm.ub = NULL;
+	}
+	uwsgi_buffer_destroy(usm.str);
+	return usm.ub;
+}
+
+/*
+	with --stats-http the request line can select the sections and the format:
+
+	GET /workers,sockets
+	GET /?sections=workers,sockets&format=msgpack
+*/
+static int uwsgi_stats_http_request(int fd, char **sections, int *msgpack) {
+	char buf[4096];
+	struct uwsgi_buffer *ub = NULL;
+
+	int ret = uwsgi_waitfd(fd, uwsgi.socket_timeout);
+	if (ret <= 0)
+		return -1;
+
+	ssize_t len = read(fd, buf, sizeof(buf) - 1);
+	if (len <= 0)
+		return -1;
+	buf[len] = 0;
+
+	char *path = strchr(buf, ' ');
+	if (!path)
+		goto headers;
+	path++;
+	char *path_end = strpbrk(path, " \r\n");
+	if (path_end)
+		*path_end = 0;
+
+	char *qs = strchr(path, '?');
+	if (qs) {
+		*qs = 0;
+		qs++;
+		char *p, *ctx = NULL;
+		uwsgi_foreach_token(qs, "&", p, ctx) {
+			if (!strncmp(p, "sections=", 9)) {
+				if (*sections)
+					free(*sections);
+				*sections = uwsgi_str(p + 9);
+			}
+			else if (!strcmp(p, "format=msgpack")) {
+				*msgpack = 1;
+			}
+			else if (!strcmp(p, "format=json")) {
+				*msgpack = 0;
+			}
+		}
+	}
+
+	if (*path == '/' && path[1] && !*sections) {
+		*sections = uwsgi_str(path + 1);
+	}
+
+	// uwsgi_list_has_str() works on space separated lists
+	if (*sections) {
+		char *ptr = *sections;
+		while (*ptr) {
+			if (*ptr == ',')
+				*ptr = ' ';
+			ptr++;
+		}
+	}
+
+headers:
+	ub = uwsgi_buffer_new(uwsgi.page_size);
+
+	if (uwsgi_buffer_append(ub, "HTTP/1.0 200 OK\r\n", 17))
+		goto error;
+	if (uwsgi_buffer_append(ub, "Connection: close\r\n", 19))
+		goto error;
+	if (uwsgi_buffer_append(ub, "Access-Control-Allow-Origin: *\r\n", 32))
+		goto error;
+	if (*msgpack) {
+		if (uwsgi_buffer_append(ub, "Content-Type: application/msgpack\r\n", 35))
+			goto error;
+	}
+	else {
+		if (uwsgi_buffer_append(ub, "Content-Type: application/json\r\n", 32))
+			goto error;
+	}
+	if (uwsgi_buffer_append(ub, "\r\n", 2))
+		goto error;
+
+	if (uwsgi_buffer_send(ub, fd))
+		goto error;
+	uwsgi_buffer_destroy(ub);
+	return 0;
+
+error:
+	uwsgi_buffer_destroy(ub);
+	return -1;
+}
+
+static void uwsgi_master_serve_stats(int client_fd) {
+	char *sections = NULL;
+	int msgpack = uwsgi.stats_msgpack;
+
+	if (uwsgi.stats_http) {
+		if (uwsgi_stats_http_request(client_fd, &sections, &msgpack))
+			goto end;
+	}
+
+	struct uwsgi_stats *us = uwsgi_stats_new(8192);
+	if (msgpack) {
+		// msgpack needs the whole document
+		if (uwsgi_master_generate_stats_sections(us, sections))
+			goto end0;
+		struct uwsgi_buffer *ub = uwsgi_stats_to_msgpack(us->base, us->pos);
+		if (ub) {
+			uwsgi_buffer_send(ub, client_fd);
+			uwsgi_buffer_destroy(ub);
+		}
+	}
+	else {
+		// json is streamed while it is generated
+		us->fd = client_fd;
+		uwsgi_master_generate_stats_sections(us, sections);
+	}
+
+end0:
+	free(us->base);
+	free(us);
+end:
+	if (sections)
+		free(sections);
+	close(client_fd);
+}
+
+void uwsgi_master_send_stats(int fd) {
+	struct sockaddr_un client_src;
+	socklen_t client_src_len = 0;
+
+	int client_fd = accept(fd, (struct sockaddr *) &client_src, &client_src_len);
+	if (client_fd < 0) {
+		uwsgi_error("uwsgi_master_send_stats()/accept()");
+		return;
+	}
+	uwsgi_master_serve_stats(client_fd);
+}
+
+/*
+	--stats-thread: serve the stats clients from a master thread,
+	so slow clients or huge documents do not stall the master loop
+*/
+static void *uwsgi_stats_thread_loop(void *arg) {
+	sigset_t smask;
+	sigfillset(&smask);
+#ifndef UWSGI_DEBUG
+	sigdelset(&smask, SIGSEGV);
+#endif
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	for (;;) {
+		struct sockaddr_un client_src;
+		socklen_t client_src_len = 0;
+		int client_fd = accept(uwsgi.stats_fd, (struct sockaddr *) &client_src, &client_src_len);
+		if (client_fd < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED)
+				continue;
+			uwsgi_error("uwsgi_stats_thread_loop()/accept()");
+			sleep(1);
+			continue;
+		}
+		uwsgi_master_serve_stats(client_fd);
+	}
+	return NULL;
+}
+
+void uwsgi_stats_thread_start() {
+	pthread_t t;
+	// the listening socket could be non-blocking
+	uwsgi_socket_b(uwsgi.stats_fd);
+	if (pthread_create(&t, NULL, uwsgi_stats_thread_loop, NULL)) {
+		uwsgi_error("uwsgi_stats_thread_start()/pthread_create()");
+		exit(1);
+	}
+	uwsgi_log("stats server thread started\n");
+}
+
 struct uwsgi_stats_pusher *uwsgi_stats_pusher_get(char *name) {
 	struct uwsgi_stats_pusher *usp = uwsgi.stats_pushers;
 	while (usp) {
@@ -0,0 +1,248 @@
+/*
+
+	uWSGI hierarchical timer wheel
+
+	An alternative to the rbtree timers for subsystems re-arming
+	lot of timeouts (the async loop and the corerouters re-arm a timeout
+	after each read/write).
+
+	Timers are embedded in the owner structure (no allocation), arming,
+	re-arming and cancelling are O(1), expired timers are collected
+	in batches while the wheel advances.
+
+	The wheel has UWSGI_WHEEL_LEVELS levels of UWSGI_WHEEL_SLOTS slots,
+	level 0 has a resolution of 1 second, each level is UWSGI_WHEEL_SLOTS times
+	coarser than the previous one. Whenever level 0 wraps, the current slot of
+	the upper level is cascaded (re-hashed) to the lower ones.
+
+	Timers farther than the wheel range are parked in the last level and re-hashed
+	on each cascade.
+
+*/
+
+#include <uwsgi.h>
+
+#define UWSGI_WHEEL_MASK (UWSGI_WHEEL_SLOTS - 1)
+#define UWSGI_WHEEL_RANGE ((uint64_t) 1 << (UWSGI_WHEEL_BITS * UWSGI_WHEEL_LEVELS))
+
+struct uwsgi_timer_wheel *uwsgi_init_timer_wheel(uint64_t now) {
+	struct uwsgi_timer_wheel *wheel = uwsgi_calloc(sizeof(struct uwsgi_timer_wheel));
+	wheel->current = now;
+	return wheel;
+}
+
+static void wheel_timer_link(struct uwsgi_wheel_timer **list, struct uwsgi_wheel_timer *uwt) {
+	uwt->list = list;
+	uwt->prev = NULL;
+	uwt->next = *list;
+	if (*list) {
+		(*list)->prev = uwt;
+	}
+	*list = uwt;
+}
+
+static void wheel_timer_unlink(struct uwsgi_timer_wheel *wheel, struct uwsgi_wheel_timer *uwt) {
+	struct uwsgi_wheel_timer **list = uwt->list;
+
+	if (uwt->prev) {
+		uwt->prev->next = uwt->next;
+	}
+	else {
+		*list = uwt->next;
+	}
+
+	if (uwt->next) {
+		uwt->next->prev = uwt->prev;
+	}
+
+	// empty slot ? clear its bit
+	if (!*list && list != &wheel->expired) {
+		ptrdiff_t pos = list - &wheel->slots[0][0];
+		wheel->bitmap[pos / UWSGI_WHEEL_SLOTS] &= ~((uint64_t) 1 << (pos % UWSGI_WHEEL_SLOTS));
+	}
+
+	uwt->list = NULL;
+	uwt->prev = NULL;
+	uwt->next = NULL;
+}
+
+// hash the timer in the right level/slot (relative to wheel->current)
+static void wheel_timer_place(struct uwsgi_timer_wheel *wheel, struct uwsgi_wheel_timer *uwt) {
+
+	if (uwt->value <= wheel->current) {
+		wheel_timer_link(&wheel->expired, uwt);
+		return;
+	}
+
+	uint64_t expires = uwt->value;
+	uint64_t delta = expires - wheel->current;
+	// park far timers in the last level
+	if (delta >= UWSGI_WHEEL_RANGE) {
+		delta = UWSGI_WHEEL_RANGE - 1;
+		expires = wheel->current + delta;
+	}
+
+	int level = 0;
+	while (level < UWSGI_WHEEL_LEVELS - 1 && delta >= ((uint64_t) 1 << (UWSGI_WHEEL_BITS * (level + 1)))) {
+		level++;
+	}
+
+	int slot = (expires >> (UWSGI_WHEEL_BITS * level)) & UWSGI_WHEEL_MASK;
+	wheel_timer_link(&wheel->slots[level][slot], uwt);
+	wheel->bitmap[level] |= (uint64_t) 1 << slot;
+}
+
+// arm (or re-arm) a timer
+void uwsgi_add_wheel_timer(struct uwsgi_timer_wheel *wheel, struct uwsgi_wheel_timer *uwt, uint64_t value, void *data) {
+
+	uwt->data = data;
+
+	if (uwt->list) {
+		// fast path, nothing changed
+		if (uwt->value == value)
+			return;
+		wheel_timer_unlink(wheel, uwt);
+		wheel->count--;
+	}
+
+	uwt->value = value;
+	wheel_timer_place(wheel, uwt);
+	wheel->count++;
+}
+
+// cancel a timer (safe to call on non-armed timers)
+void uwsgi_del_wheel_timer(struct uwsgi_timer_wheel *wheel, struct uwsgi_wheel_timer *uwt) {
+	if (!uwt->list)
+		return;
+	wheel_timer_unlink(wheel, uwt);
+	wheel->count--;
+}
+
+static void wheel_cascade(struct uwsgi_timer_wheel *wheel, int level, int slot) {
+	struct uwsgi_wheel_timer *uwt = wheel->slots[level][slot];
+	wheel->slots[level][slot] = NULL;
+	wheel->bitmap[level] &= ~((uint64_t) 1 << slot);
+
+	while (uwt) {
+		struct uwsgi_wheel_timer *next = uwt->next;
+		wheel_timer_place(wheel, uwt);
+		uwt = next;
+	}
+}
+
+static void wheel_advance(struct uwsgi_timer_wheel *wheel, uint64_t now) {
+	int i;
+
+	while (wheel->current < now) {
+
+		// no timers in the wheel, just jump
+		if (!wheel->bitmap[0]) {
+			int empty = 1;
+			for (i = 1; i < UWSGI_WHEEL_LEVELS; i++) {
+				if (wheel->bitmap[i]) {
+					empty = 0;
+					break;
+				}
+			}
+			if (empty) {
+				wheel->current = now;
+				return;
+			}
+			// level 0 is empty, skip to the tick before the next cascade
+			uint64_t last = wheel->current | UWSGI_WHEEL_MASK;
+			if (last >= now) {
+				wheel->current = now;
+				return;
+			}
+			wheel->current = last;
+		}
+
+		wheel->current++;
+
+		int slot = wheel->current & UWSGI_WHEEL_MASK;
+
+		if (slot == 0) {
+			for (i = 1; i < UWSGI_WHEEL_LEVELS; i++) {
+				int upper_slot = (wheel->current >> (UWSGI_WHEEL_BITS * i)) & UWSGI_WHEEL_MASK;
+				wheel_cascade(wheel, i, upper_slot);
+				if (upper_slot != 0)
+					break;
+			}
+		}
+
+		// move the whole slot to the expired list
+		struct uwsgi_wheel_timer *uwt = wheel->slots[0][slot];
+		if (!uwt)
+			continue;
+		wheel->slots[0][slot] = NULL;
+		wheel->bitmap[0] &= ~((uint64_t) 1 << slot);
+		while (uwt) {
+			struct uwsgi_wheel_timer *next = uwt->next;
+			wheel_timer_link(&wheel->expired, uwt);
+			uwt = next;
+		}
+	}
+}
+
+/*
+	get the next expired timer (or NULL)
+
+	the returned timer is disarmed, so it can be safely re-armed or ignored
+	by the caller. Timers can be freely cancelled while draining the expired list.
+*/
+struct uwsgi_wheel_timer *uwsgi_expired_wheel_timer(struct uwsgi_timer_wheel *wheel, uint64_t now) {
+
+	if (!wheel->expired) {
+		wheel_advance(wheel, now);
+	}
+
+	struct uwsgi_wheel_timer *uwt = wheel->expired;
+	if (!uwt)
+		return NULL;
+
+	wheel_timer_unlink(wheel, uwt);
+	wheel->count--;
+	return uwt;
+}
+
+/*
+	returns the number of seconds before the wheel needs to be advanced
+	(0 for already expired timers, -1 if there are no timers)
+
+	this could be lower than the first real expiration (when a cascade is needed)
+*/
+int uwsgi_wheel_timer_next(struct uwsgi_timer_wheel *wheel, uint64_t now) {
+	int i;
+
+	if (wheel->expired)
+		return 0;
+	if (!wheel->count)
+		return -1;
+
+	// the next cascade
+	uint64_t next = (wheel->current | UWSGI_WHEEL_MASK) + 1;
+
+	uint64_t bitmap = wheel->bitmap[0];
+	if (bitmap) {
+		// rotate the bitmap so the bit 0 maps to the next tick
+		int shift = (wheel->current + 1) & UWSGI_WHEEL_MASK;
+		if (shift) {
+			bitmap = (bitmap >> shift) | (bitmap << (UWSGI_WHEEL_SLOTS - shift));
+		}
+		uint64_t first = wheel->current + 1 + __builtin_ctzll(bitmap);
+		int upper = 0;
+		for (i = 1; i < UWSGI_WHEEL_LEVELS; i++) {
+			if (wheel->bitmap[i]) {
+				upper = 1;
+				break;
+			}
+		}
+		if (!upper || first < next) {
+			next = first;
+		}
+	}
+
+	if (next <= now)
+		return 0;
+	return next - now;
+}
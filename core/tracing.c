@@ -0,0 +1,332 @@
+/*
+
+	uWSGI request tracing (--trace-spans <collector>)
+
+	Spans are fixed size (64 bytes) records written in a per-process shared memory ring
+	(one per worker, plus a shared one for gateways, mules and the master).
+
+	Producers get a slot with an atomic ticket and publish it by storing ticket+1 in the
+	slot sequence, the ring is lossy: a slow consumer loses the oldest spans (accounted)
+	but producers never wait.
+
+	A master thread drains the rings in batches and sends the spans (as json lines) to
+	the collector (a unix datagram socket or udp address).
+
+	Workers only take a few timestamps while serving a request, the spans are built and
+	pushed in uwsgi_close_request(). Traces are sampled (--trace-sample N traces 1 request every N)
+	and the context is propagated between the http router and the workers using the W3C
+	traceparent format in the UWSGI_TRACEPARENT var (the HTTP traceparent header is honoured too).
+
+*/
+
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+#define UWSGI_TRACE_BATCH 8192
+
+static char *uwsgi_trace_span_names[] = {
+	"",
+	"router.request",
+	"router.connect",
+	"worker.queue",
+	"worker.parse",
+	"worker.handler",
+	"worker.request",
+	"offload",
+};
+
+static uint64_t uwsgi_trace_seed;
+static uint64_t uwsgi_trace_counter;
+static pid_t uwsgi_trace_pid;
+
+// every process (after fork()) gets its own id generator
+static void uwsgi_tracing_seed() {
+	uwsgi_trace_seed = (((uint64_t) uwsgi.mypid) << 32) ^ uwsgi_micros();
+	uwsgi_trace_counter = 0;
+	uwsgi_trace_pid = uwsgi.mypid;
+}
+
+// splitmix64 over an atomic counter, good enough for ids and safe in multithreaded workers
+uint64_t uwsgi_trace_new_id() {
+	if (uwsgi_trace_pid != uwsgi.mypid)
+		uwsgi_tracing_seed();
+	uint64_t z = uwsgi_trace_seed + (uwsgi_atomic_add(uwsgi_trace_counter, 1) + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z = z ^ (z >> 31);
+	// 0 is an invalid id
+	return z ? z : 1;
+}
+
+void uwsgi_tracing_init() {
+	int i;
+	uint64_t size = 1;
+	while (size < uwsgi.trace_ring_size)
+		size <<= 1;
+
+	uwsgi.trace_rings = uwsgi_calloc(sizeof(struct uwsgi_trace_ring *) * (uwsgi.numproc + 1));
+	for (i = 0; i <= uwsgi.numproc; i++) {
+		struct uwsgi_trace_ring *utr = uwsgi_calloc_shared(sizeof(struct uwsgi_trace_ring) + (sizeof(struct uwsgi_trace_span) * size));
+		utr->size = size;
+		uwsgi.trace_rings[i] = utr;
+	}
+	uwsgi_log("tracing: %llu spans ring per process (%llu bytes of shared memory)\n", (unsigned long long) size, (unsigned long long) ((uwsgi.numproc + 1) * (sizeof(struct uwsgi_trace_ring) + (sizeof(struct uwsgi_trace_span) * size))));
+}
+
+// start a new (root or child) context, parent is the context (could be NULL) received from upstream
+void uwsgi_trace_context_new(struct uwsgi_trace_context *utc, struct uwsgi_trace_context *parent) {
+	if (parent && (parent->trace_id[0] | parent->trace_id[1])) {
+		utc->trace_id[0] = parent->trace_id[0];
+		utc->trace_id[1] = parent->trace_id[1];
+		utc->parent_id = parent->span_id;
+		utc->sampled = parent->sampled;
+	}
+	else {
+		utc->trace_id[0] = uwsgi_trace_new_id();
+		utc->trace_id[1] = uwsgi_trace_new_id();
+		utc->parent_id = 0;
+		utc->sampled = 1;
+		if (uwsgi.trace_sample > 1) {
+			utc->sampled = (utc->trace_id[1] % uwsgi.trace_sample) == 0;
+		}
+	}
+	utc->span_id = uwsgi_trace_new_id();
+}
+
+static int uwsgi_trace_hex(char *buf, size_t len, uint64_t * num) {
+	size_t i;
+	uint64_t n = 0;
+	for (i = 0; i < len; i++) {
+		char c = buf[i];
+		n <<= 4;
+		if (c >= '0' && c <= '9')
+			n |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			n |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			n |= c - 'A' + 10;
+		else
+			return -1;
+	}
+	*num = n;
+	return 0;
+}
+
+// 00-<32 hex trace id>-<16 hex parent id>-<2 hex flags>
+int uwsgi_trace_context_parse(struct uwsgi_trace_context *utc, char *buf, size_t len) {
+	if (len < 55)
+		return -1;
+	if (buf[2] != '-' || buf[35] != '-' || buf[52] != '-')
+		return -1;
+	uint64_t flags = 0;
+	if (uwsgi_trace_hex(buf + 3, 16, &utc->trace_id[0]))
+		return -1;
+	if (uwsgi_trace_hex(buf + 19, 16, &utc->trace_id[1]))
+		return -1;
+	if (uwsgi_trace_hex(buf + 36, 16, &utc->span_id))
+		return -1;
+	if (uwsgi_trace_hex(buf + 53, 2, &flags))
+		return -1;
+	if (!(utc->trace_id[0] | utc->trace_id[1]) || !utc->span_id)
+		return -1;
+	utc->sampled = flags & 1;
+	utc->parent_id = 0;
+	return 0;
+}
+
+// buf must be at least 56 bytes
+int uwsgi_trace_context_format(struct uwsgi_trace_context *utc, char *buf) {
+	return snprintf(buf, 56, "00-%016llx%016llx-%016llx-%02x", (unsigned long long) utc->trace_id[0], (unsigned long long) utc->trace_id[1], (unsigned long long) utc->span_id, utc->sampled ? 1 : 0);
+}
+
+void uwsgi_trace_span_push(struct uwsgi_trace_context *utc, uint16_t kind, uint64_t span_id, uint64_t parent_id, uint64_t start, uint64_t end, uint16_t core, uint16_t status) {
+	if (!utc->sampled)
+		return;
+	struct uwsgi_trace_ring *utr = uwsgi.trace_rings[(uwsgi.mywid > 0 && uwsgi.mywid <= uwsgi.numproc) ? uwsgi.mywid : 0];
+	uint64_t ticket = uwsgi_atomic_add(utr->head, 1);
+	struct uwsgi_trace_span *uts = &utr->spans[ticket & (utr->size - 1)];
+	// invalidate the slot while it is written
+	uwsgi_atomic_store(uts->seq, 0);
+	// the release store does not order the following ones (seqlock writer)
+	uwsgi_atomic_fence();
+	uts->trace_id[0] = utc->trace_id[0];
+	uts->trace_id[1] = utc->trace_id[1];
+	uts->span_id = span_id;
+	uts->parent_id = parent_id;
+	uts->start = start;
+	uts->end = end;
+	uts->kind = kind;
+	uts->wid = uwsgi.mywid;
+	uts->core = core;
+	uts->status = status;
+	uwsgi_atomic_store(uts->seq, ticket + 1);
+}
+
+// the context of a request is resolved lazily (only when it is needed)
+struct uwsgi_trace_context *uwsgi_trace_request_context(struct wsgi_request *wsgi_req) {
+	if (wsgi_req->trace_resolved)
+		return &wsgi_req->trace;
+	wsgi_req->trace_resolved = 1;
+	struct uwsgi_trace_context parent;
+	uint16_t len = 0;
+	char *tp = uwsgi_get_var(wsgi_req, "UWSGI_TRACEPARENT", 17, &len);
+	if (!tp) {
+		tp = uwsgi_get_var(wsgi_req, "HTTP_TRACEPARENT", 16, &len);
+	}
+	if (tp && !uwsgi_trace_context_parse(&parent, tp, len)) {
+		uwsgi_trace_context_new(&wsgi_req->trace, &parent);
+	}
+	else {
+		uwsgi_trace_context_new(&wsgi_req->trace, NULL);
+	}
+	return &wsgi_req->trace;
+}
+
+// push the spans of a request (called by uwsgi_close_request())
+void uwsgi_trace_request(struct wsgi_request *wsgi_req) {
+	struct uwsgi_trace_context *utc = uwsgi_trace_request_context(wsgi_req);
+	if (!utc->sampled)
+		return;
+	uint16_t core = wsgi_req->async_id;
+	uint16_t status = wsgi_req->status;
+	uint64_t end = wsgi_req->end_of_request;
+
+	uwsgi_trace_span_push(utc, UWSGI_TRACE_SPAN_REQUEST, utc->span_id, utc->parent_id, wsgi_req->start_of_request, end, core, status);
+	if (wsgi_req->accepted_at && wsgi_req->accepted_at <= wsgi_req->start_of_request) {
+		uwsgi_trace_span_push(utc, UWSGI_TRACE_SPAN_QUEUE, uwsgi_trace_new_id(), utc->span_id, wsgi_req->accepted_at, wsgi_req->start_of_request, core, status);
+	}
+	if (wsgi_req->trace_parse_start) {
+		uwsgi_trace_span_push(utc, UWSGI_TRACE_SPAN_PARSE, uwsgi_trace_new_id(), utc->span_id, wsgi_req->trace_parse_start, wsgi_req->trace_parse_end ? wsgi_req->trace_parse_end : end, core, status);
+	}
+	if (wsgi_req->trace_handler_start) {
+		uwsgi_trace_span_push(utc, UWSGI_TRACE_SPAN_HANDLER, uwsgi_trace_new_id(), utc->span_id, wsgi_req->trace_handler_start, wsgi_req->trace_handler_end ? wsgi_req->trace_handler_end : end, core, status);
+	}
+}
+
+/*
+	exporter (master thread)
+*/
+
+static int uwsgi_trace_span_json(struct uwsgi_buffer *ub, struct uwsgi_trace_span *uts) {
+	char buf[512];
+	int ret = snprintf(buf, sizeof(buf), "{\"trace_id\":\"%016llx%016llx\",\"span_id\":\"%016llx\",\"parent_id\":\"%016llx\",\"name\":\"%s\",\"start\":%llu,\"end\":%llu,\"duration\":%llu,\"worker\":%d,\"core\":%u,\"status\":%u,\"node\":\"%s\"}\n",
+		(unsigned long long) uts->trace_id[0], (unsigned long long) uts->trace_id[1],
+		(unsigned long long) uts->span_id, (unsigned long long) uts->parent_id,
+		uts->kind < (sizeof(uwsgi_trace_span_names) / sizeof(char *)) ? uwsgi_trace_span_names[uts->kind] : "unknown",
+		(unsigned long long) uts->start, (unsigned long long) uts->end, (unsigned long long) (uts->end >= uts->start ? uts->end - uts->start : 0),
+		uts->wid, uts->core, uts->status, uwsgi.hostname);
+	if (ret <= 0 || ret >= (int) sizeof(buf))
+		return -1;
+	return uwsgi_buffer_append(ub, buf, ret);
+}
+
+static void uwsgi_trace_send(int fd, union uwsgi_sockaddr *addr, socklen_t addr_len, struct uwsgi_buffer *ub) {
+	if (!ub->pos)
+		return;
+	if (sendto(fd, ub->buf, ub->pos, 0, &addr->sa, addr_len) < 0) {
+		uwsgi.shared->trace_send_errors++;
+	}
+	ub->pos = 0;
+}
+
+// returns the number of spans
+static uint64_t uwsgi_trace_ring_drain(struct uwsgi_trace_ring *utr, int fd, union uwsgi_sockaddr *addr, socklen_t addr_len, struct uwsgi_buffer *ub, size_t max_datagram) {
+	uint64_t spans = 0;
+	uint64_t head = uwsgi_atomic_load(utr->head);
+	// overrun, skip the overwritten slots
+	if (head - utr->tail > utr->size) {
+		uwsgi_atomic_add(utr->dropped, head - utr->tail - utr->size);
+		utr->tail = head - utr->size;
+	}
+	while (utr->tail < head && spans < UWSGI_TRACE_BATCH) {
+		struct uwsgi_trace_span *slot = &utr->spans[utr->tail & (utr->size - 1)];
+		uint64_t seq = uwsgi_atomic_load(slot->seq);
+		// still being written
+		if (seq == 0 || seq < utr->tail + 1)
+			break;
+		struct uwsgi_trace_span uts;
+		memcpy(&uts, slot, sizeof(struct uwsgi_trace_span));
+		uwsgi_atomic_fence();
+		// overwritten by a later lap (during or before the copy)
+		if (seq != utr->tail + 1 || uwsgi_atomic_load(slot->seq) != seq) {
+			uwsgi_atomic_add(utr->dropped, 1);
+			utr->tail++;
+			continue;
+		}
+		utr->tail++;
+		spans++;
+		size_t before = ub->pos;
+		if (uwsgi_trace_span_json(ub, &uts))
+			continue;
+		if (ub->pos > max_datagram) {
+			// send the batch without the last span and restart from it
+			size_t span_len = ub->pos - before;
+			ub->pos = before;
+			uwsgi_trace_send(fd, addr, addr_len, ub);
+			memmove(ub->buf, ub->buf + before, span_len);
+			ub->pos = span_len;
+		}
+	}
+	utr->exported += spans;
+	return spans;
+}
+
+static void *uwsgi_tracing_loop(void *arg) {
+	sigset_t smask;
+	sigfillset(&smask);
+#ifndef UWSGI_DEBUG
+	sigdelset(&smask, SIGSEGV);
+#endif
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	union uwsgi_sockaddr addr;
+	socklen_t addr_len;
+	int family = AF_UNIX;
+	char *collector = uwsgi_str(uwsgi.trace_spans);
+	char *colon = strchr(collector, ':');
+	if (colon) {
+		family = AF_INET;
+		addr_len = socket_to_in_addr(collector, colon, 0, &addr.sa_in);
+	}
+	else {
+		addr_len = socket_to_un_addr(collector, &addr.sa_un);
+	}
+
+	int fd = socket(family, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		uwsgi_error("uwsgi_tracing_loop()/socket()");
+		return NULL;
+	}
+	uwsgi_socket_nb(fd);
+
+	// keep datagrams below the usual unix/loopback limits
+	size_t max_datagram = 8192;
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(max_datagram + 512);
+
+	for (;;) {
+		int i;
+		uint64_t spans = 0;
+		for (i = 0; i <= uwsgi.numproc; i++) {
+			spans += uwsgi_trace_ring_drain(uwsgi.trace_rings[i], fd, &addr, addr_len, ub, max_datagram);
+		}
+		uwsgi_trace_send(fd, &addr, addr_len, ub);
+		// under load do not wait
+		if (spans >= UWSGI_TRACE_BATCH)
+			continue;
+		usleep(uwsgi.trace_flush_interval * 1000);
+	}
+
+	return NULL;
+}
+
+void uwsgi_tracing_start_exporter() {
+	if (!uwsgi.trace_spans)
+		return;
+	pthread_t t;
+	if (pthread_create(&t, NULL, uwsgi_tracing_loop, NULL)) {
+		uwsgi_error("uwsgi_tracing_start_exporter()/pthread_create()");
+		exit(1);
+	}
+	uwsgi_log("tracing spans exporter thread started (collector: %s)\n", uwsgi.trace_spans);
+}
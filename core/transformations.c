@@ -27,7 +27,7 @@ int uwsgi_apply_transformations(struct wsgi_request *wsgi_req, char *buf, size_t
 	while(ut) {
 		// allocate the buffer (if needed)
 		if (!ut->chunk) {
-			ut->chunk = uwsgi_buffer_new(t_len);
+			ut->chunk = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), t_len);
 		}
 		// skip final transformations before appending data
 		if (ut->is_final) goto next;
@@ -92,10 +92,10 @@ int uwsgi_apply_final_transformations(struct wsgi_request *wsgi_req) {
 
 		if (!ut->chunk) {
 			if (t_len > 0) {
-				ut->chunk = uwsgi_buffer_new(t_len);
+				ut->chunk = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), t_len);
 			}
 			else {
-				ut->chunk = uwsgi_buffer_new(uwsgi.page_size);
+				ut->chunk = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), uwsgi.page_size);
 			}
 		}
 		
@@ -127,22 +127,19 @@ next:
         return 0;
 }
 
+// transformations and their chunks live in the request arena
 void uwsgi_free_transformations(struct wsgi_request *wsgi_req) {
 	struct uwsgi_transformation *ut = wsgi_req->transformations;
 	while(ut) {
-		struct uwsgi_transformation *current_ut = ut;
-		if (current_ut->chunk) {
-			uwsgi_buffer_destroy(current_ut->chunk);
+		if (ut->ub) {
+			uwsgi_buffer_destroy(ut->ub);
 		}
-		if (current_ut->ub) {
-			uwsgi_buffer_destroy(current_ut->ub);
-		}
-		if (current_ut->fd > -1) {
-			close(current_ut->fd);
+		if (ut->fd > -1) {
+			close(ut->fd);
 		}
 		ut = ut->next;
-		free(current_ut);
 	}
+	wsgi_req->transformations = NULL;
 }
 
 struct uwsgi_transformation *uwsgi_add_transformation(struct wsgi_request *wsgi_req, int (*func)(struct wsgi_request *, struct uwsgi_transformation *), void *data) {
@@ -152,7 +149,7 @@ struct uwsgi_transformation *uwsgi_add_transformation(struct wsgi_request *wsgi_
 		ut = ut->next;
 	}
 
-	ut = uwsgi_calloc(sizeof(struct uwsgi_transformation));
+	ut = uwsgi_arena_calloc(uwsgi_req_arena(wsgi_req), sizeof(struct uwsgi_transformation));
 	ut->func = func;
 	ut->fd = -1;
 	ut->data = data;
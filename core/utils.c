@@ -1041,6 +1041,8 @@ void uwsgi_destroy_request(struct wsgi_request *wsgi_req) {
 	// thanks Marko Tiikkaja for catching it
 	wsgi_req->uh->_pktsize = 0;
 
+	uwsgi_req_arena_reset(wsgi_req);
+
 	// some plugins expected async_id to be defined before setup
         int tmp_id = wsgi_req->async_id;
         memset(wsgi_req, 0, sizeof(struct wsgi_request));
@@ -1072,6 +1074,9 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 		uwsgi_buffer_destroy(wsgi_req->headers);
 	}
 
+	// send coalesced response data
+	uwsgi_response_flush(wsgi_req);
+
 	uint64_t end_of_request = uwsgi_micros();
 	wsgi_req->end_of_request = end_of_request;
 
@@ -1096,8 +1101,17 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].read_errors += wsgi_req->read_errors;
 		// this is used for MAX_REQUESTS
 		uwsgi.workers[uwsgi.mywid].delta_requests++;
+		if (uwsgi.histograms) {
+			uwsgi_histograms_account(wsgi_req);
+		}
 	}
 
+	if (uwsgi.trace_spans) {
+		uwsgi_trace_request(wsgi_req);
+	}
+
+	UWSGI_PROBE5(request__done, uwsgi.mywid, wsgi_req->async_id, wsgi_req->status, wsgi_req->end_of_request - wsgi_req->start_of_request, wsgi_req->response_size);
+
 #ifdef UWSGI_ROUTING
 	// apply final routes after accounting
 	uwsgi_apply_final_routes(wsgi_req);
@@ -1147,31 +1161,6 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 		while (waitpid(WAIT_ANY, &waitpid_status, WNOHANG) > 0);
 	}
 
-	// free logvars
-	struct uwsgi_logvar *lv = wsgi_req->logvars;
-	while (lv) {
-		struct uwsgi_logvar *ptr = lv;
-		lv = lv->next;
-		free(ptr);
-	}
-
-	// free additional headers
-	struct uwsgi_string_list *ah = wsgi_req->additional_headers;
-	while (ah) {
-		struct uwsgi_string_list *ptr = ah;
-		ah = ah->next;
-		free(ptr->value);
-		free(ptr);
-	}
-	// free remove headers
-	ah = wsgi_req->remove_headers;
-	while (ah) {
-		struct uwsgi_string_list *ptr = ah;
-		ah = ah->next;
-		free(ptr->value);
-		free(ptr);
-	}
-
 	// free chunked input
 	if (wsgi_req->chunked_input_buf) {
 		uwsgi_buffer_destroy(wsgi_req->chunked_input_buf);
@@ -1185,6 +1174,8 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 		uwsgi_buffer_destroy(wsgi_req->websocket_send_buf);
 	}
 
+	// release logvars, headers, transformations...
+	uwsgi_req_arena_reset(wsgi_req);
 
 	// reset request
 	wsgi_req->uh->_pktsize = 0;
@@ -1195,7 +1186,10 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 	// yes, this is pretty useless but we cannot ensure all of the plugin have the same behaviour
 	uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request = 0;
 
-	if (uwsgi.max_requests > 0 && uwsgi.workers[uwsgi.mywid].delta_requests >= (uwsgi.max_requests + ((uwsgi.mywid-1) * uwsgi.max_requests_delta))
+	// --thread-acceptor: when another core is already stopping the worker, keep serving the queued connections
+	int recycle = !uwsgi.request_ring || !uwsgi_atomic_load(uwsgi.request_ring->stopped);
+
+	if (recycle && uwsgi.max_requests > 0 && uwsgi.workers[uwsgi.mywid].delta_requests >= (uwsgi.max_requests + ((uwsgi.mywid-1) * uwsgi.max_requests_delta))
 	    && (end_of_request - (uwsgi.workers[uwsgi.mywid].last_spawn * 1000000) >= uwsgi.min_worker_lifetime * 1000000)) {
 		goodbye_cruel_world("max requests reached (%llu >= %llu)",
 			(unsigned long long) uwsgi.workers[uwsgi.mywid].delta_requests,
@@ -1203,14 +1197,14 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 		);
 	}
 
-	if (uwsgi.reload_on_as && (rlim_t) vsz >= uwsgi.reload_on_as && (end_of_request - (uwsgi.workers[uwsgi.mywid].last_spawn * 1000000) >= uwsgi.min_worker_lifetime * 1000000)) {
+	if (recycle && uwsgi.reload_on_as && (rlim_t) vsz >= uwsgi.reload_on_as && (end_of_request - (uwsgi.workers[uwsgi.mywid].last_spawn * 1000000) >= uwsgi.min_worker_lifetime * 1000000)) {
 		goodbye_cruel_world("reload-on-as limit reached (%llu >= %llu)",
 			(unsigned long long) (rlim_t) vsz,
 			(unsigned long long) uwsgi.reload_on_as
 		);
 	}
 
-	if (uwsgi.reload_on_rss && (rlim_t) rss >= uwsgi.reload_on_rss && (end_of_request - (uwsgi.workers[uwsgi.mywid].last_spawn * 1000000) >= uwsgi.min_worker_lifetime * 1000000)) {
+	if (recycle && uwsgi.reload_on_rss && (rlim_t) rss >= uwsgi.reload_on_rss && (end_of_request - (uwsgi.workers[uwsgi.mywid].last_spawn * 1000000) >= uwsgi.min_worker_lifetime * 1000000)) {
 		goodbye_cruel_world("reload-on-rss limit reached (%llu >= %llu)",
 			(unsigned long long) (rlim_t) rss,
 			(unsigned long long) uwsgi.reload_on_rss
@@ -1435,8 +1429,16 @@ int wsgi_req_recv(int queue, struct wsgi_request *wsgi_req) {
 		return 0;
 #endif
 
+	UWSGI_PROBE3(request__dispatch, uwsgi.mywid, wsgi_req->async_id, wsgi_req->uh->modifier1);
+
+	if (uwsgi.trace_spans)
+		wsgi_req->trace_handler_start = uwsgi_micros();
+
 	wsgi_req->async_status = uwsgi.p[wsgi_req->uh->modifier1]->request(wsgi_req);
 
+	if (uwsgi.trace_spans)
+		wsgi_req->trace_handler_end = uwsgi_micros();
+
 	return 0;
 }
 
@@ -1453,6 +1455,13 @@ void uwsgi_post_accept(struct wsgi_request *wsgi_req) {
 	if (uwsgi.tcp_nodelay) {
 		uwsgi_tcp_nodelay(wsgi_req->fd);
 	}
+
+	// used for the queue wait histograms (and spans)
+	if (uwsgi.histograms || uwsgi.trace_spans) {
+		wsgi_req->accepted_at = uwsgi_micros();
+	}
+
+	UWSGI_PROBE3(request__accept, uwsgi.mywid, wsgi_req->async_id, wsgi_req->fd);
 }
 
 // accept a new request
@@ -4048,15 +4057,24 @@ int uwsgi_uuid_cmp(char *x, char *y) {
 	return 0;
 }
 
+// will be released on request's end
+static void uwsgi_req_string_list_add(struct wsgi_request *wsgi_req, struct uwsgi_string_list **list, char *value, uint16_t len) {
+	struct uwsgi_arena *ua = uwsgi_req_arena(wsgi_req);
+	struct uwsgi_string_list *usl = uwsgi_arena_calloc(ua, sizeof(struct uwsgi_string_list));
+	usl->value = uwsgi_arena_strncpy(ua, value, len);
+	usl->len = len;
+	while (*list) {
+		list = &(*list)->next;
+	}
+	*list = usl;
+}
+
 void uwsgi_additional_header_add(struct wsgi_request *wsgi_req, char *hh, uint16_t hh_len) {
-	// will be freed on request's end
-	char *header = uwsgi_concat2n(hh, hh_len, "", 0);
-	uwsgi_string_new_list(&wsgi_req->additional_headers, header);
+	uwsgi_req_string_list_add(wsgi_req, &wsgi_req->additional_headers, hh, hh_len);
 }
 
 void uwsgi_remove_header(struct wsgi_request *wsgi_req, char *hh, uint16_t hh_len) {
-	char *header = uwsgi_concat2n(hh, hh_len, "", 0);
-	uwsgi_string_new_list(&wsgi_req->remove_headers, header);
+	uwsgi_req_string_list_add(wsgi_req, &wsgi_req->remove_headers, hh, hh_len);
 }
 
 // based on nginx implementation
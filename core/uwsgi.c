@@ -170,11 +170,35 @@ static struct uwsgi_option uwsgi_base_options[] = {
 
 	{"connect-and-read", required_argument, 0, "connect to a socket and wait for data from it", uwsgi_opt_connect_and_read, NULL, UWSGI_OPT_IMMEDIATE},
 	{"extract", required_argument, 0, "fetch/dump any supported address to stdout", uwsgi_opt_extract, NULL, UWSGI_OPT_IMMEDIATE},
+	{"bench", required_argument, 0, "run the load generator against the specified address, report throughput and latency and exit", uwsgi_opt_set_str, &uwsgi.bench.address, 0},
+	{"bench-protocol", required_argument, 0, "set the load generator protocol (uwsgi, http, raw or websocket, default uwsgi)", uwsgi_opt_set_str, &uwsgi.bench.protocol, 0},
+	{"bench-concurrency", required_argument, 0, "set the number of concurrent load generator connections (default 10)", uwsgi_opt_set_int, &uwsgi.bench.concurrency, 0},
+	{"bench-threads", required_argument, 0, "spread the load generator connections over the specified number of threads (default 1)", uwsgi_opt_set_int, &uwsgi.bench.threads, 0},
+	{"bench-pipeline", required_argument, 0, "send up to <n> pipelined requests per connection (http keepalive, raw with --bench-expect and websocket)", uwsgi_opt_set_int, &uwsgi.bench.pipeline, 0},
+	{"bench-requests", required_argument, 0, "stop the load generator after the specified number of requests (default 10000)", uwsgi_opt_set_64bit, &uwsgi.bench.requests, 0},
+	{"bench-duration", required_argument, 0, "run the load generator for the specified number of seconds", uwsgi_opt_set_int, &uwsgi.bench.duration, 0},
+	{"bench-timeout", required_argument, 0, "set the load generator i/o timeout in seconds (default 10)", uwsgi_opt_set_int, &uwsgi.bench.timeout, 0},
+	{"bench-method", required_argument, 0, "set the load generator request method (default GET)", uwsgi_opt_set_str, &uwsgi.bench.method, 0},
+	{"bench-uri", required_argument, 0, "set the load generator request uri (default /)", uwsgi_opt_set_str, &uwsgi.bench.uri, 0},
+	{"bench-header", required_argument, 0, "add a header to the load generator requests", uwsgi_opt_add_string_list, &uwsgi.bench.headers, 0},
+	{"bench-var", required_argument, 0, "add a var (KEY=VALUE) to the load generator uwsgi packets", uwsgi_opt_add_string_list, &uwsgi.bench.vars, 0},
+	{"bench-body", required_argument, 0, "set the load generator request body (or the raw/websocket payload)", uwsgi_opt_set_str, &uwsgi.bench.body, 0},
+	{"bench-body-file", required_argument, 0, "load the load generator request body (or the raw/websocket payload) from the specified file", uwsgi_opt_set_str, &uwsgi.bench.body_file, 0},
+	{"bench-modifier1", required_argument, 0, "set the modifier1 of the load generator uwsgi packets", uwsgi_opt_set_int, &uwsgi.bench.modifier1, 0},
+	{"bench-modifier2", required_argument, 0, "set the modifier2 of the load generator uwsgi packets", uwsgi_opt_set_int, &uwsgi.bench.modifier2, 0},
+	{"bench-keepalive", no_argument, 0, "reuse the load generator http connections", uwsgi_opt_true, &uwsgi.bench.keepalive, 0},
+	{"bench-expect", required_argument, 0, "in raw mode, consider the response complete after the specified number of bytes (allows connection reuse)", uwsgi_opt_set_64bit, &uwsgi.bench.expect, 0},
+	{"bench-message-size", required_argument, 0, "set the size of the load generator websocket messages when no body is specified (default 64)", uwsgi_opt_set_64bit, &uwsgi.bench.message_size, 0},
+	{"bench-json", no_argument, 0, "report the load generator results as json", uwsgi_opt_true, &uwsgi.bench.json, 0},
 
 	{"listen", required_argument, 'l', "set the socket listen queue size", uwsgi_opt_set_int, &uwsgi.listen_queue, 0},
+	{"accept-batch", required_argument, 0, "accept up to <n> pending connections per wakeup (async mode, thread acceptor and corerouters)", uwsgi_opt_set_int, &uwsgi.accept_batch, 0},
+	{"udp-batch", required_argument, 0, "read up to <n> datagrams per wakeup from the udp, subscription and cache udp servers (default 8, uses recvmmsg() on Linux)", uwsgi_opt_set_int, &uwsgi.udp_batch, 0},
 	{"max-vars", required_argument, 'v', "set the amount of internal iovec/vars structures", uwsgi_opt_max_vars, NULL, 0},
 	{"max-apps", required_argument, 0, "set the maximum number of per-worker applications", uwsgi_opt_set_int, &uwsgi.max_apps, 0},
 	{"buffer-size", required_argument, 'b', "set internal buffer size", uwsgi_opt_set_64bit, &uwsgi.buffer_size, 0},
+	{"response-coalesce", required_argument, 0, "buffer response headers and body chunks smaller than <n> bytes, sending them with a single writev()", uwsgi_opt_set_64bit, &uwsgi.response_coalesce, 0},
+	{"request-arena-size", required_argument, 0, "set the initial size of the per-core request memory arena (default 16k)", uwsgi_opt_set_64bit, &uwsgi.request_arena_size, 0},
 	{"memory-report", no_argument, 'm', "enable memory report", uwsgi_opt_true, &uwsgi.logging_options.memory_report, 0},
 	{"profiler", required_argument, 0, "enable the specified profiler", uwsgi_opt_set_str, &uwsgi.profiler, 0},
 	{"cgi-mode", no_argument, 'c', "force CGI-mode for plugins supporting it", uwsgi_opt_true, &uwsgi.cgi_mode, 0},
@@ -315,12 +339,17 @@ static struct uwsgi_option uwsgi_base_options[] = {
 
 
 	{"queue", required_argument, 0, "enable shared queue", uwsgi_opt_set_int, &uwsgi.queue_size, 0},
-	{"queue-blocksize", required_argument, 0, "set queue blocksize", uwsgi_opt_set_int, &uwsgi.queue_store_sync, 0},
+	{"queue-blocksize", required_argument, 0, "set queue blocksize", uwsgi_opt_set_64bit, &uwsgi.queue_blocksize, 0},
+	{"queue-ring", no_argument, 0, "use the queue memory (items * blocksize) as a lock-free ring of variable-length messages", uwsgi_opt_true, &uwsgi.queue_ring, 0},
 	{"queue-store", required_argument, 0, "enable persistent queue to disk", uwsgi_opt_set_str, &uwsgi.queue_store, UWSGI_OPT_MASTER},
 	{"queue-store-sync", required_argument, 0, "set frequency of sync for persistent queue", uwsgi_opt_set_int, &uwsgi.queue_store_sync, 0},
 
 	{"spooler", required_argument, 'Q', "run a spooler on the specified directory", uwsgi_opt_add_spooler, NULL, UWSGI_OPT_MASTER},
 	{"spooler-external", required_argument, 0, "map spoolers requests to a spooler directory managed by an external instance", uwsgi_opt_add_spooler, (void *) UWSGI_SPOOLER_EXTERNAL, UWSGI_OPT_MASTER},
+	{"spooler-log", required_argument, 0, "run a spooler storing its tasks in append-only segments in the specified directory", uwsgi_opt_add_spooler, (void *) UWSGI_SPOOLER_LOG, UWSGI_OPT_MASTER},
+	{"spooler-log-segment-size", required_argument, 0, "set the size after which spooler log segments are rotated (default 64M)", uwsgi_opt_set_64bit, &uwsgi.spooler_log_segment_size, 0},
+	{"spooler-log-fsync", no_argument, 0, "do not return from spooler log enqueues until the task is on disk (concurrent enqueues share the fsync)", uwsgi_opt_true, &uwsgi.spooler_log_fsync, 0},
+	{"spooler-threads", required_argument, 0, "run up to <n> tasks concurrently in each spooler process using a pool of threads", uwsgi_opt_set_int, &uwsgi.spooler_threads, UWSGI_OPT_THREADS},
 	{"spooler-ordered", no_argument, 0, "try to order the execution of spooler tasks", uwsgi_opt_true, &uwsgi.spooler_ordered, 0},
 	{"spooler-chdir", required_argument, 0, "chdir() to specified directory before each spooler task", uwsgi_opt_set_str, &uwsgi.spooler_chdir, 0},
 	{"spooler-processes", required_argument, 0, "set the number of processes for spoolers", uwsgi_opt_set_int, &uwsgi.spooler_numproc, UWSGI_OPT_IMMEDIATE},
@@ -330,11 +359,16 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"spooler-frequency", required_argument, 0, "set spooler frequency", uwsgi_opt_set_int, &uwsgi.spooler_frequency, 0},
 	{"spooler-freq", required_argument, 0, "set spooler frequency", uwsgi_opt_set_int, &uwsgi.spooler_frequency, 0},
 	{"spooler-cheap", no_argument, 0, "set spooler cheap mode", uwsgi_opt_true, &uwsgi.spooler_cheap, 0},
+	{"spooler-index", no_argument, 0, "track spooler tasks in an inotify-driven in-memory index instead of rescanning the spool directory at every cycle", uwsgi_opt_true, &uwsgi.spooler_index, 0},
+	{"spooler-index-size", required_argument, 0, "set the maximum number of tasks tracked by the spooler index (default 1000000)", uwsgi_opt_set_64bit, &uwsgi.spooler_index_size, 0},
 
 	{"mule", optional_argument, 0, "add a mule", uwsgi_opt_add_mule, NULL, UWSGI_OPT_MASTER},
 	{"mules", required_argument, 0, "add the specified number of mules", uwsgi_opt_add_mules, NULL, UWSGI_OPT_MASTER},
 	{"farm", required_argument, 0, "add a mule farm", uwsgi_opt_add_farm, NULL, UWSGI_OPT_MASTER},
 	{"mule-msg-size", optional_argument, 0, "set mule message buffer size", uwsgi_opt_set_int, &uwsgi.mule_msg_size, UWSGI_OPT_MASTER},
+	{"mule-msg-ring", required_argument, 0, "pass mule messages via shared memory rings of the specified size (one for the mules pool, one per mule and one per farm)", uwsgi_opt_set_64bit, &uwsgi.mule_msg_ring, UWSGI_OPT_MASTER},
+	{"mule-msg-ring-block", required_argument, 0, "when a mule messages ring is full wait up to <n> seconds for room instead of dropping the message", uwsgi_opt_set_int, &uwsgi.mule_msg_ring_block, UWSGI_OPT_MASTER},
+	{"farm-fanout", required_argument, 0, "send a copy of the messages of the specified farm to each of its mules instead of balancing them", uwsgi_opt_add_string_list, &uwsgi.farms_fanout, UWSGI_OPT_MASTER},
 
 	{"signal", required_argument, 0, "send a uwsgi signal to a server", uwsgi_opt_signal, NULL, UWSGI_OPT_IMMEDIATE},
 	{"signal-bufsize", required_argument, 0, "set buffer size for signal queue", uwsgi_opt_set_int, &uwsgi.signal_bufsize, 0},
@@ -347,6 +381,10 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"rbtimer", required_argument, 0, "add a redblack timer (syntax: <signal> <seconds>)", uwsgi_opt_add_string_list, &uwsgi.rb_signal_timers, UWSGI_OPT_MASTER},
 
 	{"rpc-max", required_argument, 0, "maximum number of rpc slots (default: 64)", uwsgi_opt_set_64bit, &uwsgi.rpc_max, 0},
+	{"rpc-pool", required_argument, 0, "keep up to <n> idle persistent connections per remote rpc node", uwsgi_opt_set_int, &uwsgi.rpc_pool, 0},
+	{"rpc-keepalive", required_argument, 0, "keep persistent rpc connections open for <n> seconds waiting for the next call", uwsgi_opt_set_int, &uwsgi.rpc_keepalive, 0},
+	{"rpc-mule-slots", required_argument, 0, "number of concurrent calls the shared memory rpc channel of each mule can hold (default: 4, 0 disables it)", uwsgi_opt_set_int, &uwsgi.rpc_mule_slots, 0},
+	{"rpc-mule-bufsize", required_argument, 0, "size of the request/response buffer of the mules rpc channel slots (default: 64k)", uwsgi_opt_set_64bit, &uwsgi.rpc_mule_bufsize, 0},
 
 	{"disable-logging", no_argument, 'L', "disable request logging", uwsgi_opt_false, &uwsgi.logging_options.enabled, 0},
 
@@ -536,6 +574,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"command-mode", no_argument, 0, "force command mode", uwsgi_opt_true, &uwsgi.command_mode, UWSGI_OPT_IMMEDIATE},
 	{"no-defer-accept", no_argument, 0, "disable deferred-accept on sockets", uwsgi_opt_true, &uwsgi.no_defer_accept, 0},
 	{"tcp-nodelay", no_argument, 0, "enable TCP NODELAY on each request", uwsgi_opt_true, &uwsgi.tcp_nodelay, 0},
+	{"tcp-cork", no_argument, 0, "cork TCP sockets while sending headers and files, so they are sent in full packets (Linux TCP_CORK, BSD TCP_NOPUSH)", uwsgi_opt_true, &uwsgi.tcp_cork, 0},
 	{"so-keepalive", no_argument, 0, "enable TCP KEEPALIVEs", uwsgi_opt_true, &uwsgi.so_keepalive, 0},
 	{"so-send-timeout", no_argument, 0, "set SO_SNDTIMEO", uwsgi_opt_set_int, &uwsgi.so_send_timeout, 0},
 	{"socket-send-timeout", no_argument, 0, "set SO_SNDTIMEO", uwsgi_opt_set_int, &uwsgi.so_send_timeout, 0},
@@ -620,8 +659,16 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"stats-push", required_argument, 0, "push the stats json to the specified destination", uwsgi_opt_add_string_list, &uwsgi.requested_stats_pushers, UWSGI_OPT_MASTER|UWSGI_OPT_METRICS},
 	{"stats-pusher-default-freq", required_argument, 0, "set the default frequency of stats pushers", uwsgi_opt_set_int, &uwsgi.stats_pusher_default_freq, UWSGI_OPT_MASTER},
 	{"stats-pushers-default-freq", required_argument, 0, "set the default frequency of stats pushers", uwsgi_opt_set_int, &uwsgi.stats_pusher_default_freq, UWSGI_OPT_MASTER},
+	{"stats-thread", no_argument, 0, "serve the stats server clients from a dedicated master thread", uwsgi_opt_true, &uwsgi.stats_thread, UWSGI_OPT_MASTER},
+	{"stats-msgpack", no_argument, 0, "encode statistics in msgpack by default (http clients can choose with format=json|msgpack)", uwsgi_opt_true, &uwsgi.stats_msgpack, UWSGI_OPT_MASTER},
 	{"stats-no-cores", no_argument, 0, "disable generation of cores-related stats", uwsgi_opt_true, &uwsgi.stats_no_cores, UWSGI_OPT_MASTER},
 	{"stats-no-metrics", no_argument, 0, "do not include metrics in stats output", uwsgi_opt_true, &uwsgi.stats_no_metrics, UWSGI_OPT_MASTER},
+	{"metrics-http", required_argument, 0, "serve the metrics, workers stats and histograms in the OpenMetrics/Prometheus text format on the specified address", uwsgi_opt_set_str, &uwsgi.metrics_http, UWSGI_OPT_MASTER},
+	{"trace-spans", required_argument, 0, "export per-request tracing spans (json lines) to the specified unix datagram socket or udp address", uwsgi_opt_set_str, &uwsgi.trace_spans, UWSGI_OPT_MASTER},
+	{"trace-ring-size", required_argument, 0, "set the size (in spans) of the per-process tracing rings (default 4096)", uwsgi_opt_set_64bit, &uwsgi.trace_ring_size, UWSGI_OPT_MASTER},
+	{"trace-sample", required_argument, 0, "trace 1 request every N (default 1, all of them)", uwsgi_opt_set_64bit, &uwsgi.trace_sample, UWSGI_OPT_MASTER},
+	{"trace-flush-interval", required_argument, 0, "set the tracing exporter flush interval in milliseconds (default 100)", uwsgi_opt_set_int, &uwsgi.trace_flush_interval, UWSGI_OPT_MASTER},
+	{"histograms", no_argument, 0, "enable request time, queue wait and response size histograms per worker, app and route label (stats and metrics)", uwsgi_opt_true, &uwsgi.histograms, UWSGI_OPT_MASTER},
 	{"multicast", required_argument, 0, "subscribe to specified multicast group", uwsgi_opt_set_str, &uwsgi.multicast_group, UWSGI_OPT_MASTER},
 	{"multicast-ttl", required_argument, 0, "set multicast ttl", uwsgi_opt_set_int, &uwsgi.multicast_ttl, 0},
 	{"multicast-loop", required_argument, 0, "set multicast loop (default 1)", uwsgi_opt_set_int, &uwsgi.multicast_loop, 0},
@@ -698,6 +745,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"privileged-binary-patch-arg", required_argument, 0, "patch the uwsgi binary with a new command and arguments (before privileges drop)", uwsgi_opt_set_str, &uwsgi.privileged_binary_patch_arg, 0},
 	{"unprivileged-binary-patch-arg", required_argument, 0, "patch the uwsgi binary with a new command and arguments (after privileges drop)", uwsgi_opt_set_str, &uwsgi.unprivileged_binary_patch_arg, 0},
 	{"async", required_argument, 0, "enable async mode with specified cores", uwsgi_opt_set_int, &uwsgi.async, 0},
+	{"async-timer-wheel", no_argument, 0, "use a hierarchical timer wheel (instead of the rbtree) for async timeouts", uwsgi_opt_true, &uwsgi.async_timer_wheel, 0},
 	{"disable-async-warn-on-queue-full", no_argument, 0, "Disable printing 'async queue is full' warning messages.", uwsgi_opt_false, &uwsgi.async_warn_if_queue_full, 0},
 	{"max-fd", required_argument, 0, "set maximum number of file descriptors (requires root privileges)", uwsgi_opt_set_int, &uwsgi.requested_max_fd, 0},
 	{"logto", required_argument, 0, "set logfile/udp address", uwsgi_opt_set_str, &uwsgi.logfile, 0},
@@ -706,6 +754,10 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"logformat", required_argument, 0, "set advanced format for request logging", uwsgi_opt_set_str, &uwsgi.logformat, 0},
 	{"logformat-strftime", no_argument, 0, "apply strftime to logformat output", uwsgi_opt_true, &uwsgi.logformat_strftime, 0},
 	{"log-format-strftime", no_argument, 0, "apply strftime to logformat output", uwsgi_opt_true, &uwsgi.logformat_strftime, 0},
+	{"logformat-json", no_argument, 0, "json-escape the values of the logformat variables", uwsgi_opt_true, &uwsgi.logformat_json, 0},
+	{"log-format-json", no_argument, 0, "json-escape the values of the logformat variables", uwsgi_opt_true, &uwsgi.logformat_json, 0},
+	{"logformat-buffer-size", required_argument, 0, "set the per-core buffer size of the logformat engine (default: log-master-bufsize), longer lines are truncated", uwsgi_opt_set_64bit, &uwsgi.logformat_buffer_size, 0},
+	{"logformat-iovec", no_argument, 0, "use the iovec based logformat engine (lines are never truncated, no json escaping)", uwsgi_opt_true, &uwsgi.logformat_iovec, 0},
 	{"logfile-chown", no_argument, 0, "chown logfiles", uwsgi_opt_true, &uwsgi.logfile_chown, 0},
 	{"logfile-chmod", required_argument, 0, "chmod logfiles", uwsgi_opt_logfile_chmod, NULL, 0},
 	{"log-syslog", optional_argument, 0, "log to syslog", uwsgi_opt_set_logger, "syslog", UWSGI_OPT_MASTER | UWSGI_OPT_LOG_MASTER},
@@ -754,8 +806,13 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"alarm-msg-size", required_argument, 0, "set the max size of an alarm message (default 8192)", uwsgi_opt_set_64bit, &uwsgi.alarm_msg_size, 0},
 	{"log-master", no_argument, 0, "delegate logging to master process", uwsgi_opt_true, &uwsgi.log_master, UWSGI_OPT_MASTER|UWSGI_OPT_LOG_MASTER},
 	{"log-master-bufsize", required_argument, 0, "set the buffer size for the master logger. bigger log messages will be truncated", uwsgi_opt_set_64bit, &uwsgi.log_master_bufsize, 0},
+	{"log-batch", required_argument, 0, "buffer up to <n> lines for the loggers supporting batching (socket, rsyslog, graylog2, redislog, zeromq) and send them together", uwsgi_opt_set_int, &uwsgi.log_batch, UWSGI_OPT_MASTER | UWSGI_OPT_LOG_MASTER},
+	{"log-batch-size", required_argument, 0, "set the maximum amount of memory (in bytes) buffered by each batching logger (default 64k)", uwsgi_opt_set_64bit, &uwsgi.log_batch_size, 0},
+	{"log-batch-flush", required_argument, 0, "send batched log lines after the specified number of milliseconds (default 100, the master loop resolution is used without --threaded-logger)", uwsgi_opt_set_int, &uwsgi.log_batch_flush, 0},
 	{"log-master-stream", no_argument, 0, "create the master logpipe as SOCK_STREAM", uwsgi_opt_true, &uwsgi.log_master_stream, 0},
 	{"log-master-req-stream", no_argument, 0, "create the master requests logpipe as SOCK_STREAM", uwsgi_opt_true, &uwsgi.log_master_req_stream, 0},
+	{"log-req-ring", required_argument, 0, "pass request logs to the master via per-worker shared memory rings of the specified size instead of the logpipe", uwsgi_opt_set_64bit, &uwsgi.req_log_ring_size, UWSGI_OPT_REQ_LOG_MASTER},
+	{"log-req-ring-block", no_argument, 0, "wait for free space in the request log ring instead of dropping lines", uwsgi_opt_true, &uwsgi.req_log_ring_block, 0},
 	{"log-reopen", no_argument, 0, "reopen log after reload", uwsgi_opt_true, &uwsgi.log_reopen, 0},
 	{"log-truncate", no_argument, 0, "truncate log on startup", uwsgi_opt_true, &uwsgi.log_truncate, 0},
 	{"log-maxsize", required_argument, 0, "set maximum logfile size", uwsgi_opt_set_64bit, &uwsgi.log_maxsize, UWSGI_OPT_MASTER|UWSGI_OPT_LOG_MASTER},
@@ -804,6 +861,8 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"worker-mount", required_argument, 0, "load application under mountpoint in the specified worker or after workers spawn", uwsgi_opt_add_string_list, &uwsgi.mounts, 0},
 
 	{"threads", required_argument, 0, "run each worker in prethreaded mode with the specified number of threads", uwsgi_opt_set_int, &uwsgi.threads, UWSGI_OPT_THREADS},
+	{"thread-acceptor", no_argument, 0, "use a dedicated acceptor thread feeding the worker threads via a lock-free ring", uwsgi_opt_true, &uwsgi.thread_acceptor, UWSGI_OPT_THREADS},
+	{"thread-acceptor-ring-size", required_argument, 0, "set the size of the --thread-acceptor ring (default 1024, rounded up to a power of 2)", uwsgi_opt_set_64bit, &uwsgi.thread_acceptor_ring_size, UWSGI_OPT_THREADS},
 	{"thread-stacksize", required_argument, 0, "set threads stacksize", uwsgi_opt_set_int, &uwsgi.threads_stacksize, UWSGI_OPT_THREADS},
 	{"threads-stacksize", required_argument, 0, "set threads stacksize", uwsgi_opt_set_int, &uwsgi.threads_stacksize, UWSGI_OPT_THREADS},
 	{"thread-stack-size", required_argument, 0, "set threads stacksize", uwsgi_opt_set_int, &uwsgi.threads_stacksize, UWSGI_OPT_THREADS},
@@ -1208,6 +1267,9 @@ void warn_pipe() {
 void wait_for_threads() {
 	int i, ret;
 
+	// --thread-acceptor: no more connections for the threads going away
+	uwsgi_thread_acceptor_stop();
+
 	// on some platform thread cancellation is REALLY flaky
 	if (uwsgi.no_threads_wait) return;
 
@@ -1254,6 +1316,7 @@ void wait_for_threads() {
 
 end:
 
+	uwsgi_thread_acceptor_drain();
 	pthread_mutex_unlock(&uwsgi.six_feet_under_lock);
 }
 
@@ -1938,6 +2001,11 @@ check:
 			break;
 		}
 	}
+
+	// send the pending log batches
+	if (uwsgi.threaded_logger) pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+	uwsgi_log_batches_flush(1);
+	if (uwsgi.threaded_logger) pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
 }
 
 static void plugins_list(void) {
@@ -2331,6 +2399,11 @@ configure:
 		exit(0);
 	}
 
+	// --bench management (it never returns)
+	if (uwsgi.bench.address) {
+		uwsgi_bench();
+	}
+
 
 	// initial log setup (files and daemonization)
 	uwsgi_setup_log();
@@ -2583,7 +2656,7 @@ configure:
 
 int uwsgi_start(void *v_argv) {
 
-	int i, j;
+	int i;
 
 #ifdef __linux__
 	uwsgi_set_cgroup();
@@ -3106,18 +3179,7 @@ unsafe:
 
 	// cores are allocated, lets allocate logformat (if required)
 	if (uwsgi.logformat) {
-		uwsgi_build_log_format(uwsgi.logformat);
-		uwsgi.logit = uwsgi_logit_lf;
-		// TODO check it
-		//if (uwsgi.logformat_strftime) {
-			//uwsgi.logit = uwsgi_logit_lf_strftime;
-		//}
-		uwsgi.logvectors = uwsgi_malloc(sizeof(struct iovec *) * uwsgi.cores);
-		for (j = 0; j < uwsgi.cores; j++) {
-			uwsgi.logvectors[j] = uwsgi_malloc(sizeof(struct iovec) * uwsgi.logformat_vectors);
-			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_base = "\n";
-			uwsgi.logvectors[j][uwsgi.logformat_vectors - 1].iov_len = 1;
-		}
+		uwsgi_logformat_init();
 	}
 
 	// initialize locks and socket as soon as possible, as the master could enqueue tasks
@@ -3129,6 +3191,8 @@ unsafe:
 			uspool->lock = uwsgi_lock_init(uwsgi_concat2("spooler on ", uspool->dir));
 			if (uspool->mode == UWSGI_SPOOLER_EXTERNAL)
 				goto next;
+			if (uspool->mode == UWSGI_SPOOLER_LOG)
+				uwsgi_spooler_log_init(uspool);
 			create_signal_pipe(uspool->signal_pipe);
 next:
 			uspool = uspool->next;
@@ -3288,6 +3352,7 @@ next2:
 		// setup internal signalling system
 		create_signal_pipe(uwsgi.shared->worker_signal_pipe);
 		uwsgi.signal_socket = uwsgi.shared->worker_signal_pipe[1];
+		uwsgi.signal_bitmap = &uwsgi.shared->worker_signals;
 	}
 
 	// uWSGI is ready
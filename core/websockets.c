@@ -416,6 +416,8 @@ int uwsgi_websocket_handshake(struct wsgi_request *wsgi_req, char *key, uint16_t
 	free(b64);
 
 	wsgi_req->websocket_last_pong = uwsgi_now();
+	// frames must be sent immediately
+	wsgi_req->coalesce_disabled = 1;
 
 	return uwsgi_response_write_headers_do(wsgi_req);
 #else
@@ -70,7 +70,7 @@ int uwsgi_response_prepare_headers(struct wsgi_request *wsgi_req, char *status,
 	if (wsgi_req->headers_sent || wsgi_req->headers_size || wsgi_req->response_size || status_len < 3 || wsgi_req->write_errors) return -1;
 
 	if (!wsgi_req->headers) {
-		wsgi_req->headers = uwsgi_buffer_new(uwsgi.page_size);
+		wsgi_req->headers = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), uwsgi.page_size);
 		wsgi_req->headers->limit = UMAX16;
 	}
 
@@ -96,16 +96,16 @@ int uwsgi_response_prepare_headers(struct wsgi_request *wsgi_req, char *status,
 		size_t new_sc_len = 0;
 		uint16_t sc_len = 0;
 		const char *sc = uwsgi_http_status_msg(status, &sc_len);
-		if (sc) {
-			new_sc = uwsgi_concat3n(status, 3, " ", 1, (char *)sc, sc_len);
-			new_sc_len = 4+sc_len;
-		}
-		else {	
-			new_sc = uwsgi_concat2n(status, 3, " Unknown", 8);
-			new_sc_len = 11;
+		if (!sc) {
+			sc = "Unknown";
+			sc_len = 7;
 		}
+		new_sc_len = 4+sc_len;
+		new_sc = uwsgi_req_alloc(wsgi_req, new_sc_len);
+		memcpy(new_sc, status, 3);
+		new_sc[3] = ' ';
+		memcpy(new_sc + 4, sc, sc_len);
 		hh = wsgi_req->socket->proto_prepare_headers(wsgi_req, new_sc, new_sc_len);
-		free(new_sc);
 	}
 	else {
 		hh = wsgi_req->socket->proto_prepare_headers(wsgi_req, status, status_len);
@@ -145,7 +145,7 @@ static int uwsgi_response_add_header_do(struct wsgi_request *wsgi_req, char *key
 	}
 
         if (!wsgi_req->headers) {
-                wsgi_req->headers = uwsgi_buffer_new(uwsgi.page_size);
+                wsgi_req->headers = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), uwsgi.page_size);
                 wsgi_req->headers->limit = UMAX16;
         }
 
@@ -222,6 +222,8 @@ static int uwsgi_response_write_headers_do0(struct wsgi_request *wsgi_req) {
 
 	if (wsgi_req->socket->proto_fix_headers(wsgi_req)) { wsgi_req->write_errors++ ; return -1;}
 
+	UWSGI_PROBE3(response__start, uwsgi.mywid, wsgi_req->async_id, wsgi_req->status);
+
 	return UWSGI_AGAIN;
 }
 
@@ -355,6 +357,132 @@ fallback:
 
 }
 
+/*
+	response coalescing (--response-coalesce <n>)
+
+	headers and small body chunks are accumulated in a per-request buffer (allocated
+	in the request arena) until the next chunk does not fit in it, then the pending data
+	and the new chunk are sent with a single writev().
+
+	The pending data is always flushed before any other write to the client, and
+	before the request could stop producing output for a while, so the output
+	is the same of the non-buffered mode:
+
+	- when the buffer is full
+	- before vectored writes, sendfile(), uwsgi_simple_write() and offloading
+	- at the end of the request
+	- by the read and sleep wait hooks (core and loop engines) and by the suspend apis,
+	  via uwsgi_response_flush_current()
+	- explicitly by uwsgi_response_flush() in the streaming paths of the plugins (the
+	  python, psgi and rack response loops flush before asking for the next chunk of
+	  an iterator, the write callables after every write)
+
+	websockets disable it after the handshake (frames must be sent immediately)
+*/
+static int uwsgi_response_coalesce_writev(struct wsgi_request *wsgi_req, struct iovec *iov, size_t iov_len) {
+	for(;;) {
+		errno = 0;
+		int ret = wsgi_req->socket->proto_writev(wsgi_req, iov, &iov_len);
+		if (ret < 0) {
+			if (!uwsgi.ignore_write_errors) {
+				uwsgi_req_error("uwsgi_response_write_body_do()");
+			}
+			wsgi_req->write_errors++;
+			return -1;
+		}
+		if (ret == UWSGI_OK) {
+			break;
+		}
+		if (!uwsgi_is_again()) continue;
+		ret = uwsgi_wait_write_req(wsgi_req);
+		if (ret < 0) { wsgi_req->write_errors++; return -1;}
+		if (ret == 0) {
+			uwsgi_log("uwsgi_response_write_body_do() TIMEOUT !!!\n");
+			wsgi_req->write_errors++;
+			return -1;
+		}
+	}
+	// counters are updated when the data is queued
+	wsgi_req->write_pos = 0;
+	return UWSGI_OK;
+}
+
+static int uwsgi_response_coalesce(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	struct uwsgi_buffer *ub = wsgi_req->coalesce;
+	if (!ub) {
+		ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), uwsgi.response_coalesce);
+		wsgi_req->coalesce = ub;
+	}
+
+	if (ub->pos + len <= ub->len) {
+		memcpy(ub->buf + ub->pos, buf, len);
+		ub->pos += len;
+		return UWSGI_OK;
+	}
+
+	struct iovec iov[2];
+	size_t iov_len = 0;
+	if (ub->pos > 0) {
+		iov[0].iov_base = ub->buf;
+		iov[0].iov_len = ub->pos;
+		iov_len++;
+	}
+	iov[iov_len].iov_base = buf;
+	iov[iov_len].iov_len = len;
+	iov_len++;
+
+	int ret = uwsgi_response_coalesce_writev(wsgi_req, iov, iov_len);
+	ub->pos = 0;
+	return ret;
+}
+
+// send the pending (coalesced) response data
+int uwsgi_response_flush(struct wsgi_request *wsgi_req) {
+	struct uwsgi_buffer *ub = wsgi_req->coalesce;
+	if (!ub || ub->pos == 0) return 0;
+
+	if (wsgi_req->write_errors) {
+		ub->pos = 0;
+		return -1;
+	}
+
+	struct iovec iov;
+	iov.iov_base = ub->buf;
+	iov.iov_len = ub->pos;
+	int ret = uwsgi_response_coalesce_writev(wsgi_req, &iov, 1);
+	ub->pos = 0;
+	return ret;
+}
+
+// flush the pending data of the current request (if any), the wait hooks call it before sleeping
+void uwsgi_response_flush_current() {
+	if (!uwsgi.response_coalesce) return;
+	struct wsgi_request *wsgi_req = current_wsgi_req();
+	if (wsgi_req) uwsgi_response_flush(wsgi_req);
+}
+
+static int uwsgi_response_write_body_coalesce(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	// the headers are queued too, so they can be sent with the first chunks
+	if (!wsgi_req->headers_sent && wsgi_req->headers) {
+		int ret = uwsgi_response_write_headers_do0(wsgi_req);
+		if (ret == UWSGI_AGAIN) {
+			if (uwsgi_response_coalesce(wsgi_req, wsgi_req->headers->buf, wsgi_req->headers->pos)) return -1;
+			wsgi_req->headers_size += wsgi_req->headers->pos;
+			wsgi_req->headers_sent = 1;
+		}
+		else if (ret != UWSGI_OK) {
+			wsgi_req->write_errors++;
+			return -1;
+		}
+	}
+
+	if (len == 0) return UWSGI_OK;
+
+	if (uwsgi_response_coalesce(wsgi_req, buf, len)) return -1;
+	wsgi_req->response_size += len;
+	return UWSGI_OK;
+}
+
 // this is the function called by all request plugins to send chunks to the client
 int uwsgi_response_write_body_do(struct wsgi_request *wsgi_req, char *buf, size_t len) {
 
@@ -395,6 +523,10 @@ int uwsgi_response_write_body_do(struct wsgi_request *wsgi_req, char *buf, size_
 	}
 
 write:
+	if (uwsgi.response_coalesce && !wsgi_req->coalesce_disabled && wsgi_req->socket->proto_writev) {
+		return uwsgi_response_write_body_coalesce(wsgi_req, buf, len);
+	}
+
 	// send headers if not already sent
 	if (!wsgi_req->headers_sent) {
 		if (wsgi_req->socket->proto_writev && len > 0 && wsgi_req->headers) {
@@ -410,6 +542,9 @@ write:
 sendbody:
 
 	if (len == 0) return UWSGI_OK;
+
+	// coalescing could have been disabled with pending data
+	if (uwsgi_response_flush(wsgi_req)) return -1;
 	
 	for(;;) {
 		errno = 0;
@@ -500,6 +635,7 @@ write:
 sendbody:
 
         if (len == 0) return UWSGI_OK;
+	if (uwsgi_response_flush(wsgi_req)) return -1;
 	// unfortunately vector based I/O cannot be accomplished on all protocols
 	if (!wsgi_req->socket->proto_writev) goto fallback;
 
@@ -567,6 +703,22 @@ done:
 }
 
 
+// --tcp-cork: headers and the first file chunk are sent in the same packet
+static void uwsgi_response_cork(struct wsgi_request *wsgi_req, int on) {
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+	if (wsgi_req->socket->family != AF_INET && wsgi_req->socket->family != AF_INET6) return;
+#ifdef TCP_CORK
+	if (setsockopt(wsgi_req->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(int))) {
+		uwsgi_req_error("uwsgi_response_cork()/setsockopt(TCP_CORK)");
+	}
+#else
+	if (setsockopt(wsgi_req->fd, IPPROTO_TCP, TCP_NOPUSH, &on, sizeof(int))) {
+		uwsgi_req_error("uwsgi_response_cork()/setsockopt(TCP_NOPUSH)");
+	}
+#endif
+#endif
+}
+
 int uwsgi_response_sendfile_do(struct wsgi_request *wsgi_req, int fd, size_t pos, size_t len) {
 	return uwsgi_response_sendfile_do_can_close(wsgi_req, fd, pos, len, 1);	
 }
@@ -585,6 +737,12 @@ int uwsgi_response_sendfile_do_can_close(struct wsgi_request *wsgi_req, int fd,
 		return UWSGI_OK;
 	}
 
+	int corked = 0;
+	if (uwsgi.tcp_cork && !wsgi_req->socket->can_offload && (!wsgi_req->headers_sent || (wsgi_req->coalesce && wsgi_req->coalesce->pos))) {
+		uwsgi_response_cork(wsgi_req, 1);
+		corked = 1;
+	}
+
 	if (!wsgi_req->headers_sent) {
 		int ret = uwsgi_response_write_headers_do(wsgi_req);
 		if (ret == UWSGI_OK) goto sendfile;
@@ -596,6 +754,11 @@ int uwsgi_response_sendfile_do_can_close(struct wsgi_request *wsgi_req, int fd,
 
 sendfile:
 
+	if (uwsgi_response_flush(wsgi_req)) {
+		if (can_close) close(fd);
+		return -1;
+	}
+
 	if (len == 0) {
 		struct stat st;
 		if (fstat(fd, &st)) {
@@ -669,6 +832,7 @@ sendfile:
         wsgi_req->response_size += wsgi_req->write_pos;
 	// reset for the next write
         wsgi_req->write_pos = 0;
+	if (corked) uwsgi_response_cork(wsgi_req, 0);
 	// close the file descriptor
 	if (can_close) close(fd);
         return UWSGI_OK;
@@ -703,6 +867,8 @@ int uwsgi_simple_wait_write_hook(int fd, int timeout) {
 */
 int uwsgi_simple_write(struct wsgi_request *wsgi_req, char *buf, size_t len) {
 
+	if (uwsgi_response_flush(wsgi_req)) return -1;
+
 	wsgi_req->write_pos = 0;
 
 	for(;;) {
@@ -53,6 +53,7 @@ static void gil_asyncio_release() {
 static int uwsgi_asyncio_wait_read_hook(int fd, int timeout) {
 
 	struct wsgi_request *wsgi_req = current_wsgi_req();
+	uwsgi_response_flush_current();
 
 	if (PyObject_CallMethod(uasyncio.loop, "add_reader", "iOl", fd, uasyncio.hook_fd,(long) wsgi_req) == NULL) {
 		goto error;
@@ -415,12 +415,35 @@ end:
 		corerouter_close_session(ucr, cs);
 	}
 	else {
+		// the backend is gone, the request is over
+		corerouter_trace_end(cs, peer->failed);
 		if (cs->can_keepalive == 0 && cs->wait_full_write == 0) {
 			corerouter_close_session(ucr, cs);
 		}
 	}
 }
 
+// start the tracing context of a new request (the first one of a connection starts at accept() time)
+void corerouter_trace_start(struct corerouter_session *cs, struct uwsgi_trace_context *parent) {
+	if (!uwsgi.trace_spans) return;
+	// keepalive, close the previous one
+	corerouter_trace_end(cs, 0);
+	uwsgi_trace_context_new(&cs->trace, parent);
+	if (cs->trace_accepted) {
+		cs->trace_start = cs->trace_accepted;
+		cs->trace_accepted = 0;
+	}
+	else {
+		cs->trace_start = uwsgi_micros();
+	}
+}
+
+void corerouter_trace_end(struct corerouter_session *cs, uint16_t status) {
+	if (!cs->trace_start) return;
+	uwsgi_trace_span_push(&cs->trace, UWSGI_TRACE_SPAN_ROUTER_REQUEST, cs->trace.span_id, cs->trace.parent_id, cs->trace_start, uwsgi_micros(), 0, status);
+	cs->trace_start = 0;
+}
+
 // destroy a session
 void corerouter_close_session(struct uwsgi_corerouter *ucr, struct corerouter_session *cr_session) {
 
@@ -441,6 +464,8 @@ void corerouter_close_session(struct uwsgi_corerouter *ucr, struct corerouter_se
 		if (uwsgi_cr_peer_del(tmp_peer) < 0) return; 
 	}
 
+	corerouter_trace_end(cr_session, 0);
+
 	// could be used to free additional resources
 	if (cr_session->close)
 		cr_session->close(cr_session);
@@ -454,22 +479,61 @@ void corerouter_close_session(struct uwsgi_corerouter *ucr, struct corerouter_se
 	ucr->active_sessions--;
 }
 
+/*
+	with the timer wheel, timers are embedded in the peer (peer->timeout is always NULL)
+*/
+struct uwsgi_rb_timer *corerouter_add_timeout(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer, time_t now) {
+	if (ucr->wheel) {
+		uwsgi_add_wheel_timer(ucr->wheel, &peer->wheel_timeout, now + peer->current_timeout, peer);
+		return NULL;
+	}
+	return uwsgi_add_rb_timer(ucr->timeouts, now + peer->current_timeout, peer);
+}
+
+void corerouter_del_timeout(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer) {
+	if (ucr->wheel) {
+		uwsgi_del_wheel_timer(ucr->wheel, &peer->wheel_timeout);
+		return;
+	}
+	uwsgi_del_rb_timer(ucr->timeouts, peer->timeout);
+	free(peer->timeout);
+}
+
 struct uwsgi_rb_timer *corerouter_reset_timeout(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer) {
-	cr_del_timeout(ucr, peer);
+	// the wheel supports re-arming without removal
+	if (!ucr->wheel) {
+		cr_del_timeout(ucr, peer);
+	}
 	return cr_add_timeout(ucr, peer);
 }
 
 struct uwsgi_rb_timer *corerouter_reset_timeout_fast(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer, time_t now) {
-        cr_del_timeout(ucr, peer);
+	if (!ucr->wheel) {
+        	cr_del_timeout(ucr, peer);
+	}
         return cr_add_timeout_fast(ucr, peer, now);
 }
 
+static void corerouter_expire_peer(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer) {
+	peer->timed_out = 1;
+	if (peer->connecting) {
+		peer->failed = 1;
+	}
+	corerouter_close_peer(ucr, peer);
+}
 
 static void corerouter_expire_timeouts(struct uwsgi_corerouter *ucr, time_t now) {
 
 	uint64_t current = (uint64_t) now;
 	struct uwsgi_rb_timer *urbt;
-	struct corerouter_peer *peer;
+
+	if (ucr->wheel) {
+		struct uwsgi_wheel_timer *uwt;
+		while ((uwt = uwsgi_expired_wheel_timer(ucr->wheel, current))) {
+			corerouter_expire_peer(ucr, (struct corerouter_peer *) uwt->data);
+		}
+		return;
+	}
 
 	for (;;) {
 		urbt = uwsgi_min_rb_timer(ucr->timeouts, NULL);
@@ -477,12 +541,7 @@ static void corerouter_expire_timeouts(struct uwsgi_corerouter *ucr, time_t now)
 			return;
 
 		if (urbt->value <= current) {
-			peer = (struct corerouter_peer *) urbt->data;
-			peer->timed_out = 1;
-			if (peer->connecting) {
-				peer->failed = 1;
-			}
-			corerouter_close_peer(ucr, peer);
+			corerouter_expire_peer(ucr, (struct corerouter_peer *) urbt->data);
 			continue;
 		}
 
@@ -612,6 +671,10 @@ struct corerouter_session *corerouter_alloc_session(struct uwsgi_corerouter *ucr
 
 	ucr->active_sessions++;
 
+	if (uwsgi.trace_spans) {
+		cs->trace_accepted = uwsgi_micros();
+	}
+
 	// build the client address
 	memcpy(&cs->client_sockaddr, cr_addr, cr_addr_len);
 	switch(cr_addr->sa_family) {
@@ -774,21 +837,32 @@ void uwsgi_corerouter_loop(int id, void *data) {
                         }
 
 	ucr->timeouts = uwsgi_init_rb_timer();
+	if (ucr->timer_wheel) {
+		ucr->wheel = uwsgi_init_timer_wheel(uwsgi_now());
+	}
 
 	for (;;) {
 
 		time_t now = uwsgi_now();
 
 		// set timeouts and harakiri
-		min_timeout = uwsgi_min_rb_timer(ucr->timeouts, NULL);
-		if (min_timeout == NULL) {
-			delta = -1;
+		if (ucr->wheel) {
+			delta = uwsgi_wheel_timer_next(ucr->wheel, now);
+			if (delta == 0) {
+				corerouter_expire_timeouts(ucr, now);
+			}
 		}
 		else {
-			delta = min_timeout->value - now;
-			if (delta <= 0) {
-				corerouter_expire_timeouts(ucr, now);
-				delta = 0;
+			min_timeout = uwsgi_min_rb_timer(ucr->timeouts, NULL);
+			if (min_timeout == NULL) {
+				delta = -1;
+			}
+			else {
+				delta = min_timeout->value - now;
+				if (delta <= 0) {
+					corerouter_expire_timeouts(ucr, now);
+					delta = 0;
+				}
 			}
 		}
 
@@ -822,26 +896,27 @@ void uwsgi_corerouter_loop(int id, void *data) {
 			while (ugs) {
 				if (ugs->gateway == &ushared->gateways[id] && ucr->interesting_fd == ugs->fd) {
 					if (!ugs->subscription) {
+						// drain up to --accept-batch pending connections
+						int accepted;
+						for (accepted = 0; accepted < uwsgi.accept_batch; accepted++) {
+							cr_addr_len = sizeof(struct sockaddr_un);
 #if defined(__linux__) && defined(SOCK_NONBLOCK) && !defined(OBSOLETE_LINUX_KERNEL)
-						new_connection = accept4(ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len, SOCK_NONBLOCK);
-						if (new_connection < 0) {
-							taken = 1;
-							break;
-						}
+							new_connection = accept4(ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len, SOCK_NONBLOCK);
+							if (new_connection < 0)
+								break;
 #else
-						new_connection = accept(ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len);
-						if (new_connection < 0) {
-							taken = 1;
-							break;
-						}
-						// set socket in non-blocking mode, on non-linux platforms, clients get the server mode
+							new_connection = accept(ucr->interesting_fd, (struct sockaddr *) &cr_addr, &cr_addr_len);
+							if (new_connection < 0)
+								break;
+							// set socket in non-blocking mode, on non-linux platforms, clients get the server mode
 #ifdef __linux__
-                                                uwsgi_socket_nb(new_connection);
+							uwsgi_socket_nb(new_connection);
 #endif
 #endif
-						struct corerouter_session *cr = corerouter_alloc_session(ucr, ugs, new_connection, (struct sockaddr *) &cr_addr, cr_addr_len);
-						//something wrong in the allocation
-						if (!cr) break;
+							struct corerouter_session *cr = corerouter_alloc_session(ucr, ugs, new_connection, (struct sockaddr *) &cr_addr, cr_addr_len);
+							//something wrong in the allocation
+							if (!cr) break;
+						}
 					}
 					else if (ugs->subscription) {
 						uwsgi_corerouter_manage_subscription(ucr, id, ugs);
@@ -3,9 +3,9 @@
 #define COREROUTER_STATUS_RECV_HDR 2
 #define COREROUTER_STATUS_RESPONSE 3
 
-#define cr_add_timeout(u, x) uwsgi_add_rb_timer(u->timeouts, uwsgi_now()+x->current_timeout, x)
-#define cr_add_timeout_fast(u, x, t) uwsgi_add_rb_timer(u->timeouts, t+x->current_timeout, x)
-#define cr_del_timeout(u, x) uwsgi_del_rb_timer(u->timeouts, x->timeout); free(x->timeout);
+#define cr_add_timeout(u, x) corerouter_add_timeout(u, x, uwsgi_now())
+#define cr_add_timeout_fast(u, x, t) corerouter_add_timeout(u, x, t)
+#define cr_del_timeout(u, x) corerouter_del_timeout(u, x)
 
 #define uwsgi_cr_error(x, y) uwsgi_log("[uwsgi-%s key: %.*s client_addr: %s client_port: %s] %s: %s [%s line %d]\n", x->session->corerouter->short_name, (x == x->session->main_peer) ? (x->session->peers ? x->session->peers->key_len: 0) : x->key_len, (x == x->session->main_peer) ? (x->session->peers ? x->session->peers->key: "") : x->key, x->session->client_address, x->session->client_port, y, strerror(errno), __FILE__, __LINE__)
 #define uwsgi_cr_log(x, y, ...) uwsgi_log("[uwsgi-%s key: %.*s client_addr: %s client_port: %s]" y, x->session->corerouter->short_name,  (x == x->session->main_peer) ? (x->session->peers ? x->session->peers->key_len: 0) : x->key_len, (x == x->session->main_peer) ? (x->session->peers ? x->session->peers->key: "") : x->key, x->session->client_address, x->session->client_port, __VA_ARGS__)
@@ -150,6 +150,8 @@ struct corerouter_peer {
         int timed_out;
 	// the timeout rb_tree
         struct uwsgi_rb_timer *timeout;
+	// the timeout when the timer wheel is in use
+	struct uwsgi_wheel_timer wheel_timeout;
 
 	// each peer can map to a different instance
         char *tmp_socket_name;
@@ -218,6 +220,8 @@ struct uwsgi_corerouter {
         int quiet;
 
         struct uwsgi_rbtree *timeouts;
+	int timer_wheel;
+	struct uwsgi_timer_wheel *wheel;
 
         char *use_cache;
 	struct uwsgi_cache *cache;
@@ -323,6 +327,11 @@ struct corerouter_session {
 
 	// use 11 bytes to be snprintf friendly
 	char client_port[11];
+
+	// --trace-spans (the context of the current request)
+	struct uwsgi_trace_context trace;
+	uint64_t trace_start;
+	uint64_t trace_accepted;
 };
 
 void uwsgi_opt_corerouter(char *, char *, void *);
@@ -345,6 +354,8 @@ int uwsgi_corerouter_init(struct uwsgi_corerouter *);
 
 struct corerouter_session *corerouter_alloc_session(struct uwsgi_corerouter *, struct uwsgi_gateway_socket *, int, struct sockaddr *, socklen_t);
 void corerouter_close_session(struct uwsgi_corerouter *, struct corerouter_session *);
+void corerouter_trace_start(struct corerouter_session *, struct uwsgi_trace_context *);
+void corerouter_trace_end(struct corerouter_session *, uint16_t);
 
 int uwsgi_cr_map_use_void(struct uwsgi_corerouter *, struct corerouter_peer *);
 int uwsgi_cr_map_use_cache(struct uwsgi_corerouter *, struct corerouter_peer *);
@@ -364,3 +375,5 @@ struct corerouter_peer *uwsgi_cr_peer_add(struct corerouter_session *);
 struct corerouter_peer *uwsgi_cr_peer_find_by_sid(struct corerouter_session *, uint32_t);
 void corerouter_close_peer(struct uwsgi_corerouter *, struct corerouter_peer *);
 struct uwsgi_rb_timer *corerouter_reset_timeout(struct uwsgi_corerouter *, struct corerouter_peer *);
+struct uwsgi_rb_timer *corerouter_add_timeout(struct uwsgi_corerouter *, struct corerouter_peer *, time_t);
+void corerouter_del_timeout(struct uwsgi_corerouter *, struct corerouter_peer *);
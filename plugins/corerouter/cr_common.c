@@ -111,21 +111,16 @@ void *uwsgi_corerouter_setup_event_queue(struct uwsgi_corerouter *ucr, int id) {
 	return event_queue_alloc(ucr->nevents);
 }
 
-void uwsgi_corerouter_manage_subscription(struct uwsgi_corerouter *ucr, int id, struct uwsgi_gateway_socket *ugs) {
+static void corerouter_manage_subscription_packet(struct uwsgi_corerouter *ucr, int id, char *bbuf, ssize_t len, struct uwsgi_subscribe_req *creds) {
 
 	int i;
 	struct uwsgi_subscribe_req usr;
-	char bbuf[4096];
-	ssize_t len = -1;
 
 	memset(&usr, 0, sizeof(struct uwsgi_subscribe_req));
+	usr.pid = creds->pid;
+	usr.uid = creds->uid;
+	usr.gid = creds->gid;
 
-	if (uwsgi.subscriptions_use_credentials) {
-		len = uwsgi_recv_cred2(ugs->fd, bbuf, 4096, &usr.pid, &usr.uid, &usr.gid);
-	}
-	else {
-		len = recv(ugs->fd, bbuf, 4096, 0);
-	}
 	if (len > 0) {
 		uwsgi_hooked_parse(bbuf + 4, len - 4, corerouter_manage_subscription, &usr);
 		if (usr.sign_len > 0) {
@@ -232,6 +227,32 @@ void uwsgi_corerouter_manage_subscription(struct uwsgi_corerouter *ucr, int id,
 
 }
 
+void uwsgi_corerouter_manage_subscription(struct uwsgi_corerouter *ucr, int id, struct uwsgi_gateway_socket *ugs) {
+
+	static struct uwsgi_dgram_batch *udb = NULL;
+	struct uwsgi_subscribe_req creds;
+	char bbuf[4096];
+	int i;
+
+	memset(&creds, 0, sizeof(struct uwsgi_subscribe_req));
+
+	// credentials are passed as ancillary data, so they need a recvmsg() per packet
+	if (uwsgi.subscriptions_use_credentials) {
+		ssize_t len = uwsgi_recv_cred2(ugs->fd, bbuf, 4096, &creds.pid, &creds.uid, &creds.gid);
+		corerouter_manage_subscription_packet(ucr, id, bbuf, len, &creds);
+		return;
+	}
+
+	if (!udb) {
+		udb = uwsgi_dgram_batch_new(uwsgi.udp_batch, 4096);
+	}
+
+	int n = uwsgi_dgram_batch_recv(ugs->fd, udb);
+	for (i = 0; i < n; i++) {
+		corerouter_manage_subscription_packet(ucr, id, udb->buf + (udb->buf_size * i), udb->len[i], &creds);
+	}
+}
+
 void uwsgi_corerouter_manage_internal_subscription(struct uwsgi_corerouter *ucr, int fd) {
 
 
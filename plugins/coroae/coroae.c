@@ -67,6 +67,7 @@ SV * coroae_coro_new(CV *block) {
 
 static int coroae_wait_milliseconds(int timeout) {
 	char buf[256];
+	uwsgi_response_flush_current();
 	double d = ((double)timeout)/1000.0;
 	int ret = snprintf(buf, 256, "Coro::AnyEvent::sleep %f", d);
 	if (ret <= 0 || ret > 256) return -1;
@@ -76,6 +77,7 @@ static int coroae_wait_milliseconds(int timeout) {
 
 static int coroae_wait_fd_read(int fd, int timeout) {
 	int ret = 0;
+	uwsgi_response_flush_current();
 	dSP;
         ENTER;
         SAVETMPS;
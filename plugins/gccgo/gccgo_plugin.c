@@ -308,6 +308,7 @@ static struct wsgi_request *uwsgi_gccgo_current_wsgi_req(void) {
 }
 
 static int uwsgi_gccgo_wait_read_hook(int fd, int timeout) {
+        uwsgi_response_flush_current();
         void *pdesc = runtime_pollOpen(fd);
 	int64_t t = (uwsgi_micros() * 1000LL) + (((int64_t)timeout) * 1000LL * 1000LL * 1000LL);
 	runtime_pollSetDeadline(pdesc, t, 'r');
@@ -55,6 +55,8 @@ int uwsgi_gevent_wait_read_hook(int fd, int timeout) {
 
         PyObject *ret = NULL;
 
+        uwsgi_response_flush_current();
+
         /// create a watcher for writes
         PyObject *watcher = PyObject_CallMethod(ugevent.hub_loop, "io", "ii", fd, 1);
         if (!watcher) return -1;
@@ -102,6 +104,8 @@ int uwsgi_gevent_wait_milliseconds_hook(int timeout) {
 
         PyObject *ret = NULL;
 
+        uwsgi_response_flush_current();
+
         PyObject *timer = PyObject_CallMethod(ugevent.hub_loop, "timer", "f", ((double) timeout)/1000.0);
         if (!timer) return -1;
 
@@ -12,55 +12,58 @@ struct graylog2_config {
 	size_t escaped_len;
 } g2c;
 
-ssize_t uwsgi_graylog2_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+static void uwsgi_graylog2_logger_configure(struct uwsgi_logger *ul) {
 
-	size_t i;
+	if (!ul->arg) {
+		uwsgi_log_safe("invalid graylog2 syntax\n");
+		exit(1);
+	}
 
-	if (!ul->configured) {
+	ul->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (ul->fd < 0) {
+		uwsgi_error_safe("socket()");
+		exit(1);
+	}
 
-		if (!ul->arg) {
-			uwsgi_log_safe("invalid graylog2 syntax\n");
-			exit(1);
-		}
+	uwsgi_socket_nb(ul->fd);
 
-		ul->fd = socket(AF_INET, SOCK_DGRAM, 0);
-		if (ul->fd < 0) {
-			uwsgi_error_safe("socket()");
-			exit(1);
-		}
+	char *comma = strchr(ul->arg, ',');
+	if (!comma) {
+		uwsgi_log_safe("invalid graylog2 syntax\n");
+                exit(1);
+	}
 
-		uwsgi_socket_nb(ul->fd);
+	g2c.host = comma + 1;
 
-		char *comma = strchr(ul->arg, ',');
-		if (!comma) {
-			uwsgi_log_safe("invalid graylog2 syntax\n");
-                        exit(1);
-		}
+	*comma = 0;
 
-		g2c.host = comma + 1;
+	char *colon = strchr(ul->arg, ':');
+	if (!colon) {
+		uwsgi_log_safe("invalid graylog2 syntax\n");
+                exit(1);
+	}
 
-		*comma = 0;
+	ul->addr_len = socket_to_in_addr(ul->arg, colon, 0, &ul->addr.sa_in);
 
-		char *colon = strchr(ul->arg, ':');
-		if (!colon) {
-			uwsgi_log_safe("invalid graylog2 syntax\n");
-                        exit(1);
-		}
+	*comma = ',';
 
-		ul->addr_len = socket_to_in_addr(ul->arg, colon, 0, &ul->addr.sa_in);
+	ul->buf = uwsgi_malloc(MAX_GELF);
 
-		*comma = ',';
+	ul->configured = 1;
+}
 
-		ul->buf = uwsgi_malloc(MAX_GELF);
+// build the GELF json in g2c.json_buf
+static int uwsgi_graylog2_build(char *message, size_t len) {
 
-		ul->configured = 1;
-	}
+	size_t i;
+
+	// each char could be escaped
+	if (len > MAX_GELF / 2) len = MAX_GELF / 2;
 
 	g2c.escaped_len = 0;
 
 	int truncated = 0;
 	char *ptr = g2c.escaped_buf;
-	uLongf destLen = MAX_GELF;
 
 	for(i=0;i<len;i++) {
 		if (message[i] == '\\') {
@@ -87,8 +90,18 @@ ssize_t uwsgi_graylog2_logger(struct uwsgi_logger *ul, char *message, size_t len
 	if (truncated) truncated = 128 - (truncated-1);
 	else (truncated = g2c.escaped_len);
 
-	int rlen = snprintf(g2c.json_buf, MAX_GELF, "{ \"version\": \"1.0\", \"host\": \"%s\", \"short_message\": \"%.*s\", \"full_message\": \"%.*s\", \"timestamp\": %d, \"level\": 5, \"facility\": \"uWSGI-%s\" }",
+	return snprintf(g2c.json_buf, MAX_GELF, "{ \"version\": \"1.0\", \"host\": \"%s\", \"short_message\": \"%.*s\", \"full_message\": \"%.*s\", \"timestamp\": %d, \"level\": 5, \"facility\": \"uWSGI-%s\" }",
 		g2c.host, truncated, g2c.escaped_buf, (int)g2c.escaped_len, g2c.escaped_buf, (int) uwsgi_now(), UWSGI_VERSION);
+}
+
+ssize_t uwsgi_graylog2_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+
+	if (!ul->configured) {
+		uwsgi_graylog2_logger_configure(ul);
+	}
+
+	uLongf destLen = MAX_GELF;
+	int rlen = uwsgi_graylog2_build(message, len);
 
 	if (rlen > 0 && rlen < MAX_GELF) {
 		if (compressBound((uLong) rlen) <= MAX_GELF) {
@@ -103,8 +116,53 @@ ssize_t uwsgi_graylog2_logger(struct uwsgi_logger *ul, char *message, size_t len
 }
 
 
+// compress the messages of a batch in a single buffer and send them with a single syscall
+static ssize_t uwsgi_graylog2_logger_batch(struct uwsgi_logger *ul, struct iovec *lines, size_t n) {
+
+	size_t i, count = 0, pos = 0;
+	ssize_t ret = 0;
+
+	if (!ul->configured) {
+		uwsgi_graylog2_logger_configure(ul);
+	}
+
+	// the iovecs followed by the compressed messages, allocated once
+	size_t max = uwsgi.log_batch > 0 ? uwsgi.log_batch : 1;
+	size_t buf_len = UMAX(uwsgi.log_batch_size, MAX_GELF);
+	if (!ul->batch_data) {
+		ul->batch_data = uwsgi_malloc((sizeof(struct iovec) * max) + buf_len);
+	}
+	struct iovec *iov = (struct iovec *) ul->batch_data;
+	char *buf = (char *) (iov + max);
+
+	for(i=0;i<n;i++) {
+		int rlen = uwsgi_graylog2_build(lines[i].iov_base, lines[i].iov_len);
+		if (rlen <= 0 || rlen >= MAX_GELF) continue;
+		uLong bound = compressBound((uLong) rlen);
+		if (bound > MAX_GELF) continue;
+		// no more space, send the already compressed messages
+		if (count == max || pos + bound > buf_len) {
+			ret = uwsgi_logger_send_datagrams(ul, iov, count, count);
+			count = 0;
+			pos = 0;
+		}
+		uLongf destLen = bound;
+		if (compress((Bytef *) buf + pos, &destLen, (Bytef *) g2c.json_buf, (uLong) rlen) != Z_OK) continue;
+		iov[count].iov_base = buf + pos;
+		iov[count].iov_len = destLen;
+		count++;
+		pos += destLen;
+	}
+
+	if (count) {
+		ret = uwsgi_logger_send_datagrams(ul, iov, count, count);
+	}
+
+	return ret;
+}
+
 void uwsgi_graylog2_register() {
-	uwsgi_register_logger("graylog2", uwsgi_graylog2_logger);
+	uwsgi_register_batch_logger("graylog2", uwsgi_graylog2_logger, uwsgi_graylog2_logger_batch);
 }
 
 struct uwsgi_plugin graylog2_plugin = {
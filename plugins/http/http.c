@@ -54,6 +54,7 @@ struct uwsgi_option http_options[] = {
 	{"http-stats-server", required_argument, 0, "run the http router stats server", uwsgi_opt_set_str, &uhttp.cr.stats_server, 0},
 	{"http-ss", required_argument, 0, "run the http router stats server", uwsgi_opt_set_str, &uhttp.cr.stats_server, 0},
 	{"http-harakiri", required_argument, 0, "enable http router harakiri", uwsgi_opt_set_int, &uhttp.cr.harakiri, 0},
+	{"http-timer-wheel", no_argument, 0, "use a hierarchical timer wheel (instead of the rbtree) for http router timeouts", uwsgi_opt_true, &uhttp.cr.timer_wheel, 0},
 	{"http-stud-prefix", required_argument, 0, "expect a stud prefix (1byte family + 4/16 bytes address) on connections from the specified address", uwsgi_opt_add_addr_list, &uhttp.stud_prefix, 0},
 	{"http-uid", required_argument, 0, "drop http router privileges to the specified uid", uwsgi_opt_uid, &uhttp.cr.uid, 0 },
 	{"http-gid", required_argument, 0, "drop http router privileges to the specified gid", uwsgi_opt_gid, &uhttp.cr.gid, 0 },
@@ -794,9 +795,16 @@ int http_headers_parse(struct corerouter_peer *peer, int skip) {
 		ptr++;
 	}
 
+	struct uwsgi_trace_context trace_parent, *trace_parent_ptr = NULL;
+
 	usl = headers;
 	int broken = 0;
 	while(usl) {
+		if (uwsgi.trace_spans && !trace_parent_ptr && !uwsgi_strncmp(usl->value, usl->len, "TRACEPARENT", 11)) {
+			if (!uwsgi_trace_context_parse(&trace_parent, usl->custom_ptr, (size_t) usl->custom)) {
+				trace_parent_ptr = &trace_parent;
+			}
+		}
 		if (!broken) {
 			if (http_add_uwsgi_header(peer, usl->value, usl->len, usl->custom_ptr, (size_t) usl->custom, usl->custom2 & 0x02)) broken = 1;
 		}
@@ -810,6 +818,14 @@ int http_headers_parse(struct corerouter_peer *peer, int skip) {
 
 	if (broken) return -1;
 
+	// the backend will continue the trace
+	if (uwsgi.trace_spans) {
+		corerouter_trace_start(peer->session, trace_parent_ptr);
+		char traceparent[56];
+		int traceparent_len = uwsgi_trace_context_format(&peer->session->trace, traceparent);
+		if (uwsgi_buffer_append_keyval(out, "UWSGI_TRACEPARENT", 17, traceparent, traceparent_len)) return -1;
+	}
+
 	struct uwsgi_string_list *hv = uhttp.http_vars;
 	while (hv) {
 		char *equal = strchr(hv->value, '=');
@@ -943,6 +959,10 @@ ssize_t hr_write(struct corerouter_peer *main_peer) {
 ssize_t hr_instance_connected(struct corerouter_peer* peer) {
 
 	cr_peer_connected(peer, "hr_instance_connected()");
+
+	if (peer->session->trace_start) {
+		uwsgi_trace_span_push(&peer->session->trace, UWSGI_TRACE_SPAN_ROUTER_CONNECT, uwsgi_trace_new_id(), peer->session->trace.span_id, peer->session->trace_start, uwsgi_micros(), 0, 0);
+	}
 	
 	// set the default timeout
 	http_set_timeout(peer, uhttp.cr.socket_timeout);
@@ -2,57 +2,60 @@
 
 extern struct uwsgi_server uwsgi;
 
-ssize_t uwsgi_socket_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+static void uwsgi_socket_logger_configure(struct uwsgi_logger *ul) {
 
 	int family = AF_UNIX;
 
-	if (!ul->configured) {
+	char *comma = strchr(ul->arg, ',');
+	if (comma) {
+		ul->data = comma+1;
+		*comma = 0;
+	}
 
-		char *comma = strchr(ul->arg, ',');
-		if (comma) {
-			ul->data = comma+1;
-			*comma = 0;
-		}
+	char *colon = strchr(ul->arg, ':');
+	if (colon) {
+        	family = AF_INET;
+        	ul->addr_len = socket_to_in_addr(ul->arg, colon, 0, &ul->addr.sa_in);
+	}
+	else {
+        	ul->addr_len = socket_to_un_addr(ul->arg, &ul->addr.sa_un);
+	}
 
-        	char *colon = strchr(ul->arg, ':');
-        	if (colon) {
-                	family = AF_INET;
-                	ul->addr_len = socket_to_in_addr(ul->arg, colon, 0, &ul->addr.sa_in);
-        	}
-        	else {
-                	ul->addr_len = socket_to_un_addr(ul->arg, &ul->addr.sa_un);
-        	}
-
-        	ul->fd = socket(family, SOCK_DGRAM, 0);
-        	if (ul->fd < 0) {
-                	uwsgi_error_safe("socket()");
-			exit(1);
-        	}
-
-		memset(&ul->msg, 0, sizeof(struct msghdr));
-
-		ul->msg.msg_name = &ul->addr;
-		ul->msg.msg_namelen = ul->addr_len;
-		if (ul->data) {
-			ul->msg.msg_iov = uwsgi_malloc(sizeof(struct iovec) * 2);
-			ul->msg.msg_iov[0].iov_base = ul->data;
-			ul->msg.msg_iov[0].iov_len = strlen(ul->data);
-			ul->msg.msg_iovlen = 2;
-			ul->count = 1;
-		}
-		else {
-			ul->msg.msg_iov = uwsgi_malloc(sizeof(struct iovec));
-			ul->msg.msg_iovlen = 1;
-		}
+	ul->fd = socket(family, SOCK_DGRAM, 0);
+	if (ul->fd < 0) {
+        	uwsgi_error_safe("socket()");
+		exit(1);
+	}
 
-		if (comma) {
-			*comma = ',' ;
-		}
+	memset(&ul->msg, 0, sizeof(struct msghdr));
+
+	ul->msg.msg_name = &ul->addr;
+	ul->msg.msg_namelen = ul->addr_len;
+	if (ul->data) {
+		ul->msg.msg_iov = uwsgi_malloc(sizeof(struct iovec) * 2);
+		ul->msg.msg_iov[0].iov_base = ul->data;
+		ul->msg.msg_iov[0].iov_len = strlen(ul->data);
+		ul->msg.msg_iovlen = 2;
+		ul->count = 1;
+	}
+	else {
+		ul->msg.msg_iov = uwsgi_malloc(sizeof(struct iovec));
+		ul->msg.msg_iovlen = 1;
+	}
 
-		ul->configured = 1;
+	if (comma) {
+		*comma = ',' ;
+	}
+
+	ul->configured = 1;
+}
+
+ssize_t uwsgi_socket_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+
+	if (!ul->configured) {
+		uwsgi_socket_logger_configure(ul);
 	}
 
-	
 	ul->msg.msg_iov[ul->count].iov_base = message;
 	ul->msg.msg_iov[ul->count].iov_len = len;
 
@@ -60,8 +63,39 @@ ssize_t uwsgi_socket_logger(struct uwsgi_logger *ul, char *message, size_t len)
 
 }
 
+// send a datagram for each line
+static ssize_t uwsgi_socket_logger_batch(struct uwsgi_logger *ul, struct iovec *lines, size_t n) {
+
+	if (!ul->configured) {
+		uwsgi_socket_logger_configure(ul);
+	}
+
+	if (!ul->count) {
+		return uwsgi_logger_send_datagrams(ul, lines, n, n);
+	}
+
+	// prepend the prefix to each line
+	size_t i, j;
+	size_t max = uwsgi.log_batch > 0 ? uwsgi.log_batch : 1;
+	if (!ul->batch_data) {
+		ul->batch_data = uwsgi_malloc(sizeof(struct iovec) * max * 2);
+	}
+	struct iovec *iov = (struct iovec *) ul->batch_data;
+	ssize_t ret = 0;
+	for(i=0;i<n;i+=max) {
+		size_t count = UMIN(max, n - i);
+		for(j=0;j<count;j++) {
+			iov[j*2] = ul->msg.msg_iov[0];
+			iov[(j*2)+1] = lines[i+j];
+		}
+		ret = uwsgi_logger_send_datagrams(ul, iov, count * 2, count);
+		if (ret < 0) break;
+	}
+	return ret;
+}
+
 void uwsgi_logsocket_register() {
-	uwsgi_register_logger("socket", uwsgi_socket_logger);
+	uwsgi_register_batch_logger("socket", uwsgi_socket_logger, uwsgi_socket_logger_batch);
 }
 
 struct uwsgi_plugin logsocket_plugin = {
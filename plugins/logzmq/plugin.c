@@ -8,31 +8,35 @@ static struct uwsgi_option uwsgi_zmq_logger_options[] = {
 	{NULL, 0, 0, NULL, NULL, NULL, 0}, 
 };
 
-// the zeromq logger
-static ssize_t uwsgi_zeromq_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+static void uwsgi_zeromq_logger_configure(struct uwsgi_logger *ul) {
 
-        if (!ul->configured) {
+        if (!ul->arg) {
+                uwsgi_log_safe("invalid zeromq syntax\n");
+                exit(1);
+        }
 
-                if (!ul->arg) {
-                        uwsgi_log_safe("invalid zeromq syntax\n");
-                        exit(1);
-                }
+        void *ctx = zmq_init(1);
+	if (!ctx) exit(1);
 
-                void *ctx = zmq_init(1);
-		if (!ctx) exit(1);
+        ul->data = zmq_socket(ctx, ZMQ_PUSH);
+        if (ul->data == NULL) {
+                uwsgi_error_safe("zmq_socket()");
+                exit(1);
+        }
 
-                ul->data = zmq_socket(ctx, ZMQ_PUSH);
-                if (ul->data == NULL) {
-                        uwsgi_error_safe("zmq_socket()");
-                        exit(1);
-                }
+        if (zmq_connect(ul->data, ul->arg) < 0) {
+                uwsgi_error_safe("zmq_connect()");
+                exit(1);
+        }
 
-                if (zmq_connect(ul->data, ul->arg) < 0) {
-                        uwsgi_error_safe("zmq_connect()");
-                        exit(1);
-                }
+        ul->configured = 1;
+}
 
-                ul->configured = 1;
+// the zeromq logger
+static ssize_t uwsgi_zeromq_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+
+        if (!ul->configured) {
+                uwsgi_zeromq_logger_configure(ul);
         }
 
         zmq_msg_t msg;
@@ -49,9 +53,34 @@ static ssize_t uwsgi_zeromq_logger(struct uwsgi_logger *ul, char *message, size_
         return 0;
 }
 
+// a batch is sent as a single multipart message (a part per line)
+static ssize_t uwsgi_zeromq_logger_batch(struct uwsgi_logger *ul, struct iovec *lines, size_t n) {
+
+        size_t i;
+
+        if (!ul->configured) {
+                uwsgi_zeromq_logger_configure(ul);
+        }
+
+        for(i=0;i<n;i++) {
+                zmq_msg_t msg;
+                int flags = (i < n-1) ? ZMQ_SNDMORE : 0;
+                if (zmq_msg_init_size(&msg, lines[i].iov_len)) return -1;
+                memcpy(zmq_msg_data(&msg), lines[i].iov_base, lines[i].iov_len);
+#if ZMQ_VERSION >= ZMQ_MAKE_VERSION(3,0,0)
+                zmq_sendmsg(ul->data, &msg, flags);
+#else
+                zmq_send(ul->data, &msg, flags);
+#endif
+                zmq_msg_close(&msg);
+        }
+
+        return 0;
+}
+
 static void uwsgi_zmq_logger_register() {
-        uwsgi_register_logger("zmq", uwsgi_zeromq_logger);
-        uwsgi_register_logger("zeromq", uwsgi_zeromq_logger);
+        uwsgi_register_batch_logger("zmq", uwsgi_zeromq_logger, uwsgi_zeromq_logger_batch);
+        uwsgi_register_batch_logger("zeromq", uwsgi_zeromq_logger, uwsgi_zeromq_logger_batch);
 }
 
 struct uwsgi_plugin logzmq_plugin = {
@@ -207,6 +207,8 @@ XS(XS_streaming_write) {
         body = SvPV(ST(1), blen);
 
 	uwsgi_response_write_body_do(wsgi_req, body, blen);
+	// streamed data must not wait in the coalesce buffer
+	uwsgi_response_flush(wsgi_req);
 	uwsgi_pl_check_write_errors {
 		croak("error while streaming PSGI response");
 	}
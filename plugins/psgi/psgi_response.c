@@ -15,6 +15,9 @@ int psgi_response(struct wsgi_request *wsgi_req, AV *response) {
 
 		wsgi_req->async_force_again = 0;
 
+		// send the previous chunks before waiting for the next one
+		uwsgi_response_flush(wsgi_req);
+
 		wsgi_req->switches++;
                 SV *chunk = uwsgi_perl_obj_call(wsgi_req->async_placeholder, "getline");
 		if (!chunk) {
@@ -136,6 +139,9 @@ int psgi_response(struct wsgi_request *wsgi_req, AV *response) {
                 else if (uwsgi_perl_obj_can(*hitem, STR_WITH_LEN("getline"))) {
                 for(;;) {
 
+			// send the previous chunks before waiting for the next one
+			uwsgi_response_flush(wsgi_req);
+
 			wsgi_req->switches++;
                         SV *chunk = uwsgi_perl_obj_call(*hitem, "getline");
 			if (!chunk) {
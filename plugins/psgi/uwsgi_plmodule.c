@@ -422,6 +422,7 @@ XS(XS_suspend) {
 
 	wsgi_req->async_force_again = 0;
 
+	uwsgi_response_flush(wsgi_req);
         if (uwsgi.schedule_to_main) uwsgi.schedule_to_main(wsgi_req);
 
 	XSRETURN_UNDEF;
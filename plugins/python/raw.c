@@ -27,6 +27,9 @@ static int manage_raw_response(struct wsgi_request *wsgi_req) {
 				return UWSGI_OK;
 		}
 
+		if (!PyList_Check((PyObject *) wsgi_req->async_result) && !PyTuple_Check((PyObject *) wsgi_req->async_result)) {
+			uwsgi_py_flush_coalesced(wsgi_req);
+		}
 		PyObject *pychunk = PyIter_Next((PyObject *) wsgi_req->async_placeholder);
 		if (!pychunk)
 			return UWSGI_OK;
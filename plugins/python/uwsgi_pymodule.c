@@ -1359,7 +1359,6 @@ PyObject *py_uwsgi_farm_msg(PyObject * self, PyObject * args) {
         char *message = NULL;
         Py_ssize_t message_len = 0;
 	char *farm_name = NULL;
-        ssize_t len;
 	int i;
 
         if (!PyArg_ParseTuple(args, "ss#:farm_msg", &farm_name, &message, &message_len)) {
@@ -1369,12 +1368,10 @@ PyObject *py_uwsgi_farm_msg(PyObject * self, PyObject * args) {
 	for(i=0;i<uwsgi.farms_cnt;i++) {
 	
 		if (!strcmp(farm_name, uwsgi.farms[i].name)) {
+			// mule_send_msg() knows about --mule-msg-ring and --farm-fanout
 			UWSGI_RELEASE_GIL
-                	len = write(uwsgi.farms[i].queue_pipe[0], message, message_len);
+			mule_send_msg(uwsgi.farms[i].queue_pipe[0], message, message_len);
 			UWSGI_GET_GIL
-                	if (len <= 0) {
-                        	uwsgi_error("write()");
-                	}
 			break;
 		}
 	
@@ -1489,22 +1486,86 @@ PyObject *py_uwsgi_mule_get_msg(PyObject * self, PyObject * args, PyObject *kwar
 	return msg;
 }
 
+// like mule_get_msg() but returns a list with all of the queued messages (up to max)
+PyObject *py_uwsgi_mule_get_msgs(PyObject * self, PyObject * args, PyObject *kwargs) {
+
+	ssize_t len = 0;
+	char *message;
+	PyObject *py_manage_signals = NULL;
+	PyObject *py_manage_farms = NULL;
+	size_t buffer_size = 65536;
+	int timeout = -1;
+	int max = 64;
+	int manage_signals = 1, manage_farms = 1;
+
+	static char *kwlist[] = {"signals", "farms", "buffer_size", "timeout", "max", NULL};
+
+	if (uwsgi.muleid == 0) {
+		return PyErr_Format(PyExc_ValueError, "you can receive mule messages only in a mule !!!");
+	}
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOiii:mule_get_msgs", kwlist, &py_manage_signals, &py_manage_farms, &buffer_size, &timeout, &max)) {
+		return NULL;
+	}
+
+	if (py_manage_signals == Py_None || py_manage_signals == Py_False) {
+		manage_signals = 0;
+	}
+
+	if (py_manage_farms == Py_None || py_manage_farms == Py_False) {
+		manage_farms = 0;
+	}
+
+	message = uwsgi_malloc(buffer_size);
+
+	UWSGI_RELEASE_GIL;
+	len = uwsgi_mule_get_msg(manage_signals, manage_farms, message, buffer_size, timeout) ;
+	UWSGI_GET_GIL;
+
+	PyObject *msgs = PyList_New(0);
+	int sources = UWSGI_MULE_MSG_SHARED | UWSGI_MULE_MSG_OWN | (manage_farms ? UWSGI_MULE_MSG_FARMS : 0);
+	while (len >= 0) {
+		PyObject *msg = PyString_FromStringAndSize(message, len);
+		PyList_Append(msgs, msg);
+		Py_DECREF(msg);
+		if (PyList_Size(msgs) >= max)
+			break;
+		// the rest of the batch is taken from the rings without waiting
+		len = uwsgi_mule_ring_get(sources, message, buffer_size);
+	}
+
+	free(message);
+	return msgs;
+}
+
 PyObject *py_uwsgi_farm_get_msg(PyObject * self, PyObject * args) {
 
         ssize_t len = 0;
         // this buffer will be configurable
         char message[65536];
-	int i, count = 0, pos = 0, ret;
+	int i, count = 0, pos = 0, ret = 0;
 	struct pollfd *farmpoll;
+	int sources = UWSGI_MULE_MSG_FARMS;
 
         if (uwsgi.muleid == 0) {
                 return PyErr_Format(PyExc_ValueError, "you can receive farm messages only in a mule !!!");
         }
         UWSGI_RELEASE_GIL;
+	// the messages of fan-out farms are copied to the own queue of the mule
+	int fanout = uwsgi_mule_in_fanout_farm(uwsgi.muleid);
+	if (fanout) {
+		sources |= UWSGI_MULE_MSG_OWN;
+		count++;
+	}
 	for(i=0;i<uwsgi.farms_cnt;i++) {	
 		if (uwsgi_farm_has_mule(&uwsgi.farms[i], uwsgi.muleid)) count++;
 	}
 	farmpoll = uwsgi_malloc( sizeof(struct pollfd) * count);
+	if (fanout) {
+		farmpoll[pos].fd = uwsgi.mules[uwsgi.muleid - 1].queue_pipe[1];
+		farmpoll[pos].events = POLLIN;
+		pos++;
+	}
 	for(i=0;i<uwsgi.farms_cnt;i++) {
 		if (uwsgi_farm_has_mule(&uwsgi.farms[i], uwsgi.muleid)) {
 			farmpoll[pos].fd = uwsgi.farms[i].queue_pipe[1];
@@ -1513,8 +1574,36 @@ PyObject *py_uwsgi_farm_get_msg(PyObject * self, PyObject * args) {
 		}
 	}
 
+	// --mule-msg-ring: the farm sockets only carry wakeups
+	while (uwsgi.mule_msg_ring) {
+		len = uwsgi_mule_ring_get(sources, message, 65536);
+		if (len >= 0) goto ring;
+		uwsgi_mule_ring_sleeping(sources, 1);
+		len = uwsgi_mule_ring_get(sources, message, 65536);
+		if (len < 0) {
+			ret = poll(farmpoll, count, -1);
+		}
+		uwsgi_mule_ring_sleeping(sources, -1);
+		if (len >= 0) goto ring;
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			// never fall back to reading the wakeup bytes as messages
+			UWSGI_GET_GIL;
+			uwsgi_error("poll()");
+			free(farmpoll);
+			Py_INCREF(Py_None);
+			return Py_None;
+		}
+		for(i=0;i<count;i++) {
+			if (farmpoll[i].revents & POLLIN) {
+				uwsgi_mule_ring_drain(farmpoll[i].fd);
+			}
+		}
+	}
+
 	ret = poll(farmpoll, count, -1);
 	if (ret <= 0) {
+		UWSGI_GET_GIL;
 		uwsgi_error("poll()");
 		free(farmpoll);
 		Py_INCREF(Py_None);
@@ -1527,6 +1616,7 @@ PyObject *py_uwsgi_farm_get_msg(PyObject * self, PyObject * args) {
 			break;
 		}
 	}
+ring:
         UWSGI_GET_GIL;
         if (len <= 0) {
                 uwsgi_error("read()");
@@ -1650,6 +1740,254 @@ PyObject *py_uwsgi_sharedarea_dec32(PyObject * self, PyObject * args) {
 
 }
 
+PyObject *py_uwsgi_sharedarea_load64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t value = 0;
+
+	if (!PyArg_ParseTuple(args, "iL:sharedarea_load64", &id, &pos)) {
+		return NULL;
+	}
+
+	if (uwsgi_sharedarea_load64(id, pos, &value)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_load64()");
+	}
+
+	return PyLong_FromLongLong(value);
+}
+
+PyObject *py_uwsgi_sharedarea_fetch_add64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t value = 1;
+	int64_t old = 0;
+
+	if (!PyArg_ParseTuple(args, "iL|L:sharedarea_fetch_add64", &id, &pos, &value)) {
+		return NULL;
+	}
+
+	if (uwsgi_sharedarea_fetch_add64(id, pos, value, &old)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_fetch_add64()");
+	}
+
+	return PyLong_FromLongLong(old);
+}
+
+PyObject *py_uwsgi_sharedarea_cas64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t expected = 0;
+	int64_t desired = 0;
+	int64_t old = 0;
+
+	if (!PyArg_ParseTuple(args, "iLLL:sharedarea_cas64", &id, &pos, &expected, &desired)) {
+		return NULL;
+	}
+
+	int ret = uwsgi_sharedarea_cas64(id, pos, expected, desired, &old);
+	if (ret < 0) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_cas64()");
+	}
+
+	if (ret) {
+		Py_INCREF(Py_False);
+		return Py_False;
+	}
+
+	Py_INCREF(Py_True);
+	return Py_True;
+}
+
+PyObject *py_uwsgi_sharedarea_swap64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t value = 0;
+	int64_t old = 0;
+
+	if (!PyArg_ParseTuple(args, "iLL:sharedarea_swap64", &id, &pos, &value)) {
+		return NULL;
+	}
+
+	if (uwsgi_sharedarea_swap64(id, pos, value, &old)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_swap64()");
+	}
+
+	return PyLong_FromLongLong(old);
+}
+
+PyObject *py_uwsgi_sharedarea_max64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t value = 0;
+	int64_t old = 0;
+
+	if (!PyArg_ParseTuple(args, "iLL:sharedarea_max64", &id, &pos, &value)) {
+		return NULL;
+	}
+
+	if (uwsgi_sharedarea_max64(id, pos, value, &old)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_max64()");
+	}
+
+	return PyLong_FromLongLong(old);
+}
+
+PyObject *py_uwsgi_sharedarea_min64(PyObject * self, PyObject * args) {
+	int id;
+	uint64_t pos = 0;
+	int64_t value = 0;
+	int64_t old = 0;
+
+	if (!PyArg_ParseTuple(args, "iLL:sharedarea_min64", &id, &pos, &value)) {
+		return NULL;
+	}
+
+	if (uwsgi_sharedarea_min64(id, pos, value, &old)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_min64()");
+	}
+
+	return PyLong_FromLongLong(old);
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_get(PyObject * self, PyObject * args) {
+	int id;
+	char *key;
+	Py_ssize_t keylen = 0;
+
+	if (!PyArg_ParseTuple(args, "is#:sharedarea_hashmap_get", &id, &key, &keylen)) {
+		return NULL;
+	}
+
+	if (keylen > 0xffff) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea hashmap keys cannot be longer than 65535 bytes");
+	}
+
+	uint64_t valuesize = uwsgi_sharedarea_hashmap_valuesize(id);
+	if (!valuesize) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea %d is not a hashmap", id);
+	}
+
+	char *value = uwsgi_malloc(valuesize);
+	int64_t vallen = uwsgi_sharedarea_hashmap_get(id, key, keylen, value, valuesize);
+	if (vallen < 0) {
+		free(value);
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	PyObject *res = PyString_FromStringAndSize(value, vallen);
+	free(value);
+	return res;
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_set(PyObject * self, PyObject * args) {
+	int id;
+	char *key;
+	Py_ssize_t keylen = 0;
+	char *value;
+	Py_ssize_t vallen = 0;
+
+	if (!PyArg_ParseTuple(args, "is#s#:sharedarea_hashmap_set", &id, &key, &keylen, &value, &vallen)) {
+		return NULL;
+	}
+
+	if (keylen > 0xffff) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea hashmap keys cannot be longer than 65535 bytes");
+	}
+
+	if (uwsgi_sharedarea_hashmap_set(id, key, keylen, value, vallen)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_hashmap_set()");
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_del(PyObject * self, PyObject * args) {
+	int id;
+	char *key;
+	Py_ssize_t keylen = 0;
+
+	if (!PyArg_ParseTuple(args, "is#:sharedarea_hashmap_del", &id, &key, &keylen)) {
+		return NULL;
+	}
+
+	if (keylen > 0xffff) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea hashmap keys cannot be longer than 65535 bytes");
+	}
+
+	if (uwsgi_sharedarea_hashmap_del(id, key, keylen)) {
+		Py_INCREF(Py_False);
+		return Py_False;
+	}
+
+	Py_INCREF(Py_True);
+	return Py_True;
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_inc(PyObject * self, PyObject * args) {
+	int id;
+	char *key;
+	Py_ssize_t keylen = 0;
+	int64_t amount = 1;
+	int64_t value = 0;
+
+	if (!PyArg_ParseTuple(args, "is#|L:sharedarea_hashmap_inc", &id, &key, &keylen, &amount)) {
+		return NULL;
+	}
+
+	if (keylen > 0xffff) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea hashmap keys cannot be longer than 65535 bytes");
+	}
+
+	if (uwsgi_sharedarea_hashmap_inc(id, key, keylen, amount, &value)) {
+		return PyErr_Format(PyExc_ValueError, "error calling uwsgi_sharedarea_hashmap_inc()");
+	}
+
+	return PyLong_FromLongLong(value);
+}
+
+static int py_uwsgi_sharedarea_hashmap_item(char *key, uint16_t keylen, char *value, uint64_t vallen, void *data) {
+	PyObject *list = (PyObject *) data;
+	PyObject *item = PyTuple_New(2);
+	PyTuple_SetItem(item, 0, PyString_FromStringAndSize(key, keylen));
+	PyTuple_SetItem(item, 1, PyString_FromStringAndSize(value, vallen));
+	PyList_Append(list, item);
+	Py_DECREF(item);
+	return 0;
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_items(PyObject * self, PyObject * args) {
+	int id;
+
+	if (!PyArg_ParseTuple(args, "i:sharedarea_hashmap_items", &id)) {
+		return NULL;
+	}
+
+	PyObject *list = PyList_New(0);
+	if (uwsgi_sharedarea_hashmap_foreach(id, py_uwsgi_sharedarea_hashmap_item, list)) {
+		Py_DECREF(list);
+		return PyErr_Format(PyExc_ValueError, "sharedarea %d is not a hashmap", id);
+	}
+
+	return list;
+}
+
+PyObject *py_uwsgi_sharedarea_hashmap_count(PyObject * self, PyObject * args) {
+	int id;
+
+	if (!PyArg_ParseTuple(args, "i:sharedarea_hashmap_count", &id)) {
+		return NULL;
+	}
+
+	int64_t count = uwsgi_sharedarea_hashmap_count(id);
+	if (count < 0) {
+		return PyErr_Format(PyExc_ValueError, "sharedarea %d is not a hashmap", id);
+	}
+
+	return PyLong_FromLongLong(count);
+}
+
 PyObject *py_uwsgi_sharedarea_write32(PyObject * self, PyObject * args) {
         int id;
         uint64_t pos = 0;
@@ -2645,6 +2983,7 @@ PyObject *py_uwsgi_suspend(PyObject * self, PyObject * args) {
 
 	struct wsgi_request *wsgi_req = py_current_wsgi_req();
 
+	uwsgi_py_flush_coalesced(wsgi_req);
 	if (uwsgi.schedule_to_main) uwsgi.schedule_to_main(wsgi_req);
 
 	Py_INCREF(Py_True);
@@ -2727,6 +3066,7 @@ static PyMethodDef uwsgi_advanced_methods[] = {
 	{"mule_msg", py_uwsgi_mule_msg, METH_VARARGS, ""},
 	{"farm_msg", py_uwsgi_farm_msg, METH_VARARGS, ""},
 	{"mule_get_msg", (PyCFunction) py_uwsgi_mule_get_msg, METH_VARARGS|METH_KEYWORDS, ""},
+	{"mule_get_msgs", (PyCFunction) py_uwsgi_mule_get_msgs, METH_VARARGS|METH_KEYWORDS, ""},
 	{"farm_get_msg", py_uwsgi_farm_get_msg, METH_VARARGS, ""},
 	{"in_farm", py_uwsgi_in_farm, METH_VARARGS, ""},
 
@@ -2775,6 +3115,18 @@ static PyMethodDef uwsgi_sa_methods[] = {
 	{"sharedarea_inc32", py_uwsgi_sharedarea_inc32, METH_VARARGS, ""},
 	{"sharedarea_dec64", py_uwsgi_sharedarea_dec64, METH_VARARGS, ""},
 	{"sharedarea_dec32", py_uwsgi_sharedarea_dec32, METH_VARARGS, ""},
+	{"sharedarea_load64", py_uwsgi_sharedarea_load64, METH_VARARGS, ""},
+	{"sharedarea_fetch_add64", py_uwsgi_sharedarea_fetch_add64, METH_VARARGS, ""},
+	{"sharedarea_cas64", py_uwsgi_sharedarea_cas64, METH_VARARGS, ""},
+	{"sharedarea_swap64", py_uwsgi_sharedarea_swap64, METH_VARARGS, ""},
+	{"sharedarea_max64", py_uwsgi_sharedarea_max64, METH_VARARGS, ""},
+	{"sharedarea_min64", py_uwsgi_sharedarea_min64, METH_VARARGS, ""},
+	{"sharedarea_hashmap_get", py_uwsgi_sharedarea_hashmap_get, METH_VARARGS, ""},
+	{"sharedarea_hashmap_set", py_uwsgi_sharedarea_hashmap_set, METH_VARARGS, ""},
+	{"sharedarea_hashmap_del", py_uwsgi_sharedarea_hashmap_del, METH_VARARGS, ""},
+	{"sharedarea_hashmap_inc", py_uwsgi_sharedarea_hashmap_inc, METH_VARARGS, ""},
+	{"sharedarea_hashmap_items", py_uwsgi_sharedarea_hashmap_items, METH_VARARGS, ""},
+	{"sharedarea_hashmap_count", py_uwsgi_sharedarea_hashmap_count, METH_VARARGS, ""},
 	{"sharedarea_rlock", py_uwsgi_sharedarea_rlock, METH_VARARGS, ""},
 	{"sharedarea_wlock", py_uwsgi_sharedarea_wlock, METH_VARARGS, ""},
 	{"sharedarea_unlock", py_uwsgi_sharedarea_unlock, METH_VARARGS, ""},
@@ -3011,6 +3363,25 @@ PyObject *py_uwsgi_cache_exists(PyObject * self, PyObject * args) {
         return Py_None;
 }
 
+static PyObject *py_uwsgi_queue_ring_pull(int timeout) {
+
+	uint64_t size = 0;
+	PyObject *res;
+
+	UWSGI_RELEASE_GIL
+	char *message = uwsgi_queue_ring_pull(&size, timeout);
+	UWSGI_GET_GIL
+
+	if (!message) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	res = PyString_FromStringAndSize(message, size);
+	free(message);
+	return res;
+}
+
 PyObject *py_uwsgi_queue_push(PyObject * self, PyObject * args) {
 
 	Py_ssize_t msglen = 0;
@@ -3020,6 +3391,15 @@ PyObject *py_uwsgi_queue_push(PyObject * self, PyObject * args) {
 	if (!PyArg_ParseTuple(args, "s#:queue_push", &message, &msglen)) {
                 return NULL;
         }
+
+	if (uwsgi.queue_size && uwsgi.queue_ring) {
+		UWSGI_RELEASE_GIL
+		int ret = uwsgi_queue_ring_push(message, msglen);
+		UWSGI_GET_GIL
+		res = ret ? Py_True : Py_None;
+		Py_INCREF(res);
+		return res;
+	}
 	
 	if (uwsgi.queue_size) {
 		UWSGI_RELEASE_GIL
@@ -3055,7 +3435,8 @@ PyObject *py_uwsgi_queue_set(PyObject * self, PyObject * args) {
                 return NULL;
         }
 
-        if (uwsgi.queue_size) {
+        // slots do not exist in ring mode
+        if (uwsgi.queue_size && !uwsgi.queue_ring) {
 		UWSGI_RELEASE_GIL
                 uwsgi_wlock(uwsgi.queue_lock);
                 if (uwsgi_queue_set(pos, message, msglen)) {
@@ -3081,11 +3462,19 @@ PyObject *py_uwsgi_queue_set(PyObject * self, PyObject * args) {
 
 PyObject *py_uwsgi_queue_slot(PyObject * self, PyObject * args) {
 
+	if (uwsgi.queue_ring) {
+		return PyLong_FromUnsignedLongLong(uwsgi_atomic_load(uwsgi.queue_ring_header->prod_tail));
+	}
+
 	return PyLong_FromUnsignedLongLong(uwsgi.queue_header->pos);
 }
 
 PyObject *py_uwsgi_queue_pull_slot(PyObject * self, PyObject * args) {
 
+	if (uwsgi.queue_ring) {
+		return PyLong_FromUnsignedLongLong(uwsgi_atomic_load(uwsgi.queue_ring_header->cons_tail));
+	}
+
 	return PyLong_FromUnsignedLongLong(uwsgi.queue_header->pull_pos);
 }
 
@@ -3096,6 +3485,16 @@ PyObject *py_uwsgi_queue_pull(PyObject * self, PyObject * args) {
 	uint64_t size;
 	PyObject *res;
 	char *storage;
+	// only the ring can wait for messages (in seconds, < 0 waits forever)
+	int timeout = 0;
+
+	if (!PyArg_ParseTuple(args, "|i:queue_pull", &timeout)) {
+		return NULL;
+	}
+
+	if (uwsgi.queue_size && uwsgi.queue_ring) {
+		return py_uwsgi_queue_ring_pull(timeout);
+	}
 
 	if (uwsgi.queue_size) {
 		UWSGI_RELEASE_GIL
@@ -3133,6 +3532,11 @@ PyObject *py_uwsgi_queue_pop(PyObject * self, PyObject * args) {
         PyObject *res;
 	char *storage;
 
+	// the ring is FIFO only
+	if (uwsgi.queue_size && uwsgi.queue_ring) {
+		return py_uwsgi_queue_ring_pull(0);
+	}
+
         if (uwsgi.queue_size) {
 
 		UWSGI_RELEASE_GIL
@@ -3175,7 +3579,7 @@ PyObject *py_uwsgi_queue_get(PyObject * self, PyObject * args) {
                 return NULL;
         }
 
-	if (uwsgi.queue_size) {
+	if (uwsgi.queue_size && !uwsgi.queue_ring) {
 		UWSGI_RELEASE_GIL
 		uwsgi_rlock(uwsgi.queue_lock);
 
@@ -3215,7 +3619,7 @@ PyObject *py_uwsgi_queue_last(PyObject * self, PyObject * args) {
                 return NULL;
         }
 
-        if (uwsgi.queue_size) {
+        if (uwsgi.queue_size && !uwsgi.queue_ring) {
 
 		if (num > 0) {
 			res = PyList_New(0);
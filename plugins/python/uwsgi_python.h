@@ -56,6 +56,13 @@
                 }\
                 else if (wsgi_req->write_errors > uwsgi.write_errors_tolerance)\
 
+// send the data left in the --response-coalesce buffer, the GIL is released only if there is something to send
+#define uwsgi_py_flush_coalesced(x) if (x->coalesce && x->coalesce->pos > 0) {\
+			UWSGI_RELEASE_GIL\
+			uwsgi_response_flush(x);\
+			UWSGI_GET_GIL\
+		}
+
 PyAPI_FUNC(PyObject *) PyMarshal_WriteObjectToString(PyObject *, int);
 PyAPI_FUNC(PyObject *) PyMarshal_ReadObjectFromString(char *, Py_ssize_t);
 
@@ -176,6 +176,9 @@ int uwsgi_response_subhandler_web3(struct wsgi_request *wsgi_req) {
 
 
 
+	// the previous chunks could be still in the coalesce buffer, send them before waiting for the iterator
+	uwsgi_py_flush_coalesced(wsgi_req);
+
 	pychunk = PyIter_Next(wsgi_req->async_placeholder);
 
 	if (!pychunk) {
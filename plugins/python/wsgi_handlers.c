@@ -244,6 +244,8 @@ PyObject *py_uwsgi_write(PyObject * self, PyObject * args) {
 		content_len = PyString_Size(data);
 		UWSGI_RELEASE_GIL
 		uwsgi_response_write_body_do(wsgi_req, content, content_len);
+		// the write callable is used for streaming, do not keep the data in the coalesce buffer
+		uwsgi_response_flush(wsgi_req);
 		UWSGI_GET_GIL
 		// this is a special case for the write callable
 		// no need to honout write-errors-exception-only
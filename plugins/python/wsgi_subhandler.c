@@ -274,6 +274,11 @@ int uwsgi_response_subhandler_wsgi(struct wsgi_request *wsgi_req) {
 		}
 	}
 
+	// the previous chunks could be still in the coalesce buffer, send them before waiting for the generator
+	if (!PyList_Check((PyObject *)wsgi_req->async_result) && !PyTuple_Check((PyObject *)wsgi_req->async_result)) {
+		uwsgi_py_flush_coalesced(wsgi_req);
+	}
+
 	pychunk = PyIter_Next(wsgi_req->async_placeholder);
 
 	if (!pychunk) {
@@ -743,6 +743,7 @@ static VALUE uwsgi_ruby_suspend(VALUE *class) {
 
         struct wsgi_request *wsgi_req = current_wsgi_req();
 
+        uwsgi_response_flush(wsgi_req);
         uwsgi.schedule_to_main(wsgi_req);
 
         return Qtrue;
@@ -698,13 +698,15 @@ VALUE call_dispatch(VALUE env) {
 
 }
 
-static VALUE send_body(VALUE obj) {
+static VALUE send_body(VALUE obj, VALUE streaming) {
 
 	struct wsgi_request *wsgi_req = current_wsgi_req();
 
 	//uwsgi_log("sending body\n");
 	if (TYPE(obj) == T_STRING) {
 		uwsgi_response_write_body_do(wsgi_req, RSTRING_PTR(obj), RSTRING_LEN(obj));
+		// the next chunk could take a while, do not keep this one in the coalesce buffer
+		if (streaming == Qtrue) uwsgi_response_flush(wsgi_req);
 	}
 	else {
 		uwsgi_log("UNMANAGED BODY TYPE %d\n", TYPE(obj));
@@ -724,10 +726,12 @@ VALUE close_body(VALUE body) {
 
 VALUE iterate_body(VALUE body) {
 
+	// arrays are already fully generated, only enumerators need to be flushed chunk by chunk
+	VALUE streaming = TYPE(body) == T_ARRAY ? Qfalse : Qtrue;
 #ifdef RUBY19
-	return rb_block_call(body, rb_intern("each"), 0, 0, send_body, 0);
+	return rb_block_call(body, rb_intern("each"), 0, 0, send_body, streaming);
 #else
-	return rb_iterate(rb_each, body, send_body, 0);
+	return rb_iterate(rb_each, body, send_body, streaming);
 #endif
 }
 
@@ -53,6 +53,7 @@ static struct uwsgi_option rawrouter_options[] = {
 	{"rawrouter-stats-server", required_argument, 0, "run the rawrouter stats server", uwsgi_opt_set_str, &urr.cr.stats_server, 0},
 	{"rawrouter-ss", required_argument, 0, "run the rawrouter stats server", uwsgi_opt_set_str, &urr.cr.stats_server, 0},
 	{"rawrouter-harakiri", required_argument, 0, "enable rawrouter harakiri", uwsgi_opt_set_int, &urr.cr.harakiri, 0},
+	{"rawrouter-timer-wheel", no_argument, 0, "use a hierarchical timer wheel (instead of the rbtree) for rawrouter timeouts", uwsgi_opt_true, &urr.cr.timer_wheel, 0},
 
 	{"rawrouter-xclient", no_argument, 0, "use the xclient protocol to pass the client addres", uwsgi_opt_true, &urr.xclient, 0},
 
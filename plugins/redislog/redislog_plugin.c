@@ -9,9 +9,17 @@ struct uwsgi_redislog_state {
 	char *prefix;
 	char msgsize[11];
 	struct iovec iovec[7];
-	char response[8];
+	char response[4096];
+	// preallocated (--log-batch commands) by the batch logger
+	struct iovec *batch_iov;
+	char *batch_msgsizes;
+	size_t batch_max;
 };
 
+// IOV_MAX is at least 1024 on modern systems
+#define REDISLOG_MAX_IOV ((1024 / 7) * 7)
+
+
 static char *uwsgi_redis_logger_build_command(char *src) {
 	ssize_t len = 4096;
 	char *dst = uwsgi_calloc(len);
@@ -50,78 +58,139 @@ static char *uwsgi_redis_logger_build_command(char *src) {
 	return orig_dst;
 }
 
-ssize_t uwsgi_redis_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+static void uwsgi_redis_logger_configure(struct uwsgi_logger *ul) {
 
-	ssize_t ret,ret2;
 	struct uwsgi_redislog_state *uredislog = NULL;
 
-	if (!ul->configured) {
-
-		if (!ul->data) {
-			ul->data = uwsgi_calloc(sizeof(struct uwsgi_redislog_state));
-			uredislog = (struct uwsgi_redislog_state *) ul->data;
-		}
+	if (!ul->data) {
+		ul->data = uwsgi_calloc(sizeof(struct uwsgi_redislog_state));
+		uredislog = (struct uwsgi_redislog_state *) ul->data;
+	}
 
-        	if (ul->arg != NULL) {
-			char *logarg = uwsgi_str(ul->arg);
-			char *comma1 = strchr(logarg, ',');
-			if (!comma1) {
-				uredislog->address = logarg;
-				goto done;
-			}
-			*comma1 = 0;
+	if (ul->arg != NULL) {
+		char *logarg = uwsgi_str(ul->arg);
+		char *comma1 = strchr(logarg, ',');
+		if (!comma1) {
 			uredislog->address = logarg;
-			comma1++;
-			if (*comma1 == 0) goto done;
-
-			char *comma2 = strchr(comma1,',');
-			if (!comma2) {
-				uredislog->command = uwsgi_redis_logger_build_command(comma1);
-				goto done;
-			}
+			goto done;
+		}
+		*comma1 = 0;
+		uredislog->address = logarg;
+		comma1++;
+		if (*comma1 == 0) goto done;
 
-			*comma2 = 0;
+		char *comma2 = strchr(comma1,',');
+		if (!comma2) {
 			uredislog->command = uwsgi_redis_logger_build_command(comma1);
-			comma2++;
-			if (*comma2 == 0) goto done;
-
-			uredislog->prefix = comma2;
-			
+			goto done;
 		}
 
+		*comma2 = 0;
+		uredislog->command = uwsgi_redis_logger_build_command(comma1);
+		comma2++;
+		if (*comma2 == 0) goto done;
+
+		uredislog->prefix = comma2;
+		
+	}
+
 done:
 
-		if (!uredislog->address) uredislog->address = uwsgi_str("127.0.0.1:6379");
-		if (!uredislog->command) uredislog->command = "*3\r\n$7\r\npublish\r\n$5\r\nuwsgi\r\n";
-		if (!uredislog->prefix) uredislog->prefix = "";
+	if (!uredislog->address) uredislog->address = uwsgi_str("127.0.0.1:6379");
+	if (!uredislog->command) uredislog->command = "*3\r\n$7\r\npublish\r\n$5\r\nuwsgi\r\n";
+	if (!uredislog->prefix) uredislog->prefix = "";
 
-		uredislog->fd = -1;
+	uredislog->fd = -1;
 
-		uredislog->iovec[0].iov_base = uredislog->command;
-		uredislog->iovec[0].iov_len = strlen(uredislog->command);
-		uredislog->iovec[1].iov_base = "$";
-		uredislog->iovec[1].iov_len = 1;
+	uredislog->iovec[0].iov_base = uredislog->command;
+	uredislog->iovec[0].iov_len = strlen(uredislog->command);
+	uredislog->iovec[1].iov_base = "$";
+	uredislog->iovec[1].iov_len = 1;
 
-		uredislog->iovec[2].iov_base = uredislog->msgsize;
+	uredislog->iovec[2].iov_base = uredislog->msgsize;
 
-		uredislog->iovec[3].iov_base = "\r\n";
-		uredislog->iovec[3].iov_len = 2;
+	uredislog->iovec[3].iov_base = "\r\n";
+	uredislog->iovec[3].iov_len = 2;
 
-		uredislog->iovec[4].iov_base = uredislog->prefix;
-		uredislog->iovec[4].iov_len = strlen(uredislog->prefix);
+	uredislog->iovec[4].iov_base = uredislog->prefix;
+	uredislog->iovec[4].iov_len = strlen(uredislog->prefix);
 
-		uredislog->iovec[6].iov_base = "\r\n";
-		uredislog->iovec[6].iov_len = 2;
+	uredislog->iovec[6].iov_base = "\r\n";
+	uredislog->iovec[6].iov_len = 2;
 
-		ul->configured = 1;
-	}
+	ul->configured = 1;
+}
 
-	uredislog = (struct uwsgi_redislog_state *) ul->data;
+static int uwsgi_redis_logger_connect(struct uwsgi_redislog_state *uredislog) {
 	if (uredislog->fd == -1) {
 		uredislog->fd = uwsgi_connect(uredislog->address, uwsgi.socket_timeout, 0);
+		if (uredislog->fd == -1) return -1;
+		// never block the log thread for more than --socket-timeout seconds
+		uwsgi_socket_nb(uredislog->fd);
+	}
+	return 0;
+}
+
+static void uwsgi_redis_logger_close(struct uwsgi_redislog_state *uredislog) {
+	close(uredislog->fd);
+	uredislog->fd = -1;
+}
+
+// write all of the iovecs (they are consumed)
+static int uwsgi_redis_logger_writev(struct uwsgi_redislog_state *uredislog, struct iovec *iov, size_t iovcnt) {
+	while(iovcnt > 0) {
+		ssize_t wlen = writev(uredislog->fd, iov, UMIN(iovcnt, REDISLOG_MAX_IOV));
+		if (wlen < 0) {
+			if (!uwsgi_is_again()) return -1;
+			if (uwsgi_waitfd_write(uredislog->fd, uwsgi.socket_timeout) <= 0) return -1;
+			continue;
+		}
+		if (wlen == 0) return -1;
+		// skip what has been written
+		while(iovcnt > 0 && (size_t) wlen >= iov->iov_len) {
+			wlen -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (wlen > 0) {
+			iov->iov_base = ((char *) iov->iov_base) + wlen;
+			iov->iov_len -= wlen;
+		}
+	}
+	return 0;
+}
+
+// read the responses (a line each) of the pipelined commands
+static int uwsgi_redis_logger_responses(struct uwsgi_redislog_state *uredislog, size_t n) {
+	size_t i;
+	while(n > 0) {
+		ssize_t rlen = read(uredislog->fd, uredislog->response, sizeof(uredislog->response));
+		if (rlen < 0) {
+			if (!uwsgi_is_again()) return -1;
+			if (uwsgi_waitfd(uredislog->fd, uwsgi.socket_timeout) <= 0) return -1;
+			continue;
+		}
+		if (rlen == 0) return -1;
+		for(i=0;i<(size_t)rlen && n > 0;i++) {
+			if (uredislog->response[i] == '\n') n--;
+		}
 	}
+	return 0;
+}
+
+ssize_t uwsgi_redis_logger(struct uwsgi_logger *ul, char *message, size_t len) {
 
-	if (uredislog->fd == -1) return -1;
+	struct uwsgi_redislog_state *uredislog = NULL;
+	struct iovec iov[7];
+	size_t i;
+	ssize_t ret = 0;
+
+	if (!ul->configured) {
+		uwsgi_redis_logger_configure(ul);
+	}
+
+	uredislog = (struct uwsgi_redislog_state *) ul->data;
+	if (uwsgi_redis_logger_connect(uredislog)) return -1;
 
 	// drop newline
         if (message[len-1] == '\n') len--;
@@ -131,33 +200,70 @@ done:
 
 	uredislog->iovec[5].iov_base = message;
 	uredislog->iovec[5].iov_len = len;
-	
-	ret = writev(uredislog->fd, uredislog->iovec, 7);
-	if (ret <= 0) {
-		close(uredislog->fd);
-		uredislog->fd = -1;
+
+	memcpy(iov, uredislog->iovec, sizeof(struct iovec) * 7);
+	for(i=0;i<7;i++) ret += iov[i].iov_len;
+
+	if (uwsgi_redis_logger_writev(uredislog, iov, 7) || uwsgi_redis_logger_responses(uredislog, 1)) {
+		uwsgi_redis_logger_close(uredislog);
 		return -1;
 	}
 
-again:
-	// read til a \n is found (ugly but fast)
-	ret2 = read(uredislog->fd, uredislog->response, 8);
-	if (ret2 <= 0) {
-		close(uredislog->fd);
-		uredislog->fd = -1;
-		return -1;
+	return ret;
+
+}
+
+// pipeline the commands of a batch, then read all of the responses
+static ssize_t uwsgi_redis_logger_batch(struct uwsgi_logger *ul, struct iovec *lines, size_t n) {
+
+	struct uwsgi_redislog_state *uredislog = NULL;
+	size_t i, j, k;
+	ssize_t ret = 0;
+
+	if (!ul->configured) {
+		uwsgi_redis_logger_configure(ul);
 	}
 
-	if (!memchr(uredislog->response, '\n', ret2)) {
-		goto again;
+	uredislog = (struct uwsgi_redislog_state *) ul->data;
+	if (uwsgi_redis_logger_connect(uredislog)) return -1;
+
+	if (!uredislog->batch_iov) {
+		uredislog->batch_max = uwsgi.log_batch > 0 ? uwsgi.log_batch : 1;
+		uredislog->batch_iov = uwsgi_malloc(sizeof(struct iovec) * 7 * uredislog->batch_max);
+		uredislog->batch_msgsizes = uwsgi_malloc(11 * uredislog->batch_max);
+	}
+
+	for(i=0;i<n;i+=uredislog->batch_max) {
+		size_t count = UMIN(uredislog->batch_max, n - i);
+		for(j=0;j<count;j++) {
+			struct iovec *command = uredislog->batch_iov + (j * 7);
+			char *msgsize = uredislog->batch_msgsizes + (j * 11);
+			char *message = lines[i+j].iov_base;
+			size_t len = lines[i+j].iov_len;
+			// drop newline
+			if (len > 0 && message[len-1] == '\n') len--;
+			memcpy(command, uredislog->iovec, sizeof(struct iovec) * 7);
+			uwsgi_num2str2(len + uredislog->iovec[4].iov_len, msgsize);
+			command[2].iov_base = msgsize;
+			command[2].iov_len = strlen(msgsize);
+			command[5].iov_base = message;
+			command[5].iov_len = len;
+			for(k=0;k<7;k++) ret += command[k].iov_len;
+		}
+
+		if (uwsgi_redis_logger_writev(uredislog, uredislog->batch_iov, count * 7)) goto error;
+		if (uwsgi_redis_logger_responses(uredislog, count)) goto error;
 	}
 
 	return ret;
 
+error:
+	uwsgi_redis_logger_close(uredislog);
+	return -1;
 }
 
 void uwsgi_redislog_register() {
-	uwsgi_register_logger("redislog", uwsgi_redis_logger);
+	uwsgi_register_batch_logger("redislog", uwsgi_redis_logger, uwsgi_redis_logger_batch);
 }
 
 struct uwsgi_plugin redislog_plugin = {
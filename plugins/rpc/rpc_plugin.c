@@ -19,6 +19,8 @@ extern struct uwsgi_server uwsgi;
 	3 -> set xmlrpc wrapper (requires libxml2)
 	4 -> set jsonrpc wrapper (requires libjansson)
 	5 -> used in uwsgi response to signal the response is a uwsgi dictionary followed by the body (the dictionary must contains a CONTENT_LENGTH key)
+	6 -> persistent connection: every response is a modifier2 5 dictionary (with a KEEPALIVE key when --rpc-keepalive is set)
+	     and the connection is kept open for the next request
 
 */
 
@@ -128,6 +130,56 @@ static int uwsgi_rpc_xmlrpc(struct wsgi_request *wsgi_req, xmlDoc *doc, char **a
 }
 #endif
 
+// send a response as a uwsgi dictionary followed by the body (in a single write to not hit the Nagle algorithm)
+static int uwsgi_rpc_send_dict(struct wsgi_request *wsgi_req, char *response_buf, size_t content_len) {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(4 + uwsgi.page_size + content_len);
+	// leave space for the uwsgi header
+	ub->pos = 4;
+	if (uwsgi_buffer_append_keynum(ub, "CONTENT_LENGTH", 14 , content_len)) goto error;
+	if (uwsgi.rpc_keepalive > 0) {
+		if (uwsgi_buffer_append_keynum(ub, "KEEPALIVE", 9 , uwsgi.rpc_keepalive)) goto error;
+	}
+	if (uwsgi_buffer_set_uh(ub, 173, 5)) goto error;
+	if (content_len > 0) {
+		if (uwsgi_buffer_append(ub, response_buf, content_len)) goto error;
+	}
+	if (uwsgi_write_true_nb(wsgi_req->fd, ub->buf, ub->pos, uwsgi.socket_timeout)) goto error;
+	uwsgi_buffer_destroy(ub);
+	return 0;
+error:
+	uwsgi_buffer_destroy(ub);
+	return -1;
+}
+
+// serve requests on a persistent connection until it is closed or stays idle for rpc_keepalive seconds
+static int uwsgi_rpc_persistent(struct wsgi_request *wsgi_req, char *response_buf, size_t content_len) {
+	char *argv[UMAX8];
+	uint16_t argvs[UMAX8];
+
+	for(;;) {
+		int ret = uwsgi_rpc_send_dict(wsgi_req, response_buf, content_len);
+		if (response_buf) free(response_buf);
+		if (ret || uwsgi.rpc_keepalive <= 0) break;
+		// a graceful reload has been requested
+		if (!uwsgi.workers[uwsgi.mywid].manage_next_request) break;
+
+		if (uwsgi.wait_read_hook(wsgi_req->fd, uwsgi.rpc_keepalive) <= 0) break;
+		if (uwsgi_read_whole_true_nb(wsgi_req->fd, (char *) wsgi_req->uh, 4, uwsgi.socket_timeout)) break;
+		if (wsgi_req->uh->modifier1 != 173 || wsgi_req->uh->modifier2 != 6 || wsgi_req->uh->_pktsize > uwsgi.buffer_size) break;
+		if (uwsgi_read_whole_true_nb(wsgi_req->fd, wsgi_req->buffer, wsgi_req->uh->_pktsize, uwsgi.socket_timeout)) break;
+
+		uint8_t argc = 0xff;
+		if (uwsgi_parse_array(wsgi_req->buffer, wsgi_req->uh->_pktsize, argv, argvs, &argc) || argc == 0) {
+			uwsgi_log("Invalid RPC request. skip.\n");
+			break;
+		}
+		response_buf = NULL;
+		content_len = uwsgi_rpc(argv[0], argc-1, argv+1, argvs+1, &response_buf);
+	}
+
+	return UWSGI_OK;
+}
+
 static int uwsgi_rpc_request(struct wsgi_request *wsgi_req) {
 
 	// this is the list of args
@@ -233,6 +285,12 @@ static int uwsgi_rpc_request(struct wsgi_request *wsgi_req) {
 
 	// call the function (output will be in wsgi_req->buffer)
 	content_len = uwsgi_rpc(argv[0], argc-1, argv+1, argvs+1, &response_buf);
+
+	// on persistent connections even a missing function gets a (empty) response
+	if (wsgi_req->uh->modifier2 == 6) {
+		return uwsgi_rpc_persistent(wsgi_req, response_buf, content_len);
+	}
+
 	if (!response_buf) return -1;
 
 	// using modifier2 we may want a raw output
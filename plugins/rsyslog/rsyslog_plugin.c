@@ -17,74 +17,78 @@ struct uwsgi_option rsyslog_options[] = {
 };
 
 
-ssize_t uwsgi_rsyslog_logger(struct uwsgi_logger *ul, char *message, size_t len) {
+static void uwsgi_rsyslog_logger_configure(struct uwsgi_logger *ul) {
 
-	char ctime_storage[26];
-	time_t current_time;
 	int portn = 514;
-	int rlen;
 
-	if (!ul->configured) {
-
-                if (!ul->arg) {
-			uwsgi_log_safe("invalid rsyslog syntax\n");
-			exit(1);
-		}
+        if (!ul->arg) {
+		uwsgi_log_safe("invalid rsyslog syntax\n");
+		exit(1);
+	}
 
-		if (ul->arg[0] == '/') {
-                	ul->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-		}
-		else {
-                	ul->fd = socket(AF_INET, SOCK_DGRAM, 0);
-		}
-                if (ul->fd < 0) {
-			uwsgi_error_safe("socket()");
-			exit(1);
-		}
+	if (ul->arg[0] == '/') {
+        	ul->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	}
+	else {
+        	ul->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	}
+        if (ul->fd < 0) {
+		uwsgi_error_safe("socket()");
+		exit(1);
+	}
 
-		uwsgi_socket_nb(ul->fd);
+	uwsgi_socket_nb(ul->fd);
 
-		ul->count = 29;
+	ul->count = 29;
 
-                char *comma = strchr(ul->arg, ',');
-		if (comma) {
-			ul->data = comma+1;
-                	*comma = 0;
-			char *prisev = strchr(ul->data, ',');
-			if (prisev) {
-				*prisev = 0;
-				ul->count = atoi(prisev+1);
-			}
-		}
-		else {
-			ul->data = uwsgi_concat2(uwsgi.hostname," uwsgi");
+        char *comma = strchr(ul->arg, ',');
+	if (comma) {
+		ul->data = comma+1;
+        	*comma = 0;
+		char *prisev = strchr(ul->data, ',');
+		if (prisev) {
+			*prisev = 0;
+			ul->count = atoi(prisev+1);
 		}
+	}
+	else {
+		ul->data = uwsgi_concat2(uwsgi.hostname," uwsgi");
+	}
 
 
-                char *port = strchr(ul->arg, ':');
-                if (port) {
-			portn = atoi(port+1);
-			*port = 0;
-		}
+        char *port = strchr(ul->arg, ':');
+        if (port) {
+		portn = atoi(port+1);
+		*port = 0;
+	}
 
-		if (ul->arg[0] == '/') {
-			ul->addr_len = socket_to_un_addr(ul->arg, &ul->addr.sa_un);
-		}
-		else {
-			ul->addr_len = socket_to_in_addr(ul->arg, NULL, portn, &ul->addr.sa_in);
-		}
+	if (ul->arg[0] == '/') {
+		ul->addr_len = socket_to_un_addr(ul->arg, &ul->addr.sa_un);
+	}
+	else {
+		ul->addr_len = socket_to_in_addr(ul->arg, NULL, portn, &ul->addr.sa_in);
+	}
+
+	if (port) *port = ':';
+	if (comma) *comma = ',';
 
-		if (port) *port = ':';
-		if (comma) *comma = ',';
+	if (!u_rsyslog.packet_size) u_rsyslog.packet_size = 1024;
+	if (!u_rsyslog.msg_size) u_rsyslog.msg_size = u_rsyslog.packet_size - 30;
 
-		if (!u_rsyslog.packet_size) u_rsyslog.packet_size = 1024;
-		if (!u_rsyslog.msg_size) u_rsyslog.msg_size = u_rsyslog.packet_size - 30;
+	ul->buf = uwsgi_malloc(uwsgi.log_master_bufsize);
 
-		ul->buf = uwsgi_malloc(uwsgi.log_master_bufsize);
+        ul->configured = 1;
+}
 
-                ul->configured = 1;
-        }
+ssize_t uwsgi_rsyslog_logger(struct uwsgi_logger *ul, char *message, size_t len) {
 
+	char ctime_storage[26];
+	time_t current_time;
+	int rlen;
+
+	if (!ul->configured) {
+		uwsgi_rsyslog_logger_configure(ul);
+	}
 
 	current_time = uwsgi_now();
 
@@ -113,8 +117,70 @@ ssize_t uwsgi_rsyslog_logger(struct uwsgi_logger *ul, char *message, size_t len)
 
 }
 
+// format a packet for each line and send them with a single syscall
+static ssize_t uwsgi_rsyslog_logger_batch(struct uwsgi_logger *ul, struct iovec *lines, size_t n) {
+
+	char ctime_storage[26];
+	time_t current_time;
+	size_t i, count = 0;
+	ssize_t ret = 0;
+
+	if (!ul->configured) {
+		uwsgi_rsyslog_logger_configure(ul);
+	}
+
+	current_time = uwsgi_now();
+#if defined(__sun__) && !defined(__clang__)
+	ctime_r(&current_time, ctime_storage, 26);
+#else
+	ctime_r(&current_time, ctime_storage);
+#endif
+
+	// the iovecs followed by the packets, allocated once
+	size_t max = uwsgi.log_batch > 0 ? uwsgi.log_batch : 1;
+	if (!ul->batch_data) {
+		ul->batch_data = uwsgi_malloc((sizeof(struct iovec) + u_rsyslog.packet_size) * max);
+	}
+	struct iovec *iov = (struct iovec *) ul->batch_data;
+	char *packets = (char *) (iov + max);
+
+	for(i=0;i<n;i++) {
+		char *message = lines[i].iov_base;
+		size_t len = lines[i].iov_len;
+		// drop newline
+		if (len > 0 && message[len-1] == '\n') len--;
+		// messages to split are managed by the non-batched logger
+		if (u_rsyslog.split_msg && (int) len > u_rsyslog.msg_size) {
+			if (count) {
+				ret = uwsgi_logger_send_datagrams(ul, iov, count, count);
+				count = 0;
+			}
+			uwsgi_rsyslog_logger(ul, lines[i].iov_base, lines[i].iov_len);
+			continue;
+		}
+		int msg_len = ((int)len > u_rsyslog.msg_size ? u_rsyslog.msg_size : (int)len);
+		char *packet = packets + (count * u_rsyslog.packet_size);
+		int rlen = snprintf(packet, u_rsyslog.packet_size, "<%d>%.*s %s: %.*s", ul->count, 15, ctime_storage+4, (char *) ul->data, msg_len, message);
+		if (rlen > 0 && rlen < u_rsyslog.packet_size) {
+			iov[count].iov_base = packet;
+			iov[count].iov_len = rlen;
+			count++;
+		}
+		if (count == max) {
+			ret = uwsgi_logger_send_datagrams(ul, iov, count, count);
+			count = 0;
+		}
+	}
+
+	if (count) {
+		ret = uwsgi_logger_send_datagrams(ul, iov, count, count);
+	}
+
+	return ret;
+}
+
 void uwsgi_rsyslog_register() {
-	uwsgi_register_logger("rsyslog", uwsgi_rsyslog_logger);
+	uwsgi_register_batch_logger("rsyslog", uwsgi_rsyslog_logger, uwsgi_rsyslog_logger_batch);
 }
 
 struct uwsgi_plugin rsyslog_plugin = {
@@ -151,6 +151,7 @@ static struct uwsgi_option sslrouter_options[] = {
 	{"sslrouter-stats-server", required_argument, 0, "run the sslrouter stats server", uwsgi_opt_set_str, &usr.cr.stats_server, 0},
 	{"sslrouter-ss", required_argument, 0, "run the sslrouter stats server", uwsgi_opt_set_str, &usr.cr.stats_server, 0},
 	{"sslrouter-harakiri", required_argument, 0, "enable sslrouter harakiri", uwsgi_opt_set_int, &usr.cr.harakiri, 0},
+	{"sslrouter-timer-wheel", no_argument, 0, "use a hierarchical timer wheel (instead of the rbtree) for sslrouter timeouts", uwsgi_opt_true, &usr.cr.timer_wheel, 0},
 
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
 	{"sslrouter-sni", no_argument, 0, "use SNI to route requests", uwsgi_opt_true, &usr.sni, 0},
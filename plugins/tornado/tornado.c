@@ -63,6 +63,7 @@ static int uwsgi_tornado_wait_read_hook(int fd, int timeout) {
 	*/
 
 	struct wsgi_request *wsgi_req = current_wsgi_req();
+	uwsgi_response_flush_current();
 
 	PyObject *cb_fd = PyObject_CallMethod(utornado.functools, "partial", "Ol", utornado.hook_fd, (long) wsgi_req);
 	if (!cb_fd) goto error;
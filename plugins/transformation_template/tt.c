@@ -12,10 +12,11 @@ static int transform_template(struct wsgi_request *wsgi_req, struct uwsgi_transf
 
         struct uwsgi_buffer *ub = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, ut->chunk->buf, ut->chunk->pos);
         if (!ub) return -1;
-        uwsgi_buffer_map(ut->chunk, ub->buf, ub->pos);
-        ub->buf = NULL;
+        // the translated buffer lives in the request arena, just copy it
+        ut->chunk->pos = 0;
+        int ret = uwsgi_buffer_append(ut->chunk, ub->buf, ub->pos);
         uwsgi_buffer_destroy(ub);
-        return 0;
+        return ret;
 }
 static int uwsgi_router_template_func(struct wsgi_request *wsgi_req, struct uwsgi_route *route) {
         uwsgi_add_transformation(wsgi_req, transform_template, route);
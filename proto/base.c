@@ -134,17 +134,18 @@ void uwsgi_proto_ssl_close(struct wsgi_request *wsgi_req) {
 }
 #endif
 
+// response headers chunks are allocated in the request arena
 struct uwsgi_buffer *uwsgi_proto_base_add_header(struct wsgi_request *wsgi_req, char *k, uint16_t kl, char *v, uint16_t vl) {
 	struct uwsgi_buffer *ub = NULL;
 	if (kl > 0) {
-		ub = uwsgi_buffer_new(kl + 2 + vl + 2);
+		ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), kl + 2 + vl + 2);
 		if (uwsgi_buffer_append(ub, k, kl)) goto end;
 		if (uwsgi_buffer_append(ub, ": ", 2)) goto end;
 		if (uwsgi_buffer_append(ub, v, vl)) goto end;
 		if (uwsgi_buffer_append(ub, "\r\n", 2)) goto end;
 	}
 	else {
-		ub = uwsgi_buffer_new(vl + 2);
+		ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), vl + 2);
 		if (uwsgi_buffer_append(ub, v, vl)) goto end;
                 if (uwsgi_buffer_append(ub, "\r\n", 2)) goto end;
 	}
@@ -158,17 +159,17 @@ struct uwsgi_buffer *uwsgi_proto_base_prepare_headers(struct wsgi_request *wsgi_
         struct uwsgi_buffer *ub = NULL;
 	if (uwsgi.cgi_mode == 0) {
 		if (wsgi_req->protocol_len) {
-			ub = uwsgi_buffer_new(wsgi_req->protocol_len + 1 + sl + 2);
+			ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), wsgi_req->protocol_len + 1 + sl + 2);
 			if (uwsgi_buffer_append(ub, wsgi_req->protocol, wsgi_req->protocol_len)) goto end;
 			if (uwsgi_buffer_append(ub, " ", 1)) goto end;
 		}
 		else {
-			ub = uwsgi_buffer_new(9 + sl + 2);
+			ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), 9 + sl + 2);
 			if (uwsgi_buffer_append(ub, "HTTP/1.0 ", 9)) goto end;
 		}
 	}
 	else {
-		ub = uwsgi_buffer_new(8 + sl + 2);
+		ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), 8 + sl + 2);
 		if (uwsgi_buffer_append(ub, "Status: ", 8)) goto end;
 	}
         if (uwsgi_buffer_append(ub, s, sl)) goto end;
@@ -180,7 +181,7 @@ end:
 }
 
 struct uwsgi_buffer *uwsgi_proto_base_cgi_prepare_headers(struct wsgi_request *wsgi_req, char *s, uint16_t sl) {
-	struct uwsgi_buffer *ub = uwsgi_buffer_new(8 + sl + 2);
+	struct uwsgi_buffer *ub = uwsgi_buffer_new_arena(uwsgi_req_arena(wsgi_req), 8 + sl + 2);
 	if (uwsgi_buffer_append(ub, "Status: ", 8)) goto end;
         if (uwsgi_buffer_append(ub, s, sl)) goto end;
 	if (uwsgi_buffer_append(ub, "\r\n", 2)) goto end;
@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+# compare two t/bench/run.sh result files
+import json
+import sys
+
+
+def load(filename):
+    results = {}
+    with open(filename) as f:
+        for line in f:
+            name, _, data = line.strip().partition(' ')
+            if name:
+                results[name] = json.loads(data)
+    return results
+
+
+def delta(old, new):
+    if not old:
+        return '   n/a'
+    return '%+6.1f%%' % ((new - old) * 100.0 / old)
+
+
+old = load(sys.argv[1])
+new = load(sys.argv[2])
+
+print('%-12s %12s %12s %8s %10s %10s %8s %7s' % ('scenario', 'old req/s', 'new req/s', 'delta', 'old p99', 'new p99', 'delta', 'errors'))
+for name in old:
+    if name not in new:
+        continue
+    o, n = old[name], new[name]
+    if not o or not n:
+        print('%-12s failed' % name)
+        continue
+    print('%-12s %12.1f %12.1f %8s %10d %10d %8s %7d' % (
+        name, o['rps'], n['rps'], delta(o['rps'], n['rps']),
+        o['latency']['p99'], n['latency']['p99'], delta(o['latency']['p99'], n['latency']['p99']),
+        n['errors'] + n['timeouts']))
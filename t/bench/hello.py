@@ -0,0 +1,3 @@
+def application(env, start_response):
+    start_response('200 OK', [('Content-Type', 'text/plain'), ('Content-Length', '12')])
+    return [b'Hello World\n']
@@ -0,0 +1,29 @@
+# every request does CALLS rpc calls, so calls/sec = requests/sec * CALLS
+#
+# /local -> a function registered by the master (inherited by the workers)
+# /mule -> a function registered by a mule (shared memory channel)
+# /remote -> a function of another instance (pooled persistent connections)
+import uwsgi
+
+CALLS = 100
+
+
+def hello(name):
+    return b'hello ' + name
+
+uwsgi.register_rpc('hello', hello)
+
+
+def application(env, start_response):
+    path = env['PATH_INFO']
+    if path == '/mule':
+        for i in range(CALLS):
+            uwsgi.call('mule_hello', b'bench')
+    elif path == '/remote':
+        for i in range(CALLS):
+            uwsgi.rpc('127.0.0.1:9596', 'hello', b'bench')
+    else:
+        for i in range(CALLS):
+            uwsgi.call('hello', b'bench')
+    start_response('200 OK', [('Content-Type', 'text/plain'), ('Content-Length', '3')])
+    return [b'ok\n']
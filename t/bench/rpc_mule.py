@@ -0,0 +1,11 @@
+# registers the function called by the rpc_mule scenario and serves its calls
+import uwsgi
+
+
+def mule_hello(name):
+    return b'hello ' + name
+
+uwsgi.register_rpc('mule_hello', mule_hello)
+
+while True:
+    uwsgi.mule_get_msg()
@@ -0,0 +1,32 @@
+#!/bin/sh
+# run the standard benchmark scenarios against a uWSGI binary
+#
+# usage: t/bench/run.sh <uwsgi binary> [scenario ...] > results.txt
+#
+# every scenario is an ini file with a [uwsgi] section (the server) and a [bench]
+# section (the --bench options), each result is printed as "<scenario> <json>".
+# An optional [node] section is started as a second instance (e.g. a remote rpc node).
+# Compare two builds with: t/bench/compare.py old.txt new.txt
+
+BIN=${1:?usage: $0 <uwsgi binary> [scenario ...]}
+shift
+DIR=$(cd "$(dirname "$0")" && pwd)
+SCENARIOS=${*:-"hello static cache offload websockets rpc_local rpc_mule rpc_remote signals"}
+
+for s in $SCENARIOS; do
+	if grep -q '^\[node\]' $DIR/$s.ini; then
+		$BIN --ini $DIR/$s.ini:node --pidfile /tmp/uwsgi-bench-$s-node.pid > /tmp/uwsgi-bench-$s-node.log 2>&1 &
+	fi
+	$BIN --ini $DIR/$s.ini --pidfile /tmp/uwsgi-bench-$s.pid > /tmp/uwsgi-bench-$s.log 2>&1 &
+	sleep 2
+	# warm up (fills the caches and the kernel buffers), then measure
+	$BIN --ini $DIR/$s.ini:bench --bench-requests 1000 > /dev/null 2>&1
+	RESULT=$($BIN --ini $DIR/$s.ini:bench --bench-json 2>/dev/null)
+	echo "$s ${RESULT:-{\}}"
+	kill -INT $(cat /tmp/uwsgi-bench-$s.pid)
+	if [ -f /tmp/uwsgi-bench-$s-node.pid ]; then
+		kill -INT $(cat /tmp/uwsgi-bench-$s-node.pid)
+	fi
+	wait
+	rm -f /tmp/uwsgi-bench-$s.pid /tmp/uwsgi-bench-$s-node.pid
+done
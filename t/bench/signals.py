@@ -0,0 +1,22 @@
+# every request raises SIGNALS signals, bursts of the same signal are coalesced
+#
+# / -> a signal for all of the workers
+# /pool -> a signal for the first available worker
+import uwsgi
+
+SIGNALS = 100
+
+
+def handler(signum):
+    pass
+
+uwsgi.register_signal(17, 'workers', handler)
+uwsgi.register_signal(18, 'worker', handler)
+
+
+def application(env, start_response):
+    signum = 18 if env['PATH_INFO'] == '/pool' else 17
+    for i in range(SIGNALS):
+        uwsgi.signal(signum)
+    start_response('200 OK', [('Content-Type', 'text/plain'), ('Content-Length', '3')])
+    return [b'ok\n']
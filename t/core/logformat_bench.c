@@ -0,0 +1,182 @@
+/*
+
+	logformat engines microbenchmark
+
+	renders the same request with the iovec based engine (--logformat-iovec)
+	and the compiled one (default and --logformat-json), the request arena is reset after
+	each line (as uwsgi_close_request() does)
+
+	to compile (from the uWSGI source tree):
+
+	gcc -O2 -I. -o logformat_bench t/core/logformat_bench.c core/logformat.c core/arena.c
+
+	./logformat_bench [lines] [format]
+
+*/
+
+#include <uwsgi.h>
+
+struct uwsgi_server uwsgi;
+
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+void *uwsgi_malloc(size_t size) {
+	void *ptr = malloc(size);
+	if (!ptr) {
+		perror("malloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+void *uwsgi_calloc(size_t size) {
+	void *ptr = calloc(1, size);
+	if (!ptr) {
+		perror("calloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+char *uwsgi_concat2n(char *one, int s1, char *two, int s2) {
+	char *buf = uwsgi_malloc(s1 + s2 + 1);
+	memcpy(buf, one, s1);
+	memcpy(buf + s1, two, s2);
+	buf[s1 + s2] = 0;
+	return buf;
+}
+
+int uwsgi_strncmp(char *src, int slen, char *dst, int dlen) {
+	if (slen != dlen)
+		return 1;
+	return memcmp(src, dst, dlen);
+}
+
+int uwsgi_starts_with(char *src, int slen, char *dst, int dlen) {
+	if (slen < dlen)
+		return -1;
+	return memcmp(src, dst, dlen);
+}
+
+time_t uwsgi_now() {
+	return time(NULL);
+}
+
+struct uwsgi_logvar *uwsgi_logvar_get(struct wsgi_request *wsgi_req, char *key, uint8_t keylen) {
+	return NULL;
+}
+
+int64_t uwsgi_metric_get(char *name, char *oid) {
+	return 17;
+}
+
+char *uwsgi_get_var(struct wsgi_request *wsgi_req, char *key, uint16_t keylen, uint16_t * len) {
+	if (!uwsgi_strncmp(key, keylen, "HTTP_HOST", 9)) {
+		*len = 11;
+		return "example.com";
+	}
+	*len = 0;
+	return NULL;
+}
+
+// the line is copied, as the log ring does
+static char sink[65536];
+static uint64_t sink_bytes;
+
+void uwsgi_req_log_write(struct iovec *iov, int iovcnt) {
+	int i;
+	size_t pos = 0;
+	for (i = 0; i < iovcnt; i++) {
+		memcpy(sink + pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+	sink_bytes += pos;
+}
+
+static uint64_t bench_usecs() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000 * 1000) + tv.tv_usec;
+}
+
+static void bench_run(char *name, struct wsgi_request *wsgi_req, int lines) {
+	int i;
+	sink_bytes = 0;
+	uint64_t start = bench_usecs();
+	for (i = 0; i < lines; i++) {
+		wsgi_req->response_size = 1000 + i % 5000;
+		uwsgi.logit(wsgi_req);
+		uwsgi_req_arena_reset(wsgi_req);
+	}
+	uint64_t elapsed = bench_usecs() - start;
+	if (!elapsed)
+		elapsed = 1;
+	printf("%-10s %d lines in %llu usecs (%.0f lines/sec, %.1f ns/line) %llu bytes\n", name, lines, (unsigned long long) elapsed, (lines * 1000000.0) / elapsed, (elapsed * 1000.0) / lines, (unsigned long long) sink_bytes);
+}
+
+static void bench_reset_logformat() {
+	uwsgi.logchunks = NULL;
+	uwsgi.logformat_vectors = 0;
+	uwsgi.logvectors = NULL;
+	uwsgi.logformat_buffers = NULL;
+}
+
+int main(int argc, char *argv[]) {
+	int lines = 1000000;
+	char *format = "%(addr) - %(user) [%(ltime)] \"%(method) %(uri) %(proto)\" %(status) %(size) \"%(referer)\" \"%(uagent)\" host=%(var.HTTP_HOST) msecs=%(msecs) micros=%(micros) rss=%(rssM) pid=%(pid) wid=%(wid) core=%(core) m=%(metric.foo)";
+
+	if (argc > 1)
+		lines = atoi(argv[1]);
+	if (argc > 2)
+		format = argv[2];
+
+	uwsgi.cores = 1;
+	uwsgi.mypid = getpid();
+	uwsgi.mywid = 1;
+	uwsgi.log_master_bufsize = 8192;
+	uwsgi.request_arena_size = 16384;
+	uwsgi.workers = uwsgi_calloc(sizeof(struct uwsgi_worker) * 2);
+	uwsgi.workers[1].cores = uwsgi_calloc(sizeof(struct uwsgi_core));
+	uwsgi.workers[1].rss_size = 64 * 1024 * 1024;
+
+	uwsgi_register_logchunks();
+
+	struct uwsgi_header uh;
+	memset(&uh, 0, sizeof(struct uwsgi_header));
+	struct wsgi_request *wsgi_req = uwsgi_calloc(sizeof(struct wsgi_request));
+	wsgi_req->uh = &uh;
+	wsgi_req->remote_addr = "192.168.1.17";
+	wsgi_req->remote_addr_len = strlen(wsgi_req->remote_addr);
+	wsgi_req->method = "GET";
+	wsgi_req->method_len = 3;
+	wsgi_req->uri = "/api/v1/items?page=3&sort=\"name\"";
+	wsgi_req->uri_len = strlen(wsgi_req->uri);
+	wsgi_req->protocol = "HTTP/1.1";
+	wsgi_req->protocol_len = 8;
+	wsgi_req->user_agent = "Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101 Firefox/115.0";
+	wsgi_req->user_agent_len = strlen(wsgi_req->user_agent);
+	wsgi_req->status = 200;
+	wsgi_req->headers_size = 180;
+	wsgi_req->start_of_request = bench_usecs();
+	wsgi_req->end_of_request = wsgi_req->start_of_request + 1234;
+
+	uwsgi.logformat = format;
+	printf("format: %s\n", format);
+
+	uwsgi.logformat_iovec = 1;
+	uwsgi_logformat_init();
+	bench_run("iovec", wsgi_req, lines);
+
+	bench_reset_logformat();
+	uwsgi.logformat_iovec = 0;
+	uwsgi_logformat_init();
+	bench_run("compiled", wsgi_req, lines);
+
+	bench_reset_logformat();
+	uwsgi.logformat_json = 1;
+	uwsgi_logformat_init();
+	bench_run("json", wsgi_req, lines);
+	return 0;
+}
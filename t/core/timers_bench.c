@@ -0,0 +1,146 @@
+/*
+
+	rbtree vs timer wheel microbenchmark
+
+	simulates the corerouter timeouts management with 100k concurrent keepalive connections:
+	each event on a connection re-arms its timeout, while the clock advances and
+	expired timers are collected
+
+	to compile (from the uWSGI source tree):
+
+	gcc -O2 -I. -o timers_bench t/core/timers_bench.c core/rb_timers.c core/timer_wheel.c
+
+	./timers_bench [connections] [events]
+
+*/
+
+#include <uwsgi.h>
+
+struct uwsgi_server uwsgi;
+
+void uwsgi_exit(int status) {
+	_exit(status);
+}
+
+void *uwsgi_malloc(size_t size) {
+	void *ptr = malloc(size);
+	if (!ptr) {
+		perror("malloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+void *uwsgi_calloc(size_t size) {
+	void *ptr = calloc(1, size);
+	if (!ptr) {
+		perror("calloc()");
+		exit(1);
+	}
+	return ptr;
+}
+
+struct bench_conn {
+	struct uwsgi_rb_timer *timeout;
+	struct uwsgi_wheel_timer wheel_timeout;
+	int timeout_value;
+};
+
+static uint64_t bench_usecs() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000 * 1000) + tv.tv_usec;
+}
+
+// 100k events per simulated second
+#define EVENTS_PER_TICK 100000
+
+static void bench_rbtree(struct bench_conn *conns, int n, int events) {
+	int i;
+	uint64_t now = 1000000;
+	uint64_t expired = 0;
+	struct uwsgi_rbtree *tree = uwsgi_init_rb_timer();
+
+	for (i = 0; i < n; i++) {
+		conns[i].timeout = uwsgi_add_rb_timer(tree, now + conns[i].timeout_value, &conns[i]);
+	}
+
+	srand(17);
+	uint64_t start = bench_usecs();
+	for (i = 0; i < events; i++) {
+		struct bench_conn *conn = &conns[rand() % n];
+		// this is what corerouter_reset_timeout_fast() does
+		uwsgi_del_rb_timer(tree, conn->timeout);
+		free(conn->timeout);
+		conn->timeout = uwsgi_add_rb_timer(tree, now + conn->timeout_value, conn);
+
+		if (i % EVENTS_PER_TICK == 0) {
+			now++;
+			for (;;) {
+				struct uwsgi_rb_timer *urbt = uwsgi_min_rb_timer(tree, NULL);
+				if (!urbt || urbt->value > now)
+					break;
+				conn = (struct bench_conn *) urbt->data;
+				uwsgi_del_rb_timer(tree, urbt);
+				free(urbt);
+				// the client reconnects
+				conn->timeout = uwsgi_add_rb_timer(tree, now + conn->timeout_value, conn);
+				expired++;
+			}
+		}
+	}
+	uint64_t elapsed = bench_usecs() - start;
+	printf("rbtree: %d events in %llu usecs (%.1f ns/event) expired: %llu\n", events, (unsigned long long) elapsed, (elapsed * 1000.0) / events, (unsigned long long) expired);
+}
+
+static void bench_wheel(struct bench_conn *conns, int n, int events) {
+	int i;
+	uint64_t now = 1000000;
+	uint64_t expired = 0;
+	struct uwsgi_timer_wheel *wheel = uwsgi_init_timer_wheel(now);
+
+	for (i = 0; i < n; i++) {
+		uwsgi_add_wheel_timer(wheel, &conns[i].wheel_timeout, now + conns[i].timeout_value, &conns[i]);
+	}
+
+	srand(17);
+	uint64_t start = bench_usecs();
+	for (i = 0; i < events; i++) {
+		struct bench_conn *conn = &conns[rand() % n];
+		uwsgi_add_wheel_timer(wheel, &conn->wheel_timeout, now + conn->timeout_value, conn);
+
+		if (i % EVENTS_PER_TICK == 0) {
+			now++;
+			struct uwsgi_wheel_timer *uwt;
+			while ((uwt = uwsgi_expired_wheel_timer(wheel, now))) {
+				conn = (struct bench_conn *) uwt->data;
+				uwsgi_add_wheel_timer(wheel, &conn->wheel_timeout, now + conn->timeout_value, conn);
+				expired++;
+			}
+		}
+	}
+	uint64_t elapsed = bench_usecs() - start;
+	printf("wheel:  %d events in %llu usecs (%.1f ns/event) expired: %llu\n", events, (unsigned long long) elapsed, (elapsed * 1000.0) / events, (unsigned long long) expired);
+}
+
+int main(int argc, char *argv[]) {
+	int i;
+	int n = 100000;
+	int events = 10000000;
+
+	if (argc > 1)
+		n = atoi(argv[1]);
+	if (argc > 2)
+		events = atoi(argv[2]);
+
+	struct bench_conn *conns = uwsgi_calloc(sizeof(struct bench_conn) * n);
+	// mix of headers/keepalive timeouts
+	for (i = 0; i < n; i++) {
+		conns[i].timeout_value = (i % 4) ? 60 : 5;
+	}
+
+	printf("%d concurrent keepalive connections\n", n);
+	bench_rbtree(conns, n, events);
+	bench_wheel(conns, n, events);
+	return 0;
+}
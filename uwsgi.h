@@ -59,6 +59,34 @@ extern "C" {
                         }
 
 
+// atomic helpers (gcc/clang builtins)
+#define uwsgi_atomic_load(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define uwsgi_atomic_store(x, v) __atomic_store_n(&(x), v, __ATOMIC_RELEASE)
+#define uwsgi_atomic_add(x, v) __atomic_fetch_add(&(x), v, __ATOMIC_SEQ_CST)
+#define uwsgi_atomic_sub(x, v) __atomic_fetch_sub(&(x), v, __ATOMIC_SEQ_CST)
+#define uwsgi_atomic_cas(x, old, new) __atomic_compare_exchange_n(&(x), old, new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define uwsgi_atomic_or(x, v) __atomic_fetch_or(&(x), v, __ATOMIC_SEQ_CST)
+#define uwsgi_atomic_xchg(x, v) __atomic_exchange_n(&(x), v, __ATOMIC_SEQ_CST)
+#define uwsgi_atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// USDT static probes (build with usdt = true), they are a single nop when not attached
+#ifdef UWSGI_USDT
+#include <sys/sdt.h>
+#define UWSGI_PROBE(name) DTRACE_PROBE(uwsgi, name)
+#define UWSGI_PROBE1(name, a) DTRACE_PROBE1(uwsgi, name, a)
+#define UWSGI_PROBE2(name, a, b) DTRACE_PROBE2(uwsgi, name, a, b)
+#define UWSGI_PROBE3(name, a, b, c) DTRACE_PROBE3(uwsgi, name, a, b, c)
+#define UWSGI_PROBE4(name, a, b, c, d) DTRACE_PROBE4(uwsgi, name, a, b, c, d)
+#define UWSGI_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(uwsgi, name, a, b, c, d, e)
+#else
+#define UWSGI_PROBE(name)
+#define UWSGI_PROBE1(name, a)
+#define UWSGI_PROBE2(name, a, b)
+#define UWSGI_PROBE3(name, a, b, c)
+#define UWSGI_PROBE4(name, a, b, c, d)
+#define UWSGI_PROBE5(name, a, b, c, d, e)
+#endif
+
 #define uwsgi_n64(x) strtoul(x, NULL, 10)
 
 #define ushared uwsgi.shared
@@ -380,11 +408,77 @@ struct uwsgi_buffer {
 	size_t pos;
 	size_t len;
 	size_t limit;
+	// buffers allocated in an arena are released on arena reset
+	struct uwsgi_arena *arena;
 #ifdef UWSGI_DEBUG_BUFFER
 	int freed;
 #endif
 };
 
+struct uwsgi_arena {
+	char *base;
+	size_t len;
+	size_t pos;
+	// bytes requested since the last reset (could be more than len)
+	size_t used;
+	struct uwsgi_arena_block *blocks;
+	uint64_t overflows;
+};
+
+// per-worker request log ring (shared memory)
+struct uwsgi_log_ring {
+	// absolute positions (the offset is pos % size)
+	uint64_t head;
+	uint64_t tail;
+	uint64_t size;
+	uint64_t lines;
+	uint64_t dropped;
+	uint64_t waits;
+	char data[];
+};
+
+// --trace-spans
+enum {
+	UWSGI_TRACE_SPAN_ROUTER_REQUEST = 1,
+	UWSGI_TRACE_SPAN_ROUTER_CONNECT,
+	UWSGI_TRACE_SPAN_QUEUE,
+	UWSGI_TRACE_SPAN_PARSE,
+	UWSGI_TRACE_SPAN_HANDLER,
+	UWSGI_TRACE_SPAN_REQUEST,
+	UWSGI_TRACE_SPAN_OFFLOAD,
+};
+
+struct uwsgi_trace_context {
+	uint64_t trace_id[2];
+	uint64_t span_id;
+	uint64_t parent_id;
+	uint8_t sampled;
+};
+
+// 64 bytes, seq is ticket+1 when the slot is published
+struct uwsgi_trace_span {
+	uint64_t seq;
+	uint64_t trace_id[2];
+	uint64_t span_id;
+	uint64_t parent_id;
+	uint64_t start;
+	uint64_t end;
+	uint16_t kind;
+	int16_t wid;
+	uint16_t core;
+	uint16_t status;
+};
+
+struct uwsgi_trace_ring {
+	uint64_t size;
+	uint64_t head;
+	// only used by the consumer
+	uint64_t tail;
+	uint64_t exported;
+	uint64_t dropped;
+	struct uwsgi_trace_span spans[];
+};
+
 struct uwsgi_string_list {
 	char *value;
 	size_t len;
@@ -500,6 +594,34 @@ struct uwsgi_rb_timer *uwsgi_min_rb_timer(struct uwsgi_rbtree *, struct uwsgi_rb
 struct uwsgi_rb_timer *uwsgi_add_rb_timer(struct uwsgi_rbtree *, uint64_t, void *);
 void uwsgi_del_rb_timer(struct uwsgi_rbtree *, struct uwsgi_rb_timer *);
 
+// the timer wheel uses 64 slots per level (each level is mapped to a 64bit bitmap)
+#define UWSGI_WHEEL_BITS 6
+#define UWSGI_WHEEL_SLOTS (1 << UWSGI_WHEEL_BITS)
+#define UWSGI_WHEEL_LEVELS 5
+
+struct uwsgi_wheel_timer {
+	struct uwsgi_wheel_timer *prev;
+	struct uwsgi_wheel_timer *next;
+	// the list (slot) the timer is linked to, NULL if not armed
+	struct uwsgi_wheel_timer **list;
+	uint64_t value;
+	void *data;
+};
+
+struct uwsgi_timer_wheel {
+	uint64_t current;
+	uint64_t count;
+	uint64_t bitmap[UWSGI_WHEEL_LEVELS];
+	struct uwsgi_wheel_timer *slots[UWSGI_WHEEL_LEVELS][UWSGI_WHEEL_SLOTS];
+	struct uwsgi_wheel_timer *expired;
+};
+
+struct uwsgi_timer_wheel *uwsgi_init_timer_wheel(uint64_t);
+void uwsgi_add_wheel_timer(struct uwsgi_timer_wheel *, struct uwsgi_wheel_timer *, uint64_t, void *);
+void uwsgi_del_wheel_timer(struct uwsgi_timer_wheel *, struct uwsgi_wheel_timer *);
+struct uwsgi_wheel_timer *uwsgi_expired_wheel_timer(struct uwsgi_timer_wheel *, uint64_t);
+int uwsgi_wheel_timer_next(struct uwsgi_timer_wheel *, uint64_t);
+
 
 union uwsgi_sockaddr {
 	struct sockaddr sa;
@@ -629,8 +751,21 @@ struct uwsgi_logger {
 	// used by choosen logger
 	char *arg;
 	struct uwsgi_logger *next;
+
+	// batching (--log-batch), only for loggers registered with UWSGI_LOGGER_BATCH
+	int flags;
+	ssize_t(*batch_func) (struct uwsgi_logger *, struct iovec *, size_t);
+	char *batch_buf;
+	size_t batch_pos;
+	struct iovec *batch_iov;
+	size_t batch_count;
+	uint64_t batch_since;
+	// scratch memory of the batch_func, allocated once (at --log-batch size)
+	void *batch_data;
 };
 
+#define UWSGI_LOGGER_BATCH 1
+
 #ifdef UWSGI_SSL
 struct uwsgi_legion_node {
 	char *name;
@@ -729,6 +864,36 @@ struct uwsgi_queue_item {
 	time_t ts;
 };
 
+/*
+	--queue-ring: the queue memory is a ring of variable-length records.
+	Positions are absolute byte counters (never wrapping), producers and
+	consumers reserve with a CAS on *_head and publish in reservation order
+	by moving *_tail.
+*/
+#define UWSGI_QUEUE_RING_MAGIC 0x32474e52
+
+struct uwsgi_queue_ring {
+	uint64_t magic;
+	uint64_t size;
+	uint64_t prod_head __attribute__ ((aligned(64)));
+	uint64_t prod_tail;
+	// the pid of the process reserving space (producers take turns)
+	int32_t prod_owner;
+	uint64_t cons_head __attribute__ ((aligned(64)));
+	uint64_t cons_tail;
+	// bumped at every push, blocking pulls wait on it
+	uint32_t futex __attribute__ ((aligned(64)));
+	uint32_t waiters;
+};
+
+// a message reserved (or consumed) in place on a ring
+struct uwsgi_ring_slot {
+	uint64_t head;
+	uint64_t total;
+	char *data;
+	uint64_t len;
+};
+
 struct uwsgi_hash_algo {
 	char *name;
 	 uint32_t(*func) (char *, uint64_t);
@@ -751,6 +916,39 @@ struct uwsgi_sharedarea {
 	uint8_t honour_used;
 	uint64_t used;
 	void *obj;
+	// bumped on every update, waiters sleep on it
+	uint32_t futex;
+	uint32_t waiters;
+	// set when the area is formatted as a hashmap
+	struct uwsgi_sharedarea_hashmap *hashmap;
+	struct uwsgi_lock_item **hashmap_locks;
+};
+
+#define UWSGI_SHAREDAREA_HASHMAP_MAGIC 0x50414d48
+
+// stored at the start of the area, followed by the stripes and the entries
+struct uwsgi_sharedarea_hashmap {
+	uint64_t magic;
+	uint64_t items;
+	uint64_t keysize;
+	uint64_t valuesize;
+	uint64_t stripes;
+	uint64_t entry_size;
+} __attribute__ ((aligned(64)));
+
+struct uwsgi_sharedarea_hashmap_stripe {
+	// odd while a writer is updating the stripe
+	uint64_t seq;
+	uint64_t count;
+} __attribute__ ((aligned(64)));
+
+struct uwsgi_sharedarea_hashmap_entry {
+	uint32_t hash;
+	uint16_t flags;
+	uint16_t keylen;
+	uint64_t vallen;
+	// the key (padded to 8 bytes) followed by the value
+	char data[];
 };
 
 // maintain alignment here !!!
@@ -884,6 +1082,7 @@ struct uwsgi_opt {
 #endif
 
 #define UWSGI_SPOOLER_EXTERNAL		1
+#define UWSGI_SPOOLER_LOG		2
 
 #define UWSGI_MODIFIER_ADMIN_REQUEST	10
 #define UWSGI_MODIFIER_SPOOL_REQUEST	17
@@ -1150,6 +1349,25 @@ struct uwsgi_spooler {
 	struct uwsgi_spooler *next;
 
 	time_t last_task_managed;
+
+	// number of tasks tracked by the spooler index
+	uint64_t indexed;
+
+	// log backend: the active segment (protected by lock)
+	uint64_t log_segment;
+	uint64_t log_offset;
+	uint64_t log_records;
+	// set whenever a task is appended (used by cheap mode)
+	int log_dirty;
+	// group commit (protected by log_lock)
+	struct uwsgi_lock_item *log_lock;
+	uint64_t log_synced_segment;
+	uint64_t log_synced_offset;
+
+	// --spooler-threads: tasks currently running in the pool
+	uint64_t inflight;
+	// run time of the tasks (microseconds, in shared memory)
+	struct uwsgi_histogram *latency;
 };
 
 #ifdef UWSGI_ROUTING
@@ -1466,6 +1684,7 @@ struct wsgi_request {
 	int async_ready_fd;
 	int async_last_ready_fd;
 	struct uwsgi_rb_timer *async_timeout;
+	struct uwsgi_wheel_timer async_wheel_timeout;
 	struct uwsgi_async_fd *waiting_fds;
 
 	void *async_app;
@@ -1594,6 +1813,22 @@ struct wsgi_request {
 
 	// uWSGI 2.1
 	uint64_t len;
+
+	// pending output (--response-coalesce)
+	struct uwsgi_buffer *coalesce;
+	int coalesce_disabled;
+
+	// --histograms
+	uint64_t accepted_at;
+	int histogram_label;
+
+	// --trace-spans
+	struct uwsgi_trace_context trace;
+	int trace_resolved;
+	uint64_t trace_parse_start;
+	uint64_t trace_parse_end;
+	uint64_t trace_handler_start;
+	uint64_t trace_handler_end;
 };
 
 
@@ -1700,6 +1935,30 @@ struct uwsgi_harakiri_options {
 	int mules;
 };
 
+// --bench (the load generator)
+struct uwsgi_bench_options {
+	char *address;
+	char *protocol;
+	int concurrency;
+	int threads;
+	int pipeline;
+	uint64_t requests;
+	int duration;
+	int timeout;
+	char *method;
+	char *uri;
+	struct uwsgi_string_list *headers;
+	struct uwsgi_string_list *vars;
+	char *body;
+	char *body_file;
+	int modifier1;
+	int modifier2;
+	int keepalive;
+	uint64_t expect;
+	uint64_t message_size;
+	int json;
+};
+
 struct uwsgi_fsmon {
 	char *path;
 	int fd;
@@ -2306,6 +2565,7 @@ struct uwsgi_server {
 	struct uwsgi_async_request *async_runqueue_last;
 
 	struct uwsgi_rbtree *rb_async_timeouts;
+	struct uwsgi_timer_wheel *async_wheel;
 
 	int async_queue_unused_ptr;
 	struct wsgi_request **async_queue_unused;
@@ -2808,6 +3068,80 @@ struct uwsgi_server {
 
 	char *emperor_trigger_socket;
 	int emperor_trigger_socket_fd;
+
+	int async_timer_wheel;
+
+	int thread_acceptor;
+	uint64_t thread_acceptor_ring_size;
+	struct uwsgi_request_ring *request_ring;
+
+	int accept_batch;
+	int udp_batch;
+
+	// per-core request arenas (process local)
+	struct uwsgi_arena **request_arenas;
+	uint64_t request_arena_size;
+
+	uint64_t response_coalesce;
+	int tcp_cork;
+
+	uint64_t req_log_ring_size;
+	int req_log_ring_block;
+	struct uwsgi_log_ring **req_log_rings;
+	int log_batch;
+	uint64_t log_batch_size;
+	int log_batch_flush;
+
+	int logformat_json;
+	int logformat_iovec;
+	uint64_t logformat_buffer_size;
+	char **logformat_buffers;
+
+	int histograms;
+	struct uwsgi_request_histograms *histograms_workers;
+	struct uwsgi_request_histograms *histograms_apps;
+	struct uwsgi_request_histograms *histograms_routes;
+	struct uwsgi_string_list *histograms_labels;
+
+	char *metrics_http;
+	int metrics_http_fd;
+
+	int stats_thread;
+	int stats_msgpack;
+
+	char *trace_spans;
+	uint64_t trace_ring_size;
+	uint64_t trace_sample;
+	int trace_flush_interval;
+	struct uwsgi_trace_ring **trace_rings;
+
+	struct uwsgi_bench_options bench;
+
+	int spooler_index;
+	uint64_t spooler_index_size;
+
+	uint64_t spooler_log_segment_size;
+	int spooler_log_fsync;
+
+	int spooler_threads;
+
+	int queue_ring;
+	struct uwsgi_queue_ring *queue_ring_header;
+
+	int rpc_pool;
+	int rpc_keepalive;
+	int rpc_mule_slots;
+	uint64_t rpc_mule_bufsize;
+	struct uwsgi_rpc_channel *rpc_channels;
+
+	uint64_t mule_msg_ring;
+	int mule_msg_ring_block;
+	struct uwsgi_mule_ring *mules_msg_ring;
+	struct uwsgi_string_list *farms_fanout;
+
+	// the pending signals of signal_socket and my_signal_socket
+	struct uwsgi_signal_bitmap *signal_bitmap;
+	struct uwsgi_signal_bitmap *my_signal_bitmap;
 };
 
 struct uwsgi_rpc {
@@ -2818,6 +3152,21 @@ struct uwsgi_rpc {
 	struct uwsgi_plugin *plugin;
 };
 
+// a request/response slot of a mule rpc channel (in shared memory)
+struct uwsgi_rpc_slot {
+	uint32_t state;
+	// the caller that claimed the slot, 0 when free
+	pid_t owner;
+	uint64_t len;
+	char buf[];
+};
+
+struct uwsgi_rpc_channel {
+	// the callers write a byte here to wake up the mule
+	int doorbell[2];
+	char *slots;
+};
+
 struct uwsgi_signal_entry {
 	int wid;
 	uint8_t modifier1;
@@ -2825,6 +3174,19 @@ struct uwsgi_signal_entry {
 	void *handler;
 };
 
+/*
+	the signals pending on a signal socket (in shared memory)
+
+	the master sets the bit of the signal and writes a wakeup byte to the socket
+	only if the receiver is not already armed: bursts of the same signal coalesce
+	and the receiver handles all of the pending signals in a single batch
+*/
+struct uwsgi_signal_bitmap {
+	uint64_t pending[4];
+	// a wakeup byte is in flight
+	uint32_t armed;
+};
+
 /*
 they are here for backwards compatibility
 */
@@ -2931,6 +3293,23 @@ struct uwsgi_shared {
 	uint64_t overloaded;
 
 	int ready;
+
+	// the request log rings consumer is waiting on the logpipe
+	int req_log_ring_sleeping;
+
+	uint64_t trace_send_errors;
+
+	// bumped whenever an rpc function is registered
+	uint64_t rpc_generation;
+
+	// pending signals of the workers, spoolers and mules pools
+	struct uwsgi_signal_bitmap worker_signals;
+	struct uwsgi_signal_bitmap spooler_signals;
+	struct uwsgi_signal_bitmap mule_signals;
+	// signals raised by workers, spoolers and mules (routed by the master)
+	struct uwsgi_signal_bitmap master_signals;
+	// signals merged with an already pending one
+	uint64_t coalesced_signals;
 };
 
 struct uwsgi_core {
@@ -2964,6 +3343,73 @@ struct uwsgi_core {
 	// uWSGI 2.1
 	time_t harakiri;
 	time_t user_harakiri;
+
+	// heap allocations done by the request arena
+	uint64_t arena_overflows;
+};
+
+// bucket i holds values in the [2^(i-1), 2^i) range, the last one is open
+#define UWSGI_LOG2_HISTOGRAM_BUCKETS 24
+#define uwsgi_log2_bucket(x) ((x) ? ((64 - __builtin_clzll(x)) < UWSGI_LOG2_HISTOGRAM_BUCKETS ? (64 - __builtin_clzll(x)) : UWSGI_LOG2_HISTOGRAM_BUCKETS - 1) : 0)
+
+// log-linear (HDR-style) histograms, values >= 2^UWSGI_HISTOGRAM_MAX_EXP go in the last bucket
+#define UWSGI_HISTOGRAM_SUB_BITS 3
+#define UWSGI_HISTOGRAM_SUB (1 << UWSGI_HISTOGRAM_SUB_BITS)
+#define UWSGI_HISTOGRAM_MAX_EXP 40
+#define UWSGI_HISTOGRAM_BUCKETS (UWSGI_HISTOGRAM_SUB + ((UWSGI_HISTOGRAM_MAX_EXP - UWSGI_HISTOGRAM_SUB_BITS) * UWSGI_HISTOGRAM_SUB))
+
+struct uwsgi_histogram {
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[UWSGI_HISTOGRAM_BUCKETS];
+};
+
+struct uwsgi_request_histograms {
+	struct uwsgi_histogram rt;
+	struct uwsgi_histogram queue;
+	struct uwsgi_histogram size;
+};
+
+struct uwsgi_request_ring_item {
+	uint64_t seq;
+	// -1 for signals
+	int fd;
+	// the signal socket with pending signals
+	int signal_fd;
+	struct uwsgi_socket *socket;
+	struct sockaddr_un c_addr;
+	int c_len;
+	uint64_t accepted_at;
+};
+
+// bounded single producer/multiple consumers ring used by --thread-acceptor
+struct uwsgi_request_ring {
+	uint64_t head;
+	uint64_t tail;
+	uint64_t mask;
+	struct uwsgi_request_ring_item *items;
+	// used only for sleeping
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	int sleepers;
+	int acceptor_waiting;
+	pthread_t acceptor;
+	int stopped;
+};
+
+// datagrams read in a single shot by uwsgi_dgram_batch_recv()
+struct uwsgi_dgram_batch {
+	int max;
+	size_t buf_size;
+	// max * buf_size bytes
+	char *buf;
+	ssize_t *len;
+	struct sockaddr_storage *addr;
+	socklen_t *addr_len;
+	// platform specific (struct mmsghdr and struct iovec on Linux)
+	void *msgs;
+	void *iov;
 };
 
 struct uwsgi_worker {
@@ -3022,6 +3468,12 @@ struct uwsgi_worker {
 	int accepting;
 
 	char name[0xff];
+
+	// --thread-acceptor histograms (log2 buckets)
+	uint64_t ring_wait[UWSGI_LOG2_HISTOGRAM_BUCKETS];
+	uint64_t ring_depth[UWSGI_LOG2_HISTOGRAM_BUCKETS];
+
+	struct uwsgi_signal_bitmap signals_pending;
 };
 
 
@@ -3049,6 +3501,11 @@ struct uwsgi_mule {
 
 	time_t cursed_at;
 	time_t no_mercy_at;
+
+	// --mule-msg-ring
+	struct uwsgi_mule_ring *msg_ring;
+
+	struct uwsgi_signal_bitmap signals_pending;
 };
 
 struct uwsgi_mule_farm {
@@ -3065,6 +3522,37 @@ struct uwsgi_farm {
 
 	struct uwsgi_mule_farm *mules;
 
+	// messages are copied to all of the mules instead of being balanced
+	int fanout;
+	// --mule-msg-ring
+	struct uwsgi_mule_ring *msg_ring;
+
+	struct uwsgi_signal_bitmap signals_pending;
+};
+
+/*
+	--mule-msg-ring: worker->mule messages are stored in shared memory rings (one for the mules pool,
+	one per mule and one per farm), the queue socketpairs are only used to wake up sleeping mules.
+	Every message is prefixed by its enqueue time (usec) for the latency stats.
+*/
+#define UWSGI_MULE_MSG_SHARED 1
+#define UWSGI_MULE_MSG_OWN 2
+#define UWSGI_MULE_MSG_FARMS 4
+
+struct uwsgi_mule_ring {
+	// the futex is bumped by consumers when senders are waiting for room (ring.waiters)
+	struct uwsgi_queue_ring ring;
+	// mules sleeping in poll()/epoll, a byte is written to wake_fd when > 0
+	uint32_t sleeping __attribute__ ((aligned(64)));
+	int wake_fd;
+	char *name;
+	char *data;
+	uint64_t pushed;
+	uint64_t pulled;
+	uint64_t dropped;
+	uint64_t blocked;
+	// usec between the push and the pull
+	struct uwsgi_histogram latency;
 };
 
 
@@ -3329,6 +3817,9 @@ int uwsgi_register_rpc(char *, struct uwsgi_plugin *, uint8_t, void *);
 uint64_t uwsgi_rpc(char *, uint8_t, char **, uint16_t *, char **);
 char *uwsgi_do_rpc(char *, char *, uint8_t, char **, uint16_t *, uint64_t *);
 void uwsgi_rpc_init(void);
+int uwsgi_rpc_mule_fd(void);
+void uwsgi_rpc_mule_serve(void);
+void uwsgi_rpc_mule_recover(void);
 
 char *uwsgi_cheap_string(char *, int);
 
@@ -3367,6 +3858,12 @@ char *uwsgi_queue_pull(uint64_t *);
 int uwsgi_queue_push(char *, uint64_t);
 char *uwsgi_queue_pop(uint64_t *);
 int uwsgi_queue_set(uint64_t, char *, uint64_t);
+int uwsgi_queue_ring_push(char *, uint64_t);
+char *uwsgi_queue_ring_pull(uint64_t *, int);
+int uwsgi_ring_reserve(struct uwsgi_queue_ring *, char *, uint64_t, struct uwsgi_ring_slot *);
+int uwsgi_ring_publish(struct uwsgi_queue_ring *, char *, struct uwsgi_ring_slot *);
+int uwsgi_ring_consume(struct uwsgi_queue_ring *, char *, struct uwsgi_ring_slot *);
+int uwsgi_ring_release(struct uwsgi_queue_ring *, char *, struct uwsgi_ring_slot *);
 
 
 struct uwsgi_subscribe_req {
@@ -3645,6 +4142,7 @@ struct uwsgi_mule *get_mule_by_id(int);
 struct uwsgi_mule_farm *uwsgi_mule_farm_new(struct uwsgi_mule_farm **, struct uwsgi_mule *);
 
 int uwsgi_farm_has_mule(struct uwsgi_farm *, int);
+int uwsgi_mule_in_fanout_farm(int);
 struct uwsgi_farm *get_farm_by_name(char *);
 
 struct uwsgi_subscription_client {
@@ -3735,6 +4233,9 @@ int uwsgi_remove_subscribe_node(struct uwsgi_subscribe_slot **, struct uwsgi_sub
 struct uwsgi_subscribe_node *uwsgi_add_subscribe_node(struct uwsgi_subscribe_slot **, struct uwsgi_subscribe_req *);
 
 ssize_t uwsgi_mule_get_msg(int, int, char *, size_t, int);
+ssize_t uwsgi_mule_ring_get(int, char *, size_t);
+void uwsgi_mule_ring_sleeping(int, int);
+void uwsgi_mule_ring_drain(int);
 
 int uwsgi_signal_wait(struct wsgi_request *, int);
 struct uwsgi_app *uwsgi_add_app(int, uint8_t, char *, int, void *, void *);
@@ -3768,6 +4269,10 @@ void uwsgi_apply_cap(cap_value_t *, int);
 #endif
 
 void uwsgi_register_logger(char *, ssize_t(*func) (struct uwsgi_logger *, char *, size_t));
+void uwsgi_register_batch_logger(char *, ssize_t(*func) (struct uwsgi_logger *, char *, size_t), ssize_t(*batch_func) (struct uwsgi_logger *, struct iovec *, size_t));
+void uwsgi_logger_batch_flush(struct uwsgi_logger *);
+int uwsgi_log_batches_flush(int);
+int uwsgi_logger_send_datagrams(struct uwsgi_logger *, struct iovec *, size_t, size_t);
 void uwsgi_append_logger(struct uwsgi_logger *);
 void uwsgi_append_req_logger(struct uwsgi_logger *);
 struct uwsgi_logger *uwsgi_get_logger(char *);
@@ -3966,6 +4471,38 @@ int uwsgi_cheaper_algo_manual(int);
 
 int uwsgi_master_log(void);
 int uwsgi_master_req_log(void);
+void uwsgi_req_log_rings_init(void);
+int uwsgi_req_log_ring_push(struct iovec *, int);
+void uwsgi_req_log_write(struct iovec *, int);
+
+void uwsgi_histogram_add(struct uwsgi_histogram *, uint64_t, int);
+void uwsgi_histogram_merge(struct uwsgi_histogram *, struct uwsgi_histogram *);
+uint64_t uwsgi_histogram_count(struct uwsgi_histogram *);
+uint64_t uwsgi_histogram_count_below(struct uwsgi_histogram *, uint64_t);
+uint64_t uwsgi_histogram_quantile(struct uwsgi_histogram *, uint64_t, uint64_t);
+void uwsgi_histograms_init(void);
+int uwsgi_histogram_label(char *);
+void uwsgi_histograms_account(struct wsgi_request *);
+void uwsgi_histograms_register_metrics(void);
+
+void uwsgi_bench(void);
+
+void uwsgi_tracing_init(void);
+void uwsgi_tracing_start_exporter(void);
+void uwsgi_trace_context_new(struct uwsgi_trace_context *, struct uwsgi_trace_context *);
+int uwsgi_trace_context_parse(struct uwsgi_trace_context *, char *, size_t);
+int uwsgi_trace_context_format(struct uwsgi_trace_context *, char *);
+void uwsgi_trace_span_push(struct uwsgi_trace_context *, uint16_t, uint64_t, uint64_t, uint64_t, uint64_t, uint16_t, uint16_t);
+uint64_t uwsgi_trace_new_id(void);
+struct uwsgi_trace_context *uwsgi_trace_request_context(struct wsgi_request *);
+void uwsgi_trace_request(struct wsgi_request *);
+
+struct uwsgi_buffer *uwsgi_openmetrics_render(int);
+void uwsgi_openmetrics_bind(void);
+void uwsgi_openmetrics_send(int);
+void uwsgi_req_log_rings_consume(void (*)(char *, size_t));
+void uwsgi_req_log_ring_recover(int, void (*)(char *, size_t));
+void uwsgi_master_req_log_ring_recover(int);
 void uwsgi_flush_logs(void);
 
 void uwsgi_register_cheaper_algo(char *, int (*)(int));
@@ -3973,6 +4510,8 @@ void uwsgi_register_cheaper_algo(char *, int (*)(int));
 void uwsgi_setup_locking(void);
 int uwsgi_fcntl_lock(int);
 int uwsgi_fcntl_is_locked(int);
+int uwsgi_futex_wait(uint32_t *, uint32_t, int);
+int uwsgi_futex_wake(uint32_t *, int);
 
 void uwsgi_emulate_cow_for_apps(int);
 
@@ -4001,6 +4540,12 @@ int uwsgi_is_dir(char *);
 int uwsgi_is_link(char *);
 
 void uwsgi_receive_signal(struct wsgi_request *, int, char *, int);
+int uwsgi_read_signal(int, char *, int);
+int uwsgi_signal_dispatch(struct wsgi_request *, int, char *, int, int);
+int uwsgi_signal_pending(struct uwsgi_signal_bitmap *);
+void uwsgi_route_pending_signals(void);
+void uwsgi_signal_kick_all(void);
+void uwsgi_signal_disarm(int);
 void uwsgi_exec_atexit(void);
 
 struct uwsgi_stats {
@@ -4011,6 +4556,8 @@ struct uwsgi_stats {
 	size_t size;
 	int minified;
 	int dirty;
+	// when >= 0 the output is streamed to it by uwsgi_stats_flush()
+	int fd;
 };
 
 struct uwsgi_stats_pusher_instance;
@@ -4046,6 +4593,11 @@ void uwsgi_stats_pusher_loop(struct uwsgi_thread *);
 void uwsgi_stats_pusher_setup(void);
 void uwsgi_send_stats(int, struct uwsgi_stats *(*func) (void));
 struct uwsgi_stats *uwsgi_master_generate_stats(void);
+int uwsgi_master_generate_stats_sections(struct uwsgi_stats *, char *);
+int uwsgi_stats_flush(struct uwsgi_stats *);
+struct uwsgi_buffer *uwsgi_stats_to_msgpack(char *, size_t);
+void uwsgi_master_send_stats(int);
+void uwsgi_stats_thread_start(void);
 struct uwsgi_stats_pusher * uwsgi_register_stats_pusher(char *, void (*)(struct uwsgi_stats_pusher_instance *, time_t, char *, size_t));
 
 struct uwsgi_stats *uwsgi_stats_new(size_t);
@@ -4067,6 +4619,12 @@ int uwsgi_stats_keylong_comma(struct uwsgi_stats *, char *, unsigned long long);
 int uwsgi_stats_keyslong(struct uwsgi_stats *, char *, long long);
 int uwsgi_stats_keyslong_comma(struct uwsgi_stats *, char *, long long);
 int uwsgi_stats_str(struct uwsgi_stats *, char *);
+int uwsgi_stats_long(struct uwsgi_stats *, unsigned long long);
+int uwsgi_stats_keylongs(struct uwsgi_stats *, char *, uint64_t *, size_t);
+int uwsgi_stats_keylongs_comma(struct uwsgi_stats *, char *, uint64_t *, size_t);
+int uwsgi_stats_request_histograms(struct uwsgi_stats *, char *, struct uwsgi_request_histograms *);
+int uwsgi_stats_histogram(struct uwsgi_stats *, char *, struct uwsgi_histogram *);
+int uwsgi_stats_histograms(struct uwsgi_stats *);
 
 char *uwsgi_substitute(char *, char *, char *);
 
@@ -4122,12 +4680,17 @@ struct uwsgi_logchunk {
 	int free;
 	ssize_t(*func) (struct wsgi_request *, char **);
 	struct uwsgi_logchunk *next;
+	int64_t(*num) (struct wsgi_request *);
 };
 
 void uwsgi_build_log_format(char *);
 
 void uwsgi_add_logchunk(int, int, char *, size_t);
 struct uwsgi_logchunk *uwsgi_register_logchunk(char *, ssize_t (*)(struct wsgi_request *, char **), int);
+struct uwsgi_logchunk *uwsgi_register_logchunk_num(char *, int64_t (*)(struct wsgi_request *));
+void uwsgi_logformat_init(void);
+size_t uwsgi_logformat_render(struct wsgi_request *, char *, size_t);
+void uwsgi_logit_lf_compiled(struct wsgi_request *);
 
 void uwsgi_logit_simple(struct wsgi_request *);
 void uwsgi_logit_lf(struct wsgi_request *);
@@ -4244,6 +4807,7 @@ void uwsgi_bind_sockets(void);
 void uwsgi_set_sockets_protocols(void);
 
 struct uwsgi_buffer *uwsgi_buffer_new(size_t);
+struct uwsgi_buffer *uwsgi_buffer_new_arena(struct uwsgi_arena *, size_t);
 int uwsgi_buffer_append(struct uwsgi_buffer *, char *, size_t);
 int uwsgi_buffer_fix(struct uwsgi_buffer *, size_t);
 int uwsgi_buffer_ensure(struct uwsgi_buffer *, size_t);
@@ -4278,6 +4842,16 @@ struct uwsgi_buffer *uwsgi_buffer_from_file(char *);
 
 ssize_t uwsgi_buffer_write_simple(struct wsgi_request *, struct uwsgi_buffer *);
 
+struct uwsgi_arena *uwsgi_arena_new(size_t);
+void *uwsgi_arena_alloc(struct uwsgi_arena *, size_t);
+void *uwsgi_arena_calloc(struct uwsgi_arena *, size_t);
+void uwsgi_arena_adopt(struct uwsgi_arena *, void *);
+void uwsgi_arena_reset(struct uwsgi_arena *);
+char *uwsgi_arena_strncpy(struct uwsgi_arena *, char *, size_t);
+struct uwsgi_arena *uwsgi_req_arena(struct wsgi_request *);
+void *uwsgi_req_alloc(struct wsgi_request *, size_t);
+void uwsgi_req_arena_reset(struct wsgi_request *);
+
 struct uwsgi_buffer *uwsgi_to_http(struct wsgi_request *, char *, uint16_t, char *, uint16_t);
 struct uwsgi_buffer *uwsgi_to_http_dumb(struct wsgi_request *, char *, uint16_t, char *, uint16_t);
 
@@ -4383,6 +4957,11 @@ struct uwsgi_offload_request {
 
 	void *data;
 	void (*free)(struct uwsgi_offload_request *);
+
+	// --trace-spans
+	struct uwsgi_trace_context trace;
+	uint64_t trace_start;
+	uint16_t trace_core;
 };
 
 struct uwsgi_offload_engine {
@@ -4421,6 +5000,9 @@ void uwsgi_daemons_smart_check();
 
 void uwsgi_setup_thread_req(long, struct wsgi_request *);
 void uwsgi_loop_cores_run(void *(*)(void *));
+void uwsgi_thread_acceptor_loop(void);
+void uwsgi_thread_acceptor_stop(void);
+void uwsgi_thread_acceptor_drain(void);
 
 int uwsgi_kvlist_parse(char *, size_t, char, char, ...);
 int uwsgi_send_http_stats(int);
@@ -4518,6 +5100,8 @@ struct uwsgi_buffer *uwsgi_proto_base_prepare_headers(struct wsgi_request *, cha
 struct uwsgi_buffer *uwsgi_proto_base_cgi_prepare_headers(struct wsgi_request *, char *, uint16_t);
 int uwsgi_response_write_body_do(struct wsgi_request *, char *, size_t);
 int uwsgi_response_writev_body_do(struct wsgi_request *, struct iovec *, size_t);
+int uwsgi_response_flush(struct wsgi_request *);
+void uwsgi_response_flush_current(void);
 
 int uwsgi_proto_base_sendfile(struct wsgi_request *, int, size_t, size_t);
 #ifdef UWSGI_SSL
@@ -4573,6 +5157,7 @@ void uwsgi_unblock_signal(int);
 int uwsgi_worker_is_busy(int);
 
 void uwsgi_post_accept(struct wsgi_request *);
+void uwsgi_heartbeat(void);
 void uwsgi_tcp_nodelay(int);
 
 struct uwsgi_exception_handler_instance;
@@ -4868,6 +5453,7 @@ int uwsgi_metric_set_max(char *, char *, int64_t);
 int uwsgi_metric_set_min(char *, char *, int64_t);
 
 struct uwsgi_metric_collector *uwsgi_register_metric_collector(char *, int64_t (*)(struct uwsgi_metric *));
+int64_t uwsgi_metric_collector_histogram(struct uwsgi_metric *);
 struct uwsgi_metric *uwsgi_register_metric(char *, char *, uint8_t, char *, void *, uint32_t, void *);
 
 void uwsgi_metrics_collectors_setup(void);
@@ -4913,7 +5499,20 @@ int uwsgi_sharedarea_dec8(int, uint64_t, int8_t);
 int uwsgi_sharedarea_dec16(int, uint64_t, int16_t);
 int uwsgi_sharedarea_dec32(int, uint64_t, int32_t);
 int uwsgi_sharedarea_dec64(int, uint64_t, int64_t);
+int uwsgi_sharedarea_load64(int, uint64_t, int64_t *);
+int uwsgi_sharedarea_fetch_add64(int, uint64_t, int64_t, int64_t *);
+int uwsgi_sharedarea_cas64(int, uint64_t, int64_t, int64_t, int64_t *);
+int uwsgi_sharedarea_swap64(int, uint64_t, int64_t, int64_t *);
+int uwsgi_sharedarea_max64(int, uint64_t, int64_t, int64_t *);
+int uwsgi_sharedarea_min64(int, uint64_t, int64_t, int64_t *);
 int uwsgi_sharedarea_wait(int, int, int);
+int64_t uwsgi_sharedarea_hashmap_get(int, char *, uint16_t, char *, uint64_t);
+int uwsgi_sharedarea_hashmap_set(int, char *, uint16_t, char *, uint64_t);
+int uwsgi_sharedarea_hashmap_del(int, char *, uint16_t);
+int uwsgi_sharedarea_hashmap_inc(int, char *, uint16_t, int64_t, int64_t *);
+int uwsgi_sharedarea_hashmap_foreach(int, int (*)(char *, uint16_t, char *, uint64_t, void *), void *);
+int64_t uwsgi_sharedarea_hashmap_count(int);
+uint64_t uwsgi_sharedarea_hashmap_valuesize(int);
 int uwsgi_sharedarea_unlock(int);
 int uwsgi_sharedarea_rlock(int);
 int uwsgi_sharedarea_wlock(int);
@@ -4944,6 +5543,8 @@ void vassal_sos();
 
 int uwsgi_send_fds_and_body(int, int *, int, char *, size_t);
 ssize_t uwsgi_recv_cred_and_fds(int, char *, size_t buf_len, pid_t *, uid_t *, gid_t *, int *, int *);
+struct uwsgi_dgram_batch *uwsgi_dgram_batch_new(int, size_t);
+int uwsgi_dgram_batch_recv(int, struct uwsgi_dgram_batch *);
 void uwsgi_fork_server(char *);
 
 void uwsgi_emperor_ini_attrs(char *, char *, struct uwsgi_dyn_dict **);
@@ -4978,6 +5579,7 @@ int uwsgi_zeus_spawn_instance(struct uwsgi_instance *);
 
 time_t uwsgi_parse_http_date(char *, uint16_t);
 void uwsgi_spooler_cheap_check(void);
+void uwsgi_spooler_log_init(struct uwsgi_spooler *);
 #ifdef __cplusplus
 }
 #endif
@@ -81,6 +81,7 @@ report = {
     'ssl': False,
     'xml': False,
     'debug': False,
+    'usdt': False,
     'plugin_dir': False,
     'zlib': False,
 }
@@ -602,8 +603,8 @@ class uConf(object):
             'core/mount', 'core/metrics', 'core/plugins_builder',
             'core/sharedarea', 'core/fork_server', 'core/webdav', 'core/zeus',
             'core/rpc', 'core/gateway', 'core/loop', 'core/cookie',
-            'core/querystring', 'core/rb_timers', 'core/transformations',
-            'core/uwsgi',
+            'core/querystring', 'core/rb_timers', 'core/timer_wheel', 'core/arena', 'core/log_ring', 'core/logformat', 'core/histogram', 'core/openmetrics', 'core/tracing', 'core/bench',
+            'core/transformations', 'core/uwsgi',
         ]
         # add protocols
         self.gcc_list.append('proto/base')
@@ -1276,6 +1277,14 @@ class uConf(object):
             self.cflags.append("-g")
             report['debug'] = True
 
+        if self.get('usdt'):
+            if self.has_include('sys/sdt.h'):
+                self.cflags.append("-DUWSGI_USDT")
+                report['usdt'] = True
+            elif self.get('usdt') != 'auto':
+                print("*** sys/sdt.h unavailable. uWSGI build is interrupted. You have to install the systemtap sdt development package or disable usdt")
+                sys.exit(1)
+
         if self.get('unbit'):
             self.cflags.append("-DUNBIT")
 